@@ -955,6 +955,7 @@ int XrdConfig::Setup(char *dfltp)
 // Setup the link and socket polling infrastructure
 //
    XrdLink::Init(&Log, &Trace, &Sched);
+   XrdLink::Init(&BuffPool);
    XrdPoll::Init(&Log, &Trace, &Sched);
    if (!XrdLink::Setup(ProtInfo.ConnMax, ProtInfo.idleWait)
    ||  !XrdPoll::Setup(ProtInfo.ConnMax)) return 1;
@@ -1252,7 +1253,8 @@ int XrdConfig::xbuf(XrdSysError *eDest, XrdOucStream &Config)
    Purpose:  To parse directive: network [wan] [[no]keepalive] [buffsz <blen>]
                                          [kaparms parms] [cache <ct>] [[no]dnr]
                                          [routes <rtype> [use <ifn1>,<ifn2>]]
-                                         [[no]rpipa]
+                                         [[no]rpipa] [[no]asyncsf]
+                                         [zerocopy <zmin>]
 
              <rtype>: split | common | local
 
@@ -1264,6 +1266,11 @@ int XrdConfig::xbuf(XrdSysError *eDest, XrdOucStream &Config)
              [no]dnr   do [not] perform a reverse DNS lookup if not needed.
              routes    specifies the network configuration (see reference)
              [no]rpipa do [not] resolve private IP addresses.
+             [no]asyncsf do [not] queue sendfile() data that cannot be sent
+                       without blocking, instead of waiting for the client.
+             <zmin>    responses of at least <zmin> bytes that are read into a
+                       buffer (i.e. not sent via sendfile()) are sent using
+                       zero-copy (0 disables).
 
    Output: 0 upon success or !0 upon failure.
 */
@@ -1272,13 +1279,15 @@ int XrdConfig::xnet(XrdSysError *eDest, XrdOucStream &Config)
 {
     char *val;
     int  i, n, V_keep = -1, V_nodnr = 0, V_iswan = 0, V_blen = -1, V_ct = -1, V_assumev4;
-    int  v_rpip = -1;
+    int  v_rpip = -1, V_asf = -1, V_zcmin = -1;
     long long llp;
     struct netopts {const char *opname; int hasarg; int opval;
                            int *oploc;  const char *etxt;}
            ntopts[] =
        {
         {"assumev4",   0, 1, &V_assumev4, "option"},
+        {"asyncsf",    0, 1, &V_asf,    "option"},
+        {"noasyncsf",  0, 0, &V_asf,    "option"},
         {"keepalive",  0, 1, &V_keep,   "option"},
         {"nokeepalive",0, 0, &V_keep,   "option"},
         {"kaparms",    4, 0, &V_keep,   "option"},
@@ -1289,7 +1298,8 @@ int XrdConfig::xnet(XrdSysError *eDest, XrdOucStream &Config)
         {"routes",     3, 1, 0,         "routes"},
         {"rpipa",      0, 1, &v_rpip,   "rpipa"},
         {"norpipa",    0, 0, &v_rpip,   "norpipa"},
-        {"wan",        0, 1, &V_iswan,  "option"}
+        {"wan",        0, 1, &V_iswan,  "option"},
+        {"zerocopy",   1, 0, &V_zcmin,  "network zerocopy"}
        };
     int numopts = sizeof(ntopts)/sizeof(struct netopts);
 
@@ -1362,6 +1372,8 @@ int XrdConfig::xnet(XrdSysError *eDest, XrdOucStream &Config)
      if (V_ct >= 0) XrdNetAddr::SetCache(V_ct);
      if (v_rpip >= 0) XrdInet::netIF.SetRPIPA(v_rpip != 0);
      if (V_assumev4 >= 0) XrdInet::SetAssumeV4(true);
+     if (V_asf >= 0) XrdLink::sfAsync = (V_asf != 0);
+     if (V_zcmin >= 0) XrdLink::zcMin = V_zcmin;
      return 0;
 }
 
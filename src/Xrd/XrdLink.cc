@@ -35,6 +35,7 @@
 #include <sys/uio.h>
 
 #ifdef __linux__
+#include <linux/errqueue.h>
 #include <netinet/tcp.h>
 #if !defined(TCP_CORK)
 #undef HAVE_SENDFILE
@@ -102,6 +103,34 @@ int                idleTicks;
 
 static const char *TraceID;
 };
+
+/******************************************************************************/
+/*                   C l a s s   X r d L i n k Z C R e a p                    */
+/******************************************************************************/
+
+// Takes over the zero-copy buffers the kernel still holds when a link is
+// closed, along with a duplicate of the socket which keeps its error queue
+// around. The buffers go back to the pool as their completions arrive.
+
+class XrdLinkZCReap : XrdJob
+{
+public:
+
+void          DoIt();
+
+              XrdLinkZCReap(int fd, XrdLink::zcBuff *zl)
+                           : XrdJob("zero-copy reaper"), FD(fd), zList(zl),
+                             Left(zcWait) {}
+             ~XrdLinkZCReap() {}
+
+private:
+
+static const int zcWait = 300;  // Seconds we wait for the kernel
+
+int              FD;
+XrdLink::zcBuff *zList;
+int              Left;
+};
   
 /******************************************************************************/
 /*                               S t a t i c s                                */
@@ -111,12 +140,15 @@ static const char *TraceID;
        XrdOucTrace    *XrdLink::XrdTrace = 0;
        XrdScheduler   *XrdLink::XrdSched = 0;
        XrdInet        *XrdLink::XrdNetTCP= 0;
+       XrdBuffManager *XrdLink::BuffPool = 0;
 
 #if defined(HAVE_SENDFILE)
        int             XrdLink::sfOK = 1;
 #else
        int             XrdLink::sfOK = 0;
 #endif
+       bool            XrdLink::sfAsync = false;
+       int             XrdLink::zcMin   = 0;
 
        XrdLink       **XrdLink::LinkTab;
        char           *XrdLink::LinkBat;
@@ -135,6 +167,8 @@ static const char *TraceID;
        int             XrdLink::LinkTimeOuts  = 0;
        int             XrdLink::LinkStalls    = 0;
        int             XrdLink::LinkSfIntr    = 0;
+       long long       XrdLink::LinkZcBytes   = 0;
+       int             XrdLink::LinkZcCopy    = 0;
        int             XrdLink::maxFD         = 0;
        XrdSysMutex     XrdLink::statsMutex;
 
@@ -175,12 +209,19 @@ void XrdLink::Reset()
   Next     = 0;
 #endif
   sendQ    = 0;
+  sqPerm   = 0;
   Protocol = 0; 
   ProtoAlt = 0;
   conTime  = time(0);
   stallCnt = stallCntTot = 0;
   tardyCnt = tardyCntTot = 0;
   SfIntr   = 0;
+  ZcBytes  = 0;
+  ZcCopy   = 0;
+  zcOK     = 0;
+  zcUsed   = 0;
+  zcSent   = 0;
+  zcList   = 0;
   InUse    = 1;
   Poller   = 0; 
   PollEnt  = 0;
@@ -412,6 +453,11 @@ int XrdLink::Close(int defer)
        LTMutex.UnLock();
       } else opHelper.UnLock();
 
+// Return the zero-copy buffers the kernel is done with to the pool. Any others
+// are handed off so that we never wait for the kernel here.
+//
+   if (zcUsed) {if (fd >= 2) reapZC(fd); zcFree(fd);}
+
 // Close the file descriptor if it isn't being shared. Do it as the last
 // thing because closes and accepts and not interlocked.
 //
@@ -544,6 +590,24 @@ int XrdLink::getName(int &curr, char *nbuf, int nbsz, XrdLinkMatch *who)
    return 0;
 }
 
+/******************************************************************************/
+/* private                      g e t S e n d Q                               */
+/******************************************************************************/
+
+// Get a sendQ object if we don't already have one. If perm is true, all output
+// will go through it; otherwise only while it has messages queued. We also get
+// the opMutex as sendQ is protected by both locks.
+//
+void XrdLink::getSendQ(bool perm)
+{
+   opMutex.Lock();
+   wrMutex.Lock();
+   if (!sendQ) sendQ = new XrdSendQ(*this, wrMutex);
+   if (perm) sqPerm = 1;
+   wrMutex.UnLock();
+   opMutex.UnLock();
+}
+
 /******************************************************************************/
 /*                                  P e e k                                   */
 /******************************************************************************/
@@ -719,9 +783,10 @@ int XrdLink::Send(const char *Buff, int Blen)
    isIdle = 0;
    AtomicAdd(BytesOut, Blen);
 
-// Do non-blocking writes if we are setup to do so.
+// Do non-blocking writes if we are setup to do so or if parked file data must
+// go out first.
 //
-   if (sendQ)
+   if (sendQd())
       {retc = sendQ->Send(Buff, Blen);
        wrMutex.UnLock();
        return retc;
@@ -748,6 +813,13 @@ int XrdLink::Send(const char *Buff, int Blen)
 /******************************************************************************/
   
 int XrdLink::Send(const struct iovec *iov, int iocnt, int bytes)
+{
+   return Send(iov, iocnt, bytes, 0);
+}
+
+/******************************************************************************/
+
+int XrdLink::Send(const struct iovec *iov, int iocnt, int bytes, XrdBuffer *bP)
 {
    ssize_t bytesleft, n, retc = 0;
    const char *Buff;
@@ -763,14 +835,31 @@ int XrdLink::Send(const struct iovec *iov, int iocnt, int bytes)
    isIdle = 0;
    AtomicAdd(BytesOut, bytes);
 
-// Do non-blocking writes if we are setup to do so.
+// Return whatever buffers the kernel has let go of since our last send
 //
-   if (sendQ)
+   if (zcUsed) reapZC(FD);
+
+// Do non-blocking writes if we are setup to do so or if parked file data must
+// go out first. The queue copies the data so the buffer can go right back.
+//
+   if (sendQd())
       {retc = sendQ->Send(iov, iocnt, bytes);
        wrMutex.UnLock();
+       if (bP) BuffPool->Release(bP);
        return retc;
       }
 
+// Large responses in a buffer we were given may be sent without copying them
+// into the kernel. The buffer is released once the kernel is done with it.
+//
+   if (bP && zcMin && bytes >= zcMin && zcOK >= 0 && BuffPool
+   &&  (retc = sendZC(iov, iocnt, bP)) != -2)
+      {wrMutex.UnLock();
+       if (retc >= 0) return bytes;
+       XrdLog->Emsg("Link", errno, "send to", ID);
+       return -1;
+      }
+
 // Write the data out. On some version of Unix (e.g., Linux) a writev() may
 // end at any time without writing all the bytes when directed to a socket.
 // So, we attempt to resume the writev() using a combination of write() and
@@ -798,6 +887,7 @@ int XrdLink::Send(const struct iovec *iov, int iocnt, int bytes)
 // All done
 //
    wrMutex.UnLock();
+   if (bP) BuffPool->Release(bP);
    if (retc >= 0) return bytes;
    XrdLog->Emsg("Link", errno, "send to", ID);
    return -1;
@@ -816,6 +906,21 @@ int XrdLink::Send(const sfVec *sfP, int sfN)
        return -1;
       }
 
+// A vector that only refers to memory (e.g. an SSI active stream response) is
+// sent as a single gather write which avoids a system call per element. The
+// kernel still copies the data; zero-copy is not possible as the caller reuses
+// the memory as soon as we return.
+//
+   {struct iovec ioV[XrdOucSFVec::sfMax];
+    int ioN, ioBytes = 0;
+    for (ioN = 0; ioN < sfN && sfP[ioN].fdnum < 0; ioN++)
+        {ioV[ioN].iov_base = sfP[ioN].buffer;
+         ioV[ioN].iov_len  = sfP[ioN].sendsz;
+         ioBytes += sfP[ioN].sendsz;
+        }
+    if (ioN >= sfN) return Send(ioV, ioN, ioBytes);
+   }
+
 #ifdef __solaris__
     sendfilevec_t vecSF[XrdOucSFVec::sfMax], *vecSFP = vecSF;
     size_t xframt, totamt, bytes = 0;
@@ -884,11 +989,29 @@ do{retc = sendfilev(FD, vecSFP, sfN, &xframt);
    off_t myOffset;
    int i, xfrbytes = 0, uncork = 1, xIntr = 0;
 
+// If file data may be queued, make sure we have a send queue. It is created
+// once per link and never goes away until the link is closed. Unlike with
+// setNB(), other output only goes through it while it holds parked data.
+//
+   if (sfAsync && !sendQ) getSendQ(false);
+
 // lock the link
 //
    wrMutex.Lock();
    isIdle = 0;
 
+// With a send queue we send what we can without blocking and park the rest
+// to be sent by the queue's own thread. This frees the caller from waiting on
+// a slow client.
+//
+   if (sendQ)
+      {for (i = 0; i < sfN; i++) xfrbytes += sfP[i].sendsz;
+       AtomicAdd(BytesOut, xfrbytes);
+       retc = sendQ->Send(sfP, sfN, xfrbytes);
+       wrMutex.UnLock();
+       return retc;
+      }
+
 // In linux we need to cork the socket. On permanent errors we do not uncork
 // the socket because it will be closed in short order.
 //
@@ -958,6 +1081,253 @@ int XrdLink::sendData(const char *Buff, int Blen)
    return retc;
 }
 
+/******************************************************************************/
+/* private                        s e n d Q d                                 */
+/******************************************************************************/
+
+// Called with wrMutex locked. Returns true if output must go via the sendQ,
+// either because we are non-blocking or because there is data parked in it
+// that must go out first. Once it is drained we send directly again.
+
+bool XrdLink::sendQd()
+{
+   return sendQ && (sqPerm || sendQ->Busy());
+}
+
+/******************************************************************************/
+/* private                        s e n d Z C                                 */
+/******************************************************************************/
+
+// Called with wrMutex locked. Returns -2 if the data should be sent the usual
+// way (the caller keeps the buffer), -1 on error, and 0 once all the data has
+// been handed to the kernel. In the last two cases the buffer is ours and goes
+// back to the pool once the kernel has told us it no longer needs it.
+
+int XrdLink::sendZC(const struct iovec *iov, int iocnt, XrdBuffer *bP)
+{
+#if !defined(__linux__) || !defined(SO_ZEROCOPY) || !defined(MSG_ZEROCOPY)
+   return -2;
+#else
+   static const int zcIOV = 64, zcOpen = 0x40000000;
+   struct iovec  ioV[zcIOV];
+   struct msghdr msg;
+   zcBuff *zbP;
+   const char *bBeg = bP->buff, *bEnd = bP->buff + bP->bsize, *iBeg;
+   unsigned int seqBeg = zcSent;
+   ssize_t retc = 0;
+   int i, j, msgF, zcF = MSG_ZEROCOPY;
+   bool inBuff[zcIOV];
+
+// Enable zero-copy on the socket the first time around
+//
+   if (!zcOK)
+      {static const int setON = 1;
+       if (setsockopt(FD, SOL_SOCKET, SO_ZEROCOPY, &setON, sizeof(setON)))
+          {TRACEI(DEBUG, "zero-copy unavailable; errno=" <<errno);
+           zcOK = -1; return -2;
+          }
+       zcOK = 1;
+      }
+
+// We need a modifiable copy of the vector to resume partial sends. Only the
+// segments that lie in the buffer are handed to the kernel as they are, the
+// rest (e.g. a response header) may be reused as soon as we return.
+//
+   if (iocnt > zcIOV) return -2;
+   for (i = 0; i < iocnt; i++)
+       {ioV[i] = iov[i];
+        iBeg = (const char *)iov[i].iov_base;
+        inBuff[i] = iBeg >= bBeg && iBeg + iov[i].iov_len <= bEnd;
+       }
+   memset(&msg, 0, sizeof(msg));
+
+// Completions may be posted while we are still sending, so the buffer must be
+// on the list beforehand. Until we know how many sends it took, it is open.
+//
+   zbP = new zcBuff;
+   zbP->bP     = bP;
+   zbP->seqBeg = seqBeg;
+   zbP->seqNum = zcOpen;
+   zcMutex.Lock();
+   zbP->next = zcList; zcList = zbP; zcUsed = 1;
+   zcMutex.UnLock();
+
+// Send each run of segments. If the kernel cannot pin any more pages for us
+// (ENOBUFS) we simply copy the rest of the data.
+//
+   for (i = 0; i < iocnt && retc >= 0; i = j)
+       {for (j = i+1; j < iocnt && inBuff[j] == inBuff[i]; j++) {}
+        msg.msg_iov = &ioV[i]; msg.msg_iovlen = j - i;
+        while(msg.msg_iovlen)
+             {msgF = (inBuff[i] ? zcF : 0) | (j < iocnt ? MSG_MORE : 0);
+              do {retc = sendmsg(FD, &msg, msgF);} while(retc < 0 && errno == EINTR);
+              if (retc < 0)
+                 {if (errno == ENOBUFS && (msgF & MSG_ZEROCOPY)) {zcF = 0; continue;}
+                  break;
+                 }
+              if (msgF & MSG_ZEROCOPY) {zcSent++; ZcBytes += retc;}
+              while(msg.msg_iovlen && retc >= (ssize_t)msg.msg_iov->iov_len)
+                   {retc -= msg.msg_iov->iov_len; msg.msg_iov++; msg.msg_iovlen--;}
+              if (retc)
+                 {msg.msg_iov->iov_base = (char *)msg.msg_iov->iov_base + retc;
+                  msg.msg_iov->iov_len -= retc;
+                 }
+             }
+       }
+
+// Now close the buffer's range. The kernel holds on to it until every send that
+// used it has completed (even on error); if all of them have, it goes back now.
+//
+   zcMutex.Lock();
+   zbP->seqNum -= zcOpen - static_cast<int>(zcSent - seqBeg);
+   zcDone(zcList, seqBeg, seqBeg-1);
+   zcMutex.UnLock();
+   return (retc < 0 ? -1 : 0);
+#endif
+}
+
+/******************************************************************************/
+/* private                        r e a p Z C                                 */
+/******************************************************************************/
+
+// Collects the zero-copy completions the kernel has posted for fd and releases
+// the buffers it is done with. Nothing blocks. Returns false if the socket
+// reported an actual error.
+
+bool XrdLink::reapZC(int fd)
+{
+   XrdSysMutexHelper zcHelper(zcMutex);
+   int  zcCopied = 0;
+   bool aOK = zcReap(fd, zcList, zcCopied);
+
+// If the kernel had to copy the data anyway (e.g. loopback or a device that
+// cannot do scatter-gather) then zero-copy only costs us; stop using it.
+//
+   if (zcCopied) {AtomicAdd(ZcCopy, zcCopied); zcOK = -1;}
+   return aOK;
+}
+
+/******************************************************************************/
+/* private                        z c D o n e                                 */
+/******************************************************************************/
+
+// Sends seqBeg through seqEnd have completed. Completions may be coalesced and
+// need not arrive in order, so each buffer counts down the sends it was part
+// of; those at zero are released. The caller serializes access to the list.
+
+void XrdLink::zcDone(zcBuff *&zList, unsigned int seqBeg, unsigned int seqEnd)
+{
+   zcBuff *zbP = zList, *pbP = 0;
+   int lo, hi;
+
+   while(zbP)
+        {lo = static_cast<int>(seqBeg - zbP->seqBeg);
+         hi = static_cast<int>(seqEnd - zbP->seqBeg);
+         if (lo < 0) lo = 0;
+         if (hi >= zbP->seqNum) hi = zbP->seqNum - 1;
+         if (hi >= lo) zbP->seqNum -= hi - lo + 1;
+         if (zbP->seqNum > 0) {pbP = zbP; zbP = zbP->next; continue;}
+         if (pbP) pbP->next = zbP->next;
+            else  zList     = zbP->next;
+         BuffPool->Release(zbP->bP);
+         delete zbP;
+         zbP = (pbP ? pbP->next : zList);
+        }
+}
+
+/******************************************************************************/
+/* private                       z c E v e n t                                */
+/******************************************************************************/
+
+// Called by the poller when the socket reports an error. Zero-copy completions
+// are posted to the socket's error queue and look just like one. Returns true
+// if, once they are reaped, there is no actual error on the socket.
+
+bool XrdLink::zcEvent()
+{
+   socklen_t sokLen = sizeof(int);
+   int sokErr;
+
+   if (!zcUsed || !reapZC(FD)) return false;
+   if (getsockopt(FD, SOL_SOCKET, SO_ERROR, &sokErr, &sokLen) || sokErr)
+      return false;
+   return true;
+}
+
+/******************************************************************************/
+/* private                        z c F r e e                                 */
+/******************************************************************************/
+
+// Called when the link is closed. Buffers the kernel still holds might still be
+// sent from, so they are handed to a reaper along with a duplicate of the
+// socket. Only if that is not possible are they lost.
+
+void XrdLink::zcFree(int fd)
+{
+   XrdSysMutexHelper zcHelper(zcMutex);
+   zcBuff *zbP;
+   char nBuff[16];
+   int dfd, n = 0;
+
+   zcUsed = 0;
+   if (!zcList) return;
+
+// The duplicate keeps the connection open, so shut it down ourselves
+//
+   if (fd >= 2 && (dfd = XrdSysFD_Dup(fd)) >= 0)
+      {if (!KeepFD) shutdown(fd, SHUT_RDWR);
+       XrdSched->Schedule((XrdJob *)new XrdLinkZCReap(dfd, zcList), time(0)+1);
+       zcList = 0;
+       return;
+      }
+
+   while((zbP = zcList)) {zcList = zbP->next; delete zbP; n++;}
+   sprintf(nBuff, "%d", n);
+   XrdLog->Emsg("Link", nBuff, "zero-copy buffers lost at close of", ID);
+}
+
+/******************************************************************************/
+/* private                        z c R e a p                                 */
+/******************************************************************************/
+
+// Collects the zero-copy completions the kernel has posted for fd and releases
+// the buffers in zList it is done with. Nothing blocks. zcCopied is increased
+// by the number of sends the kernel had to copy after all. Returns false if
+// the socket reported an actual error. The caller serializes access to zList.
+
+bool XrdLink::zcReap(int fd, zcBuff *&zList, int &zcCopied)
+{
+#if !defined(__linux__) || !defined(SO_EE_ORIGIN_ZEROCOPY)
+   return true;
+#else
+   struct sock_extended_err *serr;
+   struct cmsghdr *cmsg;
+   struct msghdr   msg;
+   char   cbuf[128];
+
+   while(zList)
+        {memset(&msg, 0, sizeof(msg));
+         msg.msg_control = cbuf; msg.msg_controllen = sizeof(cbuf);
+         if (recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+            {if (errno == EINTR) continue;
+             return errno == EAGAIN || errno == EWOULDBLOCK;
+            }
+         for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+             {if (!((cmsg->cmsg_level == SOL_IP   && cmsg->cmsg_type == IP_RECVERR)
+                ||  (cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR)))
+                 continue;
+              serr = (struct sock_extended_err *)CMSG_DATA(cmsg);
+              if (serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY || serr->ee_errno)
+                 {errno = (serr->ee_errno ? serr->ee_errno : EPROTO); return false;}
+              zcDone(zList, serr->ee_info, serr->ee_data);
+              if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+                 zcCopied += serr->ee_data - serr->ee_info + 1;
+             }
+        }
+   return true;
+#endif
+}
+
 /******************************************************************************/
 /*                              s e t E t e x t                               */
 /******************************************************************************/
@@ -1006,16 +1376,9 @@ bool XrdLink::setNB()
 //
    TRACEI(DEBUG,"enabling non-blocking output");
 
-// If we don't already have a sendQ object get one. This is a one-time call
-// so to optimize checking if this object exists we also get the opMutex.'
+// From now on all output goes through the send queue
 //
-   opMutex.Lock();
-   if (!sendQ)
-      {wrMutex.Lock();
-       sendQ = new XrdSendQ(*this, wrMutex);
-       wrMutex.UnLock();
-      }
-   opMutex.UnLock();
+   getSendQ(true);
    return true;
 #endif
 }
@@ -1185,12 +1548,13 @@ int XrdLink::Stats(char *buff, int blen, int do_sync)
    static const char statfmt[] = "<stats id=\"link\"><num>%d</num>"
           "<maxn>%d</maxn><tot>%lld</tot><in>%lld</in><out>%lld</out>"
           "<ctime>%lld</ctime><tmo>%d</tmo><stall>%d</stall>"
-          "<sfps>%d</sfps></stats>";
+          "<sfps>%d</sfps><sfq><bytes>%lld</bytes><stall>%d</stall></sfq>"
+          "<zc><bytes>%lld</bytes><copy>%d</copy></zc></stats>";
    int i, myLTLast;
 
 // Check if actual length wanted
 //
-   if (!buff) return sizeof(statfmt)+17*6;
+   if (!buff) return sizeof(statfmt)+17*10;
 
 // We must synchronize the statistical counters
 //
@@ -1212,7 +1576,11 @@ int XrdLink::Stats(char *buff, int blen, int do_sync)
                                      AtomicGet(LinkConTime),
                                      AtomicGet(LinkTimeOuts),
                                      AtomicGet(LinkStalls),
-                                     AtomicGet(LinkSfIntr));
+                                     AtomicGet(LinkSfIntr),
+                                     AtomicGet(XrdSendQ::sfqBytes),
+                                     AtomicGet(XrdSendQ::sfqStalls),
+                                     AtomicGet(LinkZcBytes),
+                                     AtomicGet(LinkZcCopy));
    AtomicEnd(statsMutex);
    return i;
 }
@@ -1263,6 +1631,10 @@ void XrdLink::syncStats(int *ctime)
    AtomicAdd(LinkBytesOut, tmpLL); AtomicAdd(BytesOutTot, tmpLL);
    tmpI4 = AtomicFAZ(SfIntr);
    AtomicAdd(LinkSfIntr, tmpI4);
+   tmpLL = AtomicFAZ(ZcBytes);
+   AtomicAdd(LinkZcBytes, tmpLL);
+   tmpI4 = AtomicFAZ(ZcCopy);
+   AtomicAdd(LinkZcCopy, tmpI4);
    AtomicEnd(statsMutex); AtomicEnd(wrMutex);
 
 // Make sure the protocol updates it's statistics as well
@@ -1417,3 +1789,32 @@ void XrdLinkScan::idleScan()
 //
    XrdSched->Schedule((XrdJob *)this, idleCheck+time(0));
 }
+
+/******************************************************************************/
+/*                  X r d L i n k Z C R e a p   M e t h o d s                 */
+/******************************************************************************/
+
+void XrdLinkZCReap::DoIt()
+{
+   XrdLink::zcBuff *zbP;
+   char nBuff[16];
+   int zcCopied = 0, n = 0;
+
+// Collect whatever completions have arrived. An error on the socket is of no
+// interest anymore as the link is gone. Check again while buffers remain.
+//
+   XrdLink::zcReap(FD, zList, zcCopied);
+   if (zList && --Left > 0)
+      {XrdLink::XrdSched->Schedule((XrdJob *)this, time(0)+1); return;}
+
+// Whatever the kernel never let go of cannot be reused
+//
+   while((zbP = zList)) {zList = zbP->next; delete zbP; n++;}
+   if (n)
+      {sprintf(nBuff, "%d", n);
+       XrdLink::XrdLog->Emsg("Link", nBuff, "zero-copy buffers never released "
+                             "by the kernel; lost.");
+      }
+   close(FD);
+   delete this;
+}
@@ -52,6 +52,8 @@
 /*                      C l a s s   D e f i n i t i o n                       */
 /******************************************************************************/
   
+class XrdBuffer;
+class XrdBuffManager;
 class XrdInet;
 class XrdNetAddr;
 class XrdPoll;
@@ -64,6 +66,7 @@ class XrdLink : XrdJob
 {
 public:
 friend class XrdLinkScan;
+friend class XrdLinkZCReap;
 friend class XrdPoll;
 friend class XrdPollPoll;
 friend class XrdPollDev;
@@ -152,6 +155,8 @@ static   void Init(XrdSysError *eP, XrdOucTrace *tP, XrdScheduler *sP)
 
 static   void Init(XrdInet *iP) {XrdNetTCP = iP;}
 
+static   void Init(XrdBuffManager *bP) {BuffPool = bP;}
+
 //-----------------------------------------------------------------------------
 //! Obtain the link's instance number.
 //!
@@ -210,8 +215,18 @@ int           RecvAll(char *buff, int blen, int timeout=-1);
 int           Send(const char *buff, int blen);
 int           Send(const struct iovec *iov, int iocnt, int bytes=0);
 
+// The link takes over bP, which must hold the data in iov (anything outside it
+// is copied), and releases it to the buffer pool once the data has been sent.
+// This allows large responses to go out without copying them (see zcMin).
+//
+int           Send(const struct iovec *iov, int iocnt, int bytes, XrdBuffer *bP);
+
 static int    sfOK;                   // True if Send(sfVec) enabled
 
+static bool   sfAsync;                // True if Send(sfVec) may queue data
+
+static int    zcMin;                  // Min bytes for a zero-copy Send(iov,bP)
+
 typedef XrdOucSFVec sfVec;
 
 int           Send(const sfVec *sdP, int sdn); // Iff sfOK > 0
@@ -254,13 +269,29 @@ int           hasBridge() {return isBridged;}
 
 private:
 
+void   getSendQ(bool perm);
 void   Reset();
 int    sendData(const char *Buff, int Blen);
+bool   sendQd();
+int    sendZC(const struct iovec *iov, int iocnt, XrdBuffer *bP);
+bool   reapZC(int fd);
+bool   zcEvent();
+void   zcFree(int fd);
+
+struct zcBuff {zcBuff      *next;
+               XrdBuffer   *bP;
+               unsigned int seqBeg;  // First zero-copy send using the buffer
+               int          seqNum;  // Number of such sends not yet completed
+              };
+
+static void zcDone(zcBuff *&zList, unsigned int seqBeg, unsigned int seqEnd);
+static bool zcReap(int fd, zcBuff *&zList, int &zcCopied);
 
 static XrdSysError  *XrdLog;
 static XrdOucTrace  *XrdTrace;
 static XrdScheduler *XrdSched;
 static XrdInet      *XrdNetTCP;
+static XrdBuffManager *BuffPool;
 
 static XrdSysMutex   LTMutex;    // For the LinkTab only LTMutex->IOMutex allowed
 static XrdLink     **LinkTab;
@@ -283,6 +314,8 @@ static int          LinkCountMax;
 static int          LinkTimeOuts;
 static int          LinkStalls;
 static int          LinkSfIntr;
+static long long    LinkZcBytes;
+static int          LinkZcCopy;
 static int          maxFD;
        long long        BytesIn;
        long long        BytesInTot;
@@ -293,6 +326,8 @@ static int          maxFD;
        int              tardyCnt;
        int              tardyCntTot;
        int              SfIntr;
+       long long        ZcBytes;
+       int              ZcCopy;
 static XrdSysMutex  statsMutex;
 
 // Identification section
@@ -310,6 +345,7 @@ XrdLink            *Next;    // Only used by PollPoll.icc
 XrdSysMutex         opMutex;
 XrdSysMutex         rdMutex;
 XrdSysMutex         wrMutex;
+XrdSysMutex         zcMutex;        // For zcList only, never held while sending
 XrdSysSemaphore     IOSemaphore;
 XrdSysCondVar      *KillcvP;        // Protected by opMutex!
 XrdSendQ           *sendQ;          // Protected by wrMutex && opMutex
@@ -330,6 +366,11 @@ char                isIdle;
 char                inQ;    // Only used by PollPoll.icc
 char                isBridged;
 char                KillCnt;        // Protected by opMutex!
+char                sqPerm;         // All output goes via sendQ (setNB())
+char                zcOK;           // Zero-copy: 0 untried, 1 on, -1 off
+char                zcUsed;         // Zero-copy sends were issued
+unsigned int        zcSent;         // Zero-copy sends issued    (wrMutex)
+zcBuff             *zcList;         // Buffers still held by the kernel
 static const char   KillMax =   60;
 static const char   KillMsk = 0x7f;
 static const char   KillXwt = 0x80;
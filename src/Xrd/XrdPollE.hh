@@ -57,6 +57,7 @@ protected:
 const  char *x2Text(unsigned int evf, char *buff);
 
 private:
+void reArm(XrdLink *lp);
 void remFD(XrdLink *lp, unsigned int events);
 
 #ifdef EPOLLONESHOT
@@ -28,17 +28,28 @@
 /* specific prior written permission of the institution or contributor.       */
 /******************************************************************************/
 
+#include <errno.h>
+#include <poll.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
 #include <sys/uio.h>
+
+#if defined(__linux__)
+#include <linux/sockios.h>
+#include <sys/sendfile.h>
+#endif
   
 #include "Xrd/XrdLink.hh"
 #include "Xrd/XrdScheduler.hh"
 #include "Xrd/XrdSendQ.hh"
 
+#include "XrdSys/XrdSysAtomics.hh"
 #include "XrdSys/XrdSysError.hh"
 #include "XrdSys/XrdSysPthread.hh"
+#include "XrdSys/XrdSysTimer.hh"
 
 /******************************************************************************/
 /*                         L o c a l   C l a s s e s                          */
@@ -73,6 +84,10 @@ unsigned int  XrdSendQ::qWarn = 3;
 unsigned int  XrdSendQ::qMax  = 0xffffffff;
 bool          XrdSendQ::qPerm = false;
 
+long long     XrdSendQ::sfqBytes  = 0;
+int           XrdSendQ::sfqStalls = 0;
+XrdSysMutex   XrdSendQ::sfqMutex;
+
 /******************************************************************************/
 /*                           C o n s t r u c t o r                            */
 /******************************************************************************/
@@ -102,14 +117,16 @@ void XrdSendQ::DoIt()
 //
    if (delQ) {RelMsgs(delQ); delQ = 0;}
 
-// Send all queued messages (we can use a blocking send here)
+// Send all queued messages (we can use a blocking send here). Messages may
+// refer to file data that was parked by a non-blocking sendfile() request.
 //
    while(!terminate && (theMsg = fMsg))
         {if (!(fMsg = fMsg->next)) lMsg = 0;
          inQ--; myFD = theFD;
          wMutex.UnLock();
-         rc = send(myFD, theMsg->mData, theMsg->mLen, 0);
-         free(theMsg);
+         if (theMsg->mFD < 0) rc = send(myFD, theMsg->mData, theMsg->mLen, 0);
+            else rc = SendFile(myFD, theMsg);
+         RelMsgs(theMsg, false);
          wMutex.Lock();
          if (rc < 0) {Scuttle(); break;}
         }
@@ -129,6 +146,24 @@ void XrdSendQ::DoIt()
    if (theEnd) delete this;
 }
   
+/******************************************************************************/
+/* Private:                       G e t M s g                                 */
+/******************************************************************************/
+
+XrdSendQ::mBuff *XrdSendQ::GetMsg(int dlen, int fd, off_t offs)
+{
+   mBuff *theMsg;
+
+// Allocate a message. File data is not copied, we just remember where it is.
+//
+   if (!(theMsg = (mBuff *)malloc(sizeof(mBuff) + (fd < 0 ? dlen : 0))))
+      {errno = ENOMEM; return 0;}
+   theMsg->mOff = offs;
+   theMsg->mFD  = fd;
+   theMsg->mLen = dlen;
+   return theMsg;
+}
+
 /******************************************************************************/
 /* Private:                         Q M s g                                   */
 /******************************************************************************/
@@ -184,12 +219,13 @@ bool XrdSendQ::QMsg(XrdSendQ::mBuff *theMsg)
 /* Private:                      R e l M s g s                                */
 /******************************************************************************/
 
-void XrdSendQ::RelMsgs(XrdSendQ::mBuff *mP)
+void XrdSendQ::RelMsgs(XrdSendQ::mBuff *mP, bool all)
 {
    mBuff *freeMP;
 
    while((freeMP = mP))
-        {mP = mP->next;
+        {mP = (all ? mP->next : 0);
+         if (freeMP->mFD >= 0) close(freeMP->mFD);
          free(freeMP);
         }
 }
@@ -230,14 +266,12 @@ int XrdSendQ::Send(const char *buff, int blen)
 
 // Allocate buffer for the message
 //
-   if (!(theMsg = (mBuff *)malloc(sizeof(mBuff) + bleft)))
-      {errno = ENOMEM;  return -1;}
+   if (!(theMsg = GetMsg(bleft))) return -1;
 
 // Copy the unsent message fragment
 //
    bsent = blen - bleft;
    memcpy(theMsg->mData, buff+bsent, bleft);
-   theMsg->mLen  = bleft;
 
 // Queue the message.
 //
@@ -275,12 +309,7 @@ int XrdSendQ::Send(const struct iovec *iov, int iovcnt, int iotot)
 
 // Copy the unsent message (for simplicity we will copy the whole iovec stop).
 //
-   if (!(theMsg = (mBuff *)malloc(bmore+sizeof(mBuff))))
-      {errno = ENOMEM;  return -1;}
-
-// Setup the message length
-//
-   theMsg->mLen = bmore;
+   if (!(theMsg = GetMsg(bmore))) return -1;
 
 // Copy the first fragment (it cannot be zero length)
 //
@@ -302,6 +331,109 @@ int XrdSendQ::Send(const struct iovec *iov, int iovcnt, int iotot)
    return (QMsg(theMsg) ? iotot : 0);
 }
 
+/******************************************************************************/
+
+// Called with wMutex locked.
+
+int XrdSendQ::Send(const XrdOucSFVec *sfP, int sfN, int sftot)
+{
+   mBuff *theMsg;
+   long long parked = 0;
+   int bleft, sfX, fd;
+
+// If the queue cannot take the whole response, push back on the caller until
+// the queue's thread has made room rather than failing the link. We must wait
+// before sending anything as the stream would otherwise be left half-sent.
+//
+   while(inQ && inQ + (unsigned int)sfN > qMax && !terminate)
+        {wMutex.UnLock();
+         XrdSysTimer::Wait(qWait);
+         wMutex.Lock();
+        }
+   if (terminate) {errno = ECANCELED; return -1;}
+
+// If there is an active thread handling messages then we have to queue it.
+// Otherwise try to send as much as we can without blocking. Whatever cannot be
+// sent is parked in the queue; file data is referenced, not copied.
+//
+   if (active)
+      {bleft = 0;
+       for (sfX = 0; sfX < sfN; sfX++) if ((bleft = sfP[sfX].sendsz)) break;
+       if (!bleft) return sftot;
+      } else {
+       if ((bleft = SendNB(sfP, sfN, sfX)) <= 0) return (bleft ? -1 : sftot);
+      }
+
+// A partially queued response would corrupt the data stream so make sure the
+// whole remainder fits in the queue before queueing anything.
+//
+   if (inQ + (unsigned int)(sfN - sfX) > qMax)
+      {Say->Emsg("SendQ", mLink.Host(), "appears to be slow; queue limit "
+                 "reached while sending file data!");
+       return -1;
+      }
+
+// Queue each remaining segment, the first one may have been partially sent.
+// We use a duplicate file descriptor as the file may be closed before we
+// get around to sending the data.
+//
+   for (; sfX < sfN; sfX++, bleft = 0)
+       {int sfOff = (bleft ? sfP[sfX].sendsz - bleft : 0);
+        int sfLen = sfP[sfX].sendsz - sfOff;
+        if (!sfLen) continue;
+        if (sfP[sfX].fdnum < 0)
+           {if (!(theMsg = GetMsg(sfLen))) return -1;
+            memcpy(theMsg->mData, sfP[sfX].buffer+sfOff, sfLen);
+           } else {
+            if ((fd = dup(sfP[sfX].fdnum)) < 0)
+               {Say->Emsg("SendQ", errno, "park file data for", mLink.ID);
+                return -1;
+               }
+            if (!(theMsg = GetMsg(sfLen, fd, sfP[sfX].offset+sfOff)))
+               {close(fd); return -1;}
+           }
+        if (!QMsg(theMsg)) {RelMsgs(theMsg, false); return -1;}
+        parked += sfLen;
+       }
+
+// Update statistics
+//
+   AtomicBeg(sfqMutex);
+   AtomicAdd(sfqBytes, parked);
+   AtomicInc(sfqStalls);
+   AtomicEnd(sfqMutex);
+   return sftot;
+}
+
+/******************************************************************************/
+/* Private:                     S e n d F i l e                               */
+/******************************************************************************/
+
+// Called with wMutex unlocked. This is a blocking call.
+
+int XrdSendQ::SendFile(int sockFD, mBuff *theMsg)
+{
+#if !defined(__linux__)
+   errno = ENOTSUP;
+   return -1;
+#else
+   off_t   myOffset = theMsg->mOff;
+   ssize_t retc = 0, bytesleft = theMsg->mLen;
+
+// Send the file data
+//
+   while(bytesleft)
+        {if ((retc = sendfile(sockFD, theMsg->mFD, &myOffset, bytesleft)) <= 0)
+            {if (retc < 0 && errno == EINTR) continue;
+             if (!retc) errno = ECANCELED;
+             return -1;
+            }
+         bytesleft -= retc;
+        }
+   return theMsg->mLen;
+#endif
+}
+
 /******************************************************************************/
 /*                                S e n d N B                                 */
 /******************************************************************************/
@@ -375,6 +507,91 @@ int XrdSendQ::SendNB(const struct iovec *iov, int iocnt, int bytes, int &iovX)
    return 0;
 #endif
 }
+
+/******************************************************************************/
+
+// Called with wMutex locked.
+
+int XrdSendQ::SendNB(const XrdOucSFVec *sfP, int sfN, int &sfX)
+{
+#if !defined(__linux__)
+   return -1;
+#else
+   off_t   myOffset;
+   ssize_t retc;
+   int     msgL, room, msgF = MSG_DONTWAIT|MSG_MORE, sfLast = sfN-1;
+
+// Write the data out. Memory segments use a non-blocking send() while file
+// segments use sendfile(), which has no non-blocking flag. To avoid blocking
+// we never ask sendfile() for more than the socket can currently take.
+//
+   for (sfX = 0; sfX < sfN; sfX++)
+       {msgL = sfP[sfX].sendsz;
+        if (sfX == sfLast) msgF &= ~MSG_MORE;
+        if (sfP[sfX].fdnum < 0)
+           {char *msgP = sfP[sfX].buffer;
+            while(msgL)
+                 {do {retc = send(theFD, msgP, msgL, msgF);}
+                     while(retc < 0 && errno == EINTR);
+                  if (retc <= 0)
+                     {if (!retc || errno == EAGAIN || errno == EWOULDBLOCK)
+                         return msgL;
+                      Say->Emsg("SendQ", errno, "send to", mLink.ID);
+                      return -1;
+                     }
+                  msgL -= retc; msgP += retc;
+                 }
+           } else {
+            myOffset = sfP[sfX].offset;
+            while(msgL)
+                 {if ((room = SendRoom()) <= 0) return msgL;
+                  do {retc = sendfile(theFD, sfP[sfX].fdnum, &myOffset,
+                                      (msgL < room ? msgL : room));
+                     } while(retc < 0 && errno == EINTR);
+                  if (retc <= 0)
+                     {if (retc < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                         return msgL;
+                      Say->Emsg("SendQ", (retc ? errno : ECANCELED),
+                                "send file to", mLink.ID);
+                      return -1;
+                     }
+                  msgL -= retc;
+                 }
+           }
+       }
+
+// All done
+//
+   return 0;
+#endif
+}
+
+/******************************************************************************/
+/*                              S e n d R o o m                               */
+/******************************************************************************/
+
+// Return the number of bytes the socket can take without blocking. As the
+// socket itself is blocking (others may read from it), we only report room
+// when poll() says the socket is writable. The kernel doubles the requested
+// buffer size for bookkeeping so only half of it is usable.
+
+int XrdSendQ::SendRoom()
+{
+#if !defined(__linux__) || !defined(SIOCOUTQ)
+   return 0;
+#else
+   struct pollfd polltab = {theFD, POLLOUT|POLLWRNORM, 0};
+   socklen_t optLen = sizeof(int);
+   int sndBuf, outQ, retc;
+
+   do {retc = poll(&polltab, 1, 0);} while(retc < 0 && errno == EINTR);
+   if (retc != 1 || !(polltab.revents & (POLLOUT|POLLWRNORM))) return 0;
+
+   if (getsockopt(theFD, SOL_SOCKET, SO_SNDBUF, &sndBuf, &optLen)
+   ||  ioctl(theFD, SIOCOUTQ, &outQ) < 0) return 0;
+   return sndBuf/2 - outQ;
+#endif
+}
   
 /******************************************************************************/
 /*                             T e r m i n a t e                              */
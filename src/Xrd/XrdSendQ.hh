@@ -32,9 +32,11 @@
 
 #include <string.h>
 #include <unistd.h>
+#include <sys/types.h>
 #include <sys/uio.h>
   
 #include "Xrd/XrdJob.hh"
+#include "XrdOuc/XrdOucSFVec.hh"
 
 class XrdLink;
 class XrdSysMutex;
@@ -45,6 +47,8 @@ public:
 
 unsigned int  Backlog() {return inQ;}
 
+         bool Busy()    {return active;} // True until the queue is drained
+
 virtual  void DoIt();
 
 static   void Init(XrdSysError *eP, XrdScheduler *sP) {Say = eP; Sched = sP;}
@@ -53,6 +57,8 @@ static   void Init(XrdSysError *eP, XrdScheduler *sP) {Say = eP; Sched = sP;}
 
          int  Send(const struct iovec *iov, int iovcnt, int iotot);
 
+         int  Send(const XrdOucSFVec *sfP, int sfN, int sftot);
+
 static   void SetAQ(bool onoff)         {qPerm = onoff;}
 
 static   void SetQM(unsigned int qmVal) {qMax  = qmVal;}
@@ -63,28 +69,41 @@ static   void SetQW(unsigned int qwVal) {qWarn = qwVal;}
 
          XrdSendQ(XrdLink &lP, XrdSysMutex &mP);
 
+// Statistics on sendfile() data that had to be parked in a queue
+//
+static   long long    sfqBytes;   // Bytes parked
+static   int          sfqStalls;  // Times a link had to park data
+static   XrdSysMutex  sfqMutex;
+
 private:
 
 virtual ~XrdSendQ() {}
 
 int      SendNB(const char *Buff, int Blen);
 int      SendNB(const struct iovec *iov, int iocnt, int bytes, int &iovX);
+int      SendNB(const XrdOucSFVec *sfP, int sfN, int &sfX);
+int      SendRoom();
 
 struct mBuff
 {
 mBuff *next;
+off_t  mOff;     // File offset when mFD >= 0
+int    mFD;      // File to send from or -1 if the data is in mData
 int    mLen;
-char   mData[4]; // Always made long enough
+char   mData[4]; // Always made long enough (unused for files)
 };
 
+mBuff   *GetMsg(int dlen, int fd=-1, off_t offs=0);
 bool     QMsg(mBuff *theMsg);
-void     RelMsgs(mBuff *mP);
+void     RelMsgs(mBuff *mP, bool all=true);
 void     Scuttle();
+int      SendFile(int sockFD, mBuff *theMsg);
 
 static XrdScheduler *Sched;
 static XrdSysError  *Say;
 static unsigned int  qWarn;
 static unsigned int  qMax;
+static const int     qWait = 10;  // Millisecs to wait for room in a full queue
 static bool          qPerm;
 XrdLink             &mLink;
 XrdSysMutex         &wMutex;
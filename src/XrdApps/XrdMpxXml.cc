@@ -131,6 +131,12 @@ std::map<const char *, const char *, vCmp> vnMap {
 {"ofs.tpc.deny",    "TPC denials:"},
 {"ofs.tpc.err",     "TPC errors:"},
 {"ofs.tpc.exp",     "TPC expires:"},
+{"ofs.lat.opn.n",   "Ofs opens timed:"},
+{"ofs.lat.opn.us",  "Ofs open  microseconds:"},
+{"ofs.lat.opn.max", "Ofs open  max microseconds:"},
+{"ofs.lat.cls.n",   "Ofs closes timed:"},
+{"ofs.lat.cls.us",  "Ofs close microseconds:"},
+{"ofs.lat.cls.max", "Ofs close max microseconds:"},
 {"oss.paths",       "Oss exports:"},
 {"oss.space",       "Oss space:"},
 {"sched.jobs",      "Tasks scheduled: "},
@@ -53,6 +53,8 @@ namespace XrdCl
   const int DefaultRunForkHandler          = 0;
   const int DefaultRedirectLimit           = 16;
   const int DefaultWorkerThreads           = 3;
+  const int DefaultWorkerThreadsMax        = 0;
+  const int DefaultWorkerQueueLatency      = 10;
   const int DefaultCPChunkSize             = 16777216;
   const int DefaultCPParallelChunks        = 4;
   const int DefaultDataServerTTL           = 300;
@@ -74,6 +76,8 @@ namespace XrdCl
   const int DefaultMaxMetalinkWait         = 60;
   const int DefaultPreserveLocateTried     = 1;
   const int DefaultNotAuthorizedRetryLimit = 3;
+  const int DefaultZipIndexSpan            = 1048576;
+  const int DefaultSortReplicas            = 1;
 
   const char * const DefaultPollerPreference   = "built-in";
   const char * const DefaultNetworkStack       = "IPAuto";
@@ -85,6 +89,7 @@ namespace XrdCl
   const char * const DefaultWriteRecovery      = "true";
   const char * const DefaultOpenRecovery       = "true";
   const char * const DefaultGlfnRedirector     = "";
+  const char * const DefaultPollerCPUs         = "";
 }
 
 #endif // __XRD_CL_CONSTANTS_HH__
@@ -273,6 +273,8 @@ namespace XrdCl
     REGISTER_VAR_INT( varsInt, "RunForkHandler",          DefaultRunForkHandler          );
     REGISTER_VAR_INT( varsInt, "RedirectLimit",           DefaultRedirectLimit           );
     REGISTER_VAR_INT( varsInt, "WorkerThreads",           DefaultWorkerThreads           );
+    REGISTER_VAR_INT( varsInt, "WorkerThreadsMax",        DefaultWorkerThreadsMax        );
+    REGISTER_VAR_INT( varsInt, "WorkerQueueLatency",      DefaultWorkerQueueLatency      );
     REGISTER_VAR_INT( varsInt, "CPChunkSize",             DefaultCPChunkSize             );
     REGISTER_VAR_INT( varsInt, "CPParallelChunks",        DefaultCPParallelChunks        );
     REGISTER_VAR_INT( varsInt, "DataServerTTL",           DefaultDataServerTTL           );
@@ -294,6 +296,8 @@ namespace XrdCl
     REGISTER_VAR_INT( varsInt, "MaxMetalinkWait",         DefaultMaxMetalinkWait         );
     REGISTER_VAR_INT( varsInt, "PreserveLocateTried",     DefaultPreserveLocateTried     );
     REGISTER_VAR_INT( varsInt, "NotAuthorizedRetryLimit", DefaultNotAuthorizedRetryLimit );
+    REGISTER_VAR_INT( varsInt, "ZipIndexSpan",            DefaultZipIndexSpan            );
+    REGISTER_VAR_INT( varsInt, "SortReplicas",            DefaultSortReplicas            );
 
     REGISTER_VAR_STR( varsStr, "PollerPreference",        DefaultPollerPreference        );
     REGISTER_VAR_STR( varsStr, "ClientMonitor",           DefaultClientMonitor           );
@@ -305,6 +309,7 @@ namespace XrdCl
     REGISTER_VAR_STR( varsStr, "WriteRecovery",           DefaultWriteRecovery           );
     REGISTER_VAR_STR( varsStr, "OpenRecovery",            DefaultOpenRecovery            );
     REGISTER_VAR_STR( varsStr, "GlfnRedirector",          DefaultGlfnRedirector          );
+    REGISTER_VAR_STR( varsStr, "PollerCPUs",              DefaultPollerCPUs              );
 
     //--------------------------------------------------------------------------
     // Process the configuration files
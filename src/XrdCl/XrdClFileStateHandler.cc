@@ -37,6 +37,7 @@
 #include "XrdCl/XrdClResponseJob.hh"
 #include "XrdCl/XrdClJobManager.hh"
 #include "XrdCl/XrdClUglyHacks.hh"
+#include "XrdCl/XrdClReplicaStats.hh"
 #include "XrdClRedirectorRegistry.hh"
 
 #include <sstream>
@@ -336,6 +337,8 @@ namespace XrdCl
     pFileHandle( 0 ),
     pOpenMode( 0 ),
     pOpenFlags( 0 ),
+    pOpenStart( 0 ),
+    pSortReplicas( DefaultSortReplicas ),
     pSessionId( 0 ),
     pDoRecoverRead( true ),
     pDoRecoverWrite( true ),
@@ -345,6 +348,9 @@ namespace XrdCl
   {
     pFileHandle = new uint8_t[4];
     ResetMonitoringVars();
+    int sortReplicas = DefaultSortReplicas;
+    DefaultEnv::GetEnv()->GetInt( "SortReplicas", sortReplicas );
+    pSortReplicas = sortReplicas;
     DefaultEnv::GetForkHandler()->RegisterFileObject( this );
     DefaultEnv::GetFileTimer()->RegisterFileObject( this );
     pLFileHandler = new LocalFileHandler();
@@ -366,6 +372,8 @@ namespace XrdCl
     pFileHandle( 0 ),
     pOpenMode( 0 ),
     pOpenFlags( 0 ),
+    pOpenStart( 0 ),
+    pSortReplicas( DefaultSortReplicas ),
     pSessionId( 0 ),
     pDoRecoverRead( true ),
     pDoRecoverWrite( true ),
@@ -375,6 +383,9 @@ namespace XrdCl
   {
     pFileHandle = new uint8_t[4];
     ResetMonitoringVars();
+    int sortReplicas = DefaultSortReplicas;
+    DefaultEnv::GetEnv()->GetInt( "SortReplicas", sortReplicas );
+    pSortReplicas = sortReplicas;
     DefaultEnv::GetForkHandler()->RegisterFileObject( this );
     DefaultEnv::GetFileTimer()->RegisterFileObject( this );
     pLFileHandler = new LocalFileHandler();
@@ -518,6 +529,7 @@ namespace XrdCl
     params.followRedirects = pFollowRedirects;
     MessageUtils::ProcessSendParams( params );
 
+    pOpenStart = ReplicaStats::Now();
     Status st = IssueRequest( *pFileUrl, msg, openHandler, params );
 
     if( !st.IsOK() )
@@ -1203,6 +1215,39 @@ namespace XrdCl
         }
     }
 
+    //--------------------------------------------------------------------------
+    // Keep the per host estimates used for ordering the replicas up to date.
+    // The open latency covers the whole redirect chain, so it is only
+    // sampled if no real redirector was asked first (a metalink is not
+    // one); it includes the time the data server itself made us wait.
+    //--------------------------------------------------------------------------
+    if( hostList )
+    {
+      pDataServerKey.clear();
+      if( pSortReplicas && !pDataServer->IsLocalFile() )
+        pDataServerKey = ReplicaStats::HostKey( *pDataServer );
+    }
+
+    if( hostList && !pDataServerKey.empty() )
+    {
+      ReplicaStats &stats = ReplicaStats::Instance();
+      if( status->IsOK() )
+      {
+        bool direct = true;
+        for( size_t i = 0; i + 1 < hostList->size(); ++i )
+        {
+          const HostInfo &hop = (*hostList)[i];
+          if( !hop.url.IsMetalink() && !( hop.flags & kXR_attrMeta ) )
+            { direct = false; break; }
+        }
+        if( direct )
+          stats.ReportLatency( pDataServerKey,
+                               ReplicaStats::Now() - pOpenStart );
+      }
+      else if( status->code != errErrorResponse )
+        stats.ReportFailure( pDataServerKey );
+    }
+
     log->Debug( FileMsg, "[0x%x@%s] Open has returned with status %s",
                 this, pFileUrl->GetURL().c_str(), status->ToStr().c_str() );
 
@@ -1329,6 +1374,10 @@ namespace XrdCl
     XrdSysMutexHelper scopedLock( pMutex );
     pInTheFly.erase( message );
 
+    if( status->code != errErrorResponse && status->code != errRedirect &&
+        !pDataServerKey.empty() )
+      ReplicaStats::Instance().ReportFailure( pDataServerKey );
+
     log->Dump( FileMsg, "[0x%x@%s] File state error encountered. Message %s "
                "returned with %s", this, pFileUrl->GetURL().c_str(),
                message->GetDescription().c_str(), status->ToStr().c_str() );
@@ -1427,9 +1476,16 @@ namespace XrdCl
 
     //--------------------------------------------------------------------------
     // Since this message may be the last "in-the-fly" and no recovery
-    // is done if messages are in the fly, we may need to trigger recovery
+    // is done if messages are in the fly, we may need to trigger recovery.
+    // Messages resent after a recovery are not timed.
     //--------------------------------------------------------------------------
-    pInTheFly.erase( message );
+    uint64_t issued = 0;
+    std::map<Message*, uint64_t>::iterator itr = pInTheFly.find( message );
+    if( itr != pInTheFly.end() )
+    {
+      issued = itr->second;
+      pInTheFly.erase( itr );
+    }
     RunRecovery();
 
     //--------------------------------------------------------------------------
@@ -1458,6 +1514,12 @@ namespace XrdCl
       {
         ++pRCount;
         pRBytes += req->read.rlen;
+        ChunkInfo *chunk = 0;
+        response->Get( chunk );
+        if( issued && chunk )
+          ReplicaStats::Instance().ReportTransfer( pDataServerKey,
+                                                   chunk->length,
+                                                   ReplicaStats::Now() - issued );
         break;
       }
 
@@ -1472,6 +1534,12 @@ namespace XrdCl
         for( size_t i = 0; i < segs; ++i )
           pVRBytes += dataChunk[i].rlen;
         pVSegs += segs;
+        VectorReadInfo *info = 0;
+        response->Get( info );
+        if( issued && info )
+          ReplicaStats::Instance().ReportTransfer( pDataServerKey,
+                                                   info->GetSize(),
+                                                   ReplicaStats::Now() - issued );
         break;
       }
 
@@ -1585,6 +1653,7 @@ namespace XrdCl
     if( pFileState == Opened )
     {
       msg->SetSessionId( pSessionId );
+      uint64_t issued = pDataServerKey.empty() ? 0 : ReplicaStats::Now();
       Status st = IssueRequest( *pDataServer, msg, handler, sendParams );
 
       //------------------------------------------------------------------------
@@ -1595,7 +1664,7 @@ namespace XrdCl
         return RecoverMessage( RequestData( msg, handler, sendParams ), false );
 
       if( st.IsOK() )
-        pInTheFly.insert(msg);
+        pInTheFly[msg] = issued;
       else
         delete handler;
       return st;
@@ -1778,6 +1847,7 @@ namespace XrdCl
     //--------------------------------------------------------------------------
     // Issue the open request
     //--------------------------------------------------------------------------
+    pOpenStart = ReplicaStats::Now();
     Status st = IssueRequest( url, msg, openHandler, params );
 
     // if there was a problem destroy the open handler
@@ -32,6 +32,7 @@
 #include "XrdSys/XrdSysPthread.hh"
 #include "XrdCl/XrdClLocalFileHandler.hh"
 #include <list>
+#include <map>
 #include <set>
 
 #include <sys/uio.h>
@@ -468,8 +469,11 @@ namespace XrdCl
       uint8_t                *pFileHandle;
       uint16_t                pOpenMode;
       uint16_t                pOpenFlags;
+      uint64_t                pOpenStart;
+      bool                    pSortReplicas;  // sample the replica stats
+      std::string             pDataServerKey; // empty if not sampling
       RequestList             pToBeRecovered;
-      std::set<Message*>      pInTheFly;
+      std::map<Message*, uint64_t> pInTheFly; // message -> time it was issued
       uint64_t                pSessionId;
       bool                    pDoRecoverRead;
       bool                    pDoRecoverWrite;
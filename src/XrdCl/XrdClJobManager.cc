@@ -21,6 +21,48 @@
 #include "XrdCl/XrdClDefaultEnv.hh"
 #include "XrdCl/XrdClConstants.hh"
 
+#include <algorithm>
+#include <sched.h>
+#include <time.h>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  // Size of the lock-free ring, jobs queued beyond it go to the overflow
+  //----------------------------------------------------------------------------
+  const size_t JobRingSize = 4096;
+
+  //----------------------------------------------------------------------------
+  // Time the queue latency needs to stay below the threshold for an idle
+  // worker to retire (in microseconds)
+  //----------------------------------------------------------------------------
+  const uint64_t RetireIdleTime = 30000000;
+
+  //----------------------------------------------------------------------------
+  // The worker the current thread is running as, if any
+  //----------------------------------------------------------------------------
+  thread_local XrdCl::JobManager::Worker *tlsWorker = 0;
+}
+
+namespace XrdCl
+{
+  //----------------------------------------------------------------------------
+  // A worker slot
+  //----------------------------------------------------------------------------
+  struct JobManager::Worker
+  {
+    Worker( JobManager *m, uint32_t i ):
+      manager( m ), id( i ), thread( 0 ), pending( 0 ), active( false ) {}
+    JobManager            *manager;
+    uint32_t               id;
+    pthread_t              thread;
+    XrdSysMutex            mutex;
+    std::deque<JobHelper>  local;
+    std::atomic<uint32_t>  pending;
+    bool                   active;
+  };
+}
+
 //------------------------------------------------------------------------------
 // The thread
 //------------------------------------------------------------------------------
@@ -29,14 +71,45 @@ extern "C"
   static void *RunRunnerThread( void *arg )
   {
     using namespace XrdCl;
-    JobManager *mgr = (JobManager*)arg;
-    mgr->RunJobs();
+    JobManager::Worker *worker = (JobManager::Worker*)arg;
+    worker->manager->RunJobs( worker );
     return 0;
   }
 }
 
 namespace XrdCl
 {
+  //----------------------------------------------------------------------------
+  // Constructor
+  //----------------------------------------------------------------------------
+  JobManager::JobManager( uint32_t workers, uint32_t maxWorkers,
+                          uint32_t queueLatency ):
+    pJobs( JobRingSize ),
+    pOverflowSize( 0 ),
+    pSem( new Semaphore( 0 ) ),
+    pMinWorkers( workers ),
+    pMaxWorkers( std::max( workers, maxWorkers ) ),
+    pNumWorkers( 0 ),
+    pQueueLatency( (uint64_t)queueLatency * 1000 ),
+    pLastBusy( 0 ),
+    pRunning( false ),
+    pStopping( false )
+  {
+    pWorkers.reserve( pMaxWorkers );
+    for( uint32_t i = 0; i < pMaxWorkers; ++i )
+      pWorkers.push_back( new Worker( this, i ) );
+  }
+
+  //----------------------------------------------------------------------------
+  // Destructor
+  //----------------------------------------------------------------------------
+  JobManager::~JobManager()
+  {
+    for( uint32_t i = 0; i < pWorkers.size(); ++i )
+      delete pWorkers[i];
+    delete pSem;
+  }
+
   //----------------------------------------------------------------------------
   // Initialize the job manager
   //----------------------------------------------------------------------------
@@ -51,6 +124,17 @@ namespace XrdCl
   bool JobManager::Finalize()
   {
     pJobs.Clear();
+    XrdSysMutexHelper scopedLock( pOverflowMutex );
+    pOverflow.clear();
+    pOverflowSize = 0;
+    for( uint32_t i = 0; i < pWorkers.size(); ++i )
+    {
+      XrdSysMutexHelper workerLock( pWorkers[i]->mutex );
+      pWorkers[i]->local.clear();
+      pWorkers[i]->pending = 0;
+    }
+    delete pSem;
+    pSem = new Semaphore( 0 );
     return true;
   }
 
@@ -69,20 +153,24 @@ namespace XrdCl
       return false;
     }
 
-    for( uint32_t i = 0; i < pWorkers.size(); ++i )
+    pLastBusy = Now();
+    for( uint32_t i = 0; i < pMinWorkers; ++i )
     {
-      int ret = ::pthread_create( &pWorkers[i], 0, ::RunRunnerThread, this );
-      if( ret != 0 )
+      if( !SpawnWorker() )
       {
-        log->Error( JobMgrMsg, "Unable to spawn a job worker thread: %s",
-                    strerror( errno ) );
-        if( i > 0 )
-          StopWorkers( i-1 );
+        std::vector<Worker*> started( pWorkers.begin(), pWorkers.begin()+i );
+        StopWorkers( started );
+        pNumWorkers = 0;
         return false;
       }
     }
     pRunning = true;
-    log->Debug( JobMgrMsg, "Job manager started, %d workers", pWorkers.size() );
+    if( pMaxWorkers > pMinWorkers )
+      log->Debug( JobMgrMsg, "Job manager started, %d workers (up to %d, "
+                  "queue latency threshold %llu ms)", pMinWorkers,
+                  pMaxWorkers, (unsigned long long)pQueueLatency / 1000 );
+    else
+      log->Debug( JobMgrMsg, "Job manager started, %d workers", pMinWorkers );
     return true;
   }
 
@@ -91,62 +179,276 @@ namespace XrdCl
   //----------------------------------------------------------------------------
   bool JobManager::Stop()
   {
-    XrdSysMutexHelper scopedLock( pMutex );
     Log *log = DefaultEnv::GetLog();
     log->Debug( JobMgrMsg, "Stopping the job manager..." );
-    if( !pRunning )
+
+    //--------------------------------------------------------------------------
+    // The workers may need the mutex to spawn a peer or to retire, so we
+    // only hold it to freeze the set of the active ones
+    //--------------------------------------------------------------------------
+    std::vector<Worker*> active;
     {
-      log->Error( JobMgrMsg, "The job manager is not running" );
-      return false;
+      XrdSysMutexHelper scopedLock( pMutex );
+      if( !pRunning || pStopping )
+      {
+        log->Error( JobMgrMsg, "The job manager is not running" );
+        return false;
+      }
+      pStopping = true;
+      for( uint32_t i = 0; i < pWorkers.size(); ++i )
+        if( pWorkers[i]->active )
+          active.push_back( pWorkers[i] );
     }
 
-    StopWorkers( pWorkers.size()-1 );
+    StopWorkers( active );
 
-    pRunning = false;
+    XrdSysMutexHelper scopedLock( pMutex );
+    pNumWorkers = 0;
+    pStopping   = false;
+    pRunning    = false;
     log->Debug( JobMgrMsg, "Job manager stopped" );
     return true;
   }
 
   //----------------------------------------------------------------------------
-  // Stop all workers up to n'th
+  // Stop the given workers
   //----------------------------------------------------------------------------
-  void JobManager::StopWorkers( uint32_t n )
+  void JobManager::StopWorkers( const std::vector<Worker*> &workers )
   {
     Log *log = DefaultEnv::GetLog();
-    for( uint32_t i = 0; i <= n; ++i )
+    for( uint32_t i = 0; i < workers.size(); ++i )
     {
       void *threadRet;
-      log->Dump( JobMgrMsg, "Stopping worker #%d...", i );
-      if( pthread_cancel( pWorkers[i] ) != 0 )
+      uint32_t id = workers[i]->id;
+      log->Dump( JobMgrMsg, "Stopping worker #%d...", id );
+      if( pthread_cancel( workers[i]->thread ) != 0 )
       {
-        log->Error( TaskMgrMsg, "Unable to cancel worker #%d: %s", i,
+        log->Error( TaskMgrMsg, "Unable to cancel worker #%d: %s", id,
                     strerror( errno ) );
         abort();
       }
-      
-      if( pthread_join( pWorkers[i], (void**)&threadRet ) != 0 )
+
+      if( pthread_join( workers[i]->thread, (void**)&threadRet ) != 0 )
       {
-        log->Error( TaskMgrMsg, "Unable to join worker #%d: %s", i,
+        log->Error( TaskMgrMsg, "Unable to join worker #%d: %s", id,
                     strerror( errno ) );
         abort();
       }
 
-      log->Dump( JobMgrMsg, "Worker #%d stopped", i );
+      workers[i]->active = false;
+      log->Dump( JobMgrMsg, "Worker #%d stopped", id );
     }
   }
 
   //----------------------------------------------------------------------------
-  // Initialize the job manager
+  // Spawn a worker in a free slot
+  //----------------------------------------------------------------------------
+  bool JobManager::SpawnWorker()
+  {
+    Log *log = DefaultEnv::GetLog();
+    for( uint32_t i = 0; i < pWorkers.size(); ++i )
+    {
+      Worker *worker = pWorkers[i];
+      if( worker->active )
+        continue;
+
+      int ret = ::pthread_create( &worker->thread, 0, ::RunRunnerThread,
+                                  worker );
+      if( ret != 0 )
+      {
+        log->Error( JobMgrMsg, "Unable to spawn a job worker thread: %s",
+                    strerror( ret ) );
+        return false;
+      }
+      worker->active = true;
+      ++pNumWorkers;
+      return true;
+    }
+    return false;
+  }
+
   //----------------------------------------------------------------------------
-  void JobManager::RunJobs()
+  // Add a job to be run
+  //----------------------------------------------------------------------------
+  void JobManager::QueueJob( Job *job, void *arg )
   {
+    JobHelper h( job, arg, pMaxWorkers > pMinWorkers ? Now() : 0 );
+
+    //--------------------------------------------------------------------------
+    // Jobs queued by our own workers stay with them unless someone steals
+    // them
+    //--------------------------------------------------------------------------
+    Worker *worker = tlsWorker;
+    if( worker && worker->manager == this )
+    {
+      XrdSysMutexHelper scopedLock( worker->mutex );
+      worker->local.push_back( h );
+      worker->pending.store( worker->local.size(), std::memory_order_relaxed );
+    }
+    else if( !pJobs.Put( h ) )
+    {
+      XrdSysMutexHelper scopedLock( pOverflowMutex );
+      pOverflow.push_back( h );
+      pOverflowSize.store( pOverflow.size(), std::memory_order_relaxed );
+    }
+    pSem->Post();
+  }
+
+  //----------------------------------------------------------------------------
+  // Check if the calling thread is one of our workers
+  //----------------------------------------------------------------------------
+  bool JobManager::IsWorker()
+  {
+    return tlsWorker && tlsWorker->manager == this;
+  }
+
+  //----------------------------------------------------------------------------
+  // Take a job from any of the queues
+  //----------------------------------------------------------------------------
+  bool JobManager::GetJob( Worker *worker, JobHelper &h )
+  {
+    if( worker->pending.load( std::memory_order_relaxed ) )
+    {
+      XrdSysMutexHelper scopedLock( worker->mutex );
+      if( !worker->local.empty() )
+      {
+        h = worker->local.front();
+        worker->local.pop_front();
+        worker->pending.store( worker->local.size(),
+                               std::memory_order_relaxed );
+        return true;
+      }
+    }
+
+    if( pJobs.Get( h ) )
+      return true;
+
+    if( pOverflowSize.load( std::memory_order_relaxed ) )
+    {
+      XrdSysMutexHelper scopedLock( pOverflowMutex );
+      if( !pOverflow.empty() )
+      {
+        h = pOverflow.front();
+        pOverflow.pop_front();
+        pOverflowSize.store( pOverflow.size(), std::memory_order_relaxed );
+        return true;
+      }
+    }
+
+    for( uint32_t i = 1; i < pWorkers.size(); ++i )
+    {
+      Worker *victim = pWorkers[(worker->id + i) % pWorkers.size()];
+      if( !victim->pending.load( std::memory_order_relaxed ) )
+        continue;
+      XrdSysMutexHelper scopedLock( victim->mutex );
+      if( !victim->local.empty() )
+      {
+        h = victim->local.front();
+        victim->local.pop_front();
+        victim->pending.store( victim->local.size(),
+                               std::memory_order_relaxed );
+        return true;
+      }
+    }
+    return false;
+  }
+
+  //----------------------------------------------------------------------------
+  // Add a worker if the queue latency is too high, tell the calling one to
+  // retire if it has been low for long enough
+  //----------------------------------------------------------------------------
+  bool JobManager::Scale( const JobHelper &h )
+  {
+    uint64_t now = Now();
+    if( now - h.queued > pQueueLatency )
+    {
+      pLastBusy = now;
+      if( pNumWorkers >= pMaxWorkers || !pMutex.CondLock() )
+        return false;
+      if( pRunning && !pStopping && SpawnWorker() )
+      {
+        Log *log = DefaultEnv::GetLog();
+        log->Debug( JobMgrMsg, "Queue latency %llu us, added a worker, "
+                    "%d running", (unsigned long long)( now - h.queued ),
+                    (uint32_t)pNumWorkers );
+      }
+      pMutex.UnLock();
+      return false;
+    }
+    return pNumWorkers > pMinWorkers && now - pLastBusy > RetireIdleTime;
+  }
+
+  //----------------------------------------------------------------------------
+  // Retire the calling worker
+  //----------------------------------------------------------------------------
+  bool JobManager::Retire( Worker *worker )
+  {
+    XrdSysMutexHelper scopedLock( pMutex );
+    uint64_t now = Now();
+    if( !pRunning || pStopping || pNumWorkers <= pMinWorkers ||
+        worker->pending.load( std::memory_order_relaxed ) ||
+        now - pLastBusy <= RetireIdleTime )
+      return false;
+
+    //--------------------------------------------------------------------------
+    // Restart the idle period so that the workers retire one at a time
+    //--------------------------------------------------------------------------
+    pLastBusy = now;
+    worker->active = false;
+    --pNumWorkers;
+    pthread_detach( worker->thread );
+    tlsWorker = 0;
+
+    Log *log = DefaultEnv::GetLog();
+    log->Debug( JobMgrMsg, "Worker #%d retired, %d running", worker->id,
+                (uint32_t)pNumWorkers );
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  // Run the jobs
+  //----------------------------------------------------------------------------
+  void JobManager::RunJobs( Worker *worker )
+  {
+    tlsWorker = worker;
     pthread_setcanceltype( PTHREAD_CANCEL_DEFERRED, 0 );
     for( ;; )
     {
-      JobHelper h = pJobs.Get();
+      //------------------------------------------------------------------------
+      // Give the producers a chance to queue more before going to sleep,
+      // otherwise every job may cost us a wake-up
+      //------------------------------------------------------------------------
+      if( !pSem->CondWait() )
+      {
+        sched_yield();
+        if( !pSem->CondWait() )
+          pSem->Wait();
+      }
       pthread_setcancelstate( PTHREAD_CANCEL_DISABLE, 0 );
+
+      //------------------------------------------------------------------------
+      // The semaphore counts the queued jobs, so there is one for us, but
+      // a producer may still be writing it into the ring
+      //------------------------------------------------------------------------
+      JobHelper h;
+      while( !GetJob( worker, h ) )
+        sched_yield();
+
+      bool retire = pMaxWorkers > pMinWorkers && Scale( h );
       h.job->Run( h.arg );
+      if( retire && Retire( worker ) )
+        return;
       pthread_setcancelstate( PTHREAD_CANCEL_ENABLE, 0 );
     }
   }
+
+  //----------------------------------------------------------------------------
+  // Monotonic time in microseconds
+  //----------------------------------------------------------------------------
+  uint64_t JobManager::Now()
+  {
+    timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+  }
 }
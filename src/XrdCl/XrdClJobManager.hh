@@ -21,9 +21,12 @@
 
 #include <stdint.h>
 #include <vector>
-#include <algorithm>
+#include <deque>
+#include <atomic>
 #include <pthread.h>
-#include "XrdCl/XrdClSyncQueue.hh"
+#include "XrdCl/XrdClLockFreeQueue.hh"
+#include "XrdCl/XrdClUglyHacks.hh"
+#include "XrdSys/XrdSysPthread.hh"
 
 namespace XrdCl
 {
@@ -45,26 +48,37 @@ namespace XrdCl
   };
 
   //----------------------------------------------------------------------------
-  //! A synchronized queue
+  //! A thread-pool running the queued jobs
+  //!
+  //! Jobs queued by outside threads go to a bounded lock-free ring (spilling
+  //! to a locked overflow queue in a burst), jobs queued by the workers
+  //! themselves go to their local queues, from which idle workers steal.
+  //! If the maximum number of workers is larger than the initial one, a
+  //! worker is added whenever a job has waited for longer than the queue
+  //! latency threshold and an idle worker retires once no job has done so
+  //! for a while.
   //----------------------------------------------------------------------------
   class JobManager
   {
     public:
+      struct Worker;
+
       //------------------------------------------------------------------------
       //! Constructor
+      //!
+      //! @param workers      number of workers to start with
+      //! @param maxWorkers   maximum number of workers, no autoscaling if
+      //!                     not larger than workers
+      //! @param queueLatency queue latency in milliseconds above which
+      //!                     a worker is added
       //------------------------------------------------------------------------
-      JobManager( uint32_t workers )
-      {
-        pRunning = false;
-        pWorkers.resize( workers );
-      }
+      JobManager( uint32_t workers, uint32_t maxWorkers = 0,
+                  uint32_t queueLatency = 0 );
 
       //------------------------------------------------------------------------
       //! Destructor
       //------------------------------------------------------------------------
-      ~JobManager()
-      {
-      }
+      ~JobManager();
 
       //------------------------------------------------------------------------
       //! Initialize the job manager
@@ -89,42 +103,78 @@ namespace XrdCl
       //------------------------------------------------------------------------
       //! Add a job to be run
       //------------------------------------------------------------------------
-      void QueueJob( Job *job, void *arg = 0 )
-      {
-        pJobs.Put( JobHelper( job, arg ) );
-      }
+      void QueueJob( Job *job, void *arg = 0 );
 
       //------------------------------------------------------------------------
       //! Run the jobs
       //------------------------------------------------------------------------
-      void RunJobs();
+      void RunJobs( Worker *worker );
 
-      bool IsWorker()
-      {
-        pthread_t thread = pthread_self();
-        std::vector<pthread_t>::iterator itr =
-            std::find( pWorkers.begin(), pWorkers.end(), thread );
-        return itr != pWorkers.end();
-      }
-
-    private:
       //------------------------------------------------------------------------
-      //! Stop all workers up to n'th
+      //! Check if the calling thread is one of our workers
       //------------------------------------------------------------------------
-      void StopWorkers( uint32_t n );
+      bool IsWorker();
 
+    private:
       struct JobHelper
       {
-        JobHelper( Job *j = 0, void *a = 0 ): job(j), arg(a) {}
-        Job  *job;
-        void *arg;
+        JobHelper( Job *j = 0, void *a = 0, uint64_t q = 0 ):
+          job(j), arg(a), queued(q) {}
+        Job      *job;
+        void     *arg;
+        uint64_t  queued;
       };
 
-      std::vector<pthread_t> pWorkers;
-      SyncQueue<JobHelper>   pJobs;
-      XrdSysMutex            pMutex;
-      bool                   pRunning;
+      //------------------------------------------------------------------------
+      //! Take a job from any of the queues
+      //------------------------------------------------------------------------
+      bool GetJob( Worker *worker, JobHelper &h );
+
+      //------------------------------------------------------------------------
+      //! Spawn a worker in a free slot, must be called with pMutex locked
+      //------------------------------------------------------------------------
+      bool SpawnWorker();
+
+      //------------------------------------------------------------------------
+      //! Add a worker if the queue latency is too high, retire the calling
+      //! one if it has been low for long enough
+      //!
+      //! @return true if the calling worker should retire
+      //------------------------------------------------------------------------
+      bool Scale( const JobHelper &h );
+
+      //------------------------------------------------------------------------
+      //! Retire the calling worker
+      //!
+      //! @return false if the worker needs to stay
+      //------------------------------------------------------------------------
+      bool Retire( Worker *worker );
+
+      //------------------------------------------------------------------------
+      //! Stop the given workers
+      //------------------------------------------------------------------------
+      void StopWorkers( const std::vector<Worker*> &workers );
+
+      //------------------------------------------------------------------------
+      //! Monotonic time in microseconds
+      //------------------------------------------------------------------------
+      static uint64_t Now();
+
+      std::vector<Worker*>     pWorkers;
+      LockFreeQueue<JobHelper> pJobs;
+      std::deque<JobHelper>    pOverflow;
+      std::atomic<uint32_t>    pOverflowSize;
+      XrdSysMutex              pOverflowMutex;
+      Semaphore               *pSem;
+      XrdSysMutex              pMutex;
+      uint32_t                 pMinWorkers;
+      uint32_t                 pMaxWorkers;
+      std::atomic<uint32_t>    pNumWorkers;
+      uint64_t                 pQueueLatency;
+      std::atomic<uint64_t>    pLastBusy;
+      bool                     pRunning;
+      bool                     pStopping;
   };
 }
 
-#endif // __XRD_CL_ANY_OBJECT_HH__
+#endif // __XRD_CL_JOB_MANAGER_HH__
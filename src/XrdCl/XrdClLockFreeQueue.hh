@@ -0,0 +1,157 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2026 by European Organization for Nuclear Research (CERN)
+//------------------------------------------------------------------------------
+// XRootD is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// XRootD is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with XRootD.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+#ifndef __XRD_CL_LOCK_FREE_QUEUE_HH__
+#define __XRD_CL_LOCK_FREE_QUEUE_HH__
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace XrdCl
+{
+  //----------------------------------------------------------------------------
+  //! A bounded, lock-free, multi-producer multi-consumer queue
+  //!
+  //! Every cell of the ring carries a sequence number telling whether it is
+  //! ready to be written to or read from at a given position, so producers
+  //! and consumers only ever contend on a single compare-and-swap of the
+  //! tail or the head respectively. The capacity is rounded up to a power
+  //! of two.
+  //----------------------------------------------------------------------------
+  template <typename Item>
+  class LockFreeQueue
+  {
+    public:
+      //------------------------------------------------------------------------
+      //! Constructor
+      //------------------------------------------------------------------------
+      LockFreeQueue( size_t capacity )
+      {
+        size_t size = 2;
+        while( size < capacity )
+          size <<= 1;
+        pMask  = size - 1;
+        pCells = new Cell[size];
+        for( size_t i = 0; i < size; ++i )
+          pCells[i].seq.store( i, std::memory_order_relaxed );
+        pHead.store( 0, std::memory_order_relaxed );
+        pTail.store( 0, std::memory_order_relaxed );
+      }
+
+      //------------------------------------------------------------------------
+      //! Destructor
+      //------------------------------------------------------------------------
+      ~LockFreeQueue()
+      {
+        delete [] pCells;
+      }
+
+      //------------------------------------------------------------------------
+      //! Put the item at the end of the queue
+      //!
+      //! @return false if the queue is full
+      //------------------------------------------------------------------------
+      bool Put( const Item &item )
+      {
+        size_t pos = pTail.load( std::memory_order_relaxed );
+        Cell  *cell;
+        for( ;; )
+        {
+          cell = &pCells[pos & pMask];
+          size_t   seq = cell->seq.load( std::memory_order_acquire );
+          intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+          if( dif == 0 )
+          {
+            if( pTail.compare_exchange_weak( pos, pos + 1,
+                                             std::memory_order_relaxed ) )
+              break;
+          }
+          else if( dif < 0 )
+            return false;
+          else
+            pos = pTail.load( std::memory_order_relaxed );
+        }
+        cell->item = item;
+        cell->seq.store( pos + 1, std::memory_order_release );
+        return true;
+      }
+
+      //------------------------------------------------------------------------
+      //! Get the item from the front of the queue
+      //!
+      //! @return false if the queue is empty, or if the item at the front
+      //!         is still being written by its producer
+      //------------------------------------------------------------------------
+      bool Get( Item &item )
+      {
+        size_t pos = pHead.load( std::memory_order_relaxed );
+        Cell  *cell;
+        for( ;; )
+        {
+          cell = &pCells[pos & pMask];
+          size_t   seq = cell->seq.load( std::memory_order_acquire );
+          intptr_t dif = (intptr_t)seq - (intptr_t)(pos + 1);
+          if( dif == 0 )
+          {
+            if( pHead.compare_exchange_weak( pos, pos + 1,
+                                             std::memory_order_relaxed ) )
+              break;
+          }
+          else if( dif < 0 )
+            return false;
+          else
+            pos = pHead.load( std::memory_order_relaxed );
+        }
+        item = cell->item;
+        cell->item = Item();
+        cell->seq.store( pos + pMask + 1, std::memory_order_release );
+        return true;
+      }
+
+      //------------------------------------------------------------------------
+      //! Clear the queue, must not race with Put or Get
+      //------------------------------------------------------------------------
+      void Clear()
+      {
+        Item item;
+        while( Get( item ) );
+      }
+
+    private:
+      LockFreeQueue( const LockFreeQueue& );
+      LockFreeQueue &operator=( const LockFreeQueue& );
+
+      static const size_t CacheLine = 64;
+
+      struct Cell
+      {
+        std::atomic<size_t> seq;
+        Item                item;
+      };
+
+      Cell               *pCells;
+      size_t              pMask;
+      char                pPad1[CacheLine];
+      std::atomic<size_t> pHead;
+      char                pPad2[CacheLine - sizeof(std::atomic<size_t>)];
+      std::atomic<size_t> pTail;
+      char                pPad3[CacheLine - sizeof(std::atomic<size_t>)];
+  };
+}
+
+#endif // __XRD_CL_LOCK_FREE_QUEUE_HH__
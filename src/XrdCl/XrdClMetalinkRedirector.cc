@@ -18,6 +18,7 @@
 #include "XrdCl/XrdClUtils.hh"
 #include "XrdCl/XrdClPostMasterInterfaces.hh"
 #include "XrdCl/XrdClPostMaster.hh"
+#include "XrdCl/XrdClReplicaStats.hh"
 
 #include "XrdXml/XrdXmlMetaLink.hh"
 
@@ -428,6 +429,12 @@ namespace XrdCl
         continue; // this is the internal limit (defined in the protocol)
       pReplicas.push_back( replica.GetURL() );
     }
+
+    // try the replicas we expect to deliver the file first
+    int sort = DefaultSortReplicas;
+    DefaultEnv::GetEnv()->GetInt( "SortReplicas", sort );
+    if( sort )
+      ReplicaStats::Instance().Sort( pReplicas, fileInfos[0]->GetSize() );
   }
 
   //----------------------------------------------------------------------------
@@ -27,9 +27,12 @@
 #include "XrdCl/XrdClDefaultEnv.hh"
 #include "XrdCl/XrdClConstants.hh"
 #include "XrdCl/XrdClSocket.hh"
+#include "XrdCl/XrdClUtils.hh"
 #include "XrdCl/XrdClOptimizers.hh"
 #include "XrdSys/XrdSysIOEvents.hh"
 
+#include <stdlib.h>
+
 namespace
 {
   //----------------------------------------------------------------------------
@@ -38,15 +41,16 @@ namespace
   struct PollerHelper
   {
     PollerHelper():
-      channel(0), callBack(0), readEnabled(false), writeEnabled(false),
-      readTimeout(0), writeTimeout(0)
+      channel(0), callBack(0), slot(0), readEnabled(false),
+      writeEnabled(false), readTimeout(0), writeTimeout(0)
     {}
-    XrdSys::IOEvents::Channel  *channel;
-    XrdSys::IOEvents::CallBack *callBack;
-    bool                        readEnabled;
-    bool                        writeEnabled;
-    uint16_t                    readTimeout;
-    uint16_t                    writeTimeout;
+    XrdSys::IOEvents::Channel          *channel;
+    XrdSys::IOEvents::CallBack         *callBack;
+    XrdCl::PollerBuiltIn::PollerSlot   *slot;
+    bool                                readEnabled;
+    bool                                writeEnabled;
+    uint16_t                            readTimeout;
+    uint16_t                            writeTimeout;
   };
 
   //----------------------------------------------------------------------------
@@ -56,9 +60,17 @@ namespace
   {
     public:
       SocketCallBack( XrdCl::Socket *sock, XrdCl::SocketHandler *sh ):
-        pSocket( sock ), pHandler( sh ) {}
+        pSocket( sock ), pHandler( sh ), pEvents( 0 ) {}
       virtual ~SocketCallBack() {};
 
+      //------------------------------------------------------------------------
+      // Set the event counter of the poller handling the socket
+      //------------------------------------------------------------------------
+      void SetCounter( std::atomic<uint64_t> *events )
+      {
+        pEvents = events;
+      }
+
       virtual bool Event( XrdSys::IOEvents::Channel *chP,
                           void                      *cbArg,
                           int                        evFlags )
@@ -79,13 +91,35 @@ namespace
                                 SocketHandler::EventTypeToString( ev ).c_str() );
         }
 
+        //----------------------------------------------------------------------
+        // Only the poller thread counts, so there is no need for an atomic
+        // increment
+        //----------------------------------------------------------------------
+        if( pEvents )
+          pEvents->store( pEvents->load( std::memory_order_relaxed ) + 1,
+                          std::memory_order_relaxed );
+
         pHandler->Event( ev, pSocket );
         return true;
       }
     private:
-      XrdCl::Socket        *pSocket;
-      XrdCl::SocketHandler *pHandler;
+      XrdCl::Socket         *pSocket;
+      XrdCl::SocketHandler  *pHandler;
+      std::atomic<uint64_t> *pEvents;
   };
+
+  //----------------------------------------------------------------------------
+  // Attach the socket to the given poller slot
+  //----------------------------------------------------------------------------
+  void AttachHelper( PollerHelper *helper, XrdCl::Socket *socket,
+                     XrdCl::PollerBuiltIn::PollerSlot *slot )
+  {
+    helper->slot    = slot;
+    helper->channel = new XrdSys::IOEvents::Channel( slot->poller,
+                                                     socket->GetFD(),
+                                                     helper->callBack );
+    ((SocketCallBack*)helper->callBack)->SetCounter( &slot->events );
+  }
 }
 
 
@@ -107,11 +141,13 @@ namespace XrdCl
     //--------------------------------------------------------------------------
     // Clean up the channels
     //--------------------------------------------------------------------------
+    XrdSysRWLockHelper scopedLock( pLock, false );
     SocketMap::iterator it;
     for( it = pSocketMap.begin(); it != pSocketMap.end(); ++it )
     {
       PollerHelper *helper = (PollerHelper*)it->second;
-             helper->channel->Delete();
+      if( helper->channel )
+        helper->channel->Delete();
       delete helper->callBack;
       delete helper;
     }
@@ -132,7 +168,7 @@ namespace XrdCl
 
     Log *log = DefaultEnv::GetLog();
     log->Debug( PollerMsg, "Creating and starting the built-in poller..." );
-    XrdSysMutexHelper scopedLock( pMutex );
+    XrdSysRWLockHelper scopedLock( pLock, false );
     int         errNum = 0;
     const char *errMsg = 0;
 
@@ -145,12 +181,11 @@ namespace XrdCl
                                "%s (%s)", strerror( errno ), errMsg );
         return false;
       }
-      pPollerPool.push_back( poller );
+      pPollerPool.push_back( new PollerSlot( poller, i ) );
     }
 
-    pNext = pPollerPool.begin();
-
     log->Debug( PollerMsg, "Using %d poller threads", pNbPoller );
+    SetAffinity();
 
     //--------------------------------------------------------------------------
     // Check if we have any descriptors to reinsert from the last time we
@@ -161,8 +196,7 @@ namespace XrdCl
     {
       PollerHelper *helper = (PollerHelper*)it->second;
       Socket       *socket = it->first;
-      helper->channel = new IOEvents::Channel( RegisterAndGetPoller( socket ), socket->GetFD(),
-                                               helper->callBack );
+      AttachHelper( helper, socket, RegisterAndGetPoller( socket ) );
       if( helper->readEnabled )
       {
         bool status = helper->channel->Enable( IOEvents::Channel::readEvents,
@@ -202,7 +236,7 @@ namespace XrdCl
     Log *log = DefaultEnv::GetLog();
     log->Debug( PollerMsg, "Stopping the poller..." );
 
-    XrdSysMutexHelper scopedLock( pMutex );
+    XrdSysRWLockHelper scopedLock( pLock, false );
 
     if( pPollerPool.empty() )
     {
@@ -210,20 +244,26 @@ namespace XrdCl
       return true;
     }
 
-    while( !pPollerPool.empty() )
+    //--------------------------------------------------------------------------
+    // The callbacks being completed may need the lock. The slots stay
+    // around until the channels using them are gone.
+    //--------------------------------------------------------------------------
+    PollerPool slots;
+    slots.swap( pPollerPool );
+    pPollerMap.clear();
+    for( size_t i = 0; i < slots.size(); ++i )
     {
-      XrdSys::IOEvents::Poller *poller = pPollerPool.back();
-      pPollerPool.pop_back();
-
-      if( !poller ) continue;
-
+      long long pollCnt, evntCnt;
       scopedLock.UnLock();
-      poller->Stop();
-      delete poller;
-      scopedLock.Lock( &pMutex );
+      slots[i]->poller->Stop();
+      slots[i]->poller->GetStats( pollCnt, evntCnt );
+      delete slots[i]->poller;
+      scopedLock.Lock( &pLock, false );
+
+      log->Debug( PollerMsg, "Poller #%d handled %llu socket events in "
+                  "%lld wake-ups, %lld events reported", slots[i]->id,
+                  (unsigned long long)slots[i]->events, pollCnt, evntCnt );
     }
-    pNext = pPollerPool.end();
-    pPollerMap.clear();
 
     SocketMap::iterator  it;
     const char          *errMsg = 0;
@@ -232,6 +272,8 @@ namespace XrdCl
     {
       PollerHelper *helper = (PollerHelper*)it->second;
       Socket       *socket = it->first;
+      if( !helper->channel )
+        continue;
       bool status = helper->channel->Disable( Channel::allEvents, &errMsg );
       if( !status )
       {
@@ -240,8 +282,13 @@ namespace XrdCl
       }
       helper->channel->Delete();
       helper->channel = 0;
+      helper->slot    = 0;
+      ((SocketCallBack*)helper->callBack)->SetCounter( 0 );
     }
 
+    for( size_t i = 0; i < slots.size(); ++i )
+      delete slots[i];
+
     return true;
   }
 
@@ -252,7 +299,7 @@ namespace XrdCl
                                  SocketHandler *handler )
   {
     Log *log = DefaultEnv::GetLog();
-    XrdSysMutexHelper scopedLock( pMutex );
+    XrdSysRWLockHelper scopedLock( pLock, false );
 
     if( !socket )
     {
@@ -283,17 +330,13 @@ namespace XrdCl
     //--------------------------------------------------------------------------
     // Create the socket helper
     //--------------------------------------------------------------------------
-    XrdSys::IOEvents::Poller* poller = RegisterAndGetPoller( socket );
+    PollerSlot *slot = RegisterAndGetPoller( socket );
 
     PollerHelper *helper = new PollerHelper();
     helper->callBack = new ::SocketCallBack( socket, handler );
 
-    if( poller )
-    {
-      helper->channel  = new XrdSys::IOEvents::Channel( poller,
-                                                        socket->GetFD(),
-                                                        helper->callBack );
-    }
+    if( slot )
+      AttachHelper( helper, socket, slot );
 
     handler->Initialize( this );
     pSocketMap[socket] = helper;
@@ -311,7 +354,7 @@ namespace XrdCl
     //--------------------------------------------------------------------------
     // Find the right socket
     //--------------------------------------------------------------------------
-    XrdSysMutexHelper scopedLock( pMutex );
+    XrdSysRWLockHelper scopedLock( pLock, false );
     SocketMap::iterator it = pSocketMap.find( socket );
     if( it == pSocketMap.end() )
       return true;
@@ -364,7 +407,7 @@ namespace XrdCl
     //--------------------------------------------------------------------------
     // Check if the socket is registered
     //--------------------------------------------------------------------------
-    XrdSysMutexHelper scopedLock( pMutex );
+    XrdSysRWLockHelper scopedLock( pLock );
     SocketMap::const_iterator it = pSocketMap.find( socket );
     if( it == pSocketMap.end() )
     {
@@ -374,7 +417,8 @@ namespace XrdCl
     }
 
     PollerHelper *helper = (PollerHelper*)it->second;
-    XrdSys::IOEvents::Poller *poller = GetPoller( socket );
+    XrdSysMutexHelper slotLock( helper->slot ? helper->slot->mutex
+                                             : pIdleMutex );
 
     //--------------------------------------------------------------------------
     // Enable read notifications
@@ -388,7 +432,7 @@ namespace XrdCl
       log->Dump( PollerMsg, "%s Enable read notifications, timeout: %d",
                             socket->GetName().c_str(), timeout );
 
-      if( poller )
+      if( helper->slot )
       {
         const char *errMsg;
         bool status = helper->channel->Enable( Channel::readEvents, timeout,
@@ -414,7 +458,7 @@ namespace XrdCl
       log->Dump( PollerMsg, "%s Disable read notifications",
                             socket->GetName().c_str() );
 
-      if( poller )
+      if( helper->slot )
       {
         const char *errMsg;
         bool status = helper->channel->Disable( Channel::readEvents, &errMsg );
@@ -449,7 +493,7 @@ namespace XrdCl
     //--------------------------------------------------------------------------
     // Check if the socket is registered
     //--------------------------------------------------------------------------
-    XrdSysMutexHelper scopedLock( pMutex );
+    XrdSysRWLockHelper scopedLock( pLock );
     SocketMap::const_iterator it = pSocketMap.find( socket );
     if( it == pSocketMap.end() )
     {
@@ -459,7 +503,8 @@ namespace XrdCl
     }
 
     PollerHelper *helper = (PollerHelper*)it->second;
-    XrdSys::IOEvents::Poller *poller = GetPoller( socket );
+    XrdSysMutexHelper slotLock( helper->slot ? helper->slot->mutex
+                                             : pIdleMutex );
 
     //--------------------------------------------------------------------------
     // Enable write notifications
@@ -474,7 +519,7 @@ namespace XrdCl
       log->Dump( PollerMsg, "%s Enable write notifications, timeout: %d",
                             socket->GetName().c_str(), timeout );
 
-      if( poller )
+      if( helper->slot )
       {
         const char *errMsg;
         bool status = helper->channel->Enable( Channel::writeEvents, timeout,
@@ -499,7 +544,7 @@ namespace XrdCl
 
       log->Dump( PollerMsg, "%s Disable write notifications",
                             socket->GetName().c_str() );
-      if( poller )
+      if( helper->slot )
       {
         const char *errMsg;
         bool status = helper->channel->Disable( Channel::writeEvents, &errMsg );
@@ -520,37 +565,52 @@ namespace XrdCl
   //----------------------------------------------------------------------------
   bool PollerBuiltIn::IsRegistered( Socket *socket )
   {
-    XrdSysMutexHelper scopedLock( pMutex );
+    XrdSysRWLockHelper scopedLock( pLock );
     SocketMap::iterator it = pSocketMap.find( socket );
     return it != pSocketMap.end();
   }
 
   //----------------------------------------------------------------------------
-  // Return poller threads in round-robin fashion
+  // Pick the poller that has recently handled the fewest events, the load
+  // halves with every assignment so that the past traffic fades away
   //----------------------------------------------------------------------------
-  XrdSys::IOEvents::Poller* PollerBuiltIn::GetNextPoller()
+  PollerBuiltIn::PollerSlot* PollerBuiltIn::GetLeastLoadedPoller()
   {
     if( pPollerPool.empty() ) return 0;
 
-    PollerPool::iterator ret = pNext;
-    ++pNext;
-    if( pNext == pPollerPool.end() )
-      pNext = pPollerPool.begin();
-    return *ret;
+    PollerSlot *ret = 0;
+    for( size_t i = 0; i < pPollerPool.size(); ++i )
+    {
+      PollerSlot *slot   = pPollerPool[i];
+      uint64_t    events = slot->events.load( std::memory_order_relaxed );
+      slot->load       = slot->load / 2 + ( events - slot->lastEvents );
+      slot->lastEvents = events;
+      if( !ret || slot->load < ret->load ||
+          ( slot->load == ret->load && slot->channels < ret->channels ) )
+        ret = slot;
+    }
+    return ret;
   }
 
   //----------------------------------------------------------------------------
   // Return the poller associated with the respective channel
   //----------------------------------------------------------------------------
-  XrdSys::IOEvents::Poller* PollerBuiltIn::RegisterAndGetPoller(const Socket * socket)
+  PollerBuiltIn::PollerSlot* PollerBuiltIn::RegisterAndGetPoller(const Socket * socket)
   {
     PollerMap::iterator itr = pPollerMap.find( socket->GetChannelID() );
     if( itr == pPollerMap.end() )
     {
-      XrdSys::IOEvents::Poller* poller = GetNextPoller();
-      if( poller )
-        pPollerMap[socket->GetChannelID()] = std::make_pair( poller, size_t( 1 ) );
-      return poller;
+      PollerSlot* slot = GetLeastLoadedPoller();
+      if( slot )
+      {
+        pPollerMap[socket->GetChannelID()] = std::make_pair( slot, size_t( 1 ) );
+        ++slot->channels;
+        Log *log = DefaultEnv::GetLog();
+        log->Dump( PollerMsg, "Channel 0x%x assigned to poller #%d (load: "
+                   "%llu, channels: %d)", socket->GetChannelID(), slot->id,
+                   (unsigned long long)slot->load, (int)slot->channels );
+      }
+      return slot;
     }
 
     ++( itr->second.second );
@@ -563,15 +623,54 @@ namespace XrdCl
     if( itr == pPollerMap.end() ) return;
     --itr->second.second;
     if( itr->second.second == 0 )
+    {
+      --itr->second.first->channels;
       pPollerMap.erase( itr );
-
+    }
   }
 
-  XrdSys::IOEvents::Poller* PollerBuiltIn::GetPoller(const Socket * socket)
+  //----------------------------------------------------------------------------
+  // Bind the poller threads to the CPUs listed in 'PollerCPUs', e.g. "0-3,8"
+  //----------------------------------------------------------------------------
+  void PollerBuiltIn::SetAffinity()
   {
-    PollerMap::iterator itr = pPollerMap.find( socket->GetChannelID() );
-    if( itr == pPollerMap.end() ) return 0;
-    return itr->second.first;
+    Env *env = DefaultEnv::GetEnv();
+    Log *log = DefaultEnv::GetLog();
+    std::string cpuList = DefaultPollerCPUs;
+    env->GetString( "PollerCPUs", cpuList );
+    if( cpuList.empty() )
+      return;
+
+    std::vector<int>         cpus;
+    std::vector<std::string> ranges;
+    Utils::splitString( ranges, cpuList, "," );
+    for( size_t i = 0; i < ranges.size(); ++i )
+    {
+      char *end;
+      int first = strtol( ranges[i].c_str(), &end, 10 );
+      int last  = first;
+      if( *end == '-' )
+        last = strtol( end + 1, &end, 10 );
+      if( *end || end == ranges[i].c_str() || first < 0 || last < first )
+      {
+        log->Error( PollerMsg, "Invalid CPU list for the poller threads: %s",
+                    cpuList.c_str() );
+        return;
+      }
+      for( int cpu = first; cpu <= last; ++cpu )
+        cpus.push_back( cpu );
+    }
+
+    for( size_t i = 0; i < pPollerPool.size(); ++i )
+    {
+      int cpu = cpus[i % cpus.size()];
+      int rc  = pPollerPool[i]->poller->SetAffinity( cpu );
+      if( rc )
+        log->Warning( PollerMsg, "Unable to bind poller #%d to CPU %d: %s",
+                      (int)i, cpu, strerror( rc ) );
+      else
+        log->Debug( PollerMsg, "Poller #%d bound to CPU %d", (int)i, cpu );
+    }
   }
 
   //----------------------------------------------------------------------------
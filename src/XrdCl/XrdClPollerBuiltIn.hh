@@ -21,6 +21,7 @@
 
 #include "XrdSys/XrdSysPthread.hh"
 #include "XrdCl/XrdClPoller.hh"
+#include <atomic>
 #include <map>
 #include <vector>
 
@@ -36,10 +37,32 @@ namespace XrdCl
 
   //----------------------------------------------------------------------------
   //! A poller implementation using the build-in XRootD poller
+  //!
+  //! The sockets of a channel are handled by one of several poller threads.
+  //! A new channel goes to the poller that has recently handled the fewest
+  //! events. The socket registry is guarded by a read-write lock, the event
+  //! notifications of the sockets by a mutex of their poller.
   //----------------------------------------------------------------------------
   class PollerBuiltIn: public Poller
   {
     public:
+      //------------------------------------------------------------------------
+      //! A poller thread and the load it has
+      //------------------------------------------------------------------------
+      struct PollerSlot
+      {
+        PollerSlot( XrdSys::IOEvents::Poller *p, int i ):
+          poller( p ), id( i ), events( 0 ), lastEvents( 0 ), load( 0 ),
+          channels( 0 ) {}
+        XrdSys::IOEvents::Poller *poller;
+        int                       id;
+        XrdSysMutex               mutex;      // guards the socket channels
+        std::atomic<uint64_t>     events;     // events handled, poller thread
+        uint64_t                  lastEvents; // events at the last assignment
+        uint64_t                  load;       // decaying count of the events
+        size_t                    channels;   // channels assigned
+      };
+
       //------------------------------------------------------------------------
       //! Constructor
       //------------------------------------------------------------------------
@@ -122,14 +145,14 @@ namespace XrdCl
     private:
 
       //------------------------------------------------------------------------
-      //! Goes over poller threads in round robin fashion
+      //! Picks the poller that has recently handled the fewest events
       //------------------------------------------------------------------------
-      XrdSys::IOEvents::Poller* GetNextPoller();
+      PollerSlot* GetLeastLoadedPoller();
 
       //------------------------------------------------------------------------
-      //! Registers given socket as a poller user and returns the poller object
+      //! Registers given socket as a poller user and returns the poller slot
       //------------------------------------------------------------------------
-      XrdSys::IOEvents::Poller* RegisterAndGetPoller(const Socket *socket);
+      PollerSlot* RegisterAndGetPoller(const Socket *socket);
 
       //------------------------------------------------------------------------
       //! Unregisters given socket from poller object
@@ -137,9 +160,9 @@ namespace XrdCl
       void UnregisterFromPoller( const Socket *socket);
 
       //------------------------------------------------------------------------
-      //! Returns the poller object associated with the given socket
+      //! Bind the poller threads to the CPUs listed in 'PollerCPUs'
       //------------------------------------------------------------------------
-      XrdSys::IOEvents::Poller* GetPoller(const Socket *socket);
+      void SetAffinity();
 
       //------------------------------------------------------------------------
       //! Gets the initial value for 'pNbPoller'
@@ -147,17 +170,17 @@ namespace XrdCl
       static int GetNbPollerInit();
 
       // associates channel ID to a pair: poller and count (how many sockets where mapped to this poller)
-      typedef std::map<const AnyObject *, std::pair<XrdSys::IOEvents::Poller *, size_t> > PollerMap;
+      typedef std::map<const AnyObject *, std::pair<PollerSlot *, size_t> > PollerMap;
 
-      typedef std::map<Socket *, void *>              SocketMap;
-      typedef std::vector<XrdSys::IOEvents::Poller *> PollerPool;
+      typedef std::map<Socket *, void *>  SocketMap;
+      typedef std::vector<PollerSlot *>   PollerPool;
 
       SocketMap            pSocketMap;
       PollerMap            pPollerMap;
       PollerPool           pPollerPool;
-      PollerPool::iterator pNext;
       const int            pNbPoller;
-      XrdSysMutex          pMutex;
+      XrdSysRWLock         pLock;
+      XrdSysMutex          pIdleMutex; // guards the sockets while stopped
   };
 }
 
@@ -40,11 +40,16 @@ namespace XrdCl
     pPoller( 0 ), pInitialized( false )
   {
     Env *env = DefaultEnv::GetEnv();
-    int workerThreads = DefaultWorkerThreads;
-    env->GetInt( "WorkerThreads", workerThreads );
+    int workerThreads    = DefaultWorkerThreads;
+    int workerThreadsMax = DefaultWorkerThreadsMax;
+    int workerQueueLat   = DefaultWorkerQueueLatency;
+    env->GetInt( "WorkerThreads",      workerThreads );
+    env->GetInt( "WorkerThreadsMax",   workerThreadsMax );
+    env->GetInt( "WorkerQueueLatency", workerQueueLat );
 
     pTaskManager = new TaskManager();
-    pJobManager  = new JobManager(workerThreads);
+    pJobManager  = new JobManager( workerThreads, workerThreadsMax,
+                                   workerQueueLat );
   }
 
   //----------------------------------------------------------------------------
@@ -0,0 +1,256 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2011-2017 by European Organization for Nuclear Research (CERN)
+//------------------------------------------------------------------------------
+// This file is part of the XRootD software suite.
+//
+// XRootD is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// XRootD is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with XRootD.  If not, see <http://www.gnu.org/licenses/>.
+//
+// In applying this licence, CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+//------------------------------------------------------------------------------
+
+#include "XrdCl/XrdClReplicaStats.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <utility>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  // Weight of a new sample in the moving averages
+  //----------------------------------------------------------------------------
+  const double kWeight = 0.25;
+
+  //----------------------------------------------------------------------------
+  // For how long [s] a failed host is being tried last
+  //----------------------------------------------------------------------------
+  const time_t kFailureExpiry = 300;
+
+  //----------------------------------------------------------------------------
+  // Update a moving average with new sample
+  //----------------------------------------------------------------------------
+  inline void Update( double &avg, double sample )
+  {
+    if( avg <= 0 )
+      avg = sample;
+    else
+      avg += kWeight * ( sample - avg );
+  }
+
+  //----------------------------------------------------------------------------
+  // Orders replicas by their expected time
+  //----------------------------------------------------------------------------
+  struct ByExpectedTime
+  {
+    bool operator()( const std::pair<double, std::string> &a,
+                     const std::pair<double, std::string> &b ) const
+    {
+      return a.first < b.first;
+    }
+  };
+}
+
+namespace XrdCl
+{
+  //----------------------------------------------------------------------------
+  // Returns reference to the single instance
+  //----------------------------------------------------------------------------
+  ReplicaStats& ReplicaStats::Instance()
+  {
+    static ReplicaStats stats;
+    return stats;
+  }
+
+  //----------------------------------------------------------------------------
+  // Monotonic time in microseconds
+  //----------------------------------------------------------------------------
+  uint64_t ReplicaStats::Now()
+  {
+    timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+  }
+
+  //----------------------------------------------------------------------------
+  // Report the round trip time of a request carrying no bulk data
+  //----------------------------------------------------------------------------
+  void ReplicaStats::ReportLatency( const std::string &key, uint64_t latency )
+  {
+    XrdSysMutexHelper scopedLock( pMutex );
+    HostStats &stats = pStats[key];
+    Update( stats.latency, latency / 1e6 );
+    stats.failed = 0;
+  }
+
+  //----------------------------------------------------------------------------
+  // Report a completed data transfer
+  //----------------------------------------------------------------------------
+  void ReplicaStats::ReportTransfer( const std::string &key, uint64_t bytes,
+                                     uint64_t duration )
+  {
+    if( !bytes ) return;
+    if( !duration ) duration = 1;
+    XrdSysMutexHelper scopedLock( pMutex );
+    HostStats &stats = pStats[key];
+    Update( stats.throughput, bytes / ( duration / 1e6 ) );
+    stats.failed = 0;
+  }
+
+  //----------------------------------------------------------------------------
+  // Report a failure
+  //----------------------------------------------------------------------------
+  void ReplicaStats::ReportFailure( const std::string &key )
+  {
+    XrdSysMutexHelper scopedLock( pMutex );
+    pStats[key].failed = time( 0 );
+  }
+
+  //----------------------------------------------------------------------------
+  // Get the expected time of transferring given amount of data
+  //----------------------------------------------------------------------------
+  bool ReplicaStats::ExpectedTime( const URL &url, uint64_t size, double &time )
+  {
+    std::string key = HostKey( url );
+    XrdSysMutexHelper scopedLock( pMutex );
+    StatsMap::iterator itr = pStats.find( key );
+    if( itr == pStats.end() ) return false;
+    const HostStats &stats = itr->second;
+    if( stats.latency <= 0 && stats.throughput <= 0 ) return false;
+    time = ExpectedTime( stats, size, 0, 0 );
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  // Order the given replicas by their expected completion time
+  //----------------------------------------------------------------------------
+  void ReplicaStats::Sort( std::vector<std::string> &urls, int64_t size )
+  {
+    if( urls.size() < 2 ) return;
+
+    uint64_t bytes = size > 0 ? size : 0;
+    time_t   now   = time( 0 );
+
+    std::vector<HostStats> stats( urls.size() );
+    std::vector<bool>      known( urls.size(), false );
+    std::vector<bool>      failed( urls.size(), false );
+    double latency = 0, throughput = 0;
+    size_t nbLatency = 0, nbThroughput = 0, nbKnown = 0;
+
+    //--------------------------------------------------------------------------
+    // Get a snapshot of what we know about the replicas, the keys are
+    // built before taking the lock
+    //--------------------------------------------------------------------------
+    std::vector<std::string> keys( urls.size() );
+    for( size_t i = 0; i < urls.size(); ++i )
+      keys[i] = HostKey( URL( urls[i] ) );
+
+    {
+      XrdSysMutexHelper scopedLock( pMutex );
+      for( size_t i = 0; i < urls.size(); ++i )
+      {
+        StatsMap::iterator itr = pStats.find( keys[i] );
+        if( itr == pStats.end() ) continue;
+        stats[i] = itr->second;
+        if( stats[i].failed && now - stats[i].failed < kFailureExpiry )
+        {
+          failed[i] = true;
+          ++nbKnown;
+          continue;
+        }
+        if( stats[i].latency > 0 )
+        {
+          latency += stats[i].latency;
+          ++nbLatency;
+        }
+        if( stats[i].throughput > 0 )
+        {
+          throughput += stats[i].throughput;
+          ++nbThroughput;
+        }
+        if( stats[i].latency > 0 || stats[i].throughput > 0 )
+        {
+          known[i] = true;
+          ++nbKnown;
+        }
+      }
+    }
+
+    if( !nbKnown ) return;
+
+    //--------------------------------------------------------------------------
+    // Missing estimates are replaced with the average of the known ones
+    //--------------------------------------------------------------------------
+    if( nbLatency )    latency    /= nbLatency;
+    if( nbThroughput ) throughput /= nbThroughput;
+
+    std::vector<std::pair<double, std::string> > order;
+    order.reserve( urls.size() );
+    double total = 0;
+    size_t nbTotal = 0;
+    for( size_t i = 0; i < urls.size(); ++i )
+    {
+      double t = 0;
+      if( known[i] )
+      {
+        t = ExpectedTime( stats[i], bytes, latency, throughput );
+        total += t;
+        ++nbTotal;
+      }
+      order.push_back( std::make_pair( t, urls[i] ) );
+    }
+
+    //--------------------------------------------------------------------------
+    // Hosts we know nothing about are assumed to be average, and those
+    // that failed recently go last
+    //--------------------------------------------------------------------------
+    double average = nbTotal ? total / nbTotal : 0;
+    for( size_t i = 0; i < urls.size(); ++i )
+    {
+      if( failed[i] )
+        order[i].first = HUGE_VAL;
+      else if( !known[i] )
+        order[i].first = average;
+    }
+
+    std::stable_sort( order.begin(), order.end(), ByExpectedTime() );
+    for( size_t i = 0; i < urls.size(); ++i )
+      urls[i] = order[i].second;
+  }
+
+  //----------------------------------------------------------------------------
+  // Key identifying the host
+  //----------------------------------------------------------------------------
+  std::string ReplicaStats::HostKey( const URL &url )
+  {
+    std::ostringstream o;
+    o << url.GetHostName() << ":" << url.GetPort();
+    return o.str();
+  }
+
+  //----------------------------------------------------------------------------
+  // Expected time, missing estimates are replaced with the given defaults
+  //----------------------------------------------------------------------------
+  double ReplicaStats::ExpectedTime( const HostStats &stats, uint64_t size,
+                                     double latency, double throughput )
+  {
+    if( stats.latency > 0 )    latency    = stats.latency;
+    if( stats.throughput > 0 ) throughput = stats.throughput;
+    double t = latency;
+    if( throughput > 0 ) t += size / throughput;
+    return t;
+  }
+}
@@ -0,0 +1,186 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2011-2017 by European Organization for Nuclear Research (CERN)
+//------------------------------------------------------------------------------
+// This file is part of the XRootD software suite.
+//
+// XRootD is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// XRootD is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with XRootD.  If not, see <http://www.gnu.org/licenses/>.
+//
+// In applying this licence, CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+//------------------------------------------------------------------------------
+
+#ifndef SRC_XRDCL_XRDCLREPLICASTATS_HH_
+#define SRC_XRDCL_XRDCLREPLICASTATS_HH_
+
+#include "XrdCl/XrdClURL.hh"
+#include "XrdSys/XrdSysPthread.hh"
+
+#include <stdint.h>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <map>
+
+namespace XrdCl
+{
+
+//------------------------------------------------------------------------------
+//! Process-wide registry of per host latency and throughput estimates.
+//!
+//! The estimates are exponentially weighted moving averages of the samples
+//! reported by the data clients (e.g. the extreme copy sources), and are
+//! used to order the replicas of a file by the time we expect it would
+//! take to fetch the data from each of them.
+//------------------------------------------------------------------------------
+class ReplicaStats
+{
+  public:
+
+    //--------------------------------------------------------------------------
+    //! Returns reference to the single instance.
+    //--------------------------------------------------------------------------
+    static ReplicaStats& Instance();
+
+    //--------------------------------------------------------------------------
+    //! Monotonic time in microseconds
+    //--------------------------------------------------------------------------
+    static uint64_t Now();
+
+    //--------------------------------------------------------------------------
+    //! Key identifying the host (host name and port), clients reporting
+    //! many samples for the same host should compute it only once.
+    //--------------------------------------------------------------------------
+    static std::string HostKey( const URL &url );
+
+    //--------------------------------------------------------------------------
+    //! Report the round trip time of a request carrying no bulk data
+    //! (e.g. an open).
+    //!
+    //! @param url     : the URL of the host that served the request
+    //! @param latency : the time it took [us]
+    //--------------------------------------------------------------------------
+    void ReportLatency( const URL &url, uint64_t latency )
+    {
+      ReportLatency( HostKey( url ), latency );
+    }
+
+    //--------------------------------------------------------------------------
+    //! Report the round trip time of a request, the host is given by
+    //! its key (see HostKey).
+    //--------------------------------------------------------------------------
+    void ReportLatency( const std::string &key, uint64_t latency );
+
+    //--------------------------------------------------------------------------
+    //! Report a completed data transfer.
+    //!
+    //! @param url      : the URL of the host that served the data
+    //! @param bytes    : number of bytes transferred
+    //! @param duration : the time it took [us]
+    //--------------------------------------------------------------------------
+    void ReportTransfer( const URL &url, uint64_t bytes, uint64_t duration )
+    {
+      ReportTransfer( HostKey( url ), bytes, duration );
+    }
+
+    //--------------------------------------------------------------------------
+    //! Report a completed data transfer, the host is given by its key
+    //! (see HostKey).
+    //--------------------------------------------------------------------------
+    void ReportTransfer( const std::string &key, uint64_t bytes,
+                         uint64_t duration );
+
+    //--------------------------------------------------------------------------
+    //! Report a failure, the host will be tried last until it either
+    //! delivers data again or the failure expires.
+    //!
+    //! @param url : the URL of the host that failed
+    //--------------------------------------------------------------------------
+    void ReportFailure( const URL &url )
+    {
+      ReportFailure( HostKey( url ) );
+    }
+
+    //--------------------------------------------------------------------------
+    //! Report a failure, the host is given by its key (see HostKey).
+    //--------------------------------------------------------------------------
+    void ReportFailure( const std::string &key );
+
+    //--------------------------------------------------------------------------
+    //! Get the expected time of transferring given amount of data.
+    //!
+    //! @param url  : the URL of the host
+    //! @param size : amount of data
+    //! @param time : the expected time [s] (output parameter)
+    //! @return     : true if there is an estimate for the host,
+    //!               false otherwise
+    //--------------------------------------------------------------------------
+    bool ExpectedTime( const URL &url, uint64_t size, double &time );
+
+    //--------------------------------------------------------------------------
+    //! Order the given replicas by their expected completion time.
+    //!
+    //! Hosts that failed recently go last, hosts we know nothing about
+    //! are assumed to be average. The sort is stable, so if we don't
+    //! have any estimates the original order is preserved.
+    //!
+    //! @param urls : the replicas to be ordered
+    //! @param size : amount of data to be transferred (if not known
+    //!               the replicas are ordered by latency)
+    //--------------------------------------------------------------------------
+    void Sort( std::vector<std::string> &urls, int64_t size );
+
+  private:
+
+    //--------------------------------------------------------------------------
+    //! Estimates for a single host
+    //--------------------------------------------------------------------------
+    struct HostStats
+    {
+      HostStats() : latency( 0 ), throughput( 0 ), failed( 0 ) { }
+      double latency;    //!< EWMA of the round trip time [s]
+      double throughput; //!< EWMA of the throughput [B/s]
+      time_t failed;     //!< time of the last failure
+    };
+
+    typedef std::map<std::string, HostStats> StatsMap;
+
+    //--------------------------------------------------------------------------
+    //! Expected time, missing estimates are replaced with the given defaults
+    //--------------------------------------------------------------------------
+    static double ExpectedTime( const HostStats &stats, uint64_t size,
+                                double latency, double throughput );
+
+    //--------------------------------------------------------------------------
+    // Constructor (private!).
+    //--------------------------------------------------------------------------
+    ReplicaStats() { }
+
+    //--------------------------------------------------------------------------
+    // Copy constructor (private!).
+    //--------------------------------------------------------------------------
+    ReplicaStats( const ReplicaStats & );
+
+    //--------------------------------------------------------------------------
+    // Assignment operator (private!).
+    //--------------------------------------------------------------------------
+    ReplicaStats& operator=( const ReplicaStats & );
+
+    StatsMap    pStats;
+    XrdSysMutex pMutex;
+};
+
+}
+
+#endif /* SRC_XRDCL_XRDCLREPLICASTATS_HH_ */
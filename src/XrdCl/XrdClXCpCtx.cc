@@ -27,6 +27,7 @@
 #include "XrdCl/XrdClLog.hh"
 #include "XrdCl/XrdClDefaultEnv.hh"
 #include "XrdCl/XrdClConstants.hh"
+#include "XrdCl/XrdClReplicaStats.hh"
 
 #include <algorithm>
 
@@ -34,11 +35,19 @@ namespace XrdCl
 {
 
 XCpCtx::XCpCtx( const std::vector<std::string> &urls, uint64_t blockSize, uint8_t parallelSrc, uint64_t chunkSize, uint64_t parallelChunks, int64_t fileSize ) :
-      pUrls( std::deque<std::string>( urls.begin(), urls.end() ) ), pBlockSize( blockSize ),
+      pBlockSize( blockSize ),
       pParallelSrc( parallelSrc ), pChunkSize( chunkSize ), pParallelChunks( parallelChunks ),
       pOffset( 0 ), pFileSize( -1 ), pFileSizeCV( 0 ), pDataReceived( 0 ), pDone( false ),
       pDoneCV( 0 ), pRefCount( 1 )
 {
+  // start with the sources we expect to be the fastest
+  std::vector<std::string> replicas( urls );
+  int sort = DefaultSortReplicas;
+  DefaultEnv::GetEnv()->GetInt( "SortReplicas", sort );
+  if( sort )
+    ReplicaStats::Instance().Sort( replicas, fileSize );
+  pUrls = std::queue<std::string>( std::deque<std::string>( replicas.begin(), replicas.end() ) );
+
   SetFileSize( fileSize );
 }
 
@@ -65,7 +74,9 @@ bool XCpCtx::GetNextUrl( std::string & url )
 
 XCpSrc* XCpCtx::WeakestLink( XCpSrc *exclude )
 {
-  uint64_t transferRate = -1; // set transferRate to max uint64 value
+  // the weakest link is the source that dictates the
+  // copy time, that is the one that will finish last
+  double expected = 0;
   XCpSrc *ret = 0;
 
   std::list<XCpSrc*>::iterator itr;
@@ -73,11 +84,11 @@ XCpSrc* XCpCtx::WeakestLink( XCpSrc *exclude )
   {
     XCpSrc *src = *itr;
     if( src == exclude ) continue;
-    uint64_t tmp = src->TransferRate();
-    if( src->HasData() && tmp < transferRate )
+    double tmp = src->ExpectedTime();
+    if( tmp > expected )
     {
       ret = src;
-      transferRate = tmp;
+      expected = tmp;
     }
   }
 
@@ -179,7 +190,7 @@ bool XCpCtx::AllDone()
   XrdSysCondVarHelper lck( pDoneCV );
 
   if( !pDone )
-    pDoneCV.Wait( 60 );
+    pDoneCV.Wait( 1 );
 
   return pDone;
 }
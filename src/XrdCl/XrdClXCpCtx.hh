@@ -91,7 +91,8 @@ class XCpCtx
     bool GetNextUrl( std::string & url );
 
     /**
-     * Get the 'weakest' sources
+     * Get the 'weakest' sources, that is the one we expect
+     * to finish its work last
      *
      * @param exclude : the source that is excluded from the
      *                  search
@@ -182,7 +183,8 @@ class XCpCtx
     /**
      * Returns true if all chunks have been transfered,
      * otherwise blocks until NotifyIdleSrc is called,
-     * or a 1 minute timeout occurs.
+     * or a 1 second timeout occurs (so idle sources can
+     * steal from those that degraded in the meanwhile).
      *
      * @return : true is all chunks have been transfered,
      *           false otherwise.
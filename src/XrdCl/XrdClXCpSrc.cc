@@ -27,10 +27,21 @@
 #include "XrdCl/XrdClLog.hh"
 #include "XrdCl/XrdClDefaultEnv.hh"
 #include "XrdCl/XrdClConstants.hh"
+#include "XrdCl/XrdClReplicaStats.hh"
 
 #include <cmath>
 #include <cstdlib>
 
+namespace
+{
+  //----------------------------------------------------------------------------
+  // Time [us] after which a source that did not deliver any data is
+  // considered stalled, and can be robbed even by a source that did
+  // not transfer anything yet
+  //----------------------------------------------------------------------------
+  const uint64_t StallTime = 1000000;
+}
+
 namespace XrdCl
 {
 
@@ -39,7 +50,8 @@ class ChunkHandler: public ResponseHandler
   public:
 
     ChunkHandler( XCpSrc *src, uint64_t offset, uint64_t size, char *buffer, File *handle ) :
-      pSrc( src->Self() ), pOffset( offset ), pSize( size ), pBuffer( buffer ), pHandle( handle )
+      pSrc( src->Self() ), pOffset( offset ), pSize( size ), pBuffer( buffer ), pHandle( handle ),
+      pUrl( src->pUrl )
     {
 
     }
@@ -67,6 +79,9 @@ class ChunkHandler: public ResponseHandler
       if( status->IsOK() && chunk->length != pSize ) // the file size on the server is different
       {                                              // than the one specified in metalink file
         *status = XRootDStatus( stError, errDataError );
+        // the transfer itself has been accounted for by the File,
+        // but this replica should not be tried first next time
+        ReplicaStats::Instance().ReportFailure( pUrl );
       }
 
       if( !status->IsOK() )
@@ -88,6 +103,7 @@ class ChunkHandler: public ResponseHandler
     uint64_t           pSize;
     char              *pBuffer;
     File              *pHandle;
+    URL                pUrl;
 };
 
 
@@ -143,7 +159,7 @@ void XCpSrc::StartDownloading()
   }
 
   // start counting transfer time
-  pStartTime = time( 0 );
+  pStartTime = ReplicaStats::Now();
 
   while( pRunning )
   {
@@ -160,18 +176,18 @@ void XCpSrc::StartDownloading()
       // if successful continue
       if( GetWork().IsOK() ) continue;
       // keep track of the time before we go idle
-      pTransferTime += time( 0 ) - pStartTime;
+      pTransferTime += ReplicaStats::Now() - pStartTime;
       // check if the overall download process is
       // done, this makes the thread wait until
       // either the download is done, or a source
-      // went to error, or a 60s timeout has been
+      // went to error, or a short timeout has been
       // reached (the timeout is there so we can
       // check if a source degraded in the meanwhile
       // and now we can steal from it)
       if( !pCtx->AllDone() )
       {
         // reset start time after pause
-        pStartTime = time( 0 );
+        pStartTime = ReplicaStats::Now();
         continue;
       }
       // stop counting
@@ -230,9 +246,12 @@ XRootDStatus XCpSrc::Initialize()
     pFile = new File();
     pFile->SetProperty( "ReadRecovery", value );
 
+    // the open latency is recorded by the File itself, here we only
+    // remember that the replica is unusable, whatever the reason
     st = pFile->Open( pUrl, OpenFlags::Read );
     if( !st.IsOK() )
     {
+      ReplicaStats::Instance().ReportFailure( pUrl );
       log->Warning( UtilityMsg, "Failed to open %s for reading: %s", pUrl.c_str(), st.GetErrorMessage().c_str() );
       DeletePtr( pFile );
       continue;
@@ -283,9 +302,12 @@ XRootDStatus XCpSrc::Recover()
     pFile = new File();
     pFile->SetProperty( "ReadRecovery", value );
 
+    // the open latency is recorded by the File itself, here we only
+    // remember that the replica is unusable, whatever the reason
     st = pFile->Open( pUrl, OpenFlags::Read );
     if( !st.IsOK() )
     {
+      ReplicaStats::Instance().ReportFailure( pUrl );
       DeletePtr( pFile );
       log->Warning( UtilityMsg, "Failed to open %s for reading: %s", pUrl.c_str(), st.GetErrorMessage().c_str() );
     }
@@ -298,7 +320,7 @@ XRootDStatus XCpSrc::Recover()
   // since we have a brand new source, we need
   // to restart transfer rate statistics
   pTransferTime   = 0;
-  pStartTime      = time( 0 );
+  pStartTime      = ReplicaStats::Now();
   pDataTransfered = 0;
 
   return st;
@@ -443,7 +465,7 @@ void XCpSrc::Steal( XCpSrc *src )
     // need to notify
     pCtx->NotifyIdleSrc();
 
-    log->Debug( UtilityMsg, "s%: Stealing everything from %s", myHost.c_str(), srcHost.c_str() );
+    log->Debug( UtilityMsg, "%s: Stealing everything from %s", myHost.c_str(), srcHost.c_str() );
 
     return;
   }
@@ -451,8 +473,19 @@ void XCpSrc::Steal( XCpSrc *src )
   // the source we are stealing from is just slower, only take part of its work
   // so we want a fraction of its work we want for ourself
   uint64_t myTransferRate = TransferRate(), srcTransferRate = src->TransferRate();
-  if( myTransferRate == 0 ) return;
-  double fraction = double( myTransferRate ) / double( myTransferRate + srcTransferRate );
+  double fraction = 0;
+  if( myTransferRate )
+    fraction = double( myTransferRate ) / double( myTransferRate + srcTransferRate );
+  else
+  {
+    // we did not transfer anything yet (e.g. the other sources took all
+    // the blocks before we were ready), so we don't know how fast we are,
+    // but if the source has not delivered anything for a while anyone
+    // would do better
+    uint64_t srcTransferTime = src->pTransferTime + ReplicaStats::Now() - src->pStartTime;
+    if( srcTransferRate || srcTransferTime < StallTime ) return;
+    fraction = 1;
+  }
 
   if( src->pCurrentOffset < src->pBlkEnd )
   {
@@ -468,7 +501,7 @@ void XCpSrc::Steal( XCpSrc *src )
     pBlkEnd        = src->pBlkEnd;
     src->pBlkEnd  -= steal;
 
-    log->Debug( UtilityMsg, "s%: Stealing fraction (%f) of block from %s", myHost.c_str(), fraction, srcHost.c_str() );
+    log->Debug( UtilityMsg, "%s: Stealing fraction (%f) of block from %s", myHost.c_str(), fraction, srcHost.c_str() );
 
     return;
   }
@@ -483,7 +516,7 @@ void XCpSrc::Steal( XCpSrc *src )
       src->pRecovered.erase( itr );
     }
 
-    log->Debug( UtilityMsg, "s%: Stealing fraction (%f) of recovered chunks from %s", myHost.c_str(), fraction, srcHost.c_str() );
+    log->Debug( UtilityMsg, "%s: Stealing fraction (%f) of recovered chunks from %s", myHost.c_str(), fraction, srcHost.c_str() );
 
     return;
   }
@@ -504,7 +537,7 @@ void XCpSrc::Steal( XCpSrc *src )
       src->pOngoing.erase( itr );
     }
 
-    log->Debug( UtilityMsg, "s%: Stealing fraction (%f) of ongoing chunks from %s", myHost.c_str(), fraction, srcHost.c_str() );
+    log->Debug( UtilityMsg, "%s: Stealing fraction (%f) of ongoing chunks from %s", myHost.c_str(), fraction, srcHost.c_str() );
   }
 }
 
@@ -520,7 +553,7 @@ XRootDStatus XCpSrc::GetWork()
 
     Log *log = DefaultEnv::GetLog();
     std::string myHost = URL( pUrl ).GetHostName();
-    log->Debug( UtilityMsg, "s% got next block", myHost.c_str() );
+    log->Debug( UtilityMsg, "%s got next block", myHost.c_str() );
 
     return XRootDStatus();
   }
@@ -536,8 +569,27 @@ XRootDStatus XCpSrc::GetWork()
 
 uint64_t XCpSrc::TransferRate()
 {
-  time_t duration = pTransferTime + time( 0 ) - pStartTime;
-  return pDataTransfered / ( duration + 1 ); // add one to avoid floating point exception
+  uint64_t duration = pTransferTime + ReplicaStats::Now() - pStartTime;
+  return pDataTransfered * 1000000.0 / ( duration + 1 ); // add one to avoid floating point exception
+}
+
+double XCpSrc::ExpectedTime()
+{
+  XrdSysMutexHelper lck( pMtx );
+
+  uint64_t remaining = pBlkEnd > pCurrentOffset ? pBlkEnd - pCurrentOffset : 0;
+  std::map<uint64_t, uint64_t>::iterator itr;
+  for( itr = pRecovered.begin() ; itr != pRecovered.end() ; ++itr )
+    remaining += itr->second;
+  for( itr = pOngoing.begin() ; itr != pOngoing.end() ; ++itr )
+    remaining += itr->second;
+  if( !remaining ) return 0;
+
+  // a source that did not deliver anything yet is
+  // considered slower than any of those who did
+  uint64_t transferRate = TransferRate();
+  if( !transferRate ) return HUGE_VAL;
+  return double( remaining ) / transferRate;
 }
 
 } /* namespace XrdCl */
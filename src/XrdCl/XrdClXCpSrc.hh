@@ -118,6 +118,16 @@ class XCpSrc
      */
     uint64_t TransferRate();
 
+    /**
+     * Get the time we expect it will take the current source
+     * to transfer all the data that have been allocated to it
+     *
+     * @return : expected time [s] (0 if there are no data
+     *           allocated, HUGE_VAL if we don't know the
+     *           transfer rate yet)
+     */
+    double ExpectedTime();
+
     /**
      * Delete ChunkInfo object, and set the pointer to null.
      *
@@ -351,15 +361,15 @@ class XCpSrc
     bool                          pRunning;
 
     /**
-     * The time when we started / restarted  chunks
+     * The time when we started / restarted  chunks [us]
      */
-    time_t                        pStartTime;
+    uint64_t                      pStartTime;
 
     /**
      * The total time we were transferring data, before
-     * the restart
+     * the restart [us]
      */
-    time_t                        pTransferTime;
+    uint64_t                      pTransferTime;
 };
 
 } /* namespace XrdCl */
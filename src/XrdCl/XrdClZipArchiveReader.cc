@@ -32,9 +32,12 @@
 
 #include "XrdSys/XrdSysPthread.hh"
 
+#include <zlib.h>
+
 #include <string>
 #include <map>
 #include <memory>
+#include <algorithm>
 
 namespace XrdCl
 {
@@ -230,12 +233,254 @@ struct CDFH
     static const uint32_t kCdfhSign     = 0x02014b50;
 };
 
+struct LFH
+{
+    //--------------------------------------------------------------------------
+    // The Local-file-header precedes the file data, its size depends on the
+    // variable size 'filename' and 'extra' fields
+    //--------------------------------------------------------------------------
+    static XRootDStatus GetSize( const char *buffer, uint64_t length, uint32_t &size )
+    {
+      if( length < kLfhBaseSize )
+        return XRootDStatus( stError, errDataError, errDataError, "Local-file-header truncated." );
+      if( *reinterpret_cast<const uint32_t*>( buffer ) != kLfhSign )
+        return XRootDStatus( stError, errDataError, errDataError, "Local-file-header signature not found." );
+
+      uint16_t filenameLength = *reinterpret_cast<const uint16_t*>( buffer + 26 );
+      uint16_t extraLength    = *reinterpret_cast<const uint16_t*>( buffer + 28 );
+      size = kLfhBaseSize + filenameLength + extraLength;
+      if( size > length )
+        return XRootDStatus( stError, errDataError, errDataError, "Local-file-header truncated." );
+      return XRootDStatus();
+    }
+
+    static const uint16_t kLfhBaseSize = 30;
+    static const uint32_t kLfhSign     = 0x04034b50;
+};
+
+
+//------------------------------------------------------------------------------
+// Compression methods we know how to read
+//------------------------------------------------------------------------------
+static const uint16_t kStored   = 0;
+static const uint16_t kDeflated = 8;
+
+//------------------------------------------------------------------------------
+// Size of the deflate history and of the chunks of compressed data we fetch
+//------------------------------------------------------------------------------
+static const uint32_t kInflateWindow = 32768;
+static const uint32_t kInflateChunk  = 1048576;
+
+
+//------------------------------------------------------------------------------
+// An access point into a deflate stream (as in zlib's zran example): a block
+// boundary in the compressed and uncompressed data together with the 32kB of
+// uncompressed data preceding it, so inflating may start from there.
+//------------------------------------------------------------------------------
+struct InflatePoint
+{
+    InflatePoint( uint64_t out, uint64_t in, int bits ) : pOut( out ), pIn( in ), pBits( bits ) { }
+
+    uint64_t      pOut;                     // offset in the uncompressed data
+    uint64_t      pIn;                      // offset in the compressed data
+    int           pBits;                    // bits of the byte at pIn - 1 still to be used
+    unsigned char pWindow[kInflateWindow];  // the preceding uncompressed data
+};
+
+
+//------------------------------------------------------------------------------
+// Access points of a deflated file, built as the file gets read
+//------------------------------------------------------------------------------
+struct InflateIndex
+{
+    InflateIndex() : pDataOffset( 0 ) { }
+
+    XrdSysMutex                                 pMutex;
+    uint64_t                                    pDataOffset; // 0 until the LFH has been read
+    std::vector<std::shared_ptr<InflatePoint> > pPoints;     // ordered by offset
+};
+
+
+//------------------------------------------------------------------------------
+// Inflates a range of a deflated file starting from the nearest access point
+// and extends the access point index on the way
+//------------------------------------------------------------------------------
+class ZipInflater
+{
+  public:
+
+    ZipInflater( const std::shared_ptr<InflateIndex> &index, uint64_t span, uint64_t offset, uint32_t size, void *buffer ) :
+      pIndex( index ), pSpan( span ), pNextPoint( 0 ), pOffset( offset ), pSize( size ), pProduced( 0 ),
+      pBuffer( reinterpret_cast<char*>( buffer ) ), pInit( false ), pPrime( false ), pTotalIn( 0 ), pTotalOut( 0 )
+    {
+      memset( &pStrm, 0, sizeof( pStrm ) );
+    }
+
+    ~ZipInflater()
+    {
+      if( pInit ) inflateEnd( &pStrm );
+    }
+
+    //--------------------------------------------------------------------------
+    // Set up the stream at the last access point not past the requested
+    // offset; inOffset is where in the compressed data the input has to start
+    //--------------------------------------------------------------------------
+    XRootDStatus Init( uint64_t &inOffset )
+    {
+      if( inflateInit2( &pStrm, -MAX_WBITS ) != Z_OK )
+        return XRootDStatus( stError, errInternal, 0, "Failed to initialize zlib." );
+      pInit = true;
+
+      {
+        XrdSysMutexHelper scopedLock( pIndex->pMutex );
+        std::vector<std::shared_ptr<InflatePoint> > &points = pIndex->pPoints;
+        for( size_t i = points.size(); i > 0; --i )
+          if( points[i - 1]->pOut <= pOffset )
+          {
+            pStart = points[i - 1];
+            break;
+          }
+        pNextPoint = ( points.empty() ? 0 : points.back()->pOut ) + pSpan;
+      }
+
+      memset( pWindow, 0, kInflateWindow );
+      if( pStart )
+      {
+        pTotalIn  = pStart->pIn;
+        pTotalOut = pStart->pOut;
+        pPrime    = pStart->pBits;
+        memcpy( pWindow, pStart->pWindow, kInflateWindow );
+        inflateSetDictionary( &pStrm, pStart->pWindow, kInflateWindow );
+      }
+      // the window is full, it holds the dictionary
+      pStrm.avail_out = 0;
+
+      inOffset = pTotalIn - ( pPrime ? 1 : 0 );
+      return XRootDStatus();
+    }
+
+    //--------------------------------------------------------------------------
+    // Feed consecutive compressed data, done is set when the requested range
+    // has been produced or the stream has ended
+    //--------------------------------------------------------------------------
+    XRootDStatus Feed( const char *in, uint64_t length, bool &done )
+    {
+      const unsigned char *next = reinterpret_cast<const unsigned char*>( in );
+      done = false;
+
+      if( pPrime && length )
+      {
+        inflatePrime( &pStrm, pStart->pBits, next[0] >> ( 8 - pStart->pBits ) );
+        ++next;
+        --length;
+        pPrime = false;
+      }
+
+      while( length || pStrm.avail_in )
+      {
+        if( !pStrm.avail_in )
+        {
+          uInt count = std::min<uint64_t>( length, 1 << 30 );
+          pStrm.next_in  = const_cast<unsigned char*>( next );
+          pStrm.avail_in = count;
+          next   += count;
+          length -= count;
+        }
+
+        if( !pStrm.avail_out )
+        {
+          pStrm.next_out  = pWindow;
+          pStrm.avail_out = kInflateWindow;
+        }
+
+        unsigned char *out    = pStrm.next_out;
+        uInt           availIn = pStrm.avail_in;
+        int rc = inflate( &pStrm, ( pSpan && pTotalOut >= pNextPoint ) ? Z_BLOCK : Z_NO_FLUSH );
+        if( rc == Z_NEED_DICT || rc == Z_DATA_ERROR || rc == Z_MEM_ERROR || rc == Z_STREAM_ERROR ||
+            ( rc == Z_BUF_ERROR && pStrm.avail_in && pStrm.avail_out ) )
+          return XRootDStatus( stError, errDataError, 0, "Failed to inflate file data." );
+
+        uint32_t have = pStrm.next_out - out;
+        Copy( out, have );
+        pTotalIn  += availIn - pStrm.avail_in;
+        pTotalOut += have;
+
+        if( rc == Z_STREAM_END || pTotalOut >= pOffset + pSize )
+        {
+          done = true;
+          break;
+        }
+
+        // we are at a block boundary (and not the end of the stream)
+        if( pSpan && pTotalOut >= pNextPoint && ( pStrm.data_type & 128 ) && !( pStrm.data_type & 64 ) )
+          AddPoint();
+      }
+
+      // the input has to be consumed unless we are done
+      pStrm.next_in  = 0;
+      pStrm.avail_in = 0;
+      return XRootDStatus();
+    }
+
+    uint32_t GetProduced() const
+    {
+      return pProduced;
+    }
+
+  private:
+
+    void Copy( const unsigned char *out, uint32_t length )
+    {
+      uint64_t begin = std::max( pTotalOut, pOffset );
+      uint64_t end   = std::min( pTotalOut + length, pOffset + pSize );
+      if( begin >= end ) return;
+      memcpy( pBuffer + ( begin - pOffset ), out + ( begin - pTotalOut ), end - begin );
+      pProduced = end - pOffset;
+    }
+
+    void AddPoint()
+    {
+      std::shared_ptr<InflatePoint> point( new InflatePoint( pTotalOut, pTotalIn, pStrm.data_type & 7 ) );
+      uint32_t left = pStrm.avail_out;
+      if( left ) memcpy( point->pWindow, pWindow + kInflateWindow - left, left );
+      if( left < kInflateWindow ) memcpy( point->pWindow + left, pWindow, kInflateWindow - left );
+
+      // somebody else might have been indexing the same region
+      XrdSysMutexHelper scopedLock( pIndex->pMutex );
+      std::vector<std::shared_ptr<InflatePoint> > &points = pIndex->pPoints;
+      if( points.empty() || points.back()->pOut + pSpan <= pTotalOut )
+        points.push_back( point );
+      pNextPoint = points.back()->pOut + pSpan;
+    }
+
+    std::shared_ptr<InflateIndex>  pIndex;
+    std::shared_ptr<InflatePoint>  pStart;
+    uint64_t                       pSpan;
+    uint64_t                       pNextPoint;
+    uint64_t                       pOffset;
+    uint32_t                       pSize;
+    uint32_t                       pProduced;
+    char                          *pBuffer;
+    z_stream                       pStrm;
+    bool                           pInit;
+    bool                           pPrime;
+    uint64_t                       pTotalIn;
+    uint64_t                       pTotalOut;
+    unsigned char                  pWindow[kInflateWindow];
+};
+
 
 class ZipArchiveReaderImpl
 {
   public:
 
-    ZipArchiveReaderImpl( File &archive ) : pArchive( archive ), pArchiveSize( 0 ), pRefCount( 1 ), pOpen( false ) { }
+    ZipArchiveReaderImpl( File &archive ) : pArchive( archive ), pArchiveSize( 0 ), pRefCount( 1 ), pOpen( false )
+    {
+      int span = DefaultZipIndexSpan;
+      DefaultEnv::GetEnv()->GetInt( "ZipIndexSpan", span );
+      // an access point needs a full window of history behind it
+      pIndexSpan = span <= 0 ? 0 : std::max<uint64_t>( span, kInflateWindow );
+    }
 
     ZipArchiveReaderImpl* Self()
     {
@@ -275,6 +520,21 @@ class ZipArchiveReaderImpl
       return Read( pBoundFile, relativeOffset, size, buffer, userHandler, timeout );
     }
 
+    XRootDStatus VectorRead( const std::vector<std::string> &filenames, const ChunkList &chunks, ResponseHandler *userHandler, uint16_t timeout = 0 );
+
+    XRootDStatus VectorRead( const ChunkList &chunks, ResponseHandler *userHandler, uint16_t timeout = 0 )
+    {
+      if( pBoundFile.empty() )
+        return XRootDStatus( stError, errInvalidOp );
+
+      return VectorRead( std::vector<std::string>( chunks.size(), pBoundFile ), chunks, userHandler, timeout );
+    }
+
+    XRootDStatus ReadRaw( uint64_t offset, uint32_t size, void *buffer, ResponseHandler *handler, uint16_t timeout )
+    {
+      return pArchive.Read( offset, size, buffer, handler, timeout );
+    }
+
     DirectoryList* List();
 
     XRootDStatus Close( ResponseHandler *handler, uint16_t timeout )
@@ -293,7 +553,9 @@ class ZipArchiveReaderImpl
       std::map<std::string, size_t>::const_iterator it = pFileToCdfh.find( filename );
       if( it == pFileToCdfh.end() ) return XRootDStatus( stError, errNotFound );
       CDFH *cdfh = pCdRecords[it->second];
-      size = cdfh->pCompressionMethod ? cdfh->pCompressedSize : cdfh->pUncompressedSize;
+      // deflated files are inflated on the fly, the rest is read as is
+      size = cdfh->pCompressionMethod == kStored || cdfh->pCompressionMethod == kDeflated ?
+             cdfh->pUncompressedSize : cdfh->pCompressedSize;
       return XRootDStatus();
     }
 
@@ -375,10 +637,23 @@ class ZipArchiveReaderImpl
 
   private:
 
+    uint64_t GetStoredOffset( size_t cdIndex, uint64_t relativeOffset, uint32_t &size );
+
+    XRootDStatus Inflate( size_t cdIndex, uint64_t relativeOffset, uint32_t size, void *buffer, ResponseHandler *userHandler, uint16_t timeout );
+
+    std::shared_ptr<InflateIndex> GetIndex( size_t cdIndex )
+    {
+      XrdSysMutexHelper scopedLock( pMutex );
+      std::shared_ptr<InflateIndex> &index = pIndexes[cdIndex];
+      if( !index ) index.reset( new InflateIndex() );
+      return index;
+    }
+
     void ClearRecords()
     {
       pEocd.reset();
       pZip64Eocd.reset();
+      pIndexes.clear();
 
       for( std::vector<CDFH*>::iterator it = pCdRecords.begin(); it != pCdRecords.end(); ++it )
         delete *it;
@@ -413,6 +688,8 @@ class ZipArchiveReaderImpl
     size_t                         pRefCount;
     bool                           pOpen;
     std::string                    pBoundFile;
+    uint64_t                       pIndexSpan;
+    std::map<size_t, std::shared_ptr<InflateIndex> > pIndexes;
 };
 
 
@@ -442,6 +719,23 @@ class ZipHandlerCommon : public ResponseHandler
       return response;
     }
 
+    //--------------------------------------------------------------------------
+    // Delete the handler and then pass the response on to the user. Once
+    // the user has the response they may destroy the archive, so by then we
+    // must not be holding a reference to it.
+    //--------------------------------------------------------------------------
+    void Respond( XRootDStatus *status, AnyObject *response )
+    {
+      ResponseHandler *userHandler = pUserHandler;
+      delete this;
+      if( userHandler ) userHandler->HandleResponse( status, response );
+      else
+      {
+        delete status;
+        delete response;
+      }
+    }
+
   protected:
 
     ZipArchiveReaderImpl *pImpl;
@@ -665,6 +959,216 @@ class ZipReadHandler : public ZipHandlerBase<ChunkInfo>
 };
 
 
+class ZipInflateHandler : public ZipHandlerCommon
+{
+  public:
+
+    ZipInflateHandler( ZipArchiveReaderImpl *impl, ResponseHandler *userHandler, const CDFH *cdfh,
+                       const std::shared_ptr<InflateIndex> &index, uint64_t span, uint64_t relativeOffset,
+                       uint32_t size, void *buffer, uint16_t timeout ) :
+      ZipHandlerCommon( impl, userHandler ), pCdfh( cdfh ), pIndex( index ),
+      pInflater( index, span, relativeOffset, size, buffer ), pRelativeOffset( relativeOffset ),
+      pBuffer( buffer ), pTimeout( timeout ), pDataOffset( 0 ), pNextIn( 0 ), pChunk( new char[kInflateChunk] ) { }
+
+    //--------------------------------------------------------------------------
+    // Issue the first read, if we don't know yet where the data starts we
+    // start with the Local-file-header
+    //--------------------------------------------------------------------------
+    XRootDStatus Start()
+    {
+      XRootDStatus st = pInflater.Init( pNextIn );
+      if( !st.IsOK() ) return st;
+
+      {
+        XrdSysMutexHelper scopedLock( pIndex->pMutex );
+        pDataOffset = pIndex->pDataOffset;
+      }
+
+      if( pDataOffset ) return ReadNext();
+      return pImpl->ReadRaw( pCdfh->pOffset, kInflateChunk, pChunk.get(), this, pTimeout );
+    }
+
+    virtual void HandleResponse( XRootDStatus *statusptr, AnyObject *responseptr )
+    {
+      std::unique_ptr<XRootDStatus> status( statusptr );
+      std::unique_ptr<AnyObject>    response( responseptr );
+
+      if( !status->IsOK() )
+      {
+        Finish( status.release() );
+        return;
+      }
+
+      ChunkInfo *chunk = 0;
+      if( response ) response->Get( chunk );
+      const char *data   = pChunk.get();
+      uint64_t    length = chunk ? chunk->length : 0;
+
+      if( !pDataOffset )
+      {
+        uint32_t lfhSize = 0;
+        XRootDStatus st = LFH::GetSize( data, length, lfhSize );
+        if( !st.IsOK() )
+        {
+          Finish( new XRootDStatus( st ) );
+          return;
+        }
+        pDataOffset = pCdfh->pOffset + lfhSize;
+        data   += lfhSize;
+        length -= lfhSize;
+
+        XrdSysMutexHelper scopedLock( pIndex->pMutex );
+        pIndex->pDataOffset = pDataOffset;
+      }
+
+      if( length > pCdfh->pCompressedSize - pNextIn )
+        length = pCdfh->pCompressedSize - pNextIn;
+      else if( !length && chunk && chunk->offset != pCdfh->pOffset )
+      {
+        Finish( new XRootDStatus( stError, errDataError, 0, "Compressed file data truncated." ) );
+        return;
+      }
+      pNextIn += length;
+
+      bool done = false;
+      XRootDStatus st = pInflater.Feed( data, length, done );
+      if( st.IsOK() && !done ) st = ReadNext();
+      // if ReadNext succeeded we may not touch this object anymore
+      if( !st.IsOK() )
+        Finish( new XRootDStatus( st ) );
+      else if( done )
+        Finish( new XRootDStatus() );
+    }
+
+  private:
+
+    XRootDStatus ReadNext()
+    {
+      uint64_t left = pCdfh->pCompressedSize - pNextIn;
+      if( !left )
+        return XRootDStatus( stError, errDataError, 0, "Compressed file data truncated." );
+      uint32_t size = std::min<uint64_t>( left, kInflateChunk );
+      return pImpl->ReadRaw( pDataOffset + pNextIn, size, pChunk.get(), this, pTimeout );
+    }
+
+    void Finish( XRootDStatus *status )
+    {
+      AnyObject *response = 0;
+      if( status->IsOK() )
+        response = PkgResp( new ChunkInfo( pRelativeOffset, pInflater.GetProduced(), pBuffer ) );
+
+      Respond( status, response );
+    }
+
+    const CDFH                    *pCdfh;
+    std::shared_ptr<InflateIndex>  pIndex;
+    ZipInflater                    pInflater;
+    uint64_t                       pRelativeOffset;
+    void                          *pBuffer;
+    uint16_t                       pTimeout;
+    uint64_t                       pDataOffset;
+    uint64_t                       pNextIn;
+    std::unique_ptr<char[]>        pChunk;
+};
+
+
+class ZipVectorReadHandler : public ZipHandlerCommon
+{
+  public:
+
+    ZipVectorReadHandler( ZipArchiveReaderImpl *impl, ResponseHandler *userHandler, const ChunkList &chunks ) :
+      ZipHandlerCommon( impl, userHandler ), pInfo( new VectorReadInfo() ), pStatus( 0 ), pPending( 1 )
+    {
+      pInfo->GetChunks() = chunks;
+    }
+
+    //--------------------------------------------------------------------------
+    // The requests are issued one by one, each of them has to report back
+    // with PartDone, as does the issuer once it is done issuing
+    //--------------------------------------------------------------------------
+    void AddPart()
+    {
+      XrdSysMutexHelper scopedLock( pMutex );
+      ++pPending;
+    }
+
+    void SetLength( size_t index, uint32_t length )
+    {
+      pInfo->GetChunks()[index].length = length;
+    }
+
+    void PartDone( XRootDStatus *status )
+    {
+      XrdSysMutexHelper scopedLock( pMutex );
+      if( status && !status->IsOK() && !pStatus ) pStatus = status;
+      else delete status;
+      if( --pPending ) return;
+      scopedLock.UnLock();
+
+      if( pStatus )
+      {
+        delete pInfo;
+        Respond( pStatus, 0 );
+      }
+      else
+      {
+        uint32_t size = 0;
+        ChunkList &chunks = pInfo->GetChunks();
+        for( ChunkList::iterator itr = chunks.begin(); itr != chunks.end(); ++itr )
+          size += itr->length;
+        pInfo->SetSize( size );
+        Respond( new XRootDStatus(), PkgResp( pInfo ) );
+      }
+    }
+
+  private:
+
+    VectorReadInfo *pInfo;
+    XRootDStatus   *pStatus;
+    size_t          pPending;
+    XrdSysMutex     pMutex;
+};
+
+
+class ZipVectorPartHandler : public ResponseHandler
+{
+  public:
+
+    ZipVectorPartHandler( ZipVectorReadHandler *parent, const std::vector<size_t> &indexes ) : pParent( parent ), pIndexes( indexes )
+    {
+      pParent->AddPart();
+    }
+
+    virtual void HandleResponse( XRootDStatus *status, AnyObject *response )
+    {
+      if( status->IsOK() && response )
+      {
+        // either a vector read of stored files or a single inflated read
+        VectorReadInfo *vrInfo = 0;
+        ChunkInfo      *chunk  = 0;
+        response->Get( vrInfo );
+        response->Get( chunk );
+        if( vrInfo )
+        {
+          ChunkList &chunks = vrInfo->GetChunks();
+          for( size_t i = 0; i < pIndexes.size() && i < chunks.size(); ++i )
+            pParent->SetLength( pIndexes[i], chunks[i].length );
+        }
+        else if( chunk && !pIndexes.empty() )
+          pParent->SetLength( pIndexes[0], chunk->length );
+      }
+      delete response;
+      pParent->PartDone( status );
+      delete this;
+    }
+
+  private:
+
+    ZipVectorReadHandler *pParent;
+    std::vector<size_t>   pIndexes;
+};
+
+
 ZipArchiveReader::ZipArchiveReader( File &archive ) : pImpl( new ZipArchiveReaderImpl( archive ) )
 {
 
@@ -859,6 +1363,48 @@ XRootDStatus ZipArchiveReader::Read( uint64_t offset, uint32_t size, void *buffe
   return status;
 }
 
+//------------------------------------------------------------------------
+// Async vector read.
+//------------------------------------------------------------------------
+XRootDStatus ZipArchiveReader::VectorRead( const std::vector<std::string> &filenames, const ChunkList &chunks, ResponseHandler *handler, uint16_t timeout )
+{
+  return pImpl->VectorRead( filenames, chunks, handler, timeout );
+}
+
+//------------------------------------------------------------------------
+// Sync vector read.
+//------------------------------------------------------------------------
+XRootDStatus ZipArchiveReader::VectorRead( const std::vector<std::string> &filenames, const ChunkList &chunks, VectorReadInfo *&vReadInfo, uint16_t timeout )
+{
+  SyncResponseHandler handler;
+  Status st = VectorRead( filenames, chunks, &handler, timeout );
+  if( !st.IsOK() )
+    return st;
+
+  return MessageUtils::WaitForResponse( &handler, vReadInfo );
+}
+
+//------------------------------------------------------------------------
+// Async bound vector read.
+//------------------------------------------------------------------------
+XRootDStatus ZipArchiveReader::VectorRead( const ChunkList &chunks, ResponseHandler *handler, uint16_t timeout )
+{
+  return pImpl->VectorRead( chunks, handler, timeout );
+}
+
+//------------------------------------------------------------------------
+// Sync bound vector read.
+//------------------------------------------------------------------------
+XRootDStatus ZipArchiveReader::VectorRead( const ChunkList &chunks, VectorReadInfo *&vReadInfo, uint16_t timeout )
+{
+  SyncResponseHandler handler;
+  Status st = VectorRead( chunks, &handler, timeout );
+  if( !st.IsOK() )
+    return st;
+
+  return MessageUtils::WaitForResponse( &handler, vReadInfo );
+}
+
 //------------------------------------------------------------------------
 // Sync list
 //------------------------------------------------------------------------
@@ -871,17 +1417,9 @@ XRootDStatus ZipArchiveReader::List( DirectoryList *&list )
   return XRootDStatus();
 }
 
-XRootDStatus ZipArchiveReaderImpl::Read( const std::string &filename, uint64_t relativeOffset, uint32_t size, void *buffer, ResponseHandler *userHandler, uint16_t timeout )
+uint64_t ZipArchiveReaderImpl::GetStoredOffset( size_t cdIndex, uint64_t relativeOffset, uint32_t &size )
 {
-  if( !pArchive.IsOpen() ) return XRootDStatus( stError, errInvalidOp, errInvalidOp, "Archive not opened." );
-
-  std::map<std::string, size_t>::iterator cditr = pFileToCdfh.find( filename );
-  if( cditr == pFileToCdfh.end() ) return XRootDStatus( stError, errNotFound, errNotFound, "File not found." );
-  CDFH *cdfh = pCdRecords[cditr->second];
-
-  // check if the file is compressed, for now we only support uncompressed files!
-  if( cdfh->pCompressionMethod != 0 )
-    return XRootDStatus( stError, errNotSupported, 0, "Decompression is not supported!" );
+  CDFH *cdfh = pCdRecords[cdIndex];
 
   // Now the problem is that at the beginning of our
   // file there is the Local-file-header, which size
@@ -891,11 +1429,29 @@ XRootDStatus ZipArchiveReaderImpl::Read( const std::string &filename, uint64_t r
   // The next record is either the next LFH (next file)
   // or the start of the Central-directory.
   uint64_t cdOffset = pZip64Eocd ? pZip64Eocd->pCdOffset : pEocd->pCdOffset;
-  uint64_t nextRecordOffset = ( cditr->second + 1 < pCdRecords.size() ) ? pCdRecords[cditr->second + 1]->pOffset : cdOffset;
+  uint64_t nextRecordOffset = ( cdIndex + 1 < pCdRecords.size() ) ? pCdRecords[cdIndex + 1]->pOffset : cdOffset;
   uint64_t fileSize = cdfh->pCompressionMethod ? cdfh->pCompressedSize : cdfh->pUncompressedSize;
   uint64_t offset = nextRecordOffset - fileSize + relativeOffset;
-  uint64_t sizeTillEnd = fileSize - relativeOffset;
+  uint64_t sizeTillEnd = relativeOffset < fileSize ? fileSize - relativeOffset : 0;
   if( size > sizeTillEnd ) size = sizeTillEnd;
+  return offset;
+}
+
+XRootDStatus ZipArchiveReaderImpl::Read( const std::string &filename, uint64_t relativeOffset, uint32_t size, void *buffer, ResponseHandler *userHandler, uint16_t timeout )
+{
+  if( !pArchive.IsOpen() ) return XRootDStatus( stError, errInvalidOp, errInvalidOp, "Archive not opened." );
+
+  std::map<std::string, size_t>::iterator cditr = pFileToCdfh.find( filename );
+  if( cditr == pFileToCdfh.end() ) return XRootDStatus( stError, errNotFound, errNotFound, "File not found." );
+  CDFH *cdfh = pCdRecords[cditr->second];
+
+  // deflated files get inflated, any other compression is not supported
+  if( cdfh->pCompressionMethod == kDeflated )
+    return Inflate( cditr->second, relativeOffset, size, buffer, userHandler, timeout );
+  if( cdfh->pCompressionMethod != kStored )
+    return XRootDStatus( stError, errNotSupported, 0, "Only stored and deflated files are supported!" );
+
+  uint64_t offset = GetStoredOffset( cditr->second, relativeOffset, size );
 
   // check if we have the whole file in our local buffer
   if( pBuffer )
@@ -926,6 +1482,127 @@ XRootDStatus ZipArchiveReaderImpl::Read( const std::string &filename, uint64_t r
   return st;
 }
 
+XRootDStatus ZipArchiveReaderImpl::Inflate( size_t cdIndex, uint64_t relativeOffset, uint32_t size, void *buffer, ResponseHandler *userHandler, uint16_t timeout )
+{
+  CDFH *cdfh = pCdRecords[cdIndex];
+  uint64_t sizeTillEnd = relativeOffset < cdfh->pUncompressedSize ? cdfh->pUncompressedSize - relativeOffset : 0;
+  if( size > sizeTillEnd ) size = sizeTillEnd;
+
+  std::shared_ptr<InflateIndex> index = GetIndex( cdIndex );
+
+  // if we have the whole archive in our local buffer
+  // we can inflate right away
+  if( pBuffer )
+  {
+    uint32_t lfhSize = 0;
+    if( cdfh->pOffset >= pArchiveSize ) return XRootDStatus( stError, errDataError );
+    XRootDStatus st = LFH::GetSize( pBuffer.get() + cdfh->pOffset, pArchiveSize - cdfh->pOffset, lfhSize );
+    if( !st.IsOK() ) return st;
+    uint64_t dataOffset = cdfh->pOffset + lfhSize;
+    if( dataOffset + cdfh->pCompressedSize > pArchiveSize ) return XRootDStatus( stError, errDataError );
+
+    ZipInflater inflater( index, pIndexSpan, relativeOffset, size, buffer );
+    uint64_t inOffset = 0;
+    bool done = false;
+    st = inflater.Init( inOffset );
+    if( st.IsOK() && size )
+      st = inflater.Feed( pBuffer.get() + dataOffset + inOffset, cdfh->pCompressedSize - inOffset, done );
+    if( !st.IsOK() ) return st;
+
+    if( userHandler )
+    {
+      ChunkInfo *info = new ChunkInfo( relativeOffset, inflater.GetProduced(), buffer );
+      AnyObject *resp = new AnyObject();
+      resp->Set( info );
+      userHandler->HandleResponse( new XRootDStatus(), resp );
+    }
+    return XRootDStatus();
+  }
+
+  // nothing to be read, we don't need to bother the server
+  if( !size )
+  {
+    if( userHandler )
+    {
+      AnyObject *resp = new AnyObject();
+      resp->Set( new ChunkInfo( relativeOffset, 0, buffer ) );
+      userHandler->HandleResponse( new XRootDStatus(), resp );
+    }
+    return XRootDStatus();
+  }
+
+  ZipInflateHandler *handler = new ZipInflateHandler( this, userHandler, cdfh, index, pIndexSpan, relativeOffset, size, buffer, timeout );
+  XRootDStatus st = handler->Start();
+  if( !st.IsOK() ) delete handler;
+  return st;
+}
+
+XRootDStatus ZipArchiveReaderImpl::VectorRead( const std::vector<std::string> &filenames, const ChunkList &chunks, ResponseHandler *userHandler, uint16_t timeout )
+{
+  if( !pArchive.IsOpen() ) return XRootDStatus( stError, errInvalidOp, errInvalidOp, "Archive not opened." );
+  if( filenames.size() != chunks.size() ) return XRootDStatus( stError, errInvalidArgs );
+
+  // resolve all the files before issuing anything
+  std::vector<size_t> cdIndexes;
+  cdIndexes.reserve( chunks.size() );
+  for( size_t i = 0; i < chunks.size(); ++i )
+  {
+    std::map<std::string, size_t>::iterator cditr = pFileToCdfh.find( filenames[i] );
+    if( cditr == pFileToCdfh.end() ) return XRootDStatus( stError, errNotFound, errNotFound, "File not found." );
+    uint16_t method = pCdRecords[cditr->second]->pCompressionMethod;
+    if( method != kStored && method != kDeflated )
+      return XRootDStatus( stError, errNotSupported, 0, "Only stored and deflated files are supported!" );
+    if( !chunks[i].buffer ) return XRootDStatus( stError, errInvalidArgs, 0, "Each chunk needs a buffer." );
+    cdIndexes.push_back( cditr->second );
+  }
+
+  // chunks of stored files all go into a single vector read of the
+  // archive, chunks of deflated files are inflated one by one
+  ZipVectorReadHandler *handler = new ZipVectorReadHandler( this, userHandler, chunks );
+  ChunkList           stored;
+  std::vector<size_t> storedIndexes;
+  for( size_t i = 0; i < chunks.size(); ++i )
+  {
+    if( pCdRecords[cdIndexes[i]]->pCompressionMethod == kDeflated )
+    {
+      std::vector<size_t> indexes( 1, i );
+      ZipVectorPartHandler *part = new ZipVectorPartHandler( handler, indexes );
+      XRootDStatus st = Inflate( cdIndexes[i], chunks[i].offset, chunks[i].length, chunks[i].buffer, part, timeout );
+      if( !st.IsOK() ) part->HandleResponse( new XRootDStatus( st ), 0 );
+      continue;
+    }
+
+    uint32_t size   = chunks[i].length;
+    uint64_t offset = GetStoredOffset( cdIndexes[i], chunks[i].offset, size );
+    handler->SetLength( i, size );
+    if( !size ) continue;
+
+    if( !pBuffer )
+    {
+      stored.push_back( ChunkInfo( offset, size, chunks[i].buffer ) );
+      storedIndexes.push_back( i );
+    }
+    else if( offset + size <= pArchiveSize )
+      memcpy( chunks[i].buffer, pBuffer.get() + offset, size );
+    else
+    {
+      handler->AddPart();
+      handler->PartDone( new XRootDStatus( stError, errDataError ) );
+    }
+  }
+
+  if( !stored.empty() )
+  {
+    ZipVectorPartHandler *part = new ZipVectorPartHandler( handler, storedIndexes );
+    XRootDStatus st = pArchive.VectorRead( stored, 0, part, timeout );
+    if( !st.IsOK() ) part->HandleResponse( new XRootDStatus( st ), 0 );
+  }
+
+  // we are done issuing
+  handler->PartDone( 0 );
+  return XRootDStatus();
+}
+
 DirectoryList* ZipArchiveReaderImpl::List()
 {
   std::string value;
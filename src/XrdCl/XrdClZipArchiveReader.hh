@@ -37,11 +37,12 @@ class File;
 //! A wrapper class for the XrdCl::File.
 //!
 //! It is an abstraction for a ZIP file containing multiple sub-files.
-//! The class does not provide any unzip utilities, it just readjusts
-//! the offset so a respective file inside of the archive can be read.
-//! It is meant for ZIP archives containing uncompressed root files,
-//! so a single file can be accessed without downloading the whole
-//! archive.
+//! Stored (uncompressed) files are read by readjusting the offset so
+//! a respective file inside of the archive can be read without
+//! downloading the whole archive. Deflated files are inflated on the
+//! fly; while inflating, access points are recorded every
+//! XRD_ZIPINDEXSPAN bytes so later reads only need to inflate from
+//! the nearest access point rather than from the start of the file.
 //----------------------------------------------------------------------------
 class ZipArchiveReader
 {
@@ -117,6 +118,38 @@ class ZipArchiveReader
     //------------------------------------------------------------------------
     XRootDStatus Read( uint64_t offset, uint32_t size, void *buffer, uint32_t &bytesRead, uint16_t timeout = 0 );
 
+    //------------------------------------------------------------------------
+    //! Async vector read of chunks of one or more files in the archive.
+    //!
+    //! The chunks of stored files are read with a single vector read of
+    //! the archive, the chunks of deflated files are inflated separately.
+    //!
+    //! @param filenames : name of the file each of the chunks belongs to
+    //! @param chunks    : the chunks, offsets relative to the respective
+    //!                    file, each chunk needs its own buffer
+    //! @param handler   : the handler for the async operation, gets a
+    //!                    VectorReadInfo with relative offsets
+    //! @param timeout   : the timeout of the async operation
+    //!
+    //! @return        : OK on success, error otherwise
+    //------------------------------------------------------------------------
+    XRootDStatus VectorRead( const std::vector<std::string> &filenames, const ChunkList &chunks, ResponseHandler *handler, uint16_t timeout = 0 );
+
+    //------------------------------------------------------------------------
+    //! Sync vector read.
+    //------------------------------------------------------------------------
+    XRootDStatus VectorRead( const std::vector<std::string> &filenames, const ChunkList &chunks, VectorReadInfo *&vReadInfo, uint16_t timeout = 0 );
+
+    //------------------------------------------------------------------------
+    //! Async bound vector read.
+    //------------------------------------------------------------------------
+    XRootDStatus VectorRead( const ChunkList &chunks, ResponseHandler *handler, uint16_t timeout = 0 );
+
+    //------------------------------------------------------------------------
+    //! Sync bound vector read.
+    //------------------------------------------------------------------------
+    XRootDStatus VectorRead( const ChunkList &chunks, VectorReadInfo *&vReadInfo, uint16_t timeout = 0 );
+
     //------------------------------------------------------------------------
     //! Sync list
     //------------------------------------------------------------------------
@@ -142,7 +175,8 @@ class ZipArchiveReader
     //!
     //! @param filename : the name of the file
     //!
-    //! @return         : the size of the file as in CDFH record
+    //! @return         : the size of the file as in CDFH record (the
+    //!                   uncompressed size for stored and deflated files)
     //------------------------------------------------------------------------
     XRootDStatus GetSize( const std::string &filename, uint64_t &size ) const;
 
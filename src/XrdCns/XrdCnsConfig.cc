@@ -129,7 +129,7 @@ int XrdCnsConfig::Configure(int argc, char **argv, char *argt)
 
    const char *TraceID = "Config";
    XrdOucArgs Spec(&MLog,(argt ? "Cns_Config: ":"XrdCnsd: "),
-                          "a:b:B:c:dD:e:i:I:k:l:L:N:p:q:R:z");
+                          "a:b:B:c:dD:e:i:I:k:l:L:N:p:q:R:w:z");
    XrdNetAddr netHost;
    const char *dnsEtxt = 0;
    char buff[2048], *dP, *tP, *n2n = 0, *lroot = 0, *xpl = 0;
@@ -186,6 +186,8 @@ int XrdCnsConfig::Configure(int argc, char **argv, char *argt)
        case 'R': Opts |= optRecr;
                  xpl   = Spec.argval;
                  break;
+       case 'w': NoGo |= XrdOuca2x::a2i(MLog,"-w value",Spec.argval,&wThreads,0,64);
+                 break;
        case 'z': MLog.logger()->setHiRes();
                  break;
        default:  NoGo = 1;
@@ -79,6 +79,10 @@ int XrdCnsInventory::Conduct(const char *dPath)
    XrdOucNSWalk::NSEnt *nP, *fP;
    int n, aOK = 1, rc;
 
+// Walk the tree in parallel if so wanted
+//
+   if (Config.wThreads) nsObj.setThreads(Config.wThreads);
+
 // Index all directories here
 //
    do {if (!(nP = nsObj.Index(rc, &cwdP))) return 1;
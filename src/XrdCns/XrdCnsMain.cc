@@ -34,6 +34,8 @@
    options: [-a <apath>] [-b <bpath>] [-B <bpath>] [-c] [-d] [-e <epath>]
 
             [-i <tspec>] [-I <tspec>] [-l <lfile>] [-p <port>] [-q <lim>] [-R]
+
+            [-w <num>]
 Where:
    -a     The admin path where the event log is placed and where named
           sockets are created. If not specified, the admin path comes from
@@ -83,6 +85,9 @@ Where:
    -R     Run is stand-alone mode and recreate the name space and, perhaps,
           the inventory file.
 
+   -w     The number of threads used to walk the local name space when an
+          inventory is taken. Specify 0 to 64. The default is 0 (serial walk).
+
 <host>    Is the hostname of the server managing the cluster name space. You
           may specify more than one if they are replicated. The default is to
           use the hosts specified via the "all.manager" directive.
@@ -27,7 +27,9 @@
 /* specific prior written permission of the institution or contributor.       */
 /******************************************************************************/
 
+#include <errno.h>
 #include "XrdFfs/XrdFfsDent.hh"
+#include "XrdOuc/XrdOucHash.hh"
 
 #ifdef __cplusplus
   extern "C" {
@@ -265,6 +267,152 @@ void XrdFfsDent_cache_destroy()
         XrdFfsDent_dentcache_free(&XrdFfsDentCaches[i]);
 }
 
+/* 
+   life time (in seconds) of cached listings and attributes. All are zero 
+   (disabled) unless the user of this library sets them via _cache_ttl().
+ */
+int XrdFfsDent_dentttl = 0;
+int XrdFfsDent_attrttl = 0;
+int XrdFfsDent_negttl  = 0;
+
+void XrdFfsDent_cache_ttl(int dentttl, int attrttl, int negttl)
+{
+    XrdFfsDent_dentttl = (dentttl > 0? dentttl : 0);
+    XrdFfsDent_attrttl = (attrttl > 0? attrttl : 0);
+    XrdFfsDent_negttl  = (negttl  > 0? negttl  : 0);
+}
+
+/*
+  _cache_get() returns (to dnarray) a copy of the cached listing of dname if
+  it is younger than the listing life time, or -1 if there is no such listing.
+ */
+int XrdFfsDent_cache_get(const char *dname, char ***dnarray)
+{
+    int i, j, n = -1;
+    time_t t1 = time(NULL);
+
+    if (XrdFfsDent_dentttl == 0) return -1;
+
+    pthread_mutex_lock(&XrdFfsDentCaches_mutex);
+    for (i = 0; i < XrdFfsDent_NDENTCACHES; i++)
+    {
+        if (XrdFfsDentCaches[i].dirname == NULL 
+            || strcmp(XrdFfsDentCaches[i].dirname, dname) != 0
+            || (t1 - XrdFfsDentCaches[i].t0) >= XrdFfsDent_dentttl)
+            continue;
+
+        n = XrdFfsDentCaches[i].nents;
+        *dnarray = (char**) malloc(sizeof(char*) * n);
+        for (j = 0; j < n; j++)
+            (*dnarray)[j] = strdup(XrdFfsDentCaches[i].dnarray[j]);
+        break;
+    }
+    pthread_mutex_unlock(&XrdFfsDentCaches_mutex);
+    return n;
+}
+
+void XrdFfsDent_cache_invalidate(const char *dname)
+{
+    int i;
+    pthread_mutex_lock(&XrdFfsDentCaches_mutex);
+    for (i = 0; i < XrdFfsDent_NDENTCACHES; i++)
+        if (XrdFfsDentCaches[i].dirname != NULL && strcmp(XrdFfsDentCaches[i].dirname, dname) == 0)
+        {
+            XrdFfsDent_dentcache_free(&XrdFfsDentCaches[i]);
+            XrdFfsDentCaches[i].t0 = 0;
+            XrdFfsDentCaches[i].dirname = strdup("");
+        }
+    pthread_mutex_unlock(&XrdFfsDentCaches_mutex);
+}
+
+/* managing caches for attributes */
+
+struct XrdFfsDentAttr {
+    struct stat st;
+    uid_t uid;
+    short neg;
+};
+
+/* the attribute cache is simply emptied when it grows beyond this */
+#define XrdFfsDent_MAXATTRS 262144
+XrdOucHash<struct XrdFfsDentAttr> XrdFfsDentAttrHtab;
+pthread_mutex_t XrdFfsDentAttr_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+int XrdFfsDent_attr_get(const char *path, uid_t uid, struct stat *stbuf)
+{
+    struct XrdFfsDentAttr *a;
+    int rval = 0;
+
+    if (XrdFfsDent_attrttl == 0 && XrdFfsDent_negttl == 0) return 0;
+
+    pthread_mutex_lock(&XrdFfsDentAttr_mutex);
+    a = XrdFfsDentAttrHtab.Find(path);  // expired entries are not returned
+    if (a != NULL && a->uid != uid)
+        rval = 0;
+    else if (a != NULL && a->neg)
+        rval = -1;
+    else if (a != NULL)
+    {
+        memcpy((void*)stbuf, (void*)(&a->st), sizeof(struct stat));
+        rval = 1;
+    }
+    pthread_mutex_unlock(&XrdFfsDentAttr_mutex);
+
+    if (rval == -1) errno = ENOENT;
+    return rval;
+}
+
+void XrdFfsDent_attr_put(const char *path, uid_t uid, const struct stat *stbuf)
+{
+    struct XrdFfsDentAttr *a;
+    int life = (stbuf != NULL? XrdFfsDent_attrttl : XrdFfsDent_negttl);
+
+    if (life == 0) return;
+
+    a = new struct XrdFfsDentAttr;
+    a->uid = uid;
+    if (stbuf != NULL)
+    {
+        memcpy((void*)(&a->st), (void*)stbuf, sizeof(struct stat));
+        a->neg = 0;
+    }
+    else
+    {
+        memset((void*)(&a->st), 0, sizeof(struct stat));
+        a->neg = 1;
+    }
+
+    pthread_mutex_lock(&XrdFfsDentAttr_mutex);
+    if (XrdFfsDentAttrHtab.Num() >= XrdFfsDent_MAXATTRS) XrdFfsDentAttrHtab.Purge();
+    XrdFfsDentAttrHtab.Rep(path, a, life);
+    pthread_mutex_unlock(&XrdFfsDentAttr_mutex);
+}
+
+void XrdFfsDent_attr_invalidate(const char *path)
+{
+    char parent[1024], *p;
+    int err = errno;  // callers usually still need errno of their operation
+
+    strncpy(parent, path, 1023);
+    parent[1023] = '\0';
+    p = parent + strlen(parent) - 1;
+    while (p > parent && *p == '/') *p-- = '\0';
+    p = strrchr(parent, '/');
+    if (p == parent) 
+        p[1] = '\0';  // parent is "/"
+    else if (p != NULL)
+        p[0] = '\0';
+
+    pthread_mutex_lock(&XrdFfsDentAttr_mutex);
+    XrdFfsDentAttrHtab.Del(path);
+    if (p != NULL) XrdFfsDentAttrHtab.Del(parent);
+    pthread_mutex_unlock(&XrdFfsDentAttr_mutex);
+
+    if (p != NULL) XrdFfsDent_cache_invalidate(parent);
+    XrdFfsDent_cache_invalidate(path);  // in case path is a directory
+    errno = err;
+}
+
 /*
 #include <stdio.h>
 
@@ -31,6 +31,7 @@
 #include <stdlib.h>
 #include <time.h>
 #include <pthread.h>
+#include <sys/stat.h>
 
 #ifdef __cplusplus
   extern "C" {
@@ -50,6 +51,27 @@ void XrdFfsDent_cache_init();
 void XrdFfsDent_cache_destroy();
 int  XrdFfsDent_cache_fill(char *dname, char ***dnarray, int nents);
 int  XrdFfsDent_cache_search(char *dname, char *dentname);
+int  XrdFfsDent_cache_get(const char *dname, char ***dnarray);
+void XrdFfsDent_cache_invalidate(const char *dname);
+
+/*
+   Attribute cache. _attr_get() returns 1 (and fills *stbuf) if a fresh
+   positive entry exists, -1 (with errno = ENOENT) if a fresh negative entry
+   exists, and 0 otherwise. _attr_put() with stbuf == NULL records a negative
+   entry. Entries are kept per path and uid; an entry made for another uid
+   is not returned (pass the same uid, e.g. 0, if it doesn't matter).
+
+   _attr_invalidate() drops the entries of the path and its parent and the
+   parent's cached listing; call it after changing the namespace. It
+   preserves errno.
+
+   _cache_ttl() sets the life time (in seconds) of cached listings, positive
+   and negative attributes. A zero life time disables that cache.
+ */
+void XrdFfsDent_cache_ttl(int dentttl, int attrttl, int negttl);
+int  XrdFfsDent_attr_get(const char *path, uid_t uid, struct stat *stbuf);
+void XrdFfsDent_attr_put(const char *path, uid_t uid, const struct stat *stbuf);
+void XrdFfsDent_attr_invalidate(const char *path);
 
 #ifdef __cplusplus
   }
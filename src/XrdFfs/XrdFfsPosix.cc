@@ -115,6 +115,11 @@ off_t XrdFfsPosix_lseek(int fildes, off_t offset, int whence)
     return XrdPosixXrootd::Lseek(fildes, (long long)offset, whence);
 }
 
+int XrdFfsPosix_fstat(int fildes, struct stat *buf)
+{
+    return XrdPosixXrootd::Fstat(fildes, buf);
+}
+
 ssize_t XrdFfsPosix_read(int fildes, void *buf, size_t nbyte)
 {
     return XrdPosixXrootd::Read(fildes, buf, nbyte);
@@ -572,11 +577,17 @@ int XrdFfsPosix_readdirall(const char *rdrurl, const char *path, char*** direnta
     for (i = 0; i < n; i++) free(dnarraytmp[i]);  // do not mergo with the above because the above loop has 'break'.
     free(dnarraytmp);
 
-/* inject this list into dent cache */
+/* 
+   inject this list into dent cache. A listing with DIR_LOCK is not cached 
+   because a listing served from the cache would lose the DIR_LOCK entry.
+ */
 
     char *p;
     p = strdup(path);
-    XrdFfsDent_cache_fill(p, direntarray, nents);
+    if (hasDirLock)
+        XrdFfsDent_cache_invalidate(p);
+    else
+        XrdFfsDent_cache_fill(p, direntarray, nents);
     free(p);
 
     if (hasDirLock) (*direntarray)[nents++] = strdup("DIR_LOCK");
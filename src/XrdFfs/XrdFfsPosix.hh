@@ -54,6 +54,7 @@ int            XrdFfsPosix_rmdir(const char *path);
 
 int            XrdFfsPosix_open(const char *pathname, int flags, mode_t mode);
 off_t          XrdFfsPosix_lseek(int fildes, off_t offset, int whence);
+int            XrdFfsPosix_fstat(int fildes, struct stat *buf);
 ssize_t        XrdFfsPosix_read(int fd, void *buf, size_t count);
 ssize_t        XrdFfsPosix_pread(int fildes, void *buf, size_t nbyte, off_t offset);
 int            XrdFfsPosix_close(int fd);
@@ -35,6 +35,12 @@
    Note that fuse 2.8.0 pre2 or above and kernel 2.6.27 or above provide
    a big_writes option to allow > 4KByte writing. It will make this 
    smiple write caching obsolete. 
+
+   Reads are the other way around: FUSE hands us at most 128KByte at a 
+   time, and forwarding each of them synchronously costs one round trip 
+   per 128KByte. Once a file is read sequentially, reads are served from 
+   two large windows per file; while one is being consumed the next one is 
+   fetched by a worker thread.
 */
 #define XrdFfsWcacheBufsize 131072
 
@@ -48,6 +54,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <sys/resource.h>
 #include <unistd.h>
 #include <errno.h>
@@ -57,17 +64,33 @@
 #include "XrdFfs/XrdFfsWcache.hh"
 #ifndef NOXRD
     #include "XrdFfs/XrdFfsPosix.hh"
+    #include "XrdFfs/XrdFfsQueue.hh"
 #endif
 
 #ifdef __cplusplus
   extern "C" {
 #endif
 
+#define XrdFfsRcacheNwins 2
+
+struct XrdFfsRcacheWin {
+    int fd;
+    off_t offset;
+    size_t want;                      /* bytes asked for */
+    ssize_t len;                      /* bytes in buf, -1 on error */
+    char *buf;
+    struct XrdFfsQueueTasks *task;    /* not NULL while being fetched */
+};
+
 struct XrdFfsWcacheFilebuf {
     off_t offset;
     size_t len;
     char *buf;
     pthread_mutex_t *mlock;
+    off_t rnext;                      /* where the next sequential read starts */
+    short rseq;                       /* number of sequential reads seen */
+    off_t rsize;                      /* file size when read-ahead started */
+    struct XrdFfsRcacheWin *rwins;    /* read-ahead windows, if any */
 };
 
 struct XrdFfsWcacheFilebuf *XrdFfsWcacheFbufs;
@@ -99,7 +122,156 @@ void XrdFfsWcache_init(int basefd, int maxfd)
         XrdFfsWcacheFbufs[fd].len = 0;
         XrdFfsWcacheFbufs[fd].buf = NULL;
         XrdFfsWcacheFbufs[fd].mlock = NULL;
+        XrdFfsWcacheFbufs[fd].rnext = 0;
+        XrdFfsWcacheFbufs[fd].rseq = 0;
+        XrdFfsWcacheFbufs[fd].rsize = 0;
+        XrdFfsWcacheFbufs[fd].rwins = NULL;
+    }
+}
+
+/* read-ahead windows */
+
+size_t XrdFfsRcacheWinsize = 0;
+int XrdFfsRcacheMaxfiles = 0, XrdFfsRcacheNfiles = 0;
+pthread_mutex_t XrdFfsRcache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+void XrdFfsWcache_readahead(size_t winsize, int maxfiles)
+{
+    XrdFfsRcacheWinsize = winsize;
+    XrdFfsRcacheMaxfiles = maxfiles;
+}
+
+void* XrdFfsRcache_x_fetch(void *x)
+{
+    struct XrdFfsRcacheWin *win = (struct XrdFfsRcacheWin *)x;
+
+    win->len = XrdFfsPosix_pread(win->fd, win->buf, win->want, win->offset);
+    return NULL;
+}
+
+/* wait for a window that is being fetched */
+void XrdFfsRcache_settle(struct XrdFfsRcacheWin *win)
+{
+#ifndef NOUSE_QUEUE
+    if (win->task != NULL)
+    {
+        XrdFfsQueue_wait_task(win->task);
+        XrdFfsQueue_free_task(win->task);
+        win->task = NULL;
+    }
+#endif
+}
+
+/* fetch a window starting at offset, but not past the end of the file */
+void XrdFfsRcache_fetch(struct XrdFfsWcacheFilebuf *fb, struct XrdFfsRcacheWin *win, 
+                        int fd, off_t offset, int async)
+{
+    XrdFfsRcache_settle(win);
+    win->fd = fd;
+    win->offset = offset;
+    win->want = XrdFfsRcacheWinsize;
+    if ((off_t)(offset + win->want) > fb->rsize) win->want = fb->rsize - offset;
+    win->len = 0;
+#ifndef NOUSE_QUEUE
+    if (async)
+        win->task = XrdFfsQueue_create_task(XrdFfsRcache_x_fetch, (void**)win, 0);
+    else
+#endif
+        XrdFfsRcache_x_fetch((void*)win);
+}
+
+/* 
+   _find() returns the window holding (or, if being fetched, going to hold) 
+   the byte at offset.
+ */
+struct XrdFfsRcacheWin *XrdFfsRcache_find(struct XrdFfsWcacheFilebuf *fb, off_t offset)
+{
+    int i;
+    struct XrdFfsRcacheWin *win;
+
+    for (i = 0; i < XrdFfsRcacheNwins; i++)
+    {
+        win = &fb->rwins[i];
+        if (win->offset < 0 || offset < win->offset) continue;
+        if (win->task != NULL && offset < (off_t)(win->offset + win->want)) return win;
+        if (win->task == NULL && offset < (off_t)(win->offset + win->len)) return win;
+    }
+    return NULL;
+}
+
+void XrdFfsRcache_drop(struct XrdFfsWcacheFilebuf *fb)
+{
+    int i;
+
+    if (fb->rwins == NULL) return;
+    for (i = 0; i < XrdFfsRcacheNwins; i++)
+    {
+        XrdFfsRcache_settle(&fb->rwins[i]);
+        fb->rwins[i].offset = -1;
+        fb->rwins[i].len = 0;
+    }
+}
+
+void XrdFfsRcache_free(struct XrdFfsWcacheFilebuf *fb)
+{
+    int i;
+
+    if (fb->rwins == NULL) return;
+    XrdFfsRcache_drop(fb);
+    for (i = 0; i < XrdFfsRcacheNwins; i++)
+        free(fb->rwins[i].buf);
+    free(fb->rwins);
+    fb->rwins = NULL;
+
+    pthread_mutex_lock(&XrdFfsRcache_mutex);
+    XrdFfsRcacheNfiles--;
+    pthread_mutex_unlock(&XrdFfsRcache_mutex);
+}
+
+/* returns 1 if read-ahead windows could be set up for this file */
+int XrdFfsRcache_alloc(struct XrdFfsWcacheFilebuf *fb, int fd)
+{
+    int i;
+    struct stat st;
+
+/* windows never extend past what the file had when we started */
+    if (XrdFfsPosix_fstat(fd, &st) != 0)
+        return 0;
+    fb->rsize = st.st_size;
+
+    pthread_mutex_lock(&XrdFfsRcache_mutex);
+    if (XrdFfsRcacheNfiles >= XrdFfsRcacheMaxfiles)
+    {
+        pthread_mutex_unlock(&XrdFfsRcache_mutex);
+        return 0;
     }
+    XrdFfsRcacheNfiles++;
+    pthread_mutex_unlock(&XrdFfsRcache_mutex);
+
+    fb->rwins = (struct XrdFfsRcacheWin*)malloc(sizeof(struct XrdFfsRcacheWin) * XrdFfsRcacheNwins);
+    if (fb->rwins != NULL)
+        for (i = 0; i < XrdFfsRcacheNwins; i++)
+        {
+            fb->rwins[i].offset = -1;
+            fb->rwins[i].len = 0;
+            fb->rwins[i].task = NULL;
+            fb->rwins[i].buf = (char*)malloc(XrdFfsRcacheWinsize);
+            if (fb->rwins[i].buf == NULL) 
+            {
+                while (i-- > 0) free(fb->rwins[i].buf);
+                free(fb->rwins);
+                fb->rwins = NULL;
+                break;
+            }
+        }
+    if (fb->rwins == NULL)
+    {
+        pthread_mutex_lock(&XrdFfsRcache_mutex);
+        XrdFfsRcacheNfiles--;
+        pthread_mutex_unlock(&XrdFfsRcache_mutex);
+        return 0;
+    }
+    return 1;
 }
 
 int XrdFfsWcache_create(int fd)
@@ -116,6 +288,9 @@ int XrdFfsWcache_create(int fd)
 
     XrdFfsWcacheFbufs[fd].offset = 0;
     XrdFfsWcacheFbufs[fd].len = 0;
+    XrdFfsWcacheFbufs[fd].rnext = 0;
+    XrdFfsWcacheFbufs[fd].rseq = 0;
+    XrdFfsWcacheFbufs[fd].rsize = 0;
     XrdFfsWcacheFbufs[fd].buf = (char*)malloc(XrdFfsWcacheBufsize);
     if (XrdFfsWcacheFbufs[fd].buf == NULL)
         return 0;
@@ -133,6 +308,8 @@ void XrdFfsWcache_destroy(int fd)
 /*  XrdFfsWcache_flush(fd); */
     fd -= XrdFfsPosix_baseFD;
 
+    XrdFfsRcache_free(&XrdFfsWcacheFbufs[fd]);
+
     XrdFfsWcacheFbufs[fd].offset = 0;
     XrdFfsWcacheFbufs[fd].len = 0;
     if (XrdFfsWcacheFbufs[fd].buf != NULL) 
@@ -178,11 +355,14 @@ ssize_t XrdFfsWcache_pwrite(int fd, char *buf, size_t len, off_t offset)
 /* do not use caching under these cases */
     if (len > XrdFfsWcacheBufsize/2 || fd >= XrdFfsWcacheNFILES)
     {
+        if (fd < XrdFfsWcacheNFILES && XrdFfsWcacheFbufs[fd].rwins != NULL)
+            XrdFfsWcache_discard(fd + XrdFfsPosix_baseFD);
         rc = XrdFfsPosix_pwrite(fd + XrdFfsPosix_baseFD, buf, len, offset);
         return rc;
     }
 
     pthread_mutex_lock(XrdFfsWcacheFbufs[fd].mlock);
+    XrdFfsRcache_drop(&XrdFfsWcacheFbufs[fd]);  /* read-ahead data is now stale */
     rc = XrdFfsWcacheFbufs[fd].len;
 /* 
    in the following two cases, a XrdFfsWcache_flush is required:
@@ -211,6 +391,125 @@ ssize_t XrdFfsWcache_pwrite(int fd, char *buf, size_t len, off_t offset)
     return (ssize_t)len;
 }
 
+void XrdFfsWcache_discard(int fd)
+{
+    fd -= XrdFfsPosix_baseFD;
+    if (fd < 0 || fd >= XrdFfsWcacheNFILES || XrdFfsWcacheFbufs[fd].mlock == NULL)
+        return;
+
+    pthread_mutex_lock(XrdFfsWcacheFbufs[fd].mlock);
+    XrdFfsRcache_free(&XrdFfsWcacheFbufs[fd]);  /* the file size may have changed too */
+    XrdFfsWcacheFbufs[fd].rseq = 0;
+    pthread_mutex_unlock(XrdFfsWcacheFbufs[fd].mlock);
+}
+
+ssize_t XrdFfsWcache_pread(int fd, char *buf, size_t len, off_t offset)
+{
+    struct XrdFfsWcacheFilebuf *fb;
+    struct XrdFfsRcacheWin *win, *other;
+    size_t done = 0, n;
+    ssize_t rc;
+    int i, eof = 0;
+    off_t off;
+
+    fd -= XrdFfsPosix_baseFD;
+    if (fd < 0)
+    {
+        errno = EBADF;
+        return -1;
+    }
+
+/* do not use read-ahead under these cases */
+    if (XrdFfsRcacheWinsize == 0 || len > XrdFfsRcacheWinsize || 
+        fd >= XrdFfsWcacheNFILES || XrdFfsWcacheFbufs[fd].mlock == NULL)
+        return XrdFfsPosix_pread(fd + XrdFfsPosix_baseFD, buf, len, offset);
+
+    fb = &XrdFfsWcacheFbufs[fd];
+    pthread_mutex_lock(fb->mlock);
+
+/* 
+   a read is sequential if it starts where the previous one ended, or falls 
+   in a window (FUSE may deliver reads of a sequential stream out of order).
+   Once it is not, the windows go back so that another file can use them.
+ */
+    if (offset == fb->rnext || (fb->rwins != NULL && XrdFfsRcache_find(fb, offset) != NULL))
+    {
+        if (fb->rseq < 2) fb->rseq++;
+    }
+    else
+    {
+        fb->rseq = 0;
+        XrdFfsRcache_free(fb);
+    }
+    fb->rnext = offset + len;
+
+    if (fb->rwins == NULL && (fb->rseq < 2 || ! XrdFfsRcache_alloc(fb, fd + XrdFfsPosix_baseFD)))
+    {
+        pthread_mutex_unlock(fb->mlock);
+        return XrdFfsPosix_pread(fd + XrdFfsPosix_baseFD, buf, len, offset);
+    }
+
+    win = NULL;
+    while (done < len)
+    {
+        off = offset + done;
+        if (off >= fb->rsize) break;  /* the file has grown, read the rest directly */
+        win = XrdFfsRcache_find(fb, off);
+        if (win == NULL)
+        {
+            if (fb->rseq < 2) break;
+/* reuse the window that is furthest behind */
+            win = &fb->rwins[0];
+            for (i = 1; i < XrdFfsRcacheNwins; i++)
+                if (fb->rwins[i].offset < win->offset) win = &fb->rwins[i];
+            XrdFfsRcache_fetch(fb, win, fd + XrdFfsPosix_baseFD, off, 0);
+        }
+        else
+            XrdFfsRcache_settle(win);
+
+        if (win->len < 0)
+        {
+            win->offset = -1;
+            win->len = 0;
+            win = NULL;
+            break;
+        }
+        if (off >= (off_t)(win->offset + win->len))  /* end of file */
+        {
+            eof = 1;
+            break;
+        }
+        n = win->offset + win->len - off;
+        if (n > len - done) n = len - done;
+        memcpy(buf + done, win->buf + (off - win->offset), n);
+        done += n;
+        if ((size_t)win->len < win->want && done < len)
+        {
+            eof = 1;
+            break;
+        }
+    }
+
+/* start fetching the window following the one we are in */
+    if (fb->rseq >= 2 && win != NULL && (size_t)win->len == win->want
+        && win->offset + win->len < fb->rsize
+        && XrdFfsRcache_find(fb, win->offset + win->len) == NULL)
+    {
+        other = (win == &fb->rwins[0] ? &fb->rwins[1] : &fb->rwins[0]);
+        XrdFfsRcache_fetch(fb, other, fd + XrdFfsPosix_baseFD, win->offset + win->len, 1);
+    }
+    pthread_mutex_unlock(fb->mlock);
+
+    if (done < len && ! eof)
+    {
+        rc = XrdFfsPosix_pread(fd + XrdFfsPosix_baseFD, buf + done, len - done, offset + done);
+        if (rc < 0) 
+            return (done > 0 ? (ssize_t)done : -1);
+        done += rc;
+    }
+    return (ssize_t)done;
+}
+
 #ifdef __cplusplus
   }
 #endif
@@ -37,6 +37,19 @@ void    XrdFfsWcache_destroy(int fd);
 ssize_t  XrdFfsWcache_flush(int fd);
 ssize_t  XrdFfsWcache_pwrite(int fd, char *buf, size_t len, off_t offset);
 
+/*
+   Read-ahead: once a file is read sequentially, _pread() reads it in windows
+   of winsize bytes and fetches the next window in the background (through
+   the XrdFfsQueue workers), but not past the size the file had then. A file
+   gives its windows back as soon as it is no longer read sequentially. At 
+   most maxfiles files do read-ahead at a time. winsize 0 (the default) 
+   disables read-ahead. _discard() drops read-ahead data of a file that was 
+   changed other than through _pwrite().
+ */
+void    XrdFfsWcache_readahead(size_t winsize, int maxfiles);
+ssize_t  XrdFfsWcache_pread(int fd, char *buf, size_t len, off_t offset);
+void    XrdFfsWcache_discard(int fd);
+
 #ifdef __cplusplus
   }
 #endif
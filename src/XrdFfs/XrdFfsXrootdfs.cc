@@ -64,7 +64,7 @@
 #include "XrdFfs/XrdFfsMisc.hh"
 #include "XrdFfs/XrdFfsWcache.hh"
 #include "XrdFfs/XrdFfsQueue.hh"
-//#include "XrdFfs/XrdFfsDent.hh"
+#include "XrdFfs/XrdFfsDent.hh"
 #include "XrdFfs/XrdFfsFsinfo.hh"
 #include "XrdPosix/XrdPosixXrootd.hh"
 
@@ -80,12 +80,17 @@ struct XROOTDFS {
     bool ofsfwd;
     int  nworkers;
     int  maxfd;
+    int  attrttl;
+    int  negttl;
+    int  dentttl;
+    int  readdirplus;
+    int  readahead;
 };
 
 int cwdfd; // File descript of the initial working dir
 
 struct XROOTDFS xrootdfs;
-static struct fuse_opt xrootdfs_opts[14];
+static struct fuse_opt xrootdfs_opts[19];
 
 enum { OPT_KEY_HELP, OPT_KEY_SECSSS, };
 
@@ -128,6 +133,17 @@ static void* xrootdfs_init(struct fuse_conn_info *conn)
     XrdPosixXrootd *abc = new XrdPosixXrootd(-xrootdfs.maxfd);
     XrdFfsMisc_xrd_init(xrootdfs.rdr,xrootdfs.urlcachelife,0);
     XrdFfsWcache_init(abc->fdOrigin(), xrootdfs.maxfd);
+    XrdFfsDent_cache_ttl(xrootdfs.dentttl, xrootdfs.attrttl, xrootdfs.negttl);
+    XrdFfsWcache_readahead((xrootdfs.readahead > 0 ? xrootdfs.readahead : 0), 64);
+
+/* 
+   With big_writes the kernel passes writes of up to max_write bytes instead
+   of splitting them into pages (FUSE >= 2.8, kernel >= 2.6.26).
+ */
+#ifdef FUSE_CAP_BIG_WRITES
+    if (conn->capable & FUSE_CAP_BIG_WRITES)
+        conn->want |= FUSE_CAP_BIG_WRITES;
+#endif
 /*
    From FAQ:
       Miscellaneous threads should be started from the init() method.
@@ -149,7 +165,12 @@ static void* xrootdfs_init(struct fuse_conn_info *conn)
     return NULL;
 }
 
-static int xrootdfs_getattr(const char *path, struct stat *stbuf)
+static int xrootdfs_do_getattr(const char *path, struct stat *stbuf, uid_t uid, gid_t gid, bool fanout)
+/*
+   uid and gid are those of the user asking (fuse_get_context() is not valid 
+   in the worker threads). Without fanout, a stat that would have to go to all
+   data servers returns -EAGAIN instead; it is then left to getattr().
+ */
 {
 //  int res, fd;
     int res;
@@ -163,7 +184,7 @@ static int xrootdfs_getattr(const char *path, struct stat *stbuf)
 //    user_gid = fuse_get_context()->gid;
 //    gid = getgid();
 
-    XrdFfsMisc_xrd_secsss_register(fuse_get_context()->uid, fuse_get_context()->gid, 0);
+    XrdFfsMisc_xrd_secsss_register(uid, gid, 0);
 
     rootpath[0]='\0';
 /*
@@ -183,11 +204,20 @@ static int xrootdfs_getattr(const char *path, struct stat *stbuf)
     {
         strncat(rootpath,xrootdfs.cns, MAXROOTURLLEN - strlen(rootpath) -1);
         strncat(rootpath,path, MAXROOTURLLEN - strlen(rootpath) -1);
-        XrdFfsMisc_xrd_secsss_editurl(rootpath, fuse_get_context()->uid, 0);
+        XrdFfsMisc_xrd_secsss_editurl(rootpath, uid, 0);
         res = XrdFfsPosix_stat(rootpath, stbuf);
     }
+    else if (fanout)
+        res = XrdFfsPosix_statall(xrootdfs.rdr, path, stbuf, uid);
     else
-        res = XrdFfsPosix_statall(xrootdfs.rdr, path, stbuf, fuse_get_context()->uid);
+    {
+/* this is what _statall() does first for an entry of a recent listing */
+        strncat(rootpath,xrootdfs.rdr, MAXROOTURLLEN - strlen(rootpath) -1);
+        strncat(rootpath,path, MAXROOTURLLEN - strlen(rootpath) -1);
+        XrdFfsMisc_xrd_secsss_editurl(rootpath, uid, 0);
+        res = XrdFfsPosix_stat(rootpath, stbuf);
+        if (res != 0) return -EAGAIN;
+    }
 
 //    seteuid(getuid());
 //    setegid(getgid());
@@ -216,7 +246,7 @@ static int xrootdfs_getattr(const char *path, struct stat *stbuf)
                 rootpath[0]='\0';
                 strncat(rootpath,xrootdfs.rdr, MAXROOTURLLEN - strlen(rootpath) -1);
                 strncat(rootpath,path, MAXROOTURLLEN - strlen(rootpath) -1);
-                XrdFfsMisc_xrd_secsss_editurl(rootpath, fuse_get_context()->uid, 0);
+                XrdFfsMisc_xrd_secsss_editurl(rootpath, uid, 0);
                 XrdFfsPosix_stat(rootpath, stbuf);
 //                stbuf->st_uid = user_uid;
 //                stbuf->st_gid = user_gid;
@@ -244,7 +274,7 @@ static int xrootdfs_getattr(const char *path, struct stat *stbuf)
         rootpath[0]='\0';
         strncat(rootpath,xrootdfs.cns, MAXROOTURLLEN - strlen(rootpath) -1);
         strncat(rootpath,path, MAXROOTURLLEN - strlen(rootpath) -1);
-        XrdFfsMisc_xrd_secsss_editurl(rootpath, fuse_get_context()->uid, 0);
+        XrdFfsMisc_xrd_secsss_editurl(rootpath, uid, 0);
         res = XrdFfsPosix_stat(rootpath, stbuf);
 //        stbuf->st_uid = user_uid;
 //        stbuf->st_gid = user_gid;
@@ -266,6 +296,132 @@ static int xrootdfs_getattr(const char *path, struct stat *stbuf)
     }
 }
 
+/* 
+   With sss, what a user may see depends on the user, so the uid is part of 
+   the attribute cache key.
+ */
+static uid_t xrootdfs_cache_uid(uid_t uid)
+{
+    return (xrootdfs.ssskeytab != NULL? uid : 0);
+}
+
+static int xrootdfs_getattr(const char *path, struct stat *stbuf)
+/*
+   Attributes (and non-existence) are cached for a few seconds so that 
+   repeated lookups, e.g. from an 'ls -l' or a build, don't each go to 
+   all data servers.
+ */
+{
+    int res;
+    uid_t uid = fuse_get_context()->uid;
+
+    res = XrdFfsDent_attr_get(path, xrootdfs_cache_uid(uid), stbuf);
+    if (res == 1) 
+        return 0;
+    else if (res == -1)
+        return -ENOENT;
+
+    res = xrootdfs_do_getattr(path, stbuf, uid, fuse_get_context()->gid, true);
+    if (res == 0)
+        XrdFfsDent_attr_put(path, xrootdfs_cache_uid(uid), stbuf);
+    else if (res == -ENOENT)
+        XrdFfsDent_attr_put(path, xrootdfs_cache_uid(uid), NULL);
+    return res;
+}
+
+/* 
+   xrootdfs_readdirplus() stats the entries of a directory listing in parallel 
+   (through the task queue) and puts the results in the attribute cache, so 
+   that the getattr() calls following a readdir() don't have to go out one by
+   one. The entries are stat'ed exactly as getattr() would, except that the 
+   workers never fan out to all data servers (that would need workers too); 
+   such entries, and those that don't exist, are left to getattr(). As this 
+   makes a listing cost a stat per entry, it is only done if enabled.
+ */
+
+struct xrootdfs_readdirplus_args {
+    const char *path;
+    uid_t uid;
+    gid_t gid;
+    int *res;
+    struct stat *stbuf;
+};
+
+void* xrootdfs_x_readdirplus(void *x)
+{
+    struct xrootdfs_readdirplus_args *args = (struct xrootdfs_readdirplus_args *)x;
+
+    *(args->res) = xrootdfs_do_getattr(args->path, args->stbuf, args->uid, args->gid, false);
+    return NULL;
+}
+
+static void xrootdfs_readdirplus(const char *path, char **dnarray, int n)
+{
+    int i, j, k, nbatch, rootlen;
+    char rootpath[MAXROOTURLLEN];
+    struct stat stbuf;
+    uid_t uid = fuse_get_context()->uid;
+    gid_t gid = fuse_get_context()->gid;
+
+    rootpath[0]='\0';
+    strncat(rootpath, path, MAXROOTURLLEN - strlen(rootpath) -1);
+    if (rootpath[strlen(rootpath) -1] != '/') 
+        strncat(rootpath, "/", MAXROOTURLLEN - strlen(rootpath) -1);
+    rootlen = strlen(rootpath);
+
+    nbatch = 4 * (xrootdfs.nworkers > 0 ? xrootdfs.nworkers : 1);
+
+    char **paths = (char **) malloc(sizeof(char*) * nbatch);
+    int *res_i = (int *) malloc(sizeof(int) * nbatch);
+    struct stat *stbuf_i = (struct stat *) malloc(sizeof(struct stat) * nbatch);
+    struct xrootdfs_readdirplus_args *args = (struct xrootdfs_readdirplus_args *)
+                                             malloc(sizeof(struct xrootdfs_readdirplus_args) * nbatch);
+    struct XrdFfsQueueTasks **jobs = (struct XrdFfsQueueTasks **)
+                                     malloc(sizeof(struct XrdFfsQueueTasks *) * nbatch);
+
+    for (i = 0; i < n; )
+    {
+        for (j = 0; i < n && j < nbatch; i++)
+        {
+            if (! strcmp(dnarray[i], ".") || ! strcmp(dnarray[i], "..")) continue;
+
+            rootpath[rootlen] = '\0';
+            strncat(rootpath, dnarray[i], MAXROOTURLLEN - strlen(rootpath) -1);
+            if (XrdFfsDent_attr_get(rootpath, xrootdfs_cache_uid(uid), &stbuf) != 0) continue;
+
+            paths[j] = strdup(rootpath);
+            args[j].path = paths[j];
+            args[j].uid = uid;
+            args[j].gid = gid;
+            args[j].res = &res_i[j];
+            args[j].stbuf = &stbuf_i[j];
+#ifdef NOUSE_QUEUE
+            xrootdfs_x_readdirplus((void*) &args[j]);
+#else
+            jobs[j] = XrdFfsQueue_create_task(xrootdfs_x_readdirplus, (void**)(&args[j]), 0);
+#endif
+            j++;
+        }
+
+        for (k = 0; k < j; k++)
+        {
+#ifndef NOUSE_QUEUE
+            XrdFfsQueue_wait_task(jobs[k]);
+            XrdFfsQueue_free_task(jobs[k]);
+#endif
+            if (res_i[k] == 0)
+                XrdFfsDent_attr_put(paths[k], xrootdfs_cache_uid(uid), &stbuf_i[k]);
+            free(paths[k]);
+        }
+    }
+
+    free(jobs);
+    free(args);
+    free(stbuf_i);
+    free(res_i);
+    free(paths);
+}
+
 static int xrootdfs_access(const char *path, int mask)
 {
 /*
@@ -318,6 +474,7 @@ static int xrootdfs_readdir(const char *path, void *buf, fuse_fill_dir_t filler,
         if (dp == NULL)
             return -errno;
                                                                                                                                                
+        struct XrdFfsDentnames *names = NULL;
         while ((de = XrdFfsPosix_readdir(dp)) != NULL)
         {
 /*
@@ -326,22 +483,44 @@ static int xrootdfs_readdir(const char *path, void *buf, fuse_fill_dir_t filler,
             st.st_ino = de->d_ino;
             st.st_mode = de->d_type << 12;
  */
+            if (xrootdfs.readdirplus) 
+                XrdFfsDent_names_add(&names, de->d_name);
             if (filler(buf, de->d_name, NULL, 0))
                 break;
         }
         XrdFfsPosix_closedir(dp);
+
+        if (names != NULL)
+        {
+            int i, n;
+            char **dnarray;
+
+            n = XrdFfsDent_names_extract(&names, &dnarray);
+            xrootdfs_readdirplus(path, dnarray, n);
+            for (i = 0; i < n; i++)
+                free(dnarray[i]);
+            free(dnarray);
+        }
         return 0;
     }
     else  /* if there is no CNS, try collect dirents from all known data servers. */
     {
-         int i, n;
+         int i, n, err = 0;
          char **dnarray = NULL;
 
-         n = XrdFfsPosix_readdirall(xrootdfs.rdr, path, &dnarray, fuse_get_context()->uid);
+/* a recent listing of the same directory saves going to all data servers */
+         n = XrdFfsDent_cache_get(path, &dnarray);
+         if (n < 0)
+         {
+             n = XrdFfsPosix_readdirall(xrootdfs.rdr, path, &dnarray, fuse_get_context()->uid);
+             err = errno;
+         }
 
          for (i = 0; i < n; i++)
              if (filler(buf, dnarray[i], NULL, 0)) break;
 
+         if (xrootdfs.readdirplus && n > 0) xrootdfs_readdirplus(path, dnarray, n);
+
 /* 
   this loop should not be merged with the above loop because all members of 
   dnarray[] should be freed, or there will be memory leak.
@@ -350,7 +529,7 @@ static int xrootdfs_readdir(const char *path, void *buf, fuse_fill_dir_t filler,
              free(dnarray[i]);
          free(dnarray); 
 
-         return -errno;
+         return -err;
     }
 }
 
@@ -422,6 +601,7 @@ static int xrootdfs_mknod(const char *path, mode_t mode, dev_t rdev)
         xrootdfs_do_create(path, xrootdfs.cns, O_CREAT | O_EXCL, false, &fd);
         XrdFfsPosix_close(fd);
     }
+    XrdFfsDent_attr_invalidate(path);
     return res;
 }
 
@@ -447,6 +627,7 @@ static int xrootdfs_create(const char *path, mode_t mode, struct fuse_file_info
         xrootdfs_do_create(path, xrootdfs.cns, O_CREAT | O_EXCL, false, &fd);
         XrdFfsPosix_close(fd);
     }
+    XrdFfsDent_attr_invalidate(path);
     return res;
 }
 
@@ -474,6 +655,7 @@ static int xrootdfs_mkdir(const char *path, mode_t mode)
     XrdFfsMisc_xrd_secsss_editurl(rootpath, fuse_get_context()->uid, 0);
 
     res = XrdFfsPosix_mkdir(rootpath, mode);
+    XrdFfsDent_attr_invalidate(path);
     if (res == 0) return 0;
 /* 
    now we are here either because there is either a race to create the directory, or the redirector 
@@ -485,6 +667,7 @@ static int xrootdfs_mkdir(const char *path, mode_t mode)
     XrdFfsPosix_clear_from_rdr_cache(rootpath);
 
     res = XrdFfsPosix_mkdir(rootpath, mode);
+    XrdFfsDent_attr_invalidate(path);
     return ((res == -1)? -errno : 0);
 }
 
@@ -506,6 +689,7 @@ static int xrootdfs_unlink(const char *path)
     else
         res = XrdFfsPosix_unlinkall(xrootdfs.rdr, path, fuse_get_context()->uid);
 
+    XrdFfsDent_attr_invalidate(path);
     if (res == -1)
         return -errno;
 
@@ -542,6 +726,7 @@ static int xrootdfs_rmdir(const char *path)
     else
         res = XrdFfsPosix_rmdirall(xrootdfs.rdr, path, fuse_get_context()->uid);
 
+    XrdFfsDent_attr_invalidate(path);
     if (res == -1)
         return -errno;
 
@@ -615,6 +800,8 @@ static int xrootdfs_rename(const char *from, const char *to)
     else
         res = XrdFfsPosix_renameall(xrootdfs.rdr, from, to, fuse_get_context()->uid);
 
+    XrdFfsDent_attr_invalidate(from);
+    XrdFfsDent_attr_invalidate(to);
     if (res == -1)
         return -errno;
     
@@ -685,7 +872,9 @@ static int xrootdfs_ftruncate(const char *path, off_t size,
                                                                                                                                            
     fd = (int) fi->fh;
     XrdFfsWcache_flush(fd);
+    XrdFfsWcache_discard(fd);
     res = XrdFfsPosix_ftruncate(fd, size);
+    XrdFfsDent_attr_invalidate(path);
     if (res == -1)
         return -errno;
                                                                                                                               
@@ -725,6 +914,7 @@ static int xrootdfs_truncate(const char *path, off_t size)
     else
         res = XrdFfsPosix_truncateall(xrootdfs.rdr, path, size, fuse_get_context()->uid);
 
+    XrdFfsDent_attr_invalidate(path);
     if (res == -1)
         return -errno;
 
@@ -795,7 +985,7 @@ static int xrootdfs_read(const char *path, char *buf, size_t size, off_t offset,
 
     fd = (int) fi->fh;
     XrdFfsWcache_flush(fd);  /* in case is the file is reading/writing */
-    res = XrdFfsPosix_pread(fd, buf, size, offset);
+    res = XrdFfsWcache_pread(fd, buf, size, offset);
     if (res == -1)
         res = -errno;
 
@@ -902,6 +1092,8 @@ static int xrootdfs_release(const char *path, struct fuse_file_info *fi)
     XrdFfsWcache_destroy(fd);
     XrdFfsPosix_close(fd);
     fi->fh = 0;
+    if ((fi->flags & O_ACCMODE) != O_RDONLY)
+        XrdFfsDent_attr_invalidate(path);  // size and mtime may have changed
 /* 
    Return at here because the current version of Cluster Name Space daemon 
    doesn't implement the 'truncate' functon we originally planned.
@@ -1242,6 +1434,11 @@ static void xrootdfs_usage(const char *progname)
 "    -o maxfd=N               number of virtual file descriptors for posix requests, default 8192 (min 2048)\n"
 "    -o nworkers=N            number of workers to handle parallel requests to data servers, default 4\n"
 "    -o fastls=RDR            set to RDR when CNS is presented will cause stat() to go to redirector\n"
+"    -o attrttl=N             seconds to cache file/directory attributes, default 10, 0 disables\n"
+"    -o negttl=N              seconds to cache non-existence of files/directories, default 5, 0 disables\n"
+"    -o dentttl=N             seconds to reuse a directory listing, default 10, 0 disables\n"
+"    -o readdirplus=0/1       fill the attribute cache when listing a directory, default 0\n"
+"    -o readahead=N           read-ahead window (bytes) for sequential reads, default 1048576, 0 disables\n"
 "\n", progname);
 }
 
@@ -1377,7 +1574,30 @@ int main(int argc, char *argv[])
     xrootdfs_opts[12].offset = offsetof(struct XROOTDFS, maxfd);
     xrootdfs_opts[12].value = 0;
 
-    xrootdfs_opts[13].templ = NULL;
+/* life time of cached attributes, non-existence and directory listings */
+    xrootdfs_opts[13].templ = "attrttl=%d";
+    xrootdfs_opts[13].offset = offsetof(struct XROOTDFS, attrttl);
+    xrootdfs_opts[13].value = 0;
+
+    xrootdfs_opts[14].templ = "negttl=%d";
+    xrootdfs_opts[14].offset = offsetof(struct XROOTDFS, negttl);
+    xrootdfs_opts[14].value = 0;
+
+    xrootdfs_opts[15].templ = "dentttl=%d";
+    xrootdfs_opts[15].offset = offsetof(struct XROOTDFS, dentttl);
+    xrootdfs_opts[15].value = 0;
+
+/* stat the entries of a listing in parallel and cache the result */
+    xrootdfs_opts[16].templ = "readdirplus=%d";
+    xrootdfs_opts[16].offset = offsetof(struct XROOTDFS, readdirplus);
+    xrootdfs_opts[16].value = 0;
+
+/* size of read-ahead windows */
+    xrootdfs_opts[17].templ = "readahead=%d";
+    xrootdfs_opts[17].offset = offsetof(struct XROOTDFS, readahead);
+    xrootdfs_opts[17].value = 0;
+
+    xrootdfs_opts[18].templ = NULL;
 
 /* initialize struct xrootdfs */
 //    memset(&xrootdfs, 0, sizeof(xrootdfs));
@@ -1390,6 +1610,11 @@ int main(int argc, char *argv[])
     xrootdfs.urlcachelife = strdup("3650d"); /* 10 years */
     xrootdfs.nworkers = 4;
     xrootdfs.maxfd = 8192;
+    xrootdfs.attrttl = 10;
+    xrootdfs.negttl = 5;
+    xrootdfs.dentttl = 10;
+    xrootdfs.readdirplus = 0;
+    xrootdfs.readahead = 1048576;
 
 /* Get options from environment variables first */
     xrootdfs.rdr = getenv("XROOTDFS_RDRURL");
@@ -1400,6 +1625,11 @@ int main(int argc, char *argv[])
     if (getenv("XROOTDFS_OFSFWD") != NULL && ! strcmp(getenv("XROOTDFS_OFSFWD"),"1")) xrootdfs.ofsfwd = true;
     if (getenv("XROOTDFS_NWORKERS") != NULL) sscanf(getenv("XROOTDFS_NWORKERS"), "%d", &xrootdfs.nworkers);
     if (getenv("XROOTDFS_MAXFD") != NULL) sscanf(getenv("XROOTDFS_MAXFD"), "%d", &xrootdfs.maxfd);
+    if (getenv("XROOTDFS_ATTRTTL") != NULL) sscanf(getenv("XROOTDFS_ATTRTTL"), "%d", &xrootdfs.attrttl);
+    if (getenv("XROOTDFS_NEGTTL") != NULL) sscanf(getenv("XROOTDFS_NEGTTL"), "%d", &xrootdfs.negttl);
+    if (getenv("XROOTDFS_DENTTTL") != NULL) sscanf(getenv("XROOTDFS_DENTTTL"), "%d", &xrootdfs.dentttl);
+    if (getenv("XROOTDFS_READDIRPLUS") != NULL) sscanf(getenv("XROOTDFS_READDIRPLUS"), "%d", &xrootdfs.readdirplus);
+    if (getenv("XROOTDFS_READAHEAD") != NULL) sscanf(getenv("XROOTDFS_READAHEAD"), "%d", &xrootdfs.readahead);
 
 /* Parse XrootdFS options, will overwrite those defined in environment variables */
     fuse_opt_parse(&args, &xrootdfs, xrootdfs_opts, xrootdfs_opt_proc);
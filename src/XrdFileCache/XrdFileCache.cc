@@ -19,12 +19,16 @@
 #include <fcntl.h>
 #include <sstream>
 #include <algorithm>
+#include <errno.h>
+#include <time.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include <sys/statvfs.h>
 
 #include "XrdCl/XrdClConstants.hh"
 #include "XrdCl/XrdClURL.hh"
 #include "XrdSys/XrdSysPthread.hh"
-#include "XrdSys/XrdSysTimer.hh"
 #include "XrdOss/XrdOss.hh"
 #include "XrdOuc/XrdOucEnv.hh"
 #include "XrdOuc/XrdOucUtils.hh"
@@ -49,10 +53,9 @@ void *PurgeThread(void* cache_void)
    return NULL;
 }
 
-void *ProcessWriteTaskThread(void* c)
+void *ProcessWriteTaskThread(void* wq)
 {
-   Cache *cache = static_cast<Cache*>(c);
-   cache->ProcessWriteTasks();
+   Cache::GetInstance().ProcessWriteTasks(static_cast<WriteQ*>(wq));
    return NULL;
 }
 
@@ -83,16 +86,13 @@ XrdOucCache2 *XrdOucGetCache2(XrdSysLogger *logger,
    }
    err.Say("------ Proxy file cache initialization completed.");
 
-   for (int wti = 0; wti < factory.RefConfiguration().m_wqueue_threads; ++wti)
-   {
-      pthread_t tid1;
-      XrdSysThread::Run(&tid1, ProcessWriteTaskThread, (void*)(&factory), 0, "XrdFileCache WriteTasks ");
-   }
-
    if (factory.RefConfiguration().m_prefetch_max_blocks > 0)
    {
-      pthread_t tid2;
-      XrdSysThread::Run(&tid2, PrefetchThread, (void*)(&factory), 0, "XrdFileCache Prefetch ");
+      for (int pti = 0; pti < factory.RefConfiguration().m_prefetch_threads; ++pti)
+      {
+         pthread_t tid2;
+         XrdSysThread::Run(&tid2, PrefetchThread, (void*)(&factory), 0, "XrdFileCache Prefetch ");
+      }
    }
 
    pthread_t tid;
@@ -165,10 +165,21 @@ Cache::Cache(XrdSysLogger *logger) :
    m_trace(new XrdSysTrace("XrdFileCache", logger)),
    m_traceID("Manager"),
    m_prefetch_condVar(0),
+   m_prefetch_ram_limit(0),
+   m_prefetch_ram_waiters(0),
+   m_prefetch_n_blocks(0),
+   m_prefetch_n_unused(0),
+   m_RAMblocks(0),
+   m_RAMblocks_len(0),
+   m_RAMblock_size(0),
+   m_RAMblocks_next(0),
+   m_RAMblocks_free(0),
    m_RAMblocks_used(0),
    m_isClient(false),
+   m_writes_between_purges(0),
    m_in_purge(false),
-   m_active_cond(0)
+   m_active_cond(0),
+   m_prefetch_vtime(0)
 {
    // Default log level is Warning.
    m_trace->What = 2;
@@ -227,18 +238,63 @@ int Cache::isAttached()
 }
 
 
+namespace
+{
+long long now_usec()
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * 1000000ll + ts.tv_nsec / 1000;
+}
+
+bool block_order(const Block *a, const Block *b)
+{
+   return a->m_file < b->m_file || (a->m_file == b->m_file && a->m_offset < b->m_offset);
+}
+}
+
+
+WriteQ* Cache::GetWriteQ(dev_t dev)
+{
+   XrdSysMutexHelper lock(m_writeQs_mutex);
+
+   for (std::vector<WriteQ*>::iterator i = m_writeQs.begin(); i != m_writeQs.end(); ++i)
+   {
+      if ((*i)->dev == dev) return *i;
+   }
+
+   TRACE(Debug, "Cache::GetWriteQ() starting write queue for device " << dev);
+
+   WriteQ *wq = new WriteQ(dev);
+   m_writeQs.push_back(wq);
+
+   for (int wti = 0; wti < m_configuration.m_wqueue_threads; ++wti)
+   {
+      pthread_t tid;
+      XrdSysThread::Run(&tid, ProcessWriteTaskThread, (void*) wq, 0, "XrdFileCache WriteTasks ");
+   }
+
+   return wq;
+}
+
+
 void Cache::AddWriteTask(Block* b, bool fromRead)
 {
    TRACE(Dump, "Cache::AddWriteTask() bOff=%ld " <<  b->m_offset);
 
-   m_writeQ.condVar.Lock();
+   WriteQ *wq = b->m_file->GetWriteQ();
+
+   b->m_queued = now_usec();
+
+   wq->condVar.Lock();
    if (fromRead)
-      m_writeQ.queue.push_back(b);
+      wq->queue.push_back(b);
    else
-      m_writeQ.queue.push_front(b);
-   m_writeQ.size++;
-   m_writeQ.condVar.Signal();
-   m_writeQ.condVar.UnLock();
+      wq->queue.push_front(b);
+   wq->size++;
+   wq->max_size = std::max(wq->max_size, wq->size);
+   wq->condVar.Signal();
+   wq->condVar.UnLock();
 }
 
 
@@ -246,86 +302,211 @@ void Cache::RemoveWriteQEntriesFor(File *iFile)
 {
    std::list<Block*> removed_blocks;
 
-   m_writeQ.condVar.Lock();
-   std::list<Block*>::iterator i = m_writeQ.queue.begin();
-   while (i != m_writeQ.queue.end())
+   WriteQ *wq = iFile->GetWriteQ();
+
+   wq->condVar.Lock();
+   std::list<Block*>::iterator i = wq->queue.begin();
+   while (i != wq->queue.end())
    {
       if ((*i)->m_file == iFile)
       {
          TRACE(Dump, "Cache::Remove entries for " <<  (void*)(*i) << " path " <<  iFile->lPath());
          std::list<Block*>::iterator j = i++;
          removed_blocks.push_back(*j);
-         m_writeQ.queue.erase(j);
-         --m_writeQ.size;
+         wq->queue.erase(j);
+         --wq->size;
       }
       else
       {
          ++i;
       }
    }
-   m_writeQ.condVar.UnLock();
+   wq->condVar.UnLock();
 
    iFile->BlocksRemovedFromWriteQ(removed_blocks);
 }
 
 
-void Cache::ProcessWriteTasks()
+void Cache::ProcessWriteTasks(WriteQ *wq)
 {
    std::vector<Block*> blks_to_write(m_configuration.m_wqueue_blocks);
+   std::vector<int>    run_lengths;
 
    while (true)
    {
-      m_writeQ.condVar.Lock();
-      while (m_writeQ.size == 0)
+      wq->condVar.Lock();
+      while (wq->size == 0)
       {
-         m_writeQ.condVar.Wait();
+         wq->condVar.Wait();
       }
 
-      // MT -- optimize to pop several blocks if they are available (or swap the list).
-      // This makes sense especially for smallish block sizes.
-
-      int n_pushed = std::min(m_writeQ.size, m_configuration.m_wqueue_blocks);
+      int       n_pushed = std::min(wq->size, m_configuration.m_wqueue_blocks);
+      long long now      = now_usec();
 
       for (int bi = 0; bi < n_pushed; ++bi)
       {
-         Block* block = m_writeQ.queue.front();
-         m_writeQ.queue.pop_front();
-         m_writeQ.writes_between_purges += block->get_size();
+         Block* block = wq->queue.front();
+         wq->queue.pop_front();
+         m_writes_between_purges += block->get_size();
+         wq->wait_usec           += now - block->m_queued;
 
          blks_to_write[bi] = block;
 
          TRACE(Dump, "Cache::ProcessWriteTasks for block " <<  (void*)(block) << " path " << block->m_file->lPath());
       }
-      m_writeQ.size -= n_pushed;
+      wq->size -= n_pushed;
 
-      m_writeQ.condVar.UnLock();
+      // Consecutive blocks of a file are written together.
+      std::sort(blks_to_write.begin(), blks_to_write.begin() + n_pushed, block_order);
 
-      for (int bi = 0; bi < n_pushed; ++bi)
+      run_lengths.clear();
+      for (int bi = 0; bi < n_pushed; bi += run_lengths.back())
       {
-         Block* block = blks_to_write[bi];
+         int n = 1;
+         while (bi + n < n_pushed && blks_to_write[bi + n]->m_file == blks_to_write[bi]->m_file &&
+                blks_to_write[bi + n]->m_offset == blks_to_write[bi + n - 1]->m_offset + blks_to_write[bi + n - 1]->get_size())
+         {
+            ++n;
+         }
+         run_lengths.push_back(n);
+      }
+      wq->n_blocks += n_pushed;
+      wq->n_writes += run_lengths.size();
+
+      wq->condVar.UnLock();
 
-         block->m_file->WriteBlockToDisk(block);
+      Block **blks = &blks_to_write[0];
+      for (std::vector<int>::iterator ri = run_lengths.begin(); ri != run_lengths.end(); ++ri)
+      {
+         (*blks)->m_file->WriteBlocksToDisk(blks, *ri);
+         blks += *ri;
+      }
+   }
+}
+
+
+bool Cache::InitRAMBlocks()
+{
+   // Allocate the slab of in-memory cache blocks. Blocks are page aligned so
+   // that they can be used for direct I/O. The memory is only reserved here;
+   // pages are committed when a block is first used.
+
+   const long long pgsz = sysconf(_SC_PAGESIZE);
+   const int       nblk = m_configuration.m_NRamBuffers;
+   void           *slab = MAP_FAILED;
+
+   m_RAMblock_size = (m_configuration.m_bufferSize + pgsz - 1) / pgsz * pgsz;
+   m_RAMblocks_len = m_RAMblock_size * nblk;
+
+#ifdef MAP_HUGETLB
+   if (m_configuration.m_RamHugePages)
+   {
+      // Explicit huge pages have to be reserved by the administrator.
+      // If there are not enough we fall back to transparent ones. We must
+      // not use MAP_NORESERVE here, otherwise a shortage is only noticed
+      // when the page is touched (i.e. the process gets a SIGBUS).
+      const long long hpsz = 2 * 1024 * 1024;
+      long long len = (m_RAMblocks_len + hpsz - 1) / hpsz * hpsz;
+      slab = mmap(0, len, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      if (slab != MAP_FAILED)
+      {
+         m_RAMblocks_len = len;
+         m_log.Say("Config RAM blocks use explicit huge pages.");
+      }
+   }
+#endif
+
+   if (slab == MAP_FAILED)
+   {
+      slab = mmap(0, m_RAMblocks_len, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+      if (slab == MAP_FAILED)
+      {
+         m_log.Emsg("Config", errno, "allocate RAM blocks");
+         return false;
+      }
+#ifdef MADV_HUGEPAGE
+      if (m_configuration.m_RamHugePages && madvise(slab, m_RAMblocks_len, MADV_HUGEPAGE))
+      {
+         m_log.Emsg("Config", errno, "use transparent huge pages for RAM blocks");
       }
+#endif
    }
+   m_RAMblocks = (char*) slab;
+
+   // Chain all the blocks on the free list.
+   m_RAMblocks_next = new std::atomic<int>[nblk];
+   for (int i = 0; i < nblk; ++i)
+   {
+      m_RAMblocks_next[i].store(i + 1 < nblk ? i + 2 : 0, std::memory_order_relaxed);
+   }
+   m_RAMblocks_free.store(nblk > 0 ? 1 : 0);
+
+   return true;
 }
 
 
-bool Cache::RequestRAMBlock()
+char* Cache::RequestRAMBlock(long long size)
 {
-   XrdSysMutexHelper lock(&m_RAMblock_mutex);
-   if ( m_RAMblocks_used < Cache::GetInstance().RefConfiguration().m_NRamBuffers )
+   if (m_RAMblocks_used.fetch_add(1) >= m_configuration.m_NRamBuffers)
+   {
+      m_RAMblocks_used.fetch_sub(1);
+      return 0;
+   }
+
+   if (size > m_RAMblock_size)
    {
-      m_RAMblocks_used++;
-      return true;
+      void *buff;
+      if (posix_memalign(&buff, sysconf(_SC_PAGESIZE), size))
+      {
+         m_RAMblocks_used.fetch_sub(1);
+         return 0;
+      }
+      return (char*) buff;
    }
-   return false;
+
+   // There is a free block as we are within the count, pop it.
+   long long head = m_RAMblocks_free.load(), next;
+   int       idx;
+   do
+   {
+      idx  = (int) (head & 0xffffffff) - 1;
+      next = (((head >> 32) + 1) << 32) | m_RAMblocks_next[idx].load(std::memory_order_relaxed);
+   }
+   while ( ! m_RAMblocks_free.compare_exchange_weak(head, next));
+
+   return m_RAMblocks + idx * m_RAMblock_size;
 }
 
 
-void Cache::RAMBlockReleased()
+void Cache::RAMBlockReleased(char *buff)
 {
-   XrdSysMutexHelper lock(&m_RAMblock_mutex);
-   m_RAMblocks_used--;
+   if (buff < m_RAMblocks || buff >= m_RAMblocks + m_RAMblocks_len)
+   {
+      free(buff);
+   }
+   else
+   {
+      int       idx  = (buff - m_RAMblocks) / m_RAMblock_size;
+      long long head = m_RAMblocks_free.load(), next;
+      do
+      {
+         m_RAMblocks_next[idx].store((int) (head & 0xffffffff), std::memory_order_relaxed);
+         next = (((head >> 32) + 1) << 32) | (idx + 1);
+      }
+      while ( ! m_RAMblocks_free.compare_exchange_weak(head, next));
+   }
+
+   // Wake up prefetch threads waiting for a free block. They increase the
+   // waiter count before checking the number of used blocks so one of us
+   // sees the other's change.
+   if (m_RAMblocks_used.fetch_sub(1) - 1 < m_prefetch_ram_limit && m_prefetch_ram_waiters.load() > 0)
+   {
+      m_prefetch_condVar.Lock();
+      m_prefetch_condVar.Broadcast();
+      m_prefetch_condVar.UnLock();
+   }
 }
 
 
@@ -518,6 +699,7 @@ void Cache::dec_ref_cnt(File* f, bool high_debug)
 
    int tlvl = high_debug ? TRACE_Debug : TRACE_Dump;
    int cnt;
+   bool emergency_release = false;
 
    {
      XrdSysCondVarHelper lock(&m_active_cond);
@@ -533,18 +715,26 @@ void Cache::dec_ref_cnt(File* f, bool high_debug)
         {
            TRACE_INT(tlvl, "Cache::dec_ref_cnt " << f->GetLocalPath() << " is in shutdown, ref_cnt = " << cnt
                      << " -- deleting File object without further ado");
-           delete f;
+           emergency_release = true;
         }
         else
         {
            TRACE_INT(tlvl, "Cache::dec_ref_cnt " << f->GetLocalPath() << " is in shutdown, ref_cnt = " << cnt
                      << " -- waiting");
+           return;
         }
-
-        return;
      }
    }
 
+   // Waiting for running prefetches must not be done with m_active_cond held,
+   // they may need it to finish.
+   if (emergency_release)
+   {
+      ReleasePrefetchFile(f);
+      delete f;
+      return;
+   }
+
    TRACE_INT(tlvl, "Cache::dec_ref_cnt " << f->GetLocalPath() << ", cnt at entry = " << cnt);
 
    if (cnt == 1)
@@ -569,9 +759,14 @@ void Cache::dec_ref_cnt(File* f, bool high_debug)
      {
         ActiveMap_i it = m_active.find(f->GetLocalPath());
         m_active.erase(it);
-        delete f;
      }
    }
+
+   if (cnt == 0)
+   {
+      ReleasePrefetchFile(f);
+      delete f;
+   }
 }
 
 bool Cache::IsFileActiveOrPurgeProtected(const std::string& path)
@@ -598,6 +793,11 @@ void Cache::RegisterPrefetchFile(File* file)
 
    m_prefetch_condVar.Lock();
    m_prefetchList.push_back(file);
+
+   // A file that was idle must not claim the share it did not use.
+   PrefetchInfo &pi = m_prefetchInfo[file];
+   pi.m_vtime = std::max(pi.m_vtime, m_prefetch_vtime);
+
    m_prefetch_condVar.Signal();
    m_prefetch_condVar.UnLock();
 }
@@ -625,45 +825,124 @@ void Cache::DeRegisterPrefetchFile(File* file)
 }
 
 
-File* Cache::GetNextFileToPrefetch()
+void Cache::ReleasePrefetchFile(File* file)
 {
-   m_prefetch_condVar.Lock();
-   while (m_prefetchList.empty())
+   // Called without m_active_cond held. The file is no longer registered so
+   // no new prefetch can start on it, wait for the running ones.
+
+   if ( ! m_prefetch_enabled)
    {
-      m_prefetch_condVar.Wait();
+      return;
    }
 
-   //  std::sort(m_prefetchList.begin(), m_prefetchList.end(), myobject);
-
-   size_t l = m_prefetchList.size();
-   int idx = rand() % l;
-   File* f = m_prefetchList[idx];
+   XrdSysCondVarHelper _lck(m_prefetch_condVar);
 
-   m_prefetch_condVar.UnLock();
-   return f;
+   PrefetchInfoMap::iterator it;
+   while ((it = m_prefetchInfo.find(file)) != m_prefetchInfo.end() && it->second.m_busy > 0)
+   {
+      m_prefetch_condVar.Wait();
+   }
+   if (it != m_prefetchInfo.end())
+   {
+      m_prefetchInfo.erase(it);
+   }
 }
 
 
-void Cache::Prefetch()
+File* Cache::GetNextFileToPrefetch()
 {
-   const int limitRAM = int( Cache::GetInstance().RefConfiguration().m_NRamBuffers * 0.7 );
+   XrdSysCondVarHelper _lck(m_prefetch_condVar);
 
    while (true)
    {
-      m_RAMblock_mutex.Lock();
-      bool doPrefetch = (m_RAMblocks_used < limitRAM);
-      m_RAMblock_mutex.UnLock();
+      if (m_prefetchList.empty())
+      {
+         m_prefetch_condVar.Wait();
+         continue;
+      }
 
-      if (doPrefetch)
+      ++m_prefetch_ram_waiters;
+      if (m_RAMblocks_used.load() >= m_prefetch_ram_limit)
       {
-         File* f = GetNextFileToPrefetch();
-         f->Prefetch();
+         m_prefetch_condVar.Wait();
+         --m_prefetch_ram_waiters;
+         continue;
       }
-      else
+      --m_prefetch_ram_waiters;
+      break;
+   }
+
+   // Only files that have not used much more than their share compete.
+   double vtime_min = m_prefetchInfo[m_prefetchList.front()].m_vtime;
+   for (PrefetchList::iterator it = m_prefetchList.begin(); it != m_prefetchList.end(); ++it)
+   {
+      vtime_min = std::min(vtime_min, m_prefetchInfo[*it].m_vtime);
+   }
+   m_prefetch_vtime = vtime_min;
+
+   const double vtime_max = vtime_min + m_configuration.m_prefetch_max_blocks;
+   const time_t now       = time(0);
+
+   // Of those, take the one whose reader will need its next block first. If
+   // there is no clear winner, finish the file with the fewest bytes missing.
+   File      *best          = 0;
+   double     best_deadline = 0;
+   long long  best_remain   = 0;
+
+   for (PrefetchList::iterator it = m_prefetchList.begin(); it != m_prefetchList.end(); ++it)
+   {
+      if (m_prefetchInfo[*it].m_vtime > vtime_max) continue;
+
+      double    deadline = (*it)->GetPrefetchDeadline(now);
+      long long remain   = (*it)->GetPrefetchRemaining();
+
+      if ( ! best || deadline < 0.9 * best_deadline ||
+           (deadline < 1.1 * best_deadline && remain < best_remain))
       {
-         XrdSysTimer::Wait(5);
+         best          = *it;
+         best_deadline = deadline;
+         best_remain   = remain;
       }
    }
+
+   ++m_prefetchInfo[best].m_busy;
+
+   return best;
+}
+
+
+void Cache::PrefetchDone(File* file, int n_ios)
+{
+   XrdSysCondVarHelper _lck(m_prefetch_condVar);
+
+   PrefetchInfo &pi = m_prefetchInfo[file];
+
+   // A file with nothing to request is charged too, so that it does not keep
+   // getting picked.
+   pi.m_vtime += 1.0 / std::max(n_ios, 1);
+
+   if (--pi.m_busy == 0)
+   {
+      m_prefetch_condVar.Broadcast();
+   }
+}
+
+
+void Cache::AddPrefetchStats(int n_prefetched, int n_used)
+{
+   m_prefetch_n_blocks += n_prefetched;
+   m_prefetch_n_unused += n_prefetched - n_used;
+}
+
+
+void Cache::Prefetch()
+{
+   while (true)
+   {
+      File* f = GetNextFileToPrefetch();
+      int n_ios = f->Prefetch();
+      PrefetchDone(f, n_ios);
+   }
 }
 
 
@@ -864,7 +1143,7 @@ int Cache::Stat(const char *curl, struct stat &sbuff)
          if (res >= 0)
          {
             Info info(m_trace, 0);
-            if (info.Read(infoFile, i_name))
+            if (info.ReadHeader(infoFile, i_name))
             {
                sbuff.st_size = info.GetFileSize();
                success = true;
@@ -20,6 +20,7 @@
 #include <string>
 #include <list>
 #include <set>
+#include <atomic>
 
 #include "Xrd/XrdScheduler.hh"
 #include "XrdVersion.hh"
@@ -67,9 +68,12 @@ struct Configuration
       m_bufferSize(1024*1024),
       m_RamAbsAvailable(0),
       m_NRamBuffers(-1),
+      m_RamHugePages(false),
       m_wqueue_blocks(16),
       m_wqueue_threads(4),
+      m_wqueue_direct(false),
       m_prefetch_max_blocks(10),
+      m_prefetch_threads(4),
       m_hdfsbsize(128*1024*1024),
       m_flushCnt(2000)
    {}
@@ -100,9 +104,12 @@ struct Configuration
    long long m_bufferSize;              //!< prefetch buffer size, default 1MB
    long long m_RamAbsAvailable;         //!< available from configuration
    int       m_NRamBuffers;             //!< number of total in-memory cache blocks, cached
+   bool      m_RamHugePages;            //!< back in-memory cache blocks with huge pages
    int       m_wqueue_blocks;           //!< maximum number of blocks written per write-queue loop
-   int       m_wqueue_threads;          //!< number of threads writing blocks to disk
+   int       m_wqueue_threads;          //!< number of threads writing blocks to each file system
+   bool      m_wqueue_direct;           //!< write blocks to disk with direct I/O
    int       m_prefetch_max_blocks;     //!< maximum number of blocks to prefetch per file
+   int       m_prefetch_threads;        //!< number of threads requesting prefetch blocks
 
    long long m_hdfsbsize;               //!< used with m_hdfsmode, default 128MB
    long long m_flushCnt;                //!< nuber of unsynced blcoks on disk before flush is called
@@ -123,6 +130,25 @@ struct TmpConfiguration
    {}
 };
 
+//----------------------------------------------------------------------------
+//! Queue of blocks to be written to one file system of the disk cache.
+//----------------------------------------------------------------------------
+struct WriteQ
+{
+   WriteQ(dev_t d) : condVar(0), dev(d), size(0), max_size(0), n_blocks(0), n_writes(0), wait_usec(0) {}
+
+   XrdSysCondVar     condVar;      //!< write list condVar
+   std::list<Block*> queue;        //!< container
+   dev_t             dev;          //!< file system the blocks are written to
+   int               size;         //!< current size of write queue
+
+   // Statistics since the last report.
+   int               max_size;     //!< largest size of write queue
+   long long         n_blocks;     //!< number of blocks written
+   long long         n_writes;     //!< number of writes they were combined into
+   long long         wait_usec;    //!< total time blocks spent in the queue
+};
+
 //----------------------------------------------------------------------------
 //! Attaches/creates and detaches/deletes cache-io objects for disk based cache.
 //----------------------------------------------------------------------------
@@ -226,20 +252,59 @@ public:
    //---------------------------------------------------------------------
    void RemoveWriteQEntriesFor(File *f);
 
+   //---------------------------------------------------------------------
+   //! Get the write queue of a file system, starting its writer threads if
+   //! it is new.
+   //---------------------------------------------------------------------
+   WriteQ* GetWriteQ(dev_t dev);
+
    //---------------------------------------------------------------------
    //! Separate task which writes blocks from ram to disk.
    //---------------------------------------------------------------------
-   void ProcessWriteTasks();
+   void ProcessWriteTasks(WriteQ *wq);
 
-   bool RequestRAMBlock();
+   //---------------------------------------------------------------------
+   //! Get a page aligned in-memory cache block of the given size. The
+   //! contents are not initialized.
+   //!
+   //! @return pointer to the block or 0 if all blocks are in use.
+   //---------------------------------------------------------------------
+   char* RequestRAMBlock(long long size);
 
-   void RAMBlockReleased();
+   //---------------------------------------------------------------------
+   //! Return a block obtained via RequestRAMBlock().
+   //---------------------------------------------------------------------
+   void RAMBlockReleased(char *buff);
 
    void RegisterPrefetchFile(File*);
    void DeRegisterPrefetchFile(File*);
 
+   //---------------------------------------------------------------------
+   //! Wait for prefetch threads to be done with a file that is no longer
+   //! registered. Called before the file is deleted.
+   //---------------------------------------------------------------------
+   void ReleasePrefetchFile(File*);
+
+   //---------------------------------------------------------------------
+   //! Pick the file that most urgently needs a block prefetched, waiting
+   //! for one and for free RAM blocks as needed.
+   //---------------------------------------------------------------------
    File* GetNextFileToPrefetch();
 
+   //---------------------------------------------------------------------
+   //! Account for a File::Prefetch() call on a file obtained from
+   //! GetNextFileToPrefetch().
+   //---------------------------------------------------------------------
+   void PrefetchDone(File*, int n_ios);
+
+   //---------------------------------------------------------------------
+   //! Add the prefetch statistics of a file that is going away.
+   //---------------------------------------------------------------------
+   void AddPrefetchStats(int n_prefetched, int n_used);
+
+   //---------------------------------------------------------------------
+   //! Thread function requesting prefetch blocks.
+   //---------------------------------------------------------------------
    void Prefetch();
 
    XrdOss* GetOss() const { return m_output_fs; }
@@ -267,6 +332,8 @@ private:
 
    bool cfg2bytes(const std::string &str, long long &store, long long totalSpace, const char *name);
 
+   bool InitRAMBlocks();
+
    int  UnlinkCommon(const std::string& f_name, bool fail_if_open);
 
    static Cache        *m_factory;      //!< this object
@@ -287,22 +354,31 @@ private:
 
    XrdSysCondVar m_prefetch_condVar;        //!< lock for vector of prefetching files
    bool          m_prefetch_enabled;        //!< set to true when prefetching is enabled
-
-   XrdSysMutex m_RAMblock_mutex;            //!< lock for allcoation of RAM blocks
-   int         m_RAMblocks_used;
+   int           m_prefetch_ram_limit;      //!< RAM blocks in use above which prefetching waits
+   std::atomic<int> m_prefetch_ram_waiters; //!< prefetch threads waiting for RAM blocks
+
+   std::atomic<long long> m_prefetch_n_blocks;   //!< prefetched blocks of closed files
+   std::atomic<long long> m_prefetch_n_unused;   //!< ... of those never read
+
+   // In-memory cache blocks are carved out of one slab of m_NRamBuffers
+   // blocks. Free blocks are kept on a lock-free list; the head holds the
+   // index of the first free block plus one (0 if none) in its low 32 bits
+   // and a counter that is bumped on every change in its high 32 bits.
+   // Blocks larger than the slab's (i.e. for files cached with a bigger
+   // block size) are allocated individually but still count as used.
+   char                   *m_RAMblocks;         //!< the slab
+   long long               m_RAMblocks_len;     //!< length of the slab
+   long long               m_RAMblock_size;     //!< size of a block in the slab
+   std::atomic<int>       *m_RAMblocks_next;    //!< next free block index plus one
+   std::atomic<long long>  m_RAMblocks_free;    //!< free list head
+   std::atomic<int>        m_RAMblocks_used;
    bool        m_isClient;                  //!< True if running as client
 
-   struct WriteQ
-   {
-      WriteQ() : condVar(0), writes_between_purges(0), size(0) {}
-
-      XrdSysCondVar     condVar;      //!< write list condVar
-      std::list<Block*> queue;        //!< container
-      long long         writes_between_purges; //!< upper bound on amount of bytes written between two purge passes
-      int               size;         //!< current size of write queue
-   };
-
-   WriteQ m_writeQ;
+   // One write queue per file system, created as files on it are opened.
+   // Queues are never deleted.
+   std::vector<WriteQ*>   m_writeQs;
+   XrdSysMutex            m_writeQs_mutex;
+   std::atomic<long long> m_writes_between_purges; //!< upper bound on amount of bytes written between two purge passes
 
    // active map, purge delay set
    typedef std::map<std::string, File*> ActiveMap_t;
@@ -322,6 +398,23 @@ private:
    // prefetching
    typedef std::vector<File*>  PrefetchList;
    PrefetchList m_prefetchList;
+
+   // Scheduling state of files that have been registered for prefetching.
+   // Each file is charged virtual time for the blocks prefetched for it,
+   // divided by the number of IOs sharing it. Only files within a window of
+   // the least charged one compete on urgency, so that every reader gets
+   // its share.
+   struct PrefetchInfo
+   {
+      double m_vtime;  //!< virtual time charged to the file
+      int    m_busy;   //!< number of threads in File::Prefetch()
+
+      PrefetchInfo() : m_vtime(0), m_busy(0) {}
+   };
+
+   typedef std::map<File*, PrefetchInfo> PrefetchInfoMap;
+   PrefetchInfoMap m_prefetchInfo;
+   double          m_prefetch_vtime;       //!< least virtual time of registered files
 };
 
 }
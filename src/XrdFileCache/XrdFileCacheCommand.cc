@@ -291,11 +291,7 @@ void Cache::ExecuteCommandUrl(const std::string& command_url)
 
          TRACE(Info, err_prefix << "Created file '" << file_path << "', size=" << (file_size>>20) << "MB.");
 
-         {
-            XrdSysCondVarHelper lock(&m_writeQ.condVar);
-
-            m_writeQ.writes_between_purges += file_size;
-         }
+         m_writes_between_purges += file_size;
       }
    }
 
@@ -310,6 +310,16 @@ bool Cache::Config(const char *config_filename, const char *parameters)
       m_log.Say("Config info: ", buff);
    }
    m_configuration.m_NRamBuffers = static_cast<int>(m_configuration.m_RamAbsAvailable / m_configuration.m_bufferSize);
+
+   // Prefetching waits when more than 70% of RAM blocks are in use to leave
+   // room for blocks requested by clients.
+   m_prefetch_enabled   = (m_configuration.m_prefetch_max_blocks > 0);
+   m_prefetch_ram_limit = static_cast<int>(m_configuration.m_NRamBuffers * 0.7);
+
+   if (retval)
+   {
+      retval = InitRAMBlocks();
+   }
    
 
    // Set tracing to debug if this is set in environment
@@ -323,9 +333,9 @@ bool Cache::Config(const char *config_filename, const char *parameters)
       float rg =  (m_configuration.m_RamAbsAvailable)/float(1024*1024*1024);
       loff = snprintf(buff, sizeof(buff), "Config effective %s pfc configuration:\n"
                       "       pfc.blocksize %lld\n"
-                      "       pfc.prefetch %d\n"
-                      "       pfc.ram %.fg\n"
-                      "       pfc.writequeue %d %d\n"
+                      "       pfc.prefetch %d threads %d\n"
+                      "       pfc.ram %.fg%s\n"
+                      "       pfc.writequeue %d %d%s\n"
                       "       # Total available disk: %lld\n"
                       "       pfc.diskusage %lld %lld files %lld %lld %lld purgeinterval %d purgecoldfiles %d\n"
                       "       pfc.spaces %s %s\n"
@@ -333,9 +343,10 @@ bool Cache::Config(const char *config_filename, const char *parameters)
                       "       pfc.flush %lld",
                       config_filename,
                       m_configuration.m_bufferSize,
-                      m_configuration.m_prefetch_max_blocks,
-                      rg,
+                      m_configuration.m_prefetch_max_blocks, m_configuration.m_prefetch_threads,
+                      rg, m_configuration.m_RamHugePages ? " hugepages" : "",
                       m_configuration.m_wqueue_blocks, m_configuration.m_wqueue_threads,
+                      m_configuration.m_wqueue_direct ? " direct" : "",
                       sP.Total,
                       m_configuration.m_diskUsageLWM, m_configuration.m_diskUsageHWM,
                       m_configuration.m_fileUsageBaseline, m_configuration.m_fileUsageNominal, m_configuration.m_fileUsageMax,
@@ -477,6 +488,23 @@ bool Cache::ConfigParameters(std::string part, XrdOucStream& config, TmpConfigur
          return false;
       }
 
+      const char *p = cwg.GetWord();
+      if (cwg.HasLast())
+      {
+         if (strcmp(p, "threads") == 0)
+         {
+            if (XrdOuca2x::a2i(m_log, "Error setting prefetch thread count", cwg.GetWord(), &m_configuration.m_prefetch_threads, 1, 64))
+            {
+               return false;
+            }
+         }
+         else
+         {
+            m_log.Emsg("Config", "Error: pfc.prefetch stanza contains unknown directive", p);
+            return false;
+         }
+      }
+
    }
    else if ( part == "nramread" )
    {
@@ -491,6 +519,20 @@ bool Cache::ConfigParameters(std::string part, XrdOucStream& config, TmpConfigur
       {
          return false;
       }
+
+      const char *p = cwg.GetWord();
+      if (cwg.HasLast())
+      {
+         if (strcmp(p, "hugepages") == 0)
+         {
+            m_configuration.m_RamHugePages = true;
+         }
+         else
+         {
+            m_log.Emsg("Config", "Error: pfc.ram stanza contains unknown directive", p);
+            return false;
+         }
+      }
    }
    else if ( part == "writequeue")
    {
@@ -502,6 +544,20 @@ bool Cache::ConfigParameters(std::string part, XrdOucStream& config, TmpConfigur
       {
          return false;
       }
+
+      const char *p = cwg.GetWord();
+      if (cwg.HasLast())
+      {
+         if (strcmp(p, "direct") == 0)
+         {
+            m_configuration.m_wqueue_direct = true;
+         }
+         else
+         {
+            m_log.Emsg("Config", "Error: pfc.writequeue stanza contains unknown directive", p);
+            return false;
+         }
+      }
    }
    else if ( part == "spaces" )
    {
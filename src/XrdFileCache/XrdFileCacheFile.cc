@@ -24,6 +24,9 @@
 #include <sstream>
 #include <fcntl.h>
 #include <assert.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/uio.h>
 #include "XrdCl/XrdClLog.hh"
 #include "XrdCl/XrdClConstants.hh"
 #include "XrdCl/XrdClFile.hh"
@@ -55,6 +58,8 @@ File::File(const std::string& path, long long iOffset, long long iFileSize) :
    m_is_open(false),
    m_in_shutdown(false),
    m_output(0),
+   m_outputDirect(0),
+   m_writeQ(0),
    m_infoFile(0),
    m_cfi(Cache::GetInstance().GetTrace(), Cache::GetInstance().RefConfiguration().m_prefetch_max_blocks > 0),
    m_filename(path),
@@ -69,6 +74,12 @@ File::File(const std::string& path, long long iOffset, long long iFileSize) :
    m_prefetchReadCnt(0),
    m_prefetchHitCnt(0),
    m_prefetchScore(1),
+   m_readCursor(iOffset),
+   m_prefetchNext(iOffset),
+   m_prefetchRemaining(iFileSize),
+   m_readRate(0),
+   m_readRateTime(0),
+   m_readRateBytes(0),
    m_detachTimeIsLogged(false)
 {
 }
@@ -91,7 +102,17 @@ File::~File()
       m_output = NULL;
    }
 
-   TRACEF(Debug, "File::~File() ended, prefetch score = " <<  m_prefetchScore);
+   if (m_outputDirect)
+   {
+      m_outputDirect->Close();
+      delete m_outputDirect;
+      m_outputDirect = NULL;
+   }
+
+   cache()->AddPrefetchStats(m_prefetchReadCnt, m_prefetchHitCnt);
+
+   TRACEF(Debug, "File::~File() ended, prefetch score = " <<  m_prefetchScore <<
+          ", prefetched blocks " << m_prefetchReadCnt << ", unused " << m_prefetchReadCnt - m_prefetchHitCnt);
 }
 
 //------------------------------------------------------------------------------
@@ -381,6 +402,26 @@ bool File::Open()
       return false;
    }
 
+   // Blocks are queued for writing per file system.
+   struct stat out_stat;
+   m_writeQ = cache()->GetWriteQ(m_output->Fstat(&out_stat) == XrdOssOK ? out_stat.st_dev : 0);
+
+#ifdef O_DIRECT
+   // Blocks are also written through a second handle that bypasses the page
+   // cache, if the file system and the oss allow it.
+   if (conf.m_wqueue_direct)
+   {
+      m_outputDirect = myOss.newFile(myUser);
+      if ((res = m_outputDirect->Open(m_filename.c_str(), O_RDWR | O_DIRECT, 0600, myEnv)) != XrdOssOK ||
+          m_outputDirect->getFD() < 0)
+      {
+         TRACEF(Info, "File::Open() direct I/O not available " << ERRNO_AND_ERRSTR(-res));
+         if (res == XrdOssOK) m_outputDirect->Close();
+         delete m_outputDirect; m_outputDirect = 0;
+      }
+   }
+#endif
+
    // Create the info file.
    myEnv.Put("oss.asize", "64k"); // TODO: Calculate? Get it from configuration? Do not know length of access lists ...
    myEnv.Put("oss.cgroup", conf.m_meta_space.c_str());
@@ -433,6 +474,7 @@ bool File::Open()
 
    m_cfi.WriteIOStatAttach();
    m_downloadCond.Lock();
+   m_prefetchRemaining = std::max(m_fileSize - m_cfi.GetNDownloadedBlocks() * m_cfi.GetBufferSize(), 0ll);
    m_is_open = true;
    m_prefetchState = (m_cfi.IsComplete()) ? kComplete : kStopped; // Will engage in AddIO().
    m_downloadCond.UnLock();
@@ -492,11 +534,18 @@ Block* File::PrepareBlockRequest(int i, IO *io, bool prefetch)
    long long off     = i * BS;
    long long this_bs = (i == last_block) ? m_fileSize - off : BS;
 
-   // 1. Should blocks be reused to avoid recreation? There is block pool in Xrd
-   // 2, Memalign to page size
-   Block *b = new (std::nothrow) Block(this, io, off, this_bs, prefetch);
+   // The buffer comes from the cache's pool of page aligned RAM blocks; there
+   // may be none left in which case the block can not be requested.
+   char *buff = cache()->RequestRAMBlock(this_bs);
+   if ( ! buff) return 0;
 
-   if (b)
+   Block *b = new (std::nothrow) Block(this, io, buff, off, this_bs, prefetch);
+
+   if ( ! b)
+   {
+      cache()->RAMBlockReleased(buff);
+   }
+   else
    {
       m_block_map[i] = b;
 
@@ -643,6 +692,8 @@ int File::Read(IO *io, char* iUserBuff, long long iUserOff, int iUserSize)
       return -ENOENT;
    }
 
+   record_read(iUserOff, iUserSize, true);
+
    for (int block_idx = idx_first; block_idx <= idx_last; ++block_idx)
    {
       TRACEF(Dump, "File::Read() idx " << block_idx);
@@ -651,6 +702,7 @@ int File::Read(IO *io, char* iUserBuff, long long iUserOff, int iUserSize)
       // In RAM or incoming?
       if (bi != m_block_map.end())
       {
+         record_prefetch_hit(offsetIdx(block_idx));
          inc_ref_count(bi->second);
          TRACEF(Dump, "File::Read() " << (void*) iUserBuff << "inc_ref_count for existing block " << bi->second << " idx = " <<  block_idx);
          blks_to_process.push_front(bi->second);
@@ -659,6 +711,7 @@ int File::Read(IO *io, char* iUserBuff, long long iUserOff, int iUserSize)
       else if (m_cfi.TestBitWritten(offsetIdx(block_idx)))
       {
          TRACEF(Dump, "File::Read() read from disk " <<  (void*)iUserBuff << " idx = " << block_idx);
+         record_prefetch_hit(offsetIdx(block_idx));
          blks_on_disk.push_back(block_idx);
       }
       // Then we have to get it ...
@@ -666,7 +719,7 @@ int File::Read(IO *io, char* iUserBuff, long long iUserOff, int iUserSize)
       {
          // Is there room for one more RAM Block?
          Block *b;
-         if (cache()->RequestRAMBlock() && (b = PrepareBlockRequest(block_idx, io, false)) != 0)
+         if ((b = PrepareBlockRequest(block_idx, io, false)) != 0)
          {
             TRACEF(Dump, "File::Read() inc_ref_count new " <<  (void*)iUserBuff << " idx = " << block_idx);
             inc_ref_count(b);
@@ -721,7 +774,6 @@ int File::Read(IO *io, char* iUserBuff, long long iUserOff, int iUserSize)
    }
 
    // Third, loop over blocks that are available or incoming
-   int prefetchHitsRam = 0;
    while ( ! blks_to_process.empty())
    {
       BlockList_t finished;
@@ -776,11 +828,9 @@ int File::Read(IO *io, char* iUserBuff, long long iUserOff, int iUserSize)
             overlap((*bi)->m_offset/BS, BS, iUserOff, iUserSize, user_off, off_in_block, size_to_copy);
 
             TRACEF(Dump, "File::Read() ub=" << (void*)iUserBuff  << " from finished block " << (*bi)->m_offset/BS << " size " << size_to_copy);
-            memcpy(&iUserBuff[user_off], &((*bi)->m_buff[off_in_block]), size_to_copy);
+            memcpy(&iUserBuff[user_off], (*bi)->get_buff(off_in_block), size_to_copy);
             bytes_read += size_to_copy;
             loc_stats.m_BytesRam += size_to_copy;
-            if ((*bi)->m_prefetch)
-               prefetchHitsRam++;
          }
          else
          {
@@ -845,13 +895,8 @@ int File::Read(IO *io, char* iUserBuff, long long iUserOff, int iUserSize)
       }
 
       // update prefetch score
-      m_prefetchHitCnt += prefetchHitsRam;
-      for (IntList_i d = blks_on_disk.begin(); d !=  blks_on_disk.end(); ++d)
-      {
-         if (m_cfi.TestBitPrefetch(offsetIdx(*d)))
-            m_prefetchHitCnt++;
-      }
-      m_prefetchScore = float(m_prefetchHitCnt)/m_prefetchReadCnt;
+      if (m_prefetchReadCnt > 0)
+         m_prefetchScore = float(m_prefetchHitCnt)/m_prefetchReadCnt;
    }
 
    m_stats.AddStats(loc_stats);
@@ -861,65 +906,149 @@ int File::Read(IO *io, char* iUserBuff, long long iUserOff, int iUserSize)
 
 //------------------------------------------------------------------------------
 
-void File::WriteBlockToDisk(Block* b)
+void File::WriteBlocksToDisk(Block** blks, int n)
 {
-   // write block buffer into disk file
-   long long   offset = b->m_offset - m_offset;
-   long long   size   = (offset + m_cfi.GetBufferSize()) > m_fileSize ? (m_fileSize - offset) : m_cfi.GetBufferSize();
-   const char *buff   = &b->m_buff[0];
+   // Blocks are consecutive. With direct I/O enabled they are written with a
+   // single vectored write, except for a trailing block whose size is not a
+   // multiple of the page size (the last block of the file) which, like all
+   // blocks otherwise, is written through the page cache.
+
+   const long long BS = m_cfi.GetBufferSize();
+
+   std::vector<long long> sizes(n);
+   std::vector<bool>      written(n, false);
+
+   for (int i = 0; i < n; ++i)
+   {
+      long long offset = blks[i]->m_offset - m_offset;
+      sizes[i] = (offset + BS) > m_fileSize ? (m_fileSize - offset) : BS;
+   }
 
-   ssize_t retval = m_output->Write(buff, offset, size);
+   int n_direct = 0;
 
-   if (retval < size)
+#ifdef O_DIRECT
+   if (m_outputDirect)
    {
-      if (retval < 0)
+      static const long long pgsz = sysconf(_SC_PAGESIZE);
+
+      std::vector<struct iovec> iov(n);
+      long long    offset = blks[0]->m_offset - m_offset;
+      long long    size   = 0;
+
+      if (offset % pgsz == 0)
       {
-         GetLog()->Emsg("File::WriteToDisk()", -retval, "write block to disk", GetLocalPath().c_str());
+         while (n_direct < n && sizes[n_direct] % pgsz == 0)
+         {
+            iov[n_direct].iov_base = blks[n_direct]->get_buff();
+            iov[n_direct].iov_len  = sizes[n_direct];
+            size += sizes[n_direct++];
+         }
       }
-      else
+
+      if (n_direct > 0)
       {
-         TRACEF(Error, "File::WriteToDisk() incomplete block write ret=" << retval << " (should be " << size << ")");
-      }
+         int fd = m_outputDirect->getFD(), iov_idx = 0;
+         ssize_t retval;
 
-      XrdSysCondVarHelper _lck(m_downloadCond);
+         while (size > 0)
+         {
+            do { retval = pwritev(fd, &iov[iov_idx], std::min(n_direct - iov_idx, IOV_MAX), offset); }
+            while (retval < 0 && errno == EINTR);
 
-      dec_ref_count(b);
+            if (retval <= 0) break;
 
-      return;
+            offset += retval;
+            size   -= retval;
+            while (iov_idx < n_direct && retval >= (ssize_t) iov[iov_idx].iov_len)
+            {
+               retval -= iov[iov_idx++].iov_len;
+            }
+            if (iov_idx < n_direct)
+            {
+               iov[iov_idx].iov_base = (char*) iov[iov_idx].iov_base + retval;
+               iov[iov_idx].iov_len -= retval;
+            }
+         }
+
+         if (size > 0)
+         {
+            // Retry what was not written through the page cache.
+            TRACEF(Warning, "File::WriteBlocksToDisk() direct write of " << n_direct << " blocks failed" << ERRNO_AND_ERRSTR(errno));
+            n_direct = 0;
+         }
+      }
+
+      for (int i = 0; i < n_direct; ++i) written[i] = true;
    }
+#endif
 
-   const int blk_idx =  (b->m_offset - m_offset) / m_cfi.GetBufferSize();
+   for (int i = n_direct; i < n; ++i)
+   {
+      ssize_t retval = m_output->Write(blks[i]->get_buff(), blks[i]->m_offset - m_offset, sizes[i]);
 
-   // Set written bit.
-   TRACEF(Dump, "File::WriteToDisk() success set bit for block " <<  b->m_offset << " size=" <<  size);
+      if (retval < sizes[i])
+      {
+         if (retval < 0)
+         {
+            GetLog()->Emsg("File::WriteToDisk()", -retval, "write block to disk", GetLocalPath().c_str());
+         }
+         else
+         {
+            TRACEF(Error, "File::WriteToDisk() incomplete block write ret=" << retval << " (should be " << sizes[i] << ")");
+         }
+      }
+      else
+      {
+         written[i] = true;
+      }
+   }
 
    bool schedule_sync = false;
    {
       XrdSysCondVarHelper _lck(m_downloadCond);
 
-      m_cfi.SetBitWritten(blk_idx);
+      for (int i = 0; i < n; ++i)
+      {
+         Block *b = blks[i];
 
-      if (b->m_prefetch)
-         m_cfi.SetBitPrefetch(blk_idx);
+         if ( ! written[i])
+         {
+            dec_ref_count(b);
+            continue;
+         }
 
-      dec_ref_count(b);
+         const int blk_idx =  (b->m_offset - m_offset) / BS;
 
-      // Set synced bit or stash block index if in actual sync.
-      // Synced state is only written out to cinfo file when data file is synced.
-      if (m_in_sync)
-      {
-         m_writes_during_sync.push_back(blk_idx);
-      }
-      else
-      {
-         m_cfi.SetBitSynced(blk_idx);
-         ++m_non_flushed_cnt;
-         if (m_non_flushed_cnt >= Cache::GetInstance().RefConfiguration().m_flushCnt &&
-             ! m_in_shutdown)
+         // Set written bit.
+         TRACEF(Dump, "File::WriteToDisk() success set bit for block " <<  b->m_offset << " size=" <<  sizes[i]);
+
+         if ( ! m_cfi.TestBitWritten(blk_idx))
+            m_prefetchRemaining -= sizes[i];
+
+         m_cfi.SetBitWritten(blk_idx);
+
+         if (b->m_prefetch)
+            m_cfi.SetBitPrefetch(blk_idx);
+
+         dec_ref_count(b);
+
+         // Set synced bit or stash block index if in actual sync.
+         // Synced state is only written out to cinfo file when data file is synced.
+         if (m_in_sync)
          {
-            schedule_sync     = true;
-            m_in_sync         = true;
-            m_non_flushed_cnt = 0;
+            m_writes_during_sync.push_back(blk_idx);
+         }
+         else
+         {
+            m_cfi.SetBitSynced(blk_idx);
+            ++m_non_flushed_cnt;
+            if (m_non_flushed_cnt >= Cache::GetInstance().RefConfiguration().m_flushCnt &&
+                ! m_in_shutdown)
+            {
+               schedule_sync     = true;
+               m_in_sync         = true;
+               m_non_flushed_cnt = 0;
+            }
          }
       }
    }
@@ -1022,8 +1151,8 @@ void File::free_block(Block* b)
    }
    else
    {
+      cache()->RAMBlockReleased(b->m_buff);
       delete b;
-      cache()->RAMBlockReleased();
    }
 
    if (m_prefetchState == kHold && (int) m_block_map.size() < Cache::GetInstance().RefConfiguration().m_prefetch_max_blocks)
@@ -1081,16 +1210,14 @@ bool File::select_current_io_or_disable_prefetching(bool skip_current)
 
 //------------------------------------------------------------------------------
 
-void File::ProcessBlockResponse(BlockResponseHandler* brh, int res)
+void File::ProcessBlockResponse(Block* b, bool prefetch, int res)
 {
    XrdSysCondVarHelper _lck(m_downloadCond);
 
-   Block *b = brh->m_block;
-
    TRACEF(Dump, "File::ProcessBlockResponse " << (void*)b << "  " << b->m_offset/BufferSize());
 
    // Deregister block from IO's prefetch count, if needed.
-   if (brh->m_for_prefetch)
+   if (prefetch)
    {
       IoMap_i mi = m_io_map.find(b->get_io());
       if (mi != m_io_map.end())
@@ -1168,13 +1295,14 @@ int File::offsetIdx(int iIdx)
 
 //------------------------------------------------------------------------------
 
-void File::Prefetch()
+int File::Prefetch()
 {
    // Check that block is not on disk and not in RAM.
-   // TODO: Could prefetch several blocks at once!
-   //       blks_max could be an argument
+   // Blocks ahead of the reader are requested first, in order, then the
+   // ones behind it.
 
    BlockList_t blks;
+   int         n_ios = 0;
 
    TRACEF(Dump, "File::Prefetch enter to check download status");
    {
@@ -1182,30 +1310,53 @@ void File::Prefetch()
 
       if (m_prefetchState != kOn)
       {
-         return;
+         return 0;
       }
 
       if ( ! select_current_io_or_disable_prefetching(true) )
       {
          TRACEF(Error, "File::Prefetch no available IO object found, prefetching stopped. This should not happen, i.e., prefetching should be stopped before.");
-         return;
+         return 0;
       }
 
+      const long long BS     = m_cfi.GetBufferSize();
+      const int       n_blks = m_cfi.GetSizeInBits();
+
+      // Start at the reader's block or, if prefetching is already ahead of
+      // the reader, where it left off.
+      long long cursor = std::min(std::max(m_readCursor.load() - m_offset, 0ll), m_fileSize - 1);
+      long long next   = m_prefetchNext.load() - m_offset;
+      int       start  = (next > cursor && next < m_fileSize) ? next / BS : cursor / BS;
+
       // Select block(s) to fetch.
-      for (int f = 0; f < m_cfi.GetSizeInBits(); ++f)
+      for (int i = 0; i < n_blks; ++i)
       {
+         int f = (start + i) % n_blks;
+
          if ( ! m_cfi.TestBitWritten(f))
          {
-            int f_act = f + m_offset / m_cfi.GetBufferSize();
+            int f_act = f + m_offset / BS;
 
             BlockMap_i bi = m_block_map.find(f_act);
             if (bi == m_block_map.end())
             {
+               Block *b = PrepareBlockRequest(f_act, m_current_io->first, true);
+               if ( ! b)
+               {
+                  TRACEF(Dump, "File::Prefetch no RAM block available for block " << f_act);
+                  return 0;
+               }
                TRACEF(Dump, "File::Prefetch take block " << f_act);
-               cache()->RequestRAMBlock();
-               blks.push_back( PrepareBlockRequest(f_act, m_current_io->first, true) );
+               blks.push_back(b);
                m_prefetchReadCnt++;
                m_prefetchScore = float(m_prefetchHitCnt)/m_prefetchReadCnt;
+
+               if (m_prefetchUnread.empty()) m_prefetchUnread.resize(n_blks);
+               m_prefetchUnread[f] = true;
+
+               // Blocks behind the reader are needed after the ones ahead of
+               // it, account for them as if they followed the end of file.
+               m_prefetchNext = m_offset + (f + 1) * BS + (f < start ? m_fileSize : 0);
                break;
             }
          }
@@ -1220,6 +1371,7 @@ void File::Prefetch()
       else
       {
          m_current_io->second.m_active_prefetches += (int) blks.size();
+         n_ios = std::max((int) m_io_map.size() - m_ios_in_detach, 1);
       }
    }
 
@@ -1227,8 +1379,57 @@ void File::Prefetch()
    {
       ProcessBlockRequests(blks, true);
    }
+
+   return n_ios;
 }
 
+//------------------------------------------------------------------------------
+
+double File::GetPrefetchDeadline(time_t now) const
+{
+   // The reader is expected to continue at the rate it has been reading at.
+   // Files that are not being read are assumed to need a block a minute.
+
+   const long long BS = m_cfi.GetBufferSize();
+
+   long long distance = std::max(m_prefetchNext.load() - m_readCursor.load(), 0ll);
+   double    rate     = (now - m_readRateTime.load() <= 5) ? m_readRate.load() : 0;
+
+   return (distance + BS) / std::max(rate, BS / 60.0);
+}
+
+//------------------------------------------------------------------------------
+
+void File::record_read(long long off, long long size, bool move_cursor)
+{
+   // Method always called under lock.
+
+   time_t now = time(0);
+
+   if (move_cursor) m_readCursor = off + size;
+
+   if (now != m_readRateTime)
+   {
+      long long dt = now - m_readRateTime;
+      m_readRate      = (dt > 5) ? 0 : 0.5f * m_readRate + 0.5f * m_readRateBytes / dt;
+      m_readRateBytes = 0;
+      m_readRateTime  = now;
+   }
+   m_readRateBytes += size;
+}
+
+//------------------------------------------------------------------------------
+
+void File::record_prefetch_hit(int idx)
+{
+   // Method always called under lock.
+
+   if (idx < (int) m_prefetchUnread.size() && m_prefetchUnread[idx])
+   {
+      m_prefetchUnread[idx] = false;
+      ++m_prefetchHitCnt;
+   }
+}
 
 //------------------------------------------------------------------------------
 
@@ -1253,7 +1454,19 @@ XrdSysTrace* File::GetTrace()
 
 void BlockResponseHandler::Done(int res)
 {
-   m_block->m_file->ProcessBlockResponse(this, res);
+   m_block->m_file->ProcessBlockResponse(m_block, m_for_prefetch, res);
+
+   delete this;
+}
+
+//------------------------------------------------------------------------------
+
+void BlockVResponseHandler::Done(int res)
+{
+   for (std::vector<Block*>::iterator i = m_blocks.begin(); i != m_blocks.end(); ++i)
+   {
+      (*i)->m_file->ProcessBlockResponse(*i, false, res);
+   }
 
    delete this;
 }
@@ -27,8 +27,10 @@
 #include "XrdFileCacheInfo.hh"
 #include "XrdFileCacheStats.hh"
 
+#include <atomic>
 #include <string>
 #include <map>
+#include <vector>
 
 class XrdJob;
 class XrdOucIOVec;
@@ -44,10 +46,8 @@ class BlockResponseHandler;
 class DirectResponseHandler;
 class IO;
 
-struct ReadVBlockListRAM;
-struct ReadVChunkListRAM;
-struct ReadVBlockListDisk;
-struct ReadVChunkListDisk;
+struct WriteQ;
+struct VReadPlan;
 }
 
 
@@ -59,7 +59,8 @@ class File;
 class Block
 {
 public:
-   std::vector<char>   m_buff;
+   char               *m_buff;          // RAM block from Cache::RequestRAMBlock()
+   int                 m_size;
    long long           m_offset;
    File               *m_file;
    IO                 *m_io;            // IO that handled current request, used for == / != comparisons only
@@ -68,16 +69,15 @@ public:
    int                 m_errno;         // stores negative errno
    bool                m_downloaded;
    bool                m_prefetch;
+   long long           m_queued;        // time of entering the write queue, in us
 
-   Block(File *f, IO *io, long long off, int size, bool m_prefetch) :
-      m_offset(off), m_file(f), m_io(io), m_refcnt(0),
-      m_errno(0), m_downloaded(false), m_prefetch(m_prefetch)
-   {
-      m_buff.resize(size);
-   }
+   Block(File *f, IO *io, char *buff, long long off, int size, bool m_prefetch) :
+      m_buff(buff), m_size(size), m_offset(off), m_file(f), m_io(io), m_refcnt(0),
+      m_errno(0), m_downloaded(false), m_prefetch(m_prefetch), m_queued(0)
+   {}
 
-   char*     get_buff(long long pos = 0) { return &m_buff[pos];        }
-   int       get_size()                  { return (int) m_buff.size(); }
+   char*     get_buff(long long pos = 0) { return m_buff + pos; }
+   int       get_size()                  { return m_size;       }
    long long get_offset()                { return m_offset;            }
 
    IO*  get_io() const { return m_io; }
@@ -112,6 +112,17 @@ public:
 
 // ================================================================
 
+//! Completion of a vector read that fetches several blocks at once.
+class BlockVResponseHandler : public XrdOucCacheIOCB
+{
+public:
+   std::vector<Block*> m_blocks;
+
+   virtual void Done(int result);
+};
+
+// ================================================================
+
 class DirectResponseHandler : public XrdOucCacheIOCB
 {
 public:
@@ -196,10 +207,33 @@ public:
    //----------------------------------------------------------------------
    Stats& GetStats() { return m_stats; }
 
-   void ProcessBlockResponse(BlockResponseHandler* brh, int res);
-   void WriteBlockToDisk(Block* b);
+   void ProcessBlockResponse(Block* b, bool prefetch, int res);
+
+   //! Write consecutive blocks to disk, with one call if possible.
+   void WriteBlocksToDisk(Block** blks, int n);
 
-   void Prefetch();
+   //! Write queue of the file system the data file is on.
+   WriteQ* GetWriteQ() const { return m_writeQ; }
+
+   //----------------------------------------------------------------------
+   //! Request the next block that is not yet cached, starting at the
+   //! position of the reader. Called from Cache's prefetch threads.
+   //!
+   //! @return number of IO objects prefetching on this file, 0 if no block
+   //!         was requested.
+   //----------------------------------------------------------------------
+   int Prefetch();
+
+   //----------------------------------------------------------------------
+   //! \brief Estimated number of seconds before the reader needs the next
+   //! block that Prefetch() would request. Can be called without a lock.
+   //----------------------------------------------------------------------
+   double GetPrefetchDeadline(time_t now) const;
+
+   //----------------------------------------------------------------------
+   //! \brief Number of bytes not yet cached. Can be called without a lock.
+   //----------------------------------------------------------------------
+   long long GetPrefetchRemaining() const { return m_prefetchRemaining.load(); }
 
    float GetPrefetchScore() const;
 
@@ -238,6 +272,8 @@ private:
    bool           m_in_shutdown;        //!< file is in emergency shutdown due to irrecoverable error or unlink request
 
    XrdOssDF      *m_output;             //!< file handle for data file on disk
+   XrdOssDF      *m_outputDirect;       //!< file handle for direct I/O writes to data file, if enabled
+   WriteQ        *m_writeQ;             //!< write queue for data file
    XrdOssDF      *m_infoFile;           //!< file handle for data-info file on disk
    Info           m_cfi;                //!< download status of file blocks and access statistics
 
@@ -286,9 +322,19 @@ private:
 
    PrefetchState_e m_prefetchState;
 
-   int   m_prefetchReadCnt;
-   int   m_prefetchHitCnt;
+   int   m_prefetchReadCnt;             //!< number of blocks prefetched
+   int   m_prefetchHitCnt;              //!< number of prefetched blocks that were read
    float m_prefetchScore;              // cached
+
+   std::vector<bool> m_prefetchUnread;  //!< blocks prefetched, not yet read
+
+   // Hints for the prefetch scheduler; set under m_downloadCond, read without.
+   std::atomic<long long> m_readCursor;        //!< end of the last read
+   std::atomic<long long> m_prefetchNext;      //!< offset of the next block to prefetch
+   std::atomic<long long> m_prefetchRemaining; //!< bytes not yet written to disk
+   std::atomic<float>     m_readRate;          //!< smoothed read rate in bytes/s
+   std::atomic<time_t>    m_readRateTime;      //!< start of the current rate window
+   long long              m_readRateBytes;     //!< bytes read in the current rate window
    
    bool  m_detachTimeIsLogged;
 
@@ -316,16 +362,10 @@ private:
 
    // VRead
    bool VReadValidate     (const XrdOucIOVec *readV, int n);
-   void VReadPreProcess   (IO *io, const XrdOucIOVec *readV, int n,
-                           BlockList_t&        blks_to_request,
-                           ReadVBlockListRAM&  blks_to_process,
-                           ReadVBlockListDisk& blks_on_disk,
-                           std::vector<XrdOucIOVec>& chunkVec);
-   int  VReadFromDisk     (const XrdOucIOVec *readV, int n,
-                           ReadVBlockListDisk& blks_on_disk);
-   int  VReadProcessBlocks(IO *io, const XrdOucIOVec *readV, int n,
-                           std::vector<ReadVChunkListRAM>& blks_to_process,
-                           std::vector<ReadVChunkListRAM>& blks_rocessed);
+   void VReadPreProcess   (IO *io, const XrdOucIOVec *readV, int n, VReadPlan& plan);
+   void VReadRequestBlocks(BlockList_t& blks);
+   int  VReadFromDisk     (VReadPlan& plan);
+   int  VReadProcessBlocks(IO *io, const XrdOucIOVec *readV, VReadPlan& plan);
 
    long long BufferSize();
 
@@ -335,6 +375,9 @@ private:
 
    bool select_current_io_or_disable_prefetching(bool skip_current);
 
+   void record_read(long long off, long long size, bool move_cursor);
+   void record_prefetch_hit(int idx);
+
    int  offsetIdx(int idx);
 };
 
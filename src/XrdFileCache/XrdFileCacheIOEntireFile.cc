@@ -92,7 +92,7 @@ int IOEntireFile::initCachedStat(const char* path)
       if ((res_open = infoFile->Open(path, O_RDONLY, 0600, myEnv)) == XrdOssOK)
       {
          Info info(m_cache.GetTrace());
-         if (info.Read(infoFile, path))
+         if (info.ReadHeader(infoFile, path))
          {
             tmpStat.st_size = info.GetFileSize();
             TRACEIO(Info, "IOEntireFile::initCachedStat successfuly read size from info file = " << tmpStat.st_size);
@@ -21,6 +21,9 @@
 #include <time.h>
 #include <string.h>
 #include <stdlib.h>
+#include <limits.h>
+#include <algorithm>
+#include <sys/mman.h>
 #include <sys/stat.h>
 
 #include "XrdOss/XrdOss.hh"
@@ -93,13 +96,112 @@ struct FpHelper
       return WriteRaw(&loc, sizeof(T));
    }
 };
+
+//------------------------------------------------------------------------------
+// Reads from a read-only mapping of the whole file so that only the pages
+// actually looked at are brought in. Falls back to plain reads when the
+// file has no descriptor or can not be mapped.
+//------------------------------------------------------------------------------
+
+struct MapHelper
+{
+   XrdOssDF    *f_fp;
+   char        *f_map;
+   off_t        f_len;
+   XrdSysTrace *f_trace;
+   const char  *m_traceID;
+   std::string  f_ttext;
+
+   XrdSysTrace* GetTrace() const { return f_trace; }
+
+   MapHelper(XrdOssDF* fp,
+             XrdSysTrace *trace, const char *tid, const std::string &ttext) :
+      f_fp(fp), f_map(0), f_len(0),
+      f_trace(trace), m_traceID(tid), f_ttext(ttext)
+   {
+      struct stat st;
+      int fd = fp->getFD();
+      if (fd >= 0 && fstat(fd, &st) == 0 && st.st_size > 0)
+      {
+         void *m = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+         if (m != MAP_FAILED)
+         {
+            f_map = (char*) m;
+            f_len = st.st_size;
+         }
+      }
+   }
+
+   ~MapHelper()
+   {
+      if (f_map) munmap(f_map, f_len);
+   }
+
+   // Returns true on error
+   bool ReadRaw(void *buf, ssize_t size, off_t off)
+   {
+      ssize_t ret;
+      if (f_map)
+      {
+         ret = (off + size <= f_len) ? size : 0;
+         if (ret) memcpy(buf, f_map + off, size);
+      }
+      else
+      {
+         ret = f_fp->Read(buf, off, size);
+      }
+      if (ret != size)
+      {
+         TRACE(Warning, f_ttext << " off=" << off << " size=" << size
+                                << " ret=" << ret << " error=" << ((ret < 0) ? strerror(-ret) : "<no error>"));
+         return true;
+      }
+      return false;
+   }
+};
+
+//------------------------------------------------------------------------------
+// Version 3 layout: the header, the synced-state vector starting right after
+// it and then a ring of Info::m_maxNumAccess access records, access n being
+// stored in slot n % m_maxNumAccess. All parts are at fixed offsets so each
+// can be updated in place.
+//------------------------------------------------------------------------------
+
+struct InfoHeader
+{
+   int       f_version;
+   int       f_astatSlots;
+   long long f_bufferSize;
+   long long f_fileSize;
+   long long f_creationTime;
+   long long f_accessCnt;
+   int       f_syncedCnt;
+   int       f_reserved;
+   char      f_cksum[16];
+};
+
+off_t AStatsOffset(int size_in_bytes)
+{
+   return ((sizeof(InfoHeader) + size_in_bytes + 7) / 8) * 8;
+}
+
+int CountBits(const unsigned char *buff, int n_bits)
+{
+   int cnt = 0;
+   const int n_full = n_bits / 8;
+   for (int i = 0; i < n_full; ++i)
+      cnt += __builtin_popcount(buff[i]);
+   if (n_bits % 8)
+      cnt += __builtin_popcount(buff[n_full] & ((1 << (n_bits % 8)) - 1));
+   return cnt;
+}
 }
 
 using namespace XrdFileCache;
 
 const char*  Info::m_infoExtension  = ".cinfo";
 const char*  Info::m_traceID        = "Cinfo";
-const int    Info::m_defaultVersion = 2;
+const int    Info::m_defaultVersion = 3;
 const size_t Info::m_maxNumAccess   = 20;
 
 //------------------------------------------------------------------------------
@@ -110,6 +212,10 @@ Info::Info(XrdSysTrace* trace, bool prefetchBuffer) :
    m_buff_written(0),  m_buff_prefetch(0),
    m_sizeInBits(0),
    m_complete(false),
+   m_syncedDirtyBeg(INT_MAX), m_syncedDirtyEnd(0),
+   m_astatsDirtyFrom(0),
+   m_writeAll(true),
+   m_headerOnly(false),
    m_cksCalc(0)
 {}
 
@@ -135,6 +241,9 @@ void Info::SetAllBitsSynced()
    for (int i = 0; i < nb; ++i)
       m_store.m_buff_synced[i] = 255;
 
+   m_syncedDirtyBeg = 0;
+   m_syncedDirtyEnd = nb;
+
    m_complete = true;
 }
 
@@ -180,11 +289,24 @@ void Info::ResizeBits(int s)
    {
       m_buff_prefetch = 0;
    }
+
+   m_writeAll   = true;
+   m_headerOnly = false;
 }
 
 //------------------------------------------------------------------------------
 
 bool Info::Read(XrdOssDF* fp, const std::string &fname)
+{
+   return Read(fp, fname, false);
+}
+
+bool Info::ReadHeader(XrdOssDF* fp, const std::string &fname)
+{
+   return Read(fp, fname, true);
+}
+
+bool Info::Read(XrdOssDF* fp, const std::string &fname, bool header_only)
 {
    // does not need lock, called only in File::Open
    // before File::Run() starts
@@ -194,16 +316,107 @@ bool Info::Read(XrdOssDF* fp, const std::string &fname)
 
    FpHelper r(fp, 0, m_trace, m_traceID, trace_pfx + "oss read failed");
 
-   if (r.Read(m_store.m_version)) return false;
+   int version;
+   if (r.Read(version)) return false;
+
+   bool ok;
+   switch (abs(version))
+   {
+      case 1:  ok = ReadV1(fp, fname); break;
+      case 2:  ok = ReadV2(fp, fname); break;
+      case 3:  return ReadV3(fp, fname, header_only);
+      default:
+         TRACE(Warning, trace_pfx << " File version " << version << " non supported");
+         return false;
+   }
+   if (ok)
+   {
+      // Older formats get converted on next write.
+      m_store.m_syncedCnt = CountBits(m_store.m_buff_synced, m_sizeInBits);
+      m_astatsDirtyFrom   = 0;
+      m_writeAll          = true;
+   }
+   return ok;
+}
+
+bool Info::ReadV3(XrdOssDF* fp, const std::string &fname, bool header_only)
+{
+   std::string trace_pfx("Info:::ReadV3() ");
+   trace_pfx += fname + " ";
 
-   if (m_store.m_version == 0)
+   MapHelper r(fp, m_trace, m_traceID, trace_pfx + "oss read failed");
+
+   InfoHeader h;
+   if (r.ReadRaw(&h, sizeof(h), 0)) return false;
+
+   if (h.f_bufferSize <= 0 || h.f_fileSize < 0 || h.f_accessCnt < 0 || h.f_astatSlots <= 0)
    {
-      TRACE(Warning, trace_pfx << " File version 0 non supported");
+      TRACE(Error, trace_pfx << " invalid header");
       return false;
    }
-   else if (abs(m_store.m_version) == 1)
-      return ReadV1(fp, fname);
 
+   const int n_bits  = (h.f_fileSize - 1) / h.f_bufferSize + 1;
+   const int n_bytes = (n_bits - 1) / 8 + 1;
+
+   m_store.m_version    = h.f_version;
+   m_store.m_bufferSize = h.f_bufferSize;
+   m_store.m_fileSize   = h.f_fileSize;
+
+   if (header_only)
+   {
+      m_complete   = (h.f_syncedCnt == n_bits);
+      m_headerOnly = true;
+   }
+   else
+   {
+      ResizeBits(n_bits);
+
+      if (r.ReadRaw(m_store.m_buff_synced, n_bytes, sizeof(InfoHeader))) return false;
+      memcpy(m_buff_written, m_store.m_buff_synced, n_bytes);
+
+      char tmpCksum[16];
+      GetCksum(&m_store.m_buff_synced[0], &tmpCksum[0]);
+      if (memcmp(h.f_cksum, &tmpCksum[0], 16))
+      {
+         TRACE(Error, trace_pfx << " buffer cksum and saved cksum don't match \n");
+         return false;
+      }
+
+      m_complete = ! IsAnythingEmptyInRng(0, m_sizeInBits);
+   }
+   memcpy(m_store.m_cksum, h.f_cksum, 16);
+
+   m_store.m_creationTime = h.f_creationTime;
+   m_store.m_accessCnt    = h.f_accessCnt;
+   m_store.m_syncedCnt    = h.f_syncedCnt;
+   TRACE(Dump, trace_pfx << " complete "<< m_complete << " access_cnt " << m_store.m_accessCnt);
+
+   // read the latest access statistics from the ring
+   size_t vs = std::min(m_store.m_accessCnt, std::min((size_t) h.f_astatSlots, m_maxNumAccess));
+   m_store.m_astats.resize(vs);
+   const off_t astats_off = AStatsOffset(n_bytes);
+   size_t a = m_store.m_accessCnt - vs;
+   for (std::vector<AStat>::iterator it = m_store.m_astats.begin(); it != m_store.m_astats.end(); ++it, ++a)
+   {
+      if (r.ReadRaw(&(*it), sizeof(AStat), astats_off + (a % h.f_astatSlots) * sizeof(AStat))) return false;
+   }
+
+   m_syncedDirtyBeg  = INT_MAX;
+   m_syncedDirtyEnd  = 0;
+   m_astatsDirtyFrom = m_store.m_accessCnt;
+   m_writeAll        = ((size_t) h.f_astatSlots != m_maxNumAccess);
+
+   return true;
+}
+
+bool Info::ReadV2(XrdOssDF* fp, const std::string &fname)
+{
+   std::string trace_pfx("Info:::ReadV2() ");
+   trace_pfx += fname + " ";
+
+   FpHelper r(fp, 0, m_trace, m_traceID, trace_pfx + "oss read failed");
+
+   if (r.Read(m_store.m_version)) return false;
    if (r.Read(m_store.m_bufferSize)) return false;
 
    long long fs;
@@ -334,6 +547,12 @@ bool Info::Write(XrdOssDF* fp, const std::string &fname)
    std::string trace_pfx("Info:::Write() ");
    trace_pfx += fname + " ";
 
+   if (m_headerOnly)
+   {
+      TRACE(Error, trace_pfx << " download status has not been read");
+      return false;
+   }
+
    int rc;
    if ((rc = XrdOucSxeq::Serialize(fp->getFD(), XrdOucSxeq::noWait)))
    {
@@ -341,32 +560,78 @@ bool Info::Write(XrdOssDF* fp, const std::string &fname)
       return false;
    }
 
-   FpHelper w(fp, 0, m_trace, m_traceID, trace_pfx + "oss write failed");
+   bool ok = WriteV3(fp, trace_pfx);
+
+   // Can this really fail?
+   if (XrdOucSxeq::Release(fp->getFD()))
+   {
+      TRACE(Error, trace_pfx << "un-lock failed");
+   }
 
-   m_store.m_version = m_defaultVersion;
-   if (w.Write(m_store.m_version))    return false;
-   if (w.Write(m_store.m_bufferSize)) return false;
-   if (w.Write(m_store.m_fileSize))   return false;
+   return ok;
+}
 
-   if (w.WriteRaw(m_store.m_buff_synced, GetSizeInBytes())) return false;
+bool Info::WriteV3(XrdOssDF* fp, const std::string &trace_pfx)
+{
+   FpHelper w(fp, 0, m_trace, m_traceID, trace_pfx + "oss write failed");
 
-   GetCksum(&m_store.m_buff_synced[0], &m_store.m_cksum[0]);
-   if (w.Write(m_store.m_cksum)) return false;
+   const bool   all        = m_writeAll || m_store.m_version != m_defaultVersion;
+   const int    n_bytes    = GetSizeInBytes();
+   const off_t  astats_off = AStatsOffset(n_bytes);
+   const size_t cnt        = m_store.m_accessCnt;
+   const size_t first_mem  = cnt - m_store.m_astats.size();
 
-   if (w.Write(m_store.m_creationTime)) return false;
+   // Synced state, only the part changed since last write.
+   int beg = all ? 0       : m_syncedDirtyBeg;
+   int end = all ? n_bytes : std::min(m_syncedDirtyEnd, n_bytes);
+   if (beg < end)
+   {
+      w.f_off = sizeof(InfoHeader) + beg;
+      if (w.WriteRaw(m_store.m_buff_synced + beg, end - beg)) return false;
+   }
 
-   if (w.Write(m_store.m_accessCnt)) return false;
-   for (std::vector<AStat>::iterator it = m_store.m_astats.begin(); it != m_store.m_astats.end(); ++it)
+   // Access records, only the ones changed since last write.
+   for (size_t a = all ? first_mem : std::max(m_astatsDirtyFrom, first_mem); a < cnt; ++a)
    {
-      if (w.WriteRaw(&(*it), sizeof(AStat))) return false;
+      w.f_off = astats_off + (a % m_maxNumAccess) * sizeof(AStat);
+      if (w.WriteRaw(&m_store.m_astats[a - first_mem], sizeof(AStat))) return false;
    }
 
-   // Can this really fail?
-   if (XrdOucSxeq::Release(fp->getFD()))
+   if (all)
    {
-      TRACE(Error, trace_pfx << "un-lock failed");
+      // Drop whatever an older format had beyond the access ring.
+      int trc = fp->Ftruncate(astats_off + m_maxNumAccess * sizeof(AStat));
+      if (trc != XrdOssOK)
+      {
+         TRACE(Error, trace_pfx << " truncate failed " << strerror(-trc));
+         return false;
+      }
    }
 
+   // Header goes last, its cksum is what validates the synced state.
+   m_store.m_version   = m_defaultVersion;
+   m_store.m_syncedCnt = CountBits(m_store.m_buff_synced, m_sizeInBits);
+   GetCksum(&m_store.m_buff_synced[0], &m_store.m_cksum[0]);
+
+   InfoHeader h;
+   memset(&h, 0, sizeof(h));
+   h.f_version      = m_store.m_version;
+   h.f_astatSlots   = m_maxNumAccess;
+   h.f_bufferSize   = m_store.m_bufferSize;
+   h.f_fileSize     = m_store.m_fileSize;
+   h.f_creationTime = m_store.m_creationTime;
+   h.f_accessCnt    = m_store.m_accessCnt;
+   h.f_syncedCnt    = m_store.m_syncedCnt;
+   memcpy(h.f_cksum, m_store.m_cksum, 16);
+
+   w.f_off = 0;
+   if (w.Write(h)) return false;
+
+   m_syncedDirtyBeg  = INT_MAX;
+   m_syncedDirtyEnd  = 0;
+   m_astatsDirtyFrom = cnt;
+   m_writeAll        = false;
+
    return true;
 }
 
@@ -376,6 +641,8 @@ void Info::ResetAllAccessStats()
 {
    m_store.m_accessCnt = 0;
    m_store.m_astats.clear();
+   m_astatsDirtyFrom = 0;
+   m_writeAll        = true;
 }
 
 void Info::WriteIOStatAttach()
@@ -387,10 +654,12 @@ void Info::WriteIOStatAttach()
    AStat as;
    as.AttachTime = time(0);
    m_store.m_astats.push_back(as);
+   m_astatsDirtyFrom = std::min(m_astatsDirtyFrom, m_store.m_accessCnt - 1);
 }
 
 void Info::WriteIOStat(Stats& s)
 {
+   m_astatsDirtyFrom = std::min(m_astatsDirtyFrom, m_store.m_accessCnt - 1);
    m_store.m_astats.back().BytesDisk   = s.m_BytesDisk;
    m_store.m_astats.back().BytesRam    = s.m_BytesRam;
    m_store.m_astats.back().BytesMissed = s.m_BytesMissed;
@@ -398,6 +667,7 @@ void Info::WriteIOStat(Stats& s)
 
 void Info::WriteIOStatDetach(Stats& s)
 {
+   m_astatsDirtyFrom = std::min(m_astatsDirtyFrom, m_store.m_accessCnt - 1);
    m_store.m_astats.back().DetachTime  = time(0);
    m_store.m_astats.back().BytesDisk   = s.m_BytesDisk;
    m_store.m_astats.back().BytesRam    = s.m_BytesRam;
@@ -414,6 +684,7 @@ void Info::WriteIOStatSingle(long long bytes_disk)
    as.AttachTime = as.DetachTime = time(0);
    as.BytesDisk  = bytes_disk;
    m_store.m_astats.push_back(as);
+   m_astatsDirtyFrom = std::min(m_astatsDirtyFrom, m_store.m_accessCnt - 1);
 }
 
 void Info::WriteIOStatSingle(long long bytes_disk, time_t att, time_t dtc)
@@ -427,6 +698,7 @@ void Info::WriteIOStatSingle(long long bytes_disk, time_t att, time_t dtc)
    as.DetachTime = dtc;
    as.BytesDisk  = bytes_disk;
    m_store.m_astats.push_back(as);
+   m_astatsDirtyFrom = std::min(m_astatsDirtyFrom, m_store.m_accessCnt - 1);
 }
 
 //------------------------------------------------------------------------------
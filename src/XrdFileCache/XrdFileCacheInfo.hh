@@ -68,9 +68,10 @@ public:
       char               m_cksum[16];              //!< cksum of downloaded information
       time_t             m_creationTime;           //!< time the info file was created
       size_t             m_accessCnt;              //!< number of written AStat structs
+      int                m_syncedCnt;              //!< number of blocks synced to disk
       std::vector<AStat> m_astats;                 //!< number of last m_maxAcessCnts
 
-      Store () : m_version(1), m_bufferSize(-1), m_fileSize(0), m_buff_synced(0),m_creationTime(0), m_accessCnt(0) {}
+      Store () : m_version(1), m_bufferSize(-1), m_fileSize(0), m_buff_synced(0),m_creationTime(0), m_accessCnt(0), m_syncedCnt(0) {}
    };
 
 
@@ -136,7 +137,24 @@ public:
    bool Read(XrdOssDF* fp, const std::string &fname = "<unknown>");
 
    //---------------------------------------------------------------------
-   //! Write number of blocks and read buffer size
+   //! \brief Load file size, synced block count and access statistics
+   //! without the per-block download state.
+   //!
+   //! Only the header and the access records are paged in. Files in an
+   //! older format are read in full. The object can not be written after
+   //! this, nor can the state of individual blocks be tested.
+   //!
+   //! @return true on success
+   //---------------------------------------------------------------------
+   bool ReadHeader(XrdOssDF* fp, const std::string &fname = "<unknown>");
+
+   //---------------------------------------------------------------------
+   //! \brief Write changes since the last Read() or Write().
+   //!
+   //! Only the modified part of the synced-state vector and the modified
+   //! access records are written, followed by the header. A new file, or
+   //! one read in an older format, is written in full.
+   //!
    //! @return true on success
    //---------------------------------------------------------------------
    bool Write(XrdOssDF* fp, const std::string &fname = "<unknown>");
@@ -220,6 +238,11 @@ public:
    //---------------------------------------------------------------------
    long long GetNDownloadedBytes() const;
 
+   //---------------------------------------------------------------------
+   //! Get number of bytes synced to disk as of last Read() or Write()
+   //---------------------------------------------------------------------
+   long long GetNSyncedBytes() const { return m_store.m_bufferSize * m_store.m_syncedCnt; }
+
    //---------------------------------------------------------------------
    //! Get number of the last downloaded block
    //---------------------------------------------------------------------
@@ -275,11 +298,22 @@ protected:
    int  m_sizeInBits;                        //!< cached
    bool m_complete;                          //!< cached
 
+   int    m_syncedDirtyBeg;                  //!< first modified byte of synced state
+   int    m_syncedDirtyEnd;                  //!< one past last modified byte of synced state
+   size_t m_astatsDirtyFrom;                 //!< first modified access record
+   bool   m_writeAll;                        //!< next write must rewrite the whole file
+   bool   m_headerOnly;                      //!< download state was not read
+
 private:
    inline unsigned char cfiBIT(int n) const { return 1 << n; }
 
-   // split reading for V1
+   // split reading for older versions
    bool ReadV1(XrdOssDF* fp, const std::string &fname);
+   bool ReadV2(XrdOssDF* fp, const std::string &fname);
+   bool ReadV3(XrdOssDF* fp, const std::string &fname, bool header_only);
+   bool Read  (XrdOssDF* fp, const std::string &fname, bool header_only);
+
+   bool WriteV3(XrdOssDF* fp, const std::string &trace_pfx);
    XrdCksCalc*   m_cksCalc;
 };
 
@@ -332,6 +366,9 @@ inline void Info::SetBitSynced(int i)
 
    const int off = i - cn*8;
    m_store.m_buff_synced[cn] |= cfiBIT(off);
+
+   if (cn <  m_syncedDirtyBeg) m_syncedDirtyBeg = cn;
+   if (cn >= m_syncedDirtyEnd) m_syncedDirtyEnd = cn + 1;
 }
 
 //------------------------------------------------------------------------------
@@ -18,6 +18,7 @@
 
 #include <iostream>
 #include <fcntl.h>
+#include <stdlib.h>
 #include <vector>
 #include "XrdFileCachePrint.hh"
 #include "XrdOuc/XrdOucEnv.hh"
@@ -31,7 +32,7 @@
 
 using namespace XrdFileCache;
 
-Print::Print(XrdOss* oss, bool v, const char* path) : m_oss(oss), m_verbose(v), m_ossUser("nobody")
+Print::Print(XrdOss* oss, bool v, bool u, const char* path) : m_oss(oss), m_verbose(v), m_upgrade(u), m_ossUser("nobody")
 {
    if (isInfoFile(path))
    {
@@ -64,7 +65,7 @@ void Print::printFile(const std::string& path)
 {
    printf("printing %s ...\n", path.c_str());
    XrdOssDF* fh = m_oss->newFile(m_ossUser);
-   fh->Open((path).c_str(),O_RDONLY, 0600, m_env);
+   fh->Open((path).c_str(), m_upgrade ? O_RDWR : O_RDONLY, 0600, m_env);
 
    XrdSysTrace tr(""); tr.What = 2;
    Info cfi(&tr);
@@ -86,6 +87,15 @@ void Print::printFile(const std::string& path)
 
    printf("version %d, created %s\n",  cfi.GetVersion(), creationBuff);
 
+   if (m_upgrade && abs(cfi.GetVersion()) != Info::m_defaultVersion)
+   {
+      int old_version = cfi.GetVersion();
+      if (cfi.Write(fh, path))
+         printf("upgraded from version %d to %d\n", old_version, cfi.GetVersion());
+      else
+         printf("upgrade from version %d failed\n", old_version);
+   }
+
    printf("fileSize %lld, bufferSize %lld nBlocks %d nDownloaded %d %s\n",
           cfi.GetFileSize(),cfi.GetBufferSize(), cfi.GetSizeInBits(), cntd,
           (cfi.GetSizeInBits() == cntd) ? "complete" : "");
@@ -182,8 +192,9 @@ void Print::printDir(XrdOssDF* iOssDF, const std::string& path)
 
 int main(int argc, char *argv[])
 {
-   static const char* usage = "Usage: pfc_print [-c config_file] [-v] path\n\n";
+   static const char* usage = "Usage: pfc_print [-c config_file] [-v] [-u] path\n\n";
    bool verbose = false;
+   bool upgrade = false;
    const char* cfgn = 0;
 
    XrdOucEnv myEnv;
@@ -196,6 +207,7 @@ int main(int argc, char *argv[])
    XrdOucArgs   Spec(&err, "xrdpfc_print: ", "",
                      "verbose",      1, "v",
                      "config",       1, "c",
+                     "upgrade",      1, "u",
                      (const char *) 0);
 
 
@@ -218,6 +230,11 @@ int main(int argc, char *argv[])
          verbose = true;
          break;
       }
+      case 'u':
+      {
+         upgrade = true;
+         break;
+      }
       default:
       {
          printf("%s", usage);
@@ -267,13 +284,13 @@ int main(int argc, char *argv[])
                std::string tmp = Config.GetWord();
                tmp += &path[6];
                // printf("Absolute path %s \n", tmp.c_str());
-               XrdFileCache::Print p(oss, verbose, tmp.c_str());
+               XrdFileCache::Print p(oss, verbose, upgrade, tmp.c_str());
             }
          }
       }
       else
       {
-         XrdFileCache::Print p(oss, verbose, path);
+         XrdFileCache::Print p(oss, verbose, upgrade, path);
       }
    }
 
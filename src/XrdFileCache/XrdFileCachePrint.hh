@@ -28,12 +28,13 @@ public:
    //------------------------------------------------------------------------
    //! Constructor.
    //------------------------------------------------------------------------
-   Print(XrdOss* oss, bool v, const char* path);
+   Print(XrdOss* oss, bool v, bool u, const char* path);
 
 private:
    XrdOss*     m_oss;      //! file system
    XrdOucEnv   m_env;      //! env used by file system
    bool        m_verbose;  //! print each block
+   bool        m_upgrade;  //! rewrite files of older versions in current format
    const char* m_ossUser;  //! file system user
 
    //---------------------------------------------------------------------
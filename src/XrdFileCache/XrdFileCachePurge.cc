@@ -115,13 +115,13 @@ void FillFileMapRecurse(XrdOssDF* iOssDF, const std::string& path, FPurgeState&
             // This is not really necessary because we do that check before unlinking the file
             Info cinfo(Cache::GetInstance().GetTrace());
             int open_rs;
-            if ((open_rs = fh->Open(np.c_str(), O_RDONLY, 0600, env)) == XrdOssOK && cinfo.Read(fh, np))
+            if ((open_rs = fh->Open(np.c_str(), O_RDONLY, 0600, env)) == XrdOssOK && cinfo.ReadHeader(fh, np))
             {
                time_t accessTime;
                if (cinfo.GetLatestDetachTime(accessTime))
                {
                   // TRACE(Dump, "FillFileMapRecurse() checking " << buff << " accessTime  " << accessTime);
-                  purgeState.checkFile(np, cinfo.GetNDownloadedBytes(), accessTime);
+                  purgeState.checkFile(np, cinfo.GetNSyncedBytes(), accessTime);
                }
                else
                {
@@ -136,7 +136,7 @@ void FillFileMapRecurse(XrdOssDF* iOssDF, const std::string& path, FPurgeState&
                   {
                      accessTime = fstat.st_mtime;
                      TRACE(Dump, "FillFileMapRecurse() have access time for " << np << " via stat: " << accessTime);
-                     purgeState.checkFile(np, cinfo.GetNDownloadedBytes(), accessTime);
+                     purgeState.checkFile(np, cinfo.GetNSyncedBytes(), accessTime);
                   }
                   else
                   {
@@ -223,13 +223,7 @@ void Cache::Purge()
       // estimate amount of space to erase based on file usage
       if (m_configuration.are_file_usage_limits_set())
       {
-         long long estimated_writes_since_last_purge;
-         {
-            XrdSysCondVarHelper lock(&m_writeQ.condVar);
-
-            estimated_writes_since_last_purge = m_writeQ.writes_between_purges;
-            m_writeQ.writes_between_purges = 0;
-         }
+         long long estimated_writes_since_last_purge = m_writes_between_purges.exchange(0);
          estimated_file_usage += estimated_writes_since_last_purge;
 
          TRACE(Debug, trc_pfx << "estimated usage by files " << estimated_file_usage << " bytes.");
@@ -390,6 +384,26 @@ void Cache::Purge()
       TRACE(Info, trc_pfx << "Finished, removed " << deleted_file_count << " data files, total size " <<
             bytesToRemove_at_start - bytesToRemove << ", bytes to remove at end: " << bytesToRemove);
 
+      TRACE(Info, trc_pfx << "Prefetched blocks of closed files: " << m_prefetch_n_blocks.load() <<
+            ", never read: " << m_prefetch_n_unused.load());
+
+      {
+         XrdSysMutexHelper lock(m_writeQs_mutex);
+
+         for (std::vector<WriteQ*>::iterator i = m_writeQs.begin(); i != m_writeQs.end(); ++i)
+         {
+            WriteQ &wq = **i;
+            XrdSysCondVarHelper wq_lock(&wq.condVar);
+
+            TRACE(Info, trc_pfx << "Write queue for device " << wq.dev << ": size " << wq.size <<
+                  ", max size " << wq.max_size << ", blocks written " << wq.n_blocks << " in " << wq.n_writes <<
+                  " writes, mean wait " << (wq.n_blocks ? wq.wait_usec / wq.n_blocks / 1000 : 0) << " ms");
+
+            wq.max_size  = wq.size;
+            wq.n_blocks  = wq.n_writes = wq.wait_usec = 0;
+         }
+      }
+
       sleep(m_configuration.m_purgeInterval);
    }
 }
@@ -11,64 +11,115 @@
 #include "XrdCl/XrdClFile.hh"
 #include "XrdCl/XrdClXRootDResponses.hh"
 
+#include <limits.h>
+
+namespace
+{
+// Limits for vector reads sent to the origin. Servers refuse elements larger
+// than their transfer buffer (2MB by default) and more than 1024 elements.
+const int ReadVMaxChunkSize = 1024 * 1024;
+const int ReadVMaxChunks    = 1024;
+}
+
 namespace XrdFileCache
 {
-// A list of IOVec chuncks that match a given block index.
-// arr vector holds chunk readv indicies.
-struct ReadVChunkListDisk
+//------------------------------------------------------------------------------
+// Array that lives on the stack for the common, short read vectors and only
+// moves to the heap when it has to grow beyond N entries.
+//------------------------------------------------------------------------------
+
+template<typename T, int N>
+class VReadArray
 {
-   ReadVChunkListDisk(int i) : block_idx(i) {}
+public:
+   VReadArray() : m_size(0) {}
 
-   int              block_idx;
-   std::vector<int> arr;
-};
+   void push_back(const T &x)
+   {
+      if (m_size < N)
+      {
+         m_arr[m_size] = x;
+      }
+      else
+      {
+         if (m_size == N) m_vec.assign(m_arr, m_arr + N);
+         m_vec.push_back(x);
+      }
+      ++m_size;
+   }
 
-struct ReadVChunkListRAM
-{
-   ReadVChunkListRAM(Block*b, std::vector <int>* iarr) : block(b), arr(iarr) {}
+   T*   data()             { return m_size > N ? &m_vec[0] : m_arr; }
+   T&   operator[](int i)  { return data()[i]; }
+   T&   back()             { return data()[m_size - 1]; }
+   int  size()  const      { return m_size; }
+   bool empty() const      { return m_size == 0; }
 
-   Block            *block;
-   std::vector<int> *arr;
+private:
+   T              m_arr[N];
+   std::vector<T> m_vec;
+   int            m_size;
 };
 
-// RAM
-struct ReadVBlockListRAM
+//------------------------------------------------------------------------------
+// Result of a single pass over the read vector: where each piece of each
+// chunk is to be found.
+//------------------------------------------------------------------------------
+
+struct VReadPlan
 {
-   std::vector<XrdFileCache::ReadVChunkListRAM> bv;
+   enum BlockState { kWaiting, kFinished, kConsumed };
+
+   struct RamBlock
+   {
+      Block      *block;
+      BlockState  state;
+   };
 
-   bool AddEntry(Block* block, int chunkIdx)
+   struct RamChunk
    {
-      for (std::vector<ReadVChunkListRAM>::iterator i = bv.begin(); i != bv.end(); ++i)
+      int block_idx;    // index in ram_blocks
+      int chunk_idx;    // index in user's read vector
+   };
+
+   VReadArray<RamBlock,     64> ram_blocks;  // in memory or being fetched, ref-counted once
+   VReadArray<RamChunk,    128> ram_chunks;  // pieces of chunks to copy from them
+   VReadArray<XrdOucIOVec, 128> disk_iov;    // pieces in the data file
+   VReadArray<XrdOucIOVec,  64> direct_iov;  // pieces to be read from origin into user buffer
+   std::list<Block*>            to_request;  // new blocks to be fetched
+
+   // Returns true if block was not in the plan yet.
+   bool AddRam(Block *b, int chunk_idx)
+   {
+      int i = ram_blocks.size() - 1;
+      while (i >= 0 && ram_blocks[i].block != b) --i;
+
+      bool is_new = (i < 0);
+      if (is_new)
       {
-         if (i->block == block)
-         {
-            i->arr->push_back(chunkIdx);
-            return false;
-         }
+         RamBlock rb = { b, kWaiting };
+         ram_blocks.push_back(rb);
+         i = ram_blocks.size() - 1;
       }
-      bv.push_back(ReadVChunkListRAM(block, new std::vector<int>));
-      bv.back().arr->push_back(chunkIdx);
-      return true;
+      RamChunk rc = { i, chunk_idx };
+      ram_chunks.push_back(rc);
+      return is_new;
    }
-};
 
-// Disk
-struct ReadVBlockListDisk
-{
-   std::vector<ReadVChunkListDisk> bv;
-
-   void AddEntry(int blockIdx, int chunkIdx)
+   // Merges with the previous piece if it continues it both in the file and
+   // in the user buffer.
+   template<int N>
+   static void AddPiece(VReadArray<XrdOucIOVec, N> &iov, char *buf, long long off, int size, int max_size)
    {
-      for (std::vector<ReadVChunkListDisk>::iterator i = bv.begin(); i != bv.end(); ++i)
+      if ( ! iov.empty())
       {
-         if (i->block_idx == blockIdx)
+         XrdOucIOVec &l = iov.back();
+         if (l.offset + l.size == off && l.data + l.size == buf && l.size + size <= max_size)
          {
-            i->arr.push_back(chunkIdx);
+            l.size += size;
             return;
          }
       }
-      bv.push_back(XrdFileCache::ReadVChunkListDisk(blockIdx));
-      bv.back().arr.push_back(chunkIdx);
+      iov.push_back(XrdOucIOVec2(buf, off, size));
    }
 };
 }
@@ -90,12 +141,8 @@ int File::ReadV(IO *io, const XrdOucIOVec *readV, int n)
 
    int bytesRead = 0;
 
-   BlockList_t                    blks_to_request;
-   ReadVBlockListRAM              blocks_to_process;
-   std::vector<ReadVChunkListRAM> blks_processed;
-   ReadVBlockListDisk             blocks_on_disk;
-   std::vector<XrdOucIOVec>       chunkVec;
-   DirectResponseHandler         *direct_handler = 0;
+   VReadPlan              plan;
+   DirectResponseHandler *direct_handler = 0;
 
    m_downloadCond.Lock();
 
@@ -112,32 +159,27 @@ int File::ReadV(IO *io, const XrdOucIOVec *readV, int n)
       return -ENOENT;
    }
 
-   VReadPreProcess(io, readV, n, blks_to_request, blocks_to_process, blocks_on_disk, chunkVec);
+   VReadPreProcess(io, readV, n, plan);
 
    m_downloadCond.UnLock();
 
    // ----------------------------------------------------------------
 
+   // Get remote requests going first so they overlap with local reads.
+
    // request blocks that need to be fetched
-   if (bytesRead >= 0)
-   {
-      ProcessBlockRequests(blks_to_request, false);
-   }
+   VReadRequestBlocks(plan.to_request);
 
    // issue a client read
-   if (bytesRead >= 0)
+   if ( ! plan.direct_iov.empty())
    {
-      if ( ! chunkVec.empty())
-      {
-         direct_handler = new DirectResponseHandler(1);
-         io->GetInput()->ReadV(*direct_handler, &chunkVec[0], chunkVec.size());
-      }
+      direct_handler = new DirectResponseHandler(1);
+      io->GetInput()->ReadV(*direct_handler, plan.direct_iov.data(), plan.direct_iov.size());
    }
 
    // disk read
-   if (bytesRead >= 0)
    {
-      int dr = VReadFromDisk(readV, n, blocks_on_disk);
+      int dr = VReadFromDisk(plan);
       if (dr < 0)
       {
          bytesRead = dr;
@@ -152,7 +194,7 @@ int File::ReadV(IO *io, const XrdOucIOVec *readV, int n)
    // read from cached blocks
    if (bytesRead >= 0)
    {
-      int br = VReadProcessBlocks(io, readV, n, blocks_to_process.bv, blks_processed);
+      int br = VReadProcessBlocks(io, readV, plan);
       if (br < 0)
       {
          bytesRead = br;
@@ -179,10 +221,10 @@ int File::ReadV(IO *io, const XrdOucIOVec *readV, int n)
       {
          if (direct_handler->m_errno == 0)
          {
-            for (std::vector<XrdOucIOVec>::iterator i = chunkVec.begin(); i != chunkVec.end(); ++i)
+            for (int i = 0; i < plan.direct_iov.size(); ++i)
             {
-               bytesRead += i->size;
-               loc_stats.m_BytesMissed += i->size;
+               bytesRead += plan.direct_iov[i].size;
+               loc_stats.m_BytesMissed += plan.direct_iov[i].size;
             }
          }
          else
@@ -195,22 +237,13 @@ int File::ReadV(IO *io, const XrdOucIOVec *readV, int n)
    {
       XrdSysCondVarHelper _lck(m_downloadCond);
 
-      // Decrease ref count on the remaining blocks.
-      // This happens when read process aborts due to encountered errors.
-      // [ See better implementation of the whole process in File::Read(). ]
-      for (std::vector<ReadVChunkListRAM>::iterator i = blocks_to_process.bv.begin(); i != blocks_to_process.bv.end(); ++i)
-         dec_ref_count(i->block);
-
-      for (std::vector<ReadVChunkListRAM>::iterator i = blks_processed.begin(); i != blks_processed.end(); ++i)
-         dec_ref_count(i->block);
+      // Decrease ref count on all blocks, also on the ones not processed
+      // when read process aborted due to encountered errors.
+      for (int i = 0; i < plan.ram_blocks.size(); ++i)
+         dec_ref_count(plan.ram_blocks[i].block);
    }
 
-   // remove objects on heap
    delete direct_handler;
-   for (std::vector<ReadVChunkListRAM>::iterator i = blocks_to_process.bv.begin(); i != blocks_to_process.bv.end(); ++i)
-      delete i->arr;
-   for (std::vector<ReadVChunkListRAM>::iterator i = blks_processed.begin(); i != blks_processed.end(); ++i)
-      delete i->arr;
 
    m_stats.AddStats(loc_stats);
 
@@ -235,56 +268,62 @@ bool File::VReadValidate(const XrdOucIOVec *vr, int n)
 
 //------------------------------------------------------------------------------
 
-void File::VReadPreProcess(IO *io, const XrdOucIOVec *readV, int n,
-                           BlockList_t              &blks_to_request,
-                           ReadVBlockListRAM        &blocks_to_process,
-                           ReadVBlockListDisk       &blocks_on_disk,
-                           std::vector<XrdOucIOVec> &chunkVec)
+void File::VReadPreProcess(IO *io, const XrdOucIOVec *readV, int n, VReadPlan &plan)
 {
    // Must be called under downloadCond lock.
 
+   const long long BS = m_cfi.GetBufferSize();
+
    for (int iov_idx = 0; iov_idx < n; iov_idx++)
    {
-      const int blck_idx_first =  readV[iov_idx].offset / m_cfi.GetBufferSize();
-      const int blck_idx_last  = (readV[iov_idx].offset + readV[iov_idx].size - 1) / m_cfi.GetBufferSize();
+      record_read(readV[iov_idx].offset, readV[iov_idx].size, false);
+
+      const int blck_idx_first =  readV[iov_idx].offset / BS;
+      const int blck_idx_last  = (readV[iov_idx].offset + readV[iov_idx].size - 1) / BS;
 
       for (int block_idx = blck_idx_first; block_idx <= blck_idx_last; ++block_idx)
       {
          TRACEF(Dump, "VReadPreProcess chunk "<<  readV[iov_idx].size << "@"<< readV[iov_idx].offset);
 
+         long long off;      // offset in user buffer
+         long long blk_off;  // offset in block
+         long long size;     // size to copy
+         overlap(block_idx, BS, readV[iov_idx].offset, readV[iov_idx].size, off, blk_off, size);
+
          BlockMap_i bi = m_block_map.find(block_idx);
          if (bi != m_block_map.end())
          {
-            if (blocks_to_process.AddEntry(bi->second, iov_idx))
+            record_prefetch_hit(offsetIdx(block_idx));
+            if (plan.AddRam(bi->second, iov_idx))
                inc_ref_count(bi->second);
 
             TRACEF(Dump, "VReadPreProcess block "<< block_idx <<" in map");
          }
          else if (m_cfi.TestBitWritten(offsetIdx(block_idx)))
          {
-            blocks_on_disk.AddEntry(block_idx, iov_idx);
+            record_prefetch_hit(offsetIdx(block_idx));
+            VReadPlan::AddPiece(plan.disk_iov, readV[iov_idx].data + off, block_idx*BS + blk_off - m_offset, size, INT_MAX);
 
             TRACEF(Dump, "VReadPreProcess block "<< block_idx <<" , chunk idx = " << iov_idx << " on disk");
          }
          else
          {
             Block *b;
-            if (Cache::GetInstance().RequestRAMBlock() && (b = PrepareBlockRequest(block_idx, io, false)) != 0)
+            if ((b = PrepareBlockRequest(block_idx, io, false)) != 0)
             {
                inc_ref_count(b);
-               blocks_to_process.AddEntry(b, iov_idx);
-               blks_to_request.push_back(b);
+               plan.AddRam(b, iov_idx);
+               plan.to_request.push_back(b);
 
                TRACEF(Dump, "VReadPreProcess request block " << block_idx);
             }
             else
             {
-               long long off;      // offset in user buffer
-               long long blk_off;  // offset in block
-               long long size;     // size to copy
-               const long long BS = m_cfi.GetBufferSize();
-               overlap(block_idx, BS, readV[iov_idx].offset, readV[iov_idx].size, off, blk_off, size);
-               chunkVec.push_back(XrdOucIOVec2(readV[iov_idx].data+off, BS*block_idx + blk_off,size));
+               // Pieces contiguous both in the file and in the user buffer get
+               // merged, also when they come from different chunks. The cap
+               // keeps the result no larger than the largest element the
+               // client asked for.
+               VReadPlan::AddPiece(plan.direct_iov, readV[iov_idx].data + off, block_idx*BS + blk_off, size, readV[iov_idx].size);
 
                TRACEF(Dump, "VReadPreProcess direct read " << block_idx);
             }
@@ -295,86 +334,111 @@ void File::VReadPreProcess(IO *io, const XrdOucIOVec *readV, int n,
 
 //------------------------------------------------------------------------------
 
-int File::VReadFromDisk(const XrdOucIOVec *readV, int n, ReadVBlockListDisk& blocks_on_disk)
+void File::VReadRequestBlocks(BlockList_t& blks)
 {
-   int bytes_read = 0;
-   for (std::vector<ReadVChunkListDisk>::iterator bit = blocks_on_disk.bv.begin(); bit != blocks_on_disk.bv.end(); ++bit )
+   // This *must not* be called with block_map locked.
+
+   if (blks.size() < 2 || BufferSize() > ReadVMaxChunkSize * (long long) ReadVMaxChunks)
    {
-      int blockIdx = bit->block_idx;
-      for (std::vector<int>::iterator chunkIt = bit->arr.begin(); chunkIt != bit->arr.end(); ++chunkIt)
-      {
-         int chunkIdx = *chunkIt;
+      ProcessBlockRequests(blks, false);
+      return;
+   }
 
-         long long off;     // offset in user buffer
-         long long blk_off;    // offset in block
-         long long size;    // size to copy
+   // Fetch all blocks with as few vector reads as possible. All blocks were
+   // requested with the same IO.
 
-         TRACEF(Dump, "VReadFromDisk block= " << blockIdx <<" chunk=" << chunkIdx);
+   IO *io = blks.front()->get_io();
 
-         overlap(blockIdx, m_cfi.GetBufferSize(), readV[chunkIdx].offset, readV[chunkIdx].size, off, blk_off, size);
+   BlockList_i bi = blks.begin();
+   while (bi != blks.end())
+   {
+      BlockVResponseHandler    *handler = new BlockVResponseHandler;
+      std::vector<XrdOucIOVec>  iov;
 
-         int rs = m_output->Read(readV[chunkIdx].data + off,  blockIdx*m_cfi.GetBufferSize() + blk_off - m_offset, size);
+      for ( ; bi != blks.end(); ++bi)
+      {
+         Block *b = *bi;
+         int n_chunks = (b->get_size() - 1) / ReadVMaxChunkSize + 1;
+         if ((int) iov.size() + n_chunks > ReadVMaxChunks) break;
 
-         if (rs < 0)
+         for (long long off = 0; off < b->get_size(); off += ReadVMaxChunkSize)
          {
-            TRACEF(Error, "VReadFromDisk FAILED rs=" << rs << " block=" << blockIdx << " chunk=" << chunkIdx << " off=" << off  <<
-                          " blk_off=" <<  blk_off << " size=" << size <<  " chunkOff=" << readV[chunkIdx].offset);
-            return rs;
+            int size = std::min((long long) ReadVMaxChunkSize, b->get_size() - off);
+            iov.push_back(XrdOucIOVec2(b->get_buff(off), b->get_offset() + off, size));
          }
+         handler->m_blocks.push_back(b);
+      }
 
-         if (rs != size)
-         {
-            TRACEF(Error, "VReadFromDisk FAILED incomplete read rs=" << rs << " block=" << blockIdx << " chunk=" << chunkIdx << " off=" << off  <<
-                          " blk_off=" <<  blk_off << " size=" << size <<  " chunkOff=" << readV[chunkIdx].offset);
-            return -EIO;
-         }
+      TRACEF(Dump, "File::VReadRequestBlocks " << handler->m_blocks.size() << " blocks in " << iov.size() << " chunks");
 
-         bytes_read += rs;
-      }
+      io->GetInput()->ReadV(*handler, &iov[0], iov.size());
    }
+}
 
-   return bytes_read;
+//------------------------------------------------------------------------------
+
+int File::VReadFromDisk(VReadPlan &plan)
+{
+   if (plan.disk_iov.empty()) return 0;
+
+   TRACEF(Dump, "VReadFromDisk " << plan.disk_iov.size() << " pieces");
+
+   long long expected = 0;
+   for (int i = 0; i < plan.disk_iov.size(); ++i)
+      expected += plan.disk_iov[i].size;
+
+   ssize_t rs = m_output->ReadV(plan.disk_iov.data(), plan.disk_iov.size());
+
+   if (rs < 0)
+   {
+      TRACEF(Error, "VReadFromDisk FAILED rs=" << rs << " n_pieces=" << plan.disk_iov.size() << " expected=" << expected);
+      return (rs == -ESPIPE) ? -EIO : rs;
+   }
+
+   if (rs != expected)
+   {
+      TRACEF(Error, "VReadFromDisk FAILED incomplete read rs=" << rs << " n_pieces=" << plan.disk_iov.size() << " expected=" << expected);
+      return -EIO;
+   }
+
+   return rs;
 }
 
 //------------------------------------------------------------------------------
 
-int File::VReadProcessBlocks(IO *io, const XrdOucIOVec *readV, int n,
-                             std::vector<ReadVChunkListRAM>& blocks_to_process,
-                             std::vector<ReadVChunkListRAM>& blocks_processed)
+int File::VReadProcessBlocks(IO *io, const XrdOucIOVec *readV, VReadPlan &plan)
 {
    int bytes_read = 0;
-   while ( ! blocks_to_process.empty() && bytes_read >= 0)
+   int n_waiting  = plan.ram_blocks.size();
+
+   while (n_waiting > 0 && bytes_read >= 0)
    {
-      std::vector<ReadVChunkListRAM> finished;
-      BlockList_t                    to_reissue;
+      BlockList_t to_reissue;
+      int         n_finished = 0;
       {
          XrdSysCondVarHelper _lck(m_downloadCond);
 
-         std::vector<ReadVChunkListRAM>::iterator bi = blocks_to_process.begin();
-         while (bi != blocks_to_process.end())
+         for (int i = 0; i < plan.ram_blocks.size(); ++i)
          {
-            if (bi->block->is_failed() && bi->block->get_io() != io)
+            VReadPlan::RamBlock &rb = plan.ram_blocks[i];
+            if (rb.state != VReadPlan::kWaiting) continue;
+
+            if (rb.block->is_failed() && rb.block->get_io() != io)
             {
-               TRACEF(Info, "File::VReadProcessBlocks() requested block " << bi->block << " failed with another io " <<
-                      bi->block->get_io() << " - reissuing request with my io " << io);
+               TRACEF(Info, "File::VReadProcessBlocks() requested block " << rb.block << " failed with another io " <<
+                      rb.block->get_io() << " - reissuing request with my io " << io);
 
-               bi->block->reset_error_and_set_io(io);
-               to_reissue.push_back(bi->block);
-               ++bi;
+               rb.block->reset_error_and_set_io(io);
+               to_reissue.push_back(rb.block);
             }
-            else if (bi->block->is_finished())
+            else if (rb.block->is_finished())
             {
-               finished.push_back(ReadVChunkListRAM(bi->block, bi->arr));
-               // Here we rely on the fact that std::vector does not reallocate on erase!
-               blocks_to_process.erase(bi);
-            }
-            else
-            {
-               ++bi;
+               rb.state = VReadPlan::kFinished;
+               ++n_finished;
             }
          }
 
-         if (finished.empty() && to_reissue.empty())
+         if (n_finished == 0 && to_reissue.empty())
          {
             m_downloadCond.Wait();
             continue;
@@ -382,39 +446,45 @@ int File::VReadProcessBlocks(IO *io, const XrdOucIOVec *readV, int n,
       }
 
       ProcessBlockRequests(to_reissue, false);
-      to_reissue.clear();
 
-      std::vector<ReadVChunkListRAM>::iterator bi = finished.begin();
-      while (bi != finished.end())
+      if (n_finished == 0) continue;
+
+      n_waiting -= n_finished;
+
+      for (int i = 0; i < plan.ram_blocks.size(); ++i)
       {
-         if (bi->block->is_ok())
+         VReadPlan::RamBlock &rb = plan.ram_blocks[i];
+         if (rb.state == VReadPlan::kFinished && ! rb.block->is_ok())
          {
-            for (std::vector<int>::iterator chunkIt = bi->arr->begin(); chunkIt < bi->arr->end(); ++chunkIt)
-            {
-               long long off;      // offset in user buffer
-               long long blk_off;  // offset in block
-               long long size;     // size to copy
-
-               int block_idx = bi->block->m_offset/m_cfi.GetBufferSize();
-               overlap(block_idx, m_cfi.GetBufferSize(), readV[*chunkIt].offset, readV[*chunkIt].size, off, blk_off, size);
-               memcpy(readV[*chunkIt].data + off,  &(bi->block->m_buff[blk_off]), size);
-               bytes_read += size;
-            }
-         }
-         else
-         {
-            bytes_read = bi->block->m_errno;
-            TRACEF(Error, "File::VReadProcessBlocks() io " << io << ", block "<< bi->block <<
+            bytes_read = rb.block->m_errno;
+            TRACEF(Error, "File::VReadProcessBlocks() io " << io << ", block "<< rb.block <<
                    " finished with error " << -bytes_read << " " << strerror(-bytes_read));
-            break;
+            return bytes_read;
          }
+      }
+
+      for (int i = 0; i < plan.ram_chunks.size(); ++i)
+      {
+         VReadPlan::RamChunk &rc = plan.ram_chunks[i];
+         Block               *b  = plan.ram_blocks[rc.block_idx].block;
+
+         if (plan.ram_blocks[rc.block_idx].state != VReadPlan::kFinished) continue;
+
+         long long off;      // offset in user buffer
+         long long blk_off;  // offset in block
+         long long size;     // size to copy
 
-         ++bi;
+         int block_idx = b->m_offset/m_cfi.GetBufferSize();
+         overlap(block_idx, m_cfi.GetBufferSize(), readV[rc.chunk_idx].offset, readV[rc.chunk_idx].size, off, blk_off, size);
+         memcpy(readV[rc.chunk_idx].data + off, b->get_buff(blk_off), size);
+         bytes_read += size;
       }
 
-      // add finished to processed list
-      std::copy(finished.begin(), finished.end(), std::back_inserter(blocks_processed));
-      finished.clear();
+      for (int i = 0; i < plan.ram_blocks.size(); ++i)
+      {
+         if (plan.ram_blocks[i].state == VReadPlan::kFinished)
+            plan.ram_blocks[i].state = VReadPlan::kConsumed;
+      }
    }
 
    TRACEF(Dump, "VReadProcessBlocks total read  " <<  bytes_read);
@@ -176,6 +176,8 @@ XrdFrmConfig::XrdFrmConfig(SubSys ss, const char *vopts, const char *uinfo)
    pProg    = 0;
    Fix      = 0;
    dirHold  = 40*60*60;
+   scanThreads = 0;
+   eagerAge = 0;
    runOld   = 0;
    runNew   = 1;
    nonXA    = 0;
@@ -1059,6 +1061,7 @@ int XrdFrmConfig::ConfigXeq(char *var, int mbok)
       {
        if (!strcmp(var, "all.sitename"  )) return xsit();
        if (!strcmp(var, "dirhold"       )) return xdpol();
+       if (!strcmp(var, "eager"         )) return xitm("eager age", eagerAge);
        if (!strcmp(var, "oss.cache"     )) return xspace(1,0);
        if (!strcmp(var, "oss.localroot" )) return Grab(var, &LocalRoot, 0);
        if (!strcmp(var, "ofs.osslib"    )) PARSEPI(theOssLib);
@@ -1066,6 +1069,7 @@ int XrdFrmConfig::ConfigXeq(char *var, int mbok)
        if (!strcmp(var, "policy"        )) return xpol();
        if (!strcmp(var, "polprog"       )) return xpolprog();
        if (!strcmp(var, "oss.space"     )) return xspace(1);
+       if (!strcmp(var, "scanthreads"   )) return xsthr();
        if (!strcmp(var, "waittime"      )) return xitm("purge wait",WaitPurge);
        if (!strcmp(var, "frm.all.monitor"))return xmon();
       }
@@ -2071,6 +2075,30 @@ void XrdFrmConfig::xspaceBuild(char *grp, char *fn, int isxa)
    if (!isxa) nonXA = 1;
 }
 
+/******************************************************************************/
+/*                                 x s t h r                                  */
+/******************************************************************************/
+
+/* Function: xsthr
+
+   Purpose:  To parse the directive: scanthreads <num>
+
+             <num>     number of threads used to scan the name space. Zero
+                       (the default) scans the name space serially.
+
+   Output: 0 upon success or !0 upon failure.
+*/
+int XrdFrmConfig::xsthr()
+{   int num;
+    char *val;
+
+    if (!(val = cFile->GetWord()))
+       {Say.Emsg("Config", "scanthreads value not specified"); return 1;}
+    if (XrdOuca2x::a2i(Say, "scanthreads value", val, &num, 0, 64)) return 1;
+    scanThreads = num;
+    return 0;
+}
+
 /******************************************************************************/
 /*                                  x x f r                                   */
 /******************************************************************************/
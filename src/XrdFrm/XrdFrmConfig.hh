@@ -143,6 +143,8 @@ struct Policy
 Policy           dfltPolicy;
 
 int              dirHold;
+int              scanThreads; // Threads used to scan the name space
+int              eagerAge;    // Purge during the scan files idle this long
 int              pVecNum;     // Number of policy variables
 static const int pVecMax=8;
 char             pVec[pVecMax];
@@ -208,6 +210,7 @@ int          xpolprog();
 int          xqchk();
 int          xsit();
 int          xspace(int isPrg=0, int isXA=1);
+int          xsthr();
 void         xspaceBuild(char *grp, char *fn, int isxa);
 int          xxfr();
 
@@ -118,6 +118,11 @@ public:
 
 XrdFrmFileset *Get(int &rc, int noBase=0);
 
+// Scan directories ahead of Get() using the indicated number of threads. This
+// must be called before the first call to Get().
+//
+bool           setThreads(int nThreads) {return nsObj.setThreads(nThreads);}
+
 static const int Recursive = 0x0001;   // List filesets recursively
 static const int CompressD = 0x0002;   // Use shared directory object (not MT)
 static const int NoAutoDel = 0x0004;   // Do not automatically delete objects
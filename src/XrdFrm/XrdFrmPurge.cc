@@ -28,6 +28,7 @@
 /* specific prior written permission of the institution or contributor.       */
 /******************************************************************************/
 
+#include <algorithm>
 #include <stdio.h>
 #include <string.h>
 #include <strings.h>
@@ -153,6 +154,7 @@ XrdOucProg       *XrdFrmPurge::PolProg   = 0;
 XrdOucStream     *XrdFrmPurge::PolStream = 0;
 
 int               XrdFrmPurge::Left2Do   = 0;
+int               XrdFrmPurge::inScan    = 0;
 
 time_t            XrdFrmPurge::lastReset = 0;
 time_t            XrdFrmPurge::nextReset = 0;
@@ -172,6 +174,7 @@ XrdFrmPurge::XrdFrmPurge(const char *snp, XrdFrmPurge *spp) : FSTab(1)
    contSpace = 0;
    minFSpace = 0;
    maxFSpace = 0;
+   keepBytes = 0;
    Enabled   = 0;
    Stop      = 0;
    SNlen     = strlen(SName);
@@ -212,10 +215,24 @@ void XrdFrmPurge::Add(XrdFrmFileset *sP)
        return;
       }
 
-// Add the file to the purge table or the defer queue based on access time
+// If the file has not been accessed in a long time, the space still needs to
+// be purged, and we are scanning, get rid of it right now. A file still in
+// hold would not be purged, so it must go to the defer queue below.
 //
-   if (xTime >= psP->Hold) psP->FSTab.Add(sP);
-      else psP->Defer(sP, xTime);
+   if (inScan && Config.eagerAge && xTime >= Config.eagerAge
+   &&  xTime > psP->Hold
+   &&  !(psP->Stop) && psP->freeSpace < psP->maxFSpace)
+      {if (psP->PurgeFile(sP)) psP->eagFiles++;
+       return;
+      }
+
+// Add the file to the purge table or the defer queue based on access time.
+// While scanning, the file goes to the candidate heap and is added to the
+// purge table only if it survives to the end of the scan.
+//
+   if (xTime < psP->Hold) psP->Defer(sP, xTime);
+      else if (inScan) psP->Keep(sP);
+              else psP->FSTab.Add(sP);
 }
   
 /******************************************************************************/
@@ -262,13 +279,16 @@ void XrdFrmPurge::Clear()
        while ((fP = DeferQ[n])) {DeferQ[n] = fP->Next; delete fP;}
    memset(DeferT, 0, sizeof(DeferT));
 
-// Purge the eligible file table
+// Purge the eligible file table and any candidates
 //
    FSTab.Purge();
+   for (n = 0; n < (int)Cands.size(); n++) delete Cands[n].fsP;
+   Cands.clear();
+   candBytes = 0;
 
 // Clear counters
 //
-   numFiles = 0; prgFiles = 0; purgBytes = 0;
+   numFiles = 0; prgFiles = 0; eagFiles = 0; purgBytes = 0; Trimmed = 0;
 }
   
 /******************************************************************************/
@@ -319,6 +339,13 @@ void XrdFrmPurge::Display()
       else sprintf(buff, "%d", Config.dirHold);
    Say.Say("=====> ", "Directory hold: ", buff);
 
+// Display eager purge age, if any
+//
+   if (Config.eagerAge)
+      {sprintf(buff, "%d", Config.eagerAge);
+       Say.Say("=====> ", "Eager purge age: ", buff);
+      }
+
 // Run through all of the policies, displaying each one
 //
    spP = First;
@@ -402,6 +429,41 @@ XrdFrmPurge *XrdFrmPurge::Find(const char *snp)
    return spP;
 }
 
+/******************************************************************************/
+/* Private:                         K e e p                                   */
+/******************************************************************************/
+
+void XrdFrmPurge::Keep(XrdFrmFileset *sP)
+{
+   EPNAME("Keep");
+   Cand theCand;
+
+// Add the candidate to the heap
+//
+   theCand.aTime = sP->baseFile()->Stat.st_atime;
+   theCand.Size  = sP->baseFile()->Stat.st_size;
+   theCand.fsP   = sP;
+   if (keepBytes <= 0) {delete sP; return;}
+   Cands.push_back(theCand);
+   std::push_heap(Cands.begin(), Cands.end(), Older);
+   candBytes += theCand.Size;
+
+// Drop the least purgeable candidates as long as the rest hold enough bytes.
+// Some candidates will not be purgeable when we get to them so we keep a
+// quarter more than is actually needed.
+//
+   while(Cands.size() > 1
+   &&    candBytes - Cands.front().Size >= keepBytes + keepBytes/4)
+        {std::pop_heap(Cands.begin(), Cands.end(), Older);
+         sP = Cands.back().fsP;
+         candBytes -= Cands.back().Size;
+         Cands.pop_back();
+         DEBUG("Purge " <<SName <<": not needed " <<sP->basePath());
+         delete sP;
+         Trimmed = 1;
+        }
+}
+
 /******************************************************************************/
 /*                                  I n i t                                   */
 /******************************************************************************/
@@ -454,6 +516,18 @@ int XrdFrmPurge::Init(XrdOucTList *sP, long long minV, int hVal)
          spP = spP->Next;
         }
 
+// Eager purging only applies to files that are past the hold time
+//
+   spP = First;
+   while(spP && Config.eagerAge)
+        {if (spP->Enabled && Config.eagerAge <= spP->Hold)
+            {Say.Emsg("Init", "Eager purge age must exceed the hold time of "
+                              "space", spP->SName);
+             return 0;
+            }
+         spP = spP->Next;
+        }
+
 // Go through each space policy getting the actual space and calculating
 // the targets based on the policy (we need to do this only once)
 //
@@ -545,14 +619,27 @@ int XrdFrmPurge::LowOnSpace()
    psP = First;
    while(psP)
         {psP->Clear();
+         psP->keepBytes = (psP->Stop ? 0 : psP->maxFSpace - psP->freeSpace);
          psP = psP->Next;
         }
 
 // We must check whether or not a full name space scan is required. This is
 // based on the last time we did one and whether or not a space needs one now.
+// Candidates that survived the scan are then moved to the purge table.
 //
    eNow = time(0);
-   if (eNow >= nextReset) {lastReset = eNow; nextReset = 0; Scan();}
+   if (eNow >= nextReset)
+      {lastReset = eNow; nextReset = 0;
+       inScan = 1; Scan(); inScan = 0;
+       psP = First;
+       while(psP)
+            {for (int i = 0; i < (int)psP->Cands.size(); i++)
+                 if (!psP->FSTab.Add(psP->Cands[i].fsP))
+                    delete psP->Cands[i].fsP;
+             psP->Cands.clear(); psP->candBytes = 0;
+             psP = psP->Next;
+            }
+      }
    return 1;
 }
 
@@ -620,19 +707,42 @@ do{psP = First;
   
 int XrdFrmPurge::PurgeFile()
 {
-   EPNAME("PurgeFile");
    XrdFrmFileset *fP;
-   const char *fn, *Why;
-   time_t xTime;
-   int rc, FilePurged = 0;
+   int FilePurged = 0;
+
+// Files may have been purged while scanning, so we may already be done
+//
+   if (freeSpace >= maxFSpace) return 1;
 
-// If we have don't have a file, see if we can grab some from the defer queue
+// If we have don't have a file, see if we can grab some from the defer queue.
+// If we ran out because the scan dropped candidates, rescan right away as long
+// as we are still making progress. Otherwise, wait for the hold time.
 //
 do{if (!(fP = FSTab.Oldest()) && !(fP = Advance()))
-      {time_t nextScan = time(0)+Hold;
+      {time_t nextScan = time(0) + (Trimmed && prgFiles ? 0 : Hold);
        if (!nextReset || nextScan < nextReset) nextReset = nextScan;
        return 1;
       }
+   FilePurged = PurgeFile(fP);
+  } while(!FilePurged && !Stop);
+
+// All done, indicate whether we should stop now
+//
+   return freeSpace >= maxFSpace || Stop;
+}
+
+/******************************************************************************/
+
+// Purge a single fileset if it is still eligible. The fileset is deleted.
+// Returns 1 if the file was purged and 0 otherwise.
+
+int XrdFrmPurge::PurgeFile(XrdFrmFileset *fP)
+{
+   EPNAME("PurgeFile");
+   const char *fn, *Why;
+   time_t xTime;
+   int rc, FilePurged = 0;
+
    Why = "file in use";
    if (fP->Refresh() && !(Why = Eligible(fP, xTime, Hold))
    && (!Ext || !(Why = XPolOK(fP))))
@@ -645,11 +755,7 @@ do{if (!(fP = FSTab.Oldest()) && !(fP = Advance()))
                 }
       } else {DEBUG("Purge " <<SName <<": keeping " <<fP->basePath() <<"; " <<Why);}
    delete fP;
-  } while(!FilePurged && !Stop);
-
-// All done, indicate whether we should stop now
-//
-   return freeSpace >= maxFSpace || Stop;
+   return FilePurged;
 }
 
 /******************************************************************************/
@@ -736,6 +842,7 @@ void XrdFrmPurge::Scan()
 // Process each directory
 //
    do {fP = new XrdFrmFiles(vP->Name, Opts, vP->Dir, cbP);
+       if (Config.scanThreads) fP->setThreads(Config.scanThreads);
        needLF = vP->Val;
        while((sP = fP->Get(ec,1)))
             {aFiles++;
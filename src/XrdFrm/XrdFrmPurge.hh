@@ -31,6 +31,7 @@
 /******************************************************************************/
 
 #include <time.h>
+#include <vector>
 #include <sys/types.h>
 
 #include "XrdFrm/XrdFrmTSort.hh"
@@ -60,6 +61,22 @@ static void          Purge();
 
 private:
 
+// Purge candidates found by a scan are kept in a heap with the most recently
+// accessed (i.e. least purgeable) candidate on top. Once the heap holds more
+// than the bytes we need to free (plus some slack) the top is dropped. This
+// bounds memory use no matter how many files the scan finds.
+//
+struct Cand
+      {time_t         aTime;
+       long long      Size;
+       XrdFrmFileset *fsP;
+      };
+
+static bool          Older(const Cand &c1, const Cand &c2)
+                          {return c1.aTime < c2.aTime
+                              || (c1.aTime == c2.aTime && c1.Size > c2.Size);
+                          }
+
 // Methods
 //
 static void          Add(XrdFrmFileset *fsp);
@@ -68,8 +85,10 @@ static void          Add(XrdFrmFileset *fsp);
        void          Defer(XrdFrmFileset *sP, time_t xTime);
 const  char         *Eligible(XrdFrmFileset *sP, time_t &xTime, int hTime=0);
 static XrdFrmPurge  *Find(const char *snp);
+       void          Keep(XrdFrmFileset *sP);
 static int           LowOnSpace();
        int           PurgeFile();
+       int           PurgeFile(XrdFrmFileset *fP);
        int           PurgeFile(XrdFrmFileset *fP, const char *pFN);
 static void          Scan();
 static void          Stats(int Final);
@@ -87,6 +106,7 @@ static XrdFrmPurge  *First;
 static XrdFrmPurge  *Default;
 
 static int           Left2Do;
+static int           inScan;
 
 // Variables local to each object
 //
@@ -99,6 +119,8 @@ long long            contSpace;      // Total contg (computed once)
 long long            purgBytes;      // Purged bytes on last purge cycle
 long long            minFSpace;      // Minimum free space
 long long            maxFSpace;      // Maximum free space (what we purge to)
+long long            candBytes;      // Bytes held by candidates in Cands
+long long            keepBytes;      // Bytes of candidates to keep in Cands
 char                *spaceTotl;
 char                *spaceTotP;
 int                  spaceTLen;
@@ -108,12 +130,15 @@ int                  Hold2x;         // Hold x2 (what we actually use)
 int                  Ext;            // External policy applies
 int                  numFiles;       // Total number of files
 int                  prgFiles;       // Total number of purged
+int                  eagFiles;       // Number purged during the scan
+int                  Trimmed;        // Candidates were dropped by the scan
 int                  Enabled;
 int                  Stop;
 int                  SNlen;
 
 XrdFrmPurge         *Next;
 XrdFrmTSort          FSTab;
+std::vector<Cand>    Cands;
 char                 SName[XrdOssSpace::minSNbsz];
 
 static const int     DeferQsz = 16;
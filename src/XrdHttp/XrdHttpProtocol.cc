@@ -38,6 +38,7 @@
 //#include "XrdXrootd/XrdXrootdStats.hh"
 
 #include <sys/stat.h>
+#include <poll.h>
 #include "XrdHttpUtils.hh"
 #include "XrdHttpSecXtractor.hh"
 #include "XrdHttpExtHandler.hh"
@@ -51,6 +52,13 @@
 
 #define XRHTTP_TK_GRACETIME     600
 
+// Kernel TLS offload is driven by OpenSSL itself (3.0 and later), which pushes
+// the session keys into the socket once the handshake completes
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L && defined(SSL_OP_ENABLE_KTLS) \
+    && !defined(OPENSSL_NO_KTLS)
+#define XRHTTP_HAVE_KTLS 1
+#endif
+
 
 
 /******************************************************************************/
@@ -83,6 +91,7 @@ XrdOucHash<XrdHttpProtocol::StaticPreloadInfo> *XrdHttpProtocol::staticpreload =
 
 kXR_int32 XrdHttpProtocol::myRole = kXR_isManager;
 bool XrdHttpProtocol::selfhttps2http = false;
+bool XrdHttpProtocol::usektls = false;
 bool XrdHttpProtocol::isdesthttps = false;
 char *XrdHttpProtocol::sslcafile = 0;
 char *XrdHttpProtocol::secretkey = 0;
@@ -596,7 +605,18 @@ int XrdHttpProtocol::Process(XrdLink *lp) // We ignore the argument here
       if (secxtractor)
         secxtractor->InitSSL(ssl, sslcadir);
 
-      SSL_set_bio(ssl, sbio, sbio);
+      if (!SSL_get_rbio(ssl)) {
+#ifdef XRHTTP_HAVE_KTLS
+        // kTLS can only be armed by OpenSSL on a plain socket BIO, but only
+        // the sending side needs it. Reads keep going through the link, so
+        // that the read timeout and the link statistics still apply
+        if (usektls) {
+          SSL_set0_rbio(ssl, sbio);
+          SSL_set0_wbio(ssl, BIO_new_socket(Link->FDnum(), BIO_NOCLOSE));
+        } else
+#endif
+        SSL_set_bio(ssl, sbio, sbio);
+      }
       //SSL_set_connect_state(ssl);
 
       //SSL_set_fd(ssl, Link->FDnum());
@@ -607,7 +627,10 @@ int XrdHttpProtocol::Process(XrdLink *lp) // We ignore the argument here
       setsockopt(Link->FDnum(), SOL_SOCKET, SO_SNDTIMEO, (struct timeval *)&tv, sizeof(struct timeval));
 
       TRACEI(DEBUG, " Entering SSL_accept...");
-      int res = SSL_accept(ssl);
+      int res;
+      do {res = SSL_accept(ssl);}
+         while(res == -1 && SSL_get_error(ssl, res) == SSL_ERROR_WANT_WRITE
+               && WaitWritable());
       TRACEI(DEBUG, " SSL_accept returned :" << res);
       ERR_print_errors(sslbio_err);
 
@@ -624,6 +647,20 @@ int XrdHttpProtocol::Process(XrdLink *lp) // We ignore the argument here
         }
       BIO_set_nbio(sbio, 0);
 
+#ifdef XRHTTP_HAVE_KTLS
+      if (usektls) {
+        ktlssend = (BIO_get_ktls_send(SSL_get_wbio(ssl)) != 0);
+        TRACEI(DEBUG, " kTLS send: " << ktlssend);
+
+        // If the kernel did not take the keys (no tls module, unsupported
+        // cipher...) then we are better off writing through the link as well
+        if (!ktlssend) {
+          BIO_up_ref(sbio);
+          SSL_set0_wbio(ssl, sbio);
+        }
+      }
+#endif
+
       res = SSL_get_verify_result(ssl);
       TRACEI(DEBUG, " SSL_get_verify_result returned :" << res);
       ERR_print_errors(sslbio_err);
@@ -1083,6 +1120,7 @@ int XrdHttpProtocol::Config(const char *ConfigFN, XrdOucEnv *myEnv) {
       else if TS_Xeq("staticpreload", xstaticpreload);
       else if TS_Xeq("listingdeny", xlistdeny);
       else if TS_Xeq("header2cgi", xheader2cgi);
+      else if TS_Xeq("ktls", xktls);
       else {
         eDest.Say("Config warning: ignoring unknown directive '", var, "'.");
         Config.Echo();
@@ -1240,6 +1278,18 @@ int XrdHttpProtocol::getDataOneShot(int blen, bool wait) {
     TRACE(DEBUG, "getDataOneShot sslavail: " << sslavail);
     if (sslavail <= 0) return 0;
 
+    // Nothing decrypted is pending, so wait for the client the same way
+    // the plain path does
+    if (wait && SSL_pending(ssl) <= 0) {
+      struct pollfd polltab = {Link->FDnum(), POLLIN|POLLRDNORM, 0};
+      int retc;
+      do {retc = poll(&polltab, 1, readWait);} while(retc < 0 && errno == EINTR);
+      if (retc == 0) {
+        Link->setEtext("link timeout");
+        return 1;
+      }
+    }
+
     if (myBuffEnd - myBuff->buff >= myBuff->bsize) {
       TRACE(DEBUG, "getDataOneShot Buffer panic");
       myBuffEnd = myBuff->buff;
@@ -1387,8 +1437,8 @@ int XrdHttpProtocol::SendData(const char *body, int bodylen) {
 
   if (body && bodylen) {
     TRACE(REQ, "Sending " << bodylen << " bytes");
-    if (ishttps) {
-      r = SSL_write(ssl, body, bodylen);
+    if (ishttps && !ktlssend) {
+      r = SSLWrite(body, bodylen);
       if (r <= 0) {
         ERR_print_errors(sslbio_err);
         return -1;
@@ -1403,6 +1453,56 @@ int XrdHttpProtocol::SendData(const char *body, int bodylen) {
   return 0;
 }
 
+/// Send some data to the client, gathered from a vector of buffers
+
+int XrdHttpProtocol::SendData(const struct iovec *iov, int iovcnt, int bytes) {
+
+  if (!iovcnt) return 0;
+
+  TRACE(REQ, "Sending " << bytes << " bytes in " << iovcnt << " pieces");
+
+  // OpenSSL has no gather write. Unless the kernel does the encryption we
+  // have to feed it one piece at a time
+  if (ishttps && !ktlssend) {
+    for (int i = 0; i < iovcnt; i++) {
+      if (!iov[i].iov_len) continue;
+      if (SSLWrite(iov[i].iov_base, iov[i].iov_len) <= 0) {
+        ERR_print_errors(sslbio_err);
+        return -1;
+      }
+    }
+
+  } else {
+    if (Link->Send(iov, iovcnt, bytes) < 0) return -1;
+  }
+
+  return 0;
+}
+
+/// Write through OpenSSL, waiting for the socket whenever it asks for it
+
+int XrdHttpProtocol::SSLWrite(const void *buff, int blen) {
+  int r;
+
+  do {r = SSL_write(ssl, buff, blen);}
+     while(r <= 0 && SSL_get_error(ssl, r) == SSL_ERROR_WANT_WRITE
+           && WaitWritable());
+  return r;
+}
+
+/// Wait until the socket can take more data, at most readWait milliseconds
+
+bool XrdHttpProtocol::WaitWritable() {
+  struct pollfd polltab = {Link->FDnum(), POLLOUT|POLLWRNORM, 0};
+  int retc;
+
+  do {retc = poll(&polltab, 1, readWait);} while(retc < 0 && errno == EINTR);
+  if (retc == 1 && !(polltab.revents & (POLLERR|POLLHUP|POLLNVAL))) return true;
+
+  Link->setEtext(retc == 0 ? "link write timeout" : "link poll error");
+  return false;
+}
+
 int XrdHttpProtocol::StartSimpleResp(int code, const char *desc, const char *header_to_add, long long bodylen, bool keepalive) {
   std::stringstream ss;
   const std::string crlf = "\r\n";
@@ -1681,6 +1781,15 @@ int XrdHttpProtocol::InitSecurity() {
   SSL_CTX_set_session_id_context(sslctx, s_server_session_id_context,
           s_server_session_id_context_len);
 
+  if (usektls) {
+#ifdef XRHTTP_HAVE_KTLS
+    SSL_CTX_set_options(sslctx, SSL_OP_ENABLE_KTLS);
+    eDest.Say(" Kernel TLS offload enabled, https GETs may use sendfile.");
+#else
+    eDest.Say(" warning: kernel TLS is not supported by this OpenSSL, ignoring http.ktls.");
+#endif
+  }
+
   /* An error write context */
   sslbio_err = BIO_new_fp(stderr, BIO_NOCLOSE);
 
@@ -1831,6 +1940,7 @@ void XrdHttpProtocol::Reset() {
   SecEntity.tident = XrdHttpSecEntityTident;
   ishttps = false;
   ssldone = false;
+  ktlssend = false;
 
   Bridge = 0;
   ssl = 0;
@@ -2353,6 +2463,40 @@ int XrdHttpProtocol::xstaticpreload(XrdOucStream & Config) {
 
 
 
+/******************************************************************************/
+/*                                 x k t l s                                  */
+/******************************************************************************/
+
+/* Function: xktls
+
+   Purpose:  To parse the directive: ktls <yes|no|0|1>
+
+             <val>    hand the TLS session to the kernel after the handshake,
+                      so that https file data can be sent with sendfile().
+                      If the kernel refuses it, the usual path is used.
+
+  Output: 0 upon success or !0 upon failure.
+ */
+
+int XrdHttpProtocol::xktls(XrdOucStream & Config) {
+  char *val;
+
+  // Get the flag
+  //
+  val = Config.GetWord();
+  if (!val || !val[0]) {
+    eDest.Emsg("Config", "ktls flag not specified");
+    return 1;
+  }
+
+  // Record the value
+  //
+  usektls = (!strcasecmp(val, "true") || !strcasecmp(val, "yes") || !strcmp(val, "1"));
+
+
+  return 0;
+}
+
 /******************************************************************************/
 /*                          x s e l f h t t p s 2 h t t p                     */
 /******************************************************************************/
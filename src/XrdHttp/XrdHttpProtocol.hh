@@ -37,6 +37,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 
 #include "XrdSys/XrdSysError.hh"
 #include "XrdSys/XrdSysPthread.hh"
@@ -143,6 +144,15 @@ private:
   /// Send some generic data to the client
   int SendData(const char *body, int bodylen);
 
+  /// Send some generic data to the client, gathered from iovcnt buffers
+  int SendData(const struct iovec *iov, int iovcnt, int bytes);
+
+  /// SSL_write() that waits for the socket when OpenSSL wants to write
+  int SSLWrite(const void *buff, int blen);
+
+  /// Wait until the socket is writable, false on timeout or error
+  bool WaitWritable();
+
   /// Deallocate resources, in order to reutilize an object of this class
   void Cleanup();
 
@@ -181,6 +191,7 @@ private:
   static int xsslverifydepth(XrdOucStream &Config);
   static int xsecretkey(XrdOucStream &Config);
   static int xheader2cgi(XrdOucStream &Config);
+  static int xktls(XrdOucStream &Config);
   
   static XrdHttpSecXtractor *secxtractor;
   
@@ -271,6 +282,11 @@ private:
   /// connection being established
   bool ssldone;
 
+  /// Tells if the kernel is encrypting what we write on the socket (kTLS),
+  /// hence data can be sent through the link, and file data with
+  /// sendfile(), also over https
+  bool ktlssend;
+
   static XrdCryptoFactory *myCryptoFactory;
 protected:
 
@@ -359,6 +375,9 @@ protected:
   
   /// If client is HTTPS, self-redirect with HTTP+token
   static bool selfhttps2http;
+
+  /// If true, try to hand the TLS session keys to the kernel after the handshake
+  static bool usektls;
   
   /// If true, use the embedded css and icons
   static bool embeddedstatic;
@@ -40,6 +40,7 @@
 #include "XrdHttpReq.hh"
 #include "XrdHttpTrace.hh"
 #include "XrdHttpExtHandler.hh"
+#include <limits.h>
 #include <string.h>
 #include <arpa/inet.h>
 #include <sstream>
@@ -58,6 +59,8 @@
 
 #include "XrdHttpUtils.hh"
 
+#include <openssl/rand.h>
+
 #include "XrdHttpStatic.hh"
 
 #define MAX_TK_LEN      256
@@ -333,29 +336,25 @@ int XrdHttpReq::parseRWOp(char *str) {
   }
 
 
-  // This can be largely optimized
   if (ok) {
 
-    kXR_int32 len_ok = 0;
-    long long sz = o1.byteend - o1.bytestart + 1;
-    kXR_int32 newlen = sz;
-
-    if (filesize > 0)
-      newlen = (kXR_int32) min(filesize - o1.bytestart, sz);
-
-    rwOps.push_back(o1);
-
-    while (len_ok < newlen) {
-      ReadWriteOp nfo;
-      int len = min(newlen - len_ok, READV_MAXCHUNKSIZE);
-
-      nfo.bytestart = o1.bytestart + len_ok;
-      nfo.byteend = nfo.bytestart + len - 1;
-      len_ok += len;
-      rwOps_split.push_back(nfo);
+    // A range that overlaps or touches the previous one is merged into it,
+    // so that the response has fewer parts and the readv fewer segments.
+    // The order in which the client listed the ranges is kept.
+    if (!rwOps.empty() && (o1.bytestart <= rwOps.back().byteend + 1) &&
+        (o1.byteend + 1 >= rwOps.back().bytestart)) {
+      ReadWriteOp &prev = rwOps.back();
+
+      length -= rangeLength(prev);
+      prev.bytestart = min(prev.bytestart, o1.bytestart);
+      prev.byteend = max(prev.byteend, o1.byteend);
+      length += rangeLength(prev);
+    } else {
+      rwOps.push_back(o1);
+      length += rangeLength(o1);
     }
-    length += len_ok;
 
+    // The split into readv segments is done when the file size is known
 
   }
 
@@ -487,29 +486,50 @@ void XrdHttpReq::clientUnMarshallReadAheadList(int nitems) {
   }
 }
 
+long long XrdHttpReq::rangeLength(const ReadWriteOp &op) {
+  long long sz = op.byteend - op.bytestart + 1;
+
+  if (filesize > 0)
+    sz = min(filesize - op.bytestart, sz);
+
+  return sz;
+}
+
 int XrdHttpReq::ReqReadV() {
 
+  // The first time, chunk the ranges respecting the xrootd max sizes.
+  // We can suppose that we know the length of the file, and the ranges
+  // that were out of boundary have already been sorted out
+  if (!rwOpSplitDone) {
+    rwOpPartialDone = 0;
+    rwOps_split.clear();
 
-  kXR_int64 total_len = 0;
-  rwOpPartialDone = 0;
-  // Now we build the protocol-ready read ahead list
-  //  and also put the correct placeholders inside the cache
-  int n = rwOps_split.size();
-  if (!ralist) ralist = (readahead_list *) malloc(n * sizeof (readahead_list));
+    for (size_t i = 0; i < rwOps.size(); i++) {
+      long long end = min(rwOps[i].byteend, filesize - 1);
 
-  int j = 0;
-  for (int i = 0; i < n; i++) {
+      for (long long offs = rwOps[i].bytestart; offs <= end; offs += READV_MAXCHUNKSIZE) {
+        ReadWriteOp nfo;
 
-    // We can suppose that we know the length of the file
-    // Hence we can sort out requests that are out of boundary or trim them
-    if (rwOps_split[i].bytestart > filesize) continue;
-    if (rwOps_split[i].byteend > filesize - 1) rwOps_split[i].byteend = filesize - 1;
+        nfo.bytestart = offs;
+        nfo.byteend = min(offs + READV_MAXCHUNKSIZE - 1, end);
+        rwOps_split.push_back(nfo);
+      }
+    }
+  }
+
+  // Now we build the protocol-ready read ahead list for the next batch.
+  // A request with many ranges needs several kXR_readv, which are issued
+  // one after the other
+  if (!ralist) ralist = (readahead_list *) malloc(READV_MAXCHUNKS * sizeof (readahead_list));
+
+  int j = 0;
+  while ((j < READV_MAXCHUNKS) && (rwOpSplitDone < rwOps_split.size())) {
+    ReadWriteOp &nfo = rwOps_split[rwOpSplitDone++];
 
     memcpy(&(ralist[j].fhandle), this->fhandle, 4);
 
-    ralist[j].offset = rwOps_split[i].bytestart;
-    ralist[j].rlen = rwOps_split[i].byteend - rwOps_split[i].bytestart + 1;
-    total_len += ralist[j].rlen;
+    ralist[j].offset = nfo.bytestart;
+    ralist[j].rlen = nfo.byteend - nfo.bytestart + 1;
     j++;
   }
 
@@ -1194,10 +1214,10 @@ int XrdHttpReq::ProcessHTTPReq() {
         default: // Read() or Close()
         {
 
-          if ( ((reqstate == 3 || (!m_req_digest.empty() && (reqstate == 4))) && (rwOps.size() > 1)) ||
+          if ( ((rwOps.size() > 1) && rwOpSplitDone && (rwOpSplitDone >= rwOps_split.size())) ||
             (writtenbytes >= length) ) {
 
-            // Close() if this was a readv or we have finished, otherwise read the next chunk
+            // Close() if this was the last readv or we have finished, otherwise read the next chunk
 
             // --------- CLOSE
 
@@ -1239,7 +1259,8 @@ int XrdHttpReq::ProcessHTTPReq() {
               xrdreq.read.rlen = htonl(l);
             }
 
-            if (prot->ishttps) {
+            // With kTLS the kernel encrypts what sendfile() pushes out
+            if (prot->ishttps && !prot->ktlssend) {
               if (!prot->Bridge->setSF((kXR_char *) fhandle, false)) {
                 TRACE(REQ, " XrdBridge::SetSF(false) failed.");
 
@@ -1276,6 +1297,11 @@ int XrdHttpReq::ProcessHTTPReq() {
 
             length = ReqReadV();
 
+            if (!length) {
+              TRACE(ALL, " No segments to read.");
+              return -1;
+            }
+
             if (!prot->Bridge->Run((char *) &xrdreq, (char *) ralist, length)) {
               prot->SendSimpleResp(404, NULL, NULL, (char *) "Could not run read request.", 0, false);
               return -1;
@@ -2093,6 +2119,26 @@ int XrdHttpReq::PostProcessHTTPReq(bool final_) {
                   TRACEI(ALL, "GET returned no STAT information. Internal error?");
               }
               
+              // The ranges that start past the end of the file are not
+              // satisfiable and are left out, the others are clipped to it.
+              // This must happen before deciding how to reply, a single
+              // remaining range is then sent as a plain partial response
+              if (!rwOps.empty()) {
+                size_t n = 0;
+                for (size_t i = 0; i < rwOps.size(); i++)
+                  if (rwOps[i].bytestart < filesize) {
+                    if (rwOps[i].byteend > filesize - 1)
+                      rwOps[i].byteend = filesize - 1;
+                    rwOps[n++] = rwOps[i];
+                  }
+                rwOps.resize(n);
+
+                if (rwOps.empty()) {
+                  prot->SendSimpleResp(416, NULL, NULL, (char *) "None of the requested ranges is satisfiable", 0, false);
+                  return -1;
+                }
+              }
+
               if (rwOps.size() == 0) {
                 // Full file.
                 
@@ -2116,23 +2162,32 @@ int XrdHttpReq::PostProcessHTTPReq(bool final_) {
                 return 0;
               } else
                 if (rwOps.size() > 1) {
-                // Multiple reads to perform, compose and send the header
-                int cnt = 0;
-                for (size_t i = 0; i < rwOps.size(); i++) {
+                // Multiple reads to perform. Each response gets its own
+                // boundary, so that it is unlikely to appear in the data
+                unsigned char rnd[12];
+                char bnd[sizeof(rnd)*2+1];
+                if (RAND_bytes(rnd, sizeof(rnd)) != 1) {
+                  unsigned long long r = ((unsigned long long)time(0) << 32) ^ (unsigned long long)(size_t)this;
+                  memcpy(rnd, &r, sizeof(r));
+                  memcpy(rnd+sizeof(r), &r, sizeof(rnd)-sizeof(r));
+                }
+                for (size_t i = 0; i < sizeof(rnd); i++)
+                  sprintf(bnd+2*i, "%02x", rnd[i]);
+                mpBoundary = bnd;
 
-                  if (rwOps[i].bytestart > filesize) continue;
-                  if (rwOps[i].byteend > filesize - 1)
-                    rwOps[i].byteend = filesize - 1;
+                // Compose and send the header
+                long long cnt = 0;
+                for (size_t i = 0; i < rwOps.size(); i++) {
 
                   cnt += (rwOps[i].byteend - rwOps[i].bytestart + 1);
 
                   cnt += buildPartialHdr(rwOps[i].bytestart,
                           rwOps[i].byteend,
                           filesize,
-                          (char *) "123456").size();
+                          (char *) mpBoundary.c_str()).size();
                 }
-                cnt += buildPartialHdrEnd((char *) "123456").size();
-                std::string header = "Content-Type: multipart/byteranges; boundary=123456";
+                cnt += buildPartialHdrEnd((char *) mpBoundary.c_str()).size();
+                std::string header = "Content-Type: multipart/byteranges; boundary=" + mpBoundary;
                 if (!m_digest_header.empty()) {
                   header += "\n";
                   header += m_digest_header;
@@ -2166,9 +2221,6 @@ int XrdHttpReq::PostProcessHTTPReq(bool final_) {
             // Nothing to do if we are postprocessing a close
             if (ntohs(xrdreq.header.requestid) == kXR_close) return keepalive ? 1 : -1;
             
-            // Close() if this was the third state of a readv, otherwise read the next chunk
-            if ((reqstate == 3) && (ntohs(xrdreq.header.requestid) == kXR_readv)) return keepalive ? 1: -1;
-
             // Prevent scenario where data is expected but none is actually read
             // E.g. Accessing files which return the results of a script
             if ((ntohs(xrdreq.header.requestid) == kXR_read) &&
@@ -2183,10 +2235,16 @@ int XrdHttpReq::PostProcessHTTPReq(bool final_) {
 
             TRACEI(REQ, "Got data vectors to send:" << iovN);
             if (ntohs(xrdreq.header.requestid) == kXR_readv) {
-              // Readv case, we must take out each individual header and format it according to the http rules
+              // Readv case, we must take out each individual header and format it according to the http rules.
+              // The part headers and the data are gathered and sent with as few writes as possible;
+              // the data is never copied
               readahead_list *l;
               char *p;
               int len;
+              struct iovec v;
+
+              mpHeaders.clear();
+              mpIov.clear();
 
               // Cycle on all the data that is coming from the server
               for (int i = 0; i < iovN; i++) {
@@ -2198,17 +2256,24 @@ int XrdHttpReq::PostProcessHTTPReq(bool final_) {
                   // Now we have a chunk coming from the server. This may be a partial chunk
 
                   if (rwOpPartialDone == 0) {
-                    string s = buildPartialHdr(rwOps[rwOpDone].bytestart,
+                    size_t hlen = mpHeaders.size();
+                    mpHeaders += buildPartialHdr(rwOps[rwOpDone].bytestart,
                             rwOps[rwOpDone].byteend,
                             filesize,
-                            (char *) "123456");
+                            (char *) mpBoundary.c_str());
 
                     TRACEI(REQ, "Sending multipart: " << rwOps[rwOpDone].bytestart << "-" << rwOps[rwOpDone].byteend);
-                    if (prot->SendData((char *) s.c_str(), s.size())) return -1;
+
+                    // The header text may still move, we point to it later
+                    v.iov_base = 0;
+                    v.iov_len = mpHeaders.size() - hlen;
+                    mpIov.push_back(v);
                   }
 
                   // Send all the data we have
-                  if (prot->SendData(p + sizeof (readahead_list), len)) return -1;
+                  v.iov_base = p + sizeof (readahead_list);
+                  v.iov_len = len;
+                  mpIov.push_back(v);
 
                   // If we sent all the data relative to the current original chunk request
                   // then pass to the next chunk, otherwise wait for more data
@@ -2225,8 +2290,25 @@ int XrdHttpReq::PostProcessHTTPReq(bool final_) {
               }
 
               if (rwOpDone == rwOps.size()) {
-                string s = buildPartialHdrEnd((char *) "123456");
-                if (prot->SendData((char *) s.c_str(), s.size())) return -1;
+                size_t hlen = mpHeaders.size();
+                mpHeaders += buildPartialHdrEnd((char *) mpBoundary.c_str());
+                v.iov_base = 0;
+                v.iov_len = mpHeaders.size() - hlen;
+                mpIov.push_back(v);
+              }
+
+              // Now that the headers are all there, fill in their addresses
+              char *hp = (char *) mpHeaders.c_str();
+              for (size_t i = 0; i < mpIov.size(); i++) {
+                if (!mpIov[i].iov_base) {
+                  mpIov[i].iov_base = hp;
+                  hp += mpIov[i].iov_len;
+                }
+              }
+
+              for (size_t i = 0; i < mpIov.size(); i += IOV_MAX) {
+                int n = (int) min(mpIov.size() - i, (size_t) IOV_MAX);
+                if (prot->SendData(&mpIov[i], n, 0)) return -1;
               }
 
             } else
@@ -2637,8 +2719,10 @@ void XrdHttpReq::reset() {
   //if (xmlbody) xmlFreeDoc(xmlbody);
   rwOps.clear();
   rwOps_split.clear();
+  rwOpSplitDone = 0;
   rwOpDone = 0;
   rwOpPartialDone = 0;
+  mpBoundary.clear();
   writtenbytes = 0;
   etext.clear();
   redirdest = "";
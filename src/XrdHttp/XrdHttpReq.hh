@@ -141,10 +141,14 @@ public:
   /// Parse the body of a request, assuming that it's XML and that it's entirely in memory
   int parseBody(char *body, long long len);
 
-  /// Prepare the buffers for sending a readv request
+  /// Prepare the buffers for sending the next readv request, that is the next
+  /// batch of at most READV_MAXCHUNKS segments. Returns the size of the list
   int ReqReadV();
   readahead_list *ralist;
 
+  /// Length of a requested range, trimmed to the file size if known
+  long long rangeLength(const ReadWriteOp &op);
+
   /// Build a partial header for a multipart response
   std::string buildPartialHdr(long long bytestart, long long byteend, long long filesize, char *token);
 
@@ -204,6 +208,8 @@ public:
   /// The new list got from chunking the original req respecting the xrootd
   /// max sizes etc.
   std::vector<ReadWriteOp> rwOps_split;
+  /// How many elements of rwOps_split have already been requested
+  unsigned int rwOpSplitDone;
 
   bool keepalive;
   long long length;  // Total size from client for PUT; total length of response TO client for GET.
@@ -235,6 +241,14 @@ public:
   /// To coordinate multipart responses across multiple calls
   unsigned int rwOpDone, rwOpPartialDone;
 
+  /// Scratch areas used to send the parts of a multipart response with
+  /// a gather write, pointing directly to the data returned by the bridge
+  std::string mpHeaders;
+  std::vector<struct iovec> mpIov;
+
+  /// The boundary separating the parts of a multipart response
+  std::string mpBoundary;
+
   /// The last issued xrd request, often pending
   ClientRequest xrdreq;
 
@@ -1,4 +1,5 @@
 
+#include <cstring>
 #include <stdexcept>
 #include <sstream>
 
@@ -11,18 +12,22 @@
 
 #include "XrdMacaroonsHandler.hh"
 #include "XrdMacaroonsAuthz.hh"
+#include "XrdMacaroonsCache.hh"
 
 using namespace Macaroons;
 
 
 namespace {
 
-class AuthzCheck
+// Collects the caveats of a macaroon while its signature is verified.  Only
+// the request-independent checks are done here; the result is cached and
+// matched against each request by AuthzCheck.
+class CaveatParser
 {
 public:
-    AuthzCheck(const char *req_path, const Access_Operation req_oper, ssize_t m_max_duration, XrdSysError &log);
+    CaveatParser(ssize_t max_duration, time_t now, XrdSysError &log);
 
-    const std::string &GetSecName() const {return m_sec_name;}
+    TokenInfo &GetInfo() {return m_info;}
 
     static int verify_before_s(void *authz_ptr,
                                const unsigned char *pred,
@@ -47,12 +52,28 @@ private:
     int verify_name(const unsigned char *pred, size_t pred_sz);
 
     ssize_t m_max_duration;
+    XrdSysError &m_log;
+    time_t m_now;
+    TokenInfo m_info;
+};
+
+
+// Checks a request against the caveats of a verified macaroon.
+class AuthzCheck
+{
+public:
+    AuthzCheck(const char *req_path, const Access_Operation req_oper, XrdSysError &log);
+
+    bool Check(const TokenInfo &info, time_t now);
+
+private:
+    bool check_activity(const std::vector<std::string> &activities);
+    bool check_path(const std::string &prefix);
+
     XrdSysError &m_log;
     const std::string m_path;
     std::string m_desired_activity;
-    std::string m_sec_name;
     Access_Operation m_oper;
-    time_t m_now;
 };
 
 
@@ -112,11 +133,18 @@ Authz::Authz(XrdSysLogger *log, char const *config, XrdAccAuthorize *chain)
     m_authz_behavior(static_cast<int>(Handler::AuthzBehavior::PASSTHROUGH))
 {
     Handler::AuthzBehavior behavior(Handler::AuthzBehavior::PASSTHROUGH);
-    if (!Handler::Config(config, nullptr, &m_log, m_location, m_secret, m_max_duration, behavior))
+    ssize_t token_cache;
+    if (!Handler::Config(config, nullptr, &m_log, m_location, m_secret, m_max_duration, behavior, token_cache))
     {
         throw std::runtime_error("Macaroon authorization config failed.");
     }
     m_authz_behavior = static_cast<int>(behavior);
+    if (token_cache > 0) {m_cache.reset(new TokenCache(token_cache, m_log));}
+}
+
+
+Authz::~Authz()
+{
 }
 
 
@@ -136,58 +164,51 @@ Authz::OnMissing(const XrdSecEntity *Entity, const char *path,
     return XrdAccPriv_None;
 }
 
-XrdAccPrivs
-Authz::Access(const XrdSecEntity *Entity, const char *path,
-              const Access_Operation oper, XrdOucEnv *env)
+TokenInfoPtr
+Authz::Verify(const XrdSecEntity *Entity, const char *path,
+              const Access_Operation oper, XrdOucEnv *env,
+              const char *token, time_t now, XrdAccPrivs &privs)
 {
-    const char *authz = env ? env->Get("authz") : nullptr;
-    // We don't allow any testing to occur in this authz module, preventing
-    // a macaroon to be used to receive further macaroons.
-    if (oper == AOP_Any)
-    {
-        return m_chain ? m_chain->Access(Entity, path, oper, env) : XrdAccPriv_None;
-    }
-    if (!authz || strncmp(authz, "Bearer%20", 9))
-    {
-        //m_log.Emsg("Access", "No bearer token present");
-        return OnMissing(Entity, path, oper, env);
-    }
-    authz += 9;
+    privs = XrdAccPriv_None;
 
     macaroon_returncode mac_err = MACAROON_SUCCESS;
     struct macaroon* macaroon = macaroon_deserialize(
-        authz,
+        token,
         &mac_err);
     if (!macaroon)
     {
         // Do not log - might be other token type!
         //m_log.Emsg("Access", "Failed to parse the macaroon");
-        return OnMissing(Entity, path, oper, env);
+        privs = OnMissing(Entity, path, oper, env);
+        return TokenInfoPtr();
     }
 
     struct macaroon_verifier *verifier = macaroon_verifier_create();
     if (!verifier)
     {
         m_log.Emsg("Access", "Failed to create a new macaroon verifier");
-        return XrdAccPriv_None;
+        macaroon_destroy(macaroon);
+        return TokenInfoPtr();
     }
     if (!path)
     {
         m_log.Emsg("Access", "Request with no provided path.");
         macaroon_verifier_destroy(verifier);
-        return XrdAccPriv_None;
+        macaroon_destroy(macaroon);
+        return TokenInfoPtr();
     }
 
-    AuthzCheck check_helper(path, oper, m_max_duration, m_log);
+    CaveatParser parser(m_max_duration, now, m_log);
 
-    if (macaroon_verifier_satisfy_general(verifier, AuthzCheck::verify_before_s, &check_helper, &mac_err) ||
-        macaroon_verifier_satisfy_general(verifier, AuthzCheck::verify_activity_s, &check_helper, &mac_err) ||
-        macaroon_verifier_satisfy_general(verifier, AuthzCheck::verify_name_s, &check_helper, &mac_err) ||
-        macaroon_verifier_satisfy_general(verifier, AuthzCheck::verify_path_s, &check_helper, &mac_err))
+    if (macaroon_verifier_satisfy_general(verifier, CaveatParser::verify_before_s, &parser, &mac_err) ||
+        macaroon_verifier_satisfy_general(verifier, CaveatParser::verify_activity_s, &parser, &mac_err) ||
+        macaroon_verifier_satisfy_general(verifier, CaveatParser::verify_name_s, &parser, &mac_err) ||
+        macaroon_verifier_satisfy_general(verifier, CaveatParser::verify_path_s, &parser, &mac_err))
     {
         m_log.Emsg("Access", "Failed to configure caveat verifier:");
         macaroon_verifier_destroy(verifier);
-        return XrdAccPriv_None;
+        macaroon_destroy(macaroon);
+        return TokenInfoPtr();
     }
 
     const unsigned char *macaroon_loc;
@@ -198,7 +219,8 @@ Authz::Access(const XrdSecEntity *Entity, const char *path,
         m_log.Emsg("Access", "Macaroon is for incorrect location", reinterpret_cast<const char *>(macaroon_loc));
         macaroon_verifier_destroy(verifier);
         macaroon_destroy(macaroon);
-        return m_chain ? m_chain->Access(Entity, path, oper, env) : XrdAccPriv_None;
+        privs = m_chain ? m_chain->Access(Entity, path, oper, env) : XrdAccPriv_None;
+        return TokenInfoPtr();
     }
 
     if (macaroon_verify(verifier, macaroon,
@@ -210,7 +232,8 @@ Authz::Access(const XrdSecEntity *Entity, const char *path,
         m_log.Log(LogMask::Debug, "Access", "Macaroon verification failed");
         macaroon_verifier_destroy(verifier);
         macaroon_destroy(macaroon);
-        return m_chain ? m_chain->Access(Entity, path, oper, env) : XrdAccPriv_None;
+        privs = m_chain ? m_chain->Access(Entity, path, oper, env) : XrdAccPriv_None;
+        return TokenInfoPtr();
     }
     macaroon_verifier_destroy(verifier);
 
@@ -218,16 +241,69 @@ Authz::Access(const XrdSecEntity *Entity, const char *path,
     size_t id_sz;
     macaroon_identifier(macaroon, &macaroon_id, &id_sz);
 
-    std::string macaroon_id_str(reinterpret_cast<const char *>(macaroon_id), id_sz);
-    m_log.Log(LogMask::Info, "Access", "Macaroon verification successful; ID", macaroon_id_str.c_str());
+    TokenInfo &info = parser.GetInfo();
+    info.m_id.assign(reinterpret_cast<const char *>(macaroon_id), id_sz);
+    m_log.Log(LogMask::Debug, "Access", "Macaroon signature verified; ID", info.m_id.c_str());
     macaroon_destroy(macaroon);
 
+    return std::make_shared<TokenInfo>(std::move(info));
+}
+
+
+XrdAccPrivs
+Authz::Access(const XrdSecEntity *Entity, const char *path,
+              const Access_Operation oper, XrdOucEnv *env)
+{
+    const char *authz = env ? env->Get("authz") : nullptr;
+    // We don't allow any testing to occur in this authz module, preventing
+    // a macaroon to be used to receive further macaroons.
+    if (oper == AOP_Any)
+    {
+        return m_chain ? m_chain->Access(Entity, path, oper, env) : XrdAccPriv_None;
+    }
+    if (!authz || strncmp(authz, "Bearer%20", 9))
+    {
+        //m_log.Emsg("Access", "No bearer token present");
+        return OnMissing(Entity, path, oper, env);
+    }
+    authz += 9;
+
+    // A token seen before only needs its caveats matched against the request;
+    // otherwise do the full parse and signature verification.
+    time_t now = time(NULL);
+    std::string token(authz);
+    TokenInfoPtr info;
+    if (m_cache) {info = m_cache->Get(token, now);}
+    if (info)
+    {
+        m_log.Log(LogMask::Debug, "Access", "Using cached macaroon; ID", info->m_id.c_str());
+        if (!path)
+        {
+            m_log.Emsg("Access", "Request with no provided path.");
+            return XrdAccPriv_None;
+        }
+    }
+    else
+    {
+        XrdAccPrivs privs;
+        if (!(info = Verify(Entity, path, oper, env, token.c_str(), now, privs))) {return privs;}
+        if (m_cache && now < info->m_expiry) {m_cache->Put(token, info);}
+    }
+
+    AuthzCheck check_helper(path, oper, m_log);
+    if (!check_helper.Check(*info, now))
+    {
+        m_log.Log(LogMask::Debug, "Access", "Macaroon verification failed");
+        return m_chain ? m_chain->Access(Entity, path, oper, env) : XrdAccPriv_None;
+    }
+    m_log.Log(LogMask::Info, "Access", "Macaroon verification successful; ID", info->m_id.c_str());
+
     // Copy the name, if present into the macaroon, into the credential object.
-    if (Entity && check_helper.GetSecName().size()) {
-        m_log.Log(LogMask::Debug, "Access", "Setting the security name to", check_helper.GetSecName().c_str());
+    if (Entity && info->m_name.size()) {
+        m_log.Log(LogMask::Debug, "Access", "Setting the security name to", info->m_name.c_str());
         XrdSecEntity &myEntity = *const_cast<XrdSecEntity *>(Entity);
         if (myEntity.name) {free(myEntity.name);}
-        myEntity.name = strdup(check_helper.GetSecName().c_str());
+        myEntity.name = strdup(info->m_name.c_str());
     }
 
     // We passed verification - give the correct privilege.
@@ -235,84 +311,52 @@ Authz::Access(const XrdSecEntity *Entity, const char *path,
 }
 
 
-AuthzCheck::AuthzCheck(const char *req_path, const Access_Operation req_oper, ssize_t max_duration, XrdSysError &log)
+CaveatParser::CaveatParser(ssize_t max_duration, time_t now, XrdSysError &log)
       : m_max_duration(max_duration),
         m_log(log),
-        m_path(req_path),
-        m_oper(req_oper),
-        m_now(time(NULL))
+        m_now(now)
 {
-    switch (m_oper)
-    {
-    case AOP_Any:
-        break;
-    case AOP_Chmod:
-    case AOP_Chown:
-        m_desired_activity = "UPDATE_METADATA";
-        break;
-    case AOP_Insert:
-    case AOP_Lock:
-    case AOP_Mkdir:
-    case AOP_Rename:
-    case AOP_Update:
-        m_desired_activity = "MANAGE";
-        break;
-    case AOP_Create:
-        m_desired_activity = "UPLOAD";
-        break;
-    case AOP_Delete:
-        m_desired_activity = "DELETE";
-        break;
-    case AOP_Read:
-        m_desired_activity = "DOWNLOAD";
-        break;
-    case AOP_Readdir:
-        m_desired_activity = "LIST";
-        break;
-    case AOP_Stat:
-        m_desired_activity = "READ_METADATA";
-    };
 }
 
 
 int
-AuthzCheck::verify_before_s(void *authz_ptr,
-                            const unsigned char *pred,
-                            size_t pred_sz)
+CaveatParser::verify_before_s(void *authz_ptr,
+                              const unsigned char *pred,
+                              size_t pred_sz)
 {
-    return static_cast<AuthzCheck*>(authz_ptr)->verify_before(pred, pred_sz);
+    return static_cast<CaveatParser*>(authz_ptr)->verify_before(pred, pred_sz);
 }
 
 
 int
-AuthzCheck::verify_activity_s(void *authz_ptr,
-                              const unsigned char *pred,
-                              size_t pred_sz)
+CaveatParser::verify_activity_s(void *authz_ptr,
+                                const unsigned char *pred,
+                                size_t pred_sz)
 {
-    return static_cast<AuthzCheck*>(authz_ptr)->verify_activity(pred, pred_sz);
+    return static_cast<CaveatParser*>(authz_ptr)->verify_activity(pred, pred_sz);
 }
 
 
 int
-AuthzCheck::verify_path_s(void *authz_ptr,
-                          const unsigned char *pred,
-                          size_t pred_sz)
+CaveatParser::verify_path_s(void *authz_ptr,
+                            const unsigned char *pred,
+                            size_t pred_sz)
 {
-    return static_cast<AuthzCheck*>(authz_ptr)->verify_path(pred, pred_sz);
+    return static_cast<CaveatParser*>(authz_ptr)->verify_path(pred, pred_sz);
 }
 
 
 int
-AuthzCheck::verify_name_s(void *authz_ptr,
-                          const unsigned char *pred,
-                          size_t pred_sz)
+CaveatParser::verify_name_s(void *authz_ptr,
+                            const unsigned char *pred,
+                            size_t pred_sz)
 {
-    return static_cast<AuthzCheck*>(authz_ptr)->verify_name(pred, pred_sz);
+    return static_cast<CaveatParser*>(authz_ptr)->verify_name(pred, pred_sz);
 }
 
 
 int
-AuthzCheck::verify_before(const unsigned char * pred, size_t pred_sz)
+CaveatParser::verify_before(const unsigned char * pred, size_t pred_sz)
 {
     std::string pred_str(reinterpret_cast<const char *>(pred), pred_sz);
     if (strncmp("before:", pred_str.c_str(), 7))
@@ -322,6 +366,7 @@ AuthzCheck::verify_before(const unsigned char * pred, size_t pred_sz)
     m_log.Log(LogMask::Debug, "AuthzCheck", "running verify before", pred_str.c_str());
 
     struct tm caveat_tm;
+    memset(&caveat_tm, 0, sizeof(caveat_tm));
     if (strptime(&pred_str[7], "%Y-%m-%dT%H:%M:%SZ", &caveat_tm) == nullptr)
     {
         m_log.Log(LogMask::Debug, "AuthzCheck", "failed to parse time string", &pred_str[7]);
@@ -341,54 +386,148 @@ AuthzCheck::verify_before(const unsigned char * pred, size_t pred_sz)
         return 1;
     }
 
-    int result = (m_now >= caveat_time);
-    if (!result) m_log.Log(LogMask::Debug, "AuthzCheck", "verify before successful");
-    else m_log.Log(LogMask::Debug, "AuthzCheck", "verify before failed");
-    return result;
+    // Whether the token has already expired is checked per request.
+    if (caveat_time < m_info.m_expiry) {m_info.m_expiry = caveat_time;}
+    return 0;
 }
 
 
 int
-AuthzCheck::verify_activity(const unsigned char * pred, size_t pred_sz)
+CaveatParser::verify_activity(const unsigned char * pred, size_t pred_sz)
 {
-    if (!m_desired_activity.size()) {return 1;}
     std::string pred_str(reinterpret_cast<const char *>(pred), pred_sz);
     if (strncmp("activity:", pred_str.c_str(), 9)) {return 1;}
     m_log.Log(LogMask::Debug, "AuthzCheck", "running verify activity", pred_str.c_str());
 
+    std::vector<std::string> activities;
     std::stringstream ss(pred_str.substr(9));
     for (std::string activity; std::getline(ss, activity, ','); )
+    {
+        activities.push_back(activity);
+    }
+    m_info.m_activities.push_back(std::move(activities));
+    return 0;
+}
+
+
+int
+CaveatParser::verify_path(const unsigned char * pred, size_t pred_sz)
+{
+    std::string pred_str(reinterpret_cast<const char *>(pred), pred_sz);
+    if (strncmp("path:", pred_str.c_str(), 5)) {return 1;}
+    m_log.Log(LogMask::Debug, "AuthzCheck", "running verify path", pred_str.c_str());
+
+    m_info.m_paths.push_back(pred_str.substr(5));
+    return 0;
+}
+
+
+int
+CaveatParser::verify_name(const unsigned char * pred, size_t pred_sz)
+{
+    std::string pred_str(reinterpret_cast<const char *>(pred), pred_sz);
+    if (strncmp("name:", pred_str.c_str(), 5)) {return 1;}
+    if (pred_str.size() < 6) {return 1;}
+    m_log.Log(LogMask::Debug, "AuthzCheck", "Verifying macaroon with", pred_str.c_str());
+
+    // Make a copy of the name for the XrdSecEntity; this will be used later.
+    m_info.m_name = pred_str.substr(5);
+
+    return 0;
+}
+
+
+AuthzCheck::AuthzCheck(const char *req_path, const Access_Operation req_oper, XrdSysError &log)
+      : m_log(log),
+        m_path(req_path),
+        m_oper(req_oper)
+{
+    switch (m_oper)
+    {
+    case AOP_Any:
+        break;
+    case AOP_Chmod:
+    case AOP_Chown:
+        m_desired_activity = "UPDATE_METADATA";
+        break;
+    case AOP_Insert:
+    case AOP_Lock:
+    case AOP_Mkdir:
+    case AOP_Rename:
+    case AOP_Update:
+        m_desired_activity = "MANAGE";
+        break;
+    case AOP_Create:
+        m_desired_activity = "UPLOAD";
+        break;
+    case AOP_Delete:
+        m_desired_activity = "DELETE";
+        break;
+    case AOP_Read:
+        m_desired_activity = "DOWNLOAD";
+        break;
+    case AOP_Readdir:
+        m_desired_activity = "LIST";
+        break;
+    case AOP_Stat:
+        m_desired_activity = "READ_METADATA";
+    };
+}
+
+
+bool
+AuthzCheck::Check(const TokenInfo &info, time_t now)
+{
+    if (now >= info.m_expiry)
+    {
+        m_log.Log(LogMask::Debug, "AuthzCheck", "verify before failed");
+        return false;
+    }
+    for (const auto &activities : info.m_activities)
+    {
+        if (!check_activity(activities)) {return false;}
+    }
+    for (const auto &prefix : info.m_paths)
+    {
+        if (!check_path(prefix)) {return false;}
+    }
+    return true;
+}
+
+
+bool
+AuthzCheck::check_activity(const std::vector<std::string> &activities)
+{
+    if (!m_desired_activity.size()) {return false;}
+
+    for (const auto &activity : activities)
     {
         // Any allowed activity also implies "READ_METADATA"
-        if (m_desired_activity == "READ_METADATA") {return 0;}
+        if (m_desired_activity == "READ_METADATA") {return true;}
         if (activity == m_desired_activity)
         {
             m_log.Log(LogMask::Debug, "AuthzCheck", "macaroon has desired activity", activity.c_str());
-            return 0;
+            return true;
         }
     }
     m_log.Log(LogMask::Info, "AuthzCheck", "macaroon does NOT have desired activity", m_desired_activity.c_str());
-    return 1;
+    return false;
 }
 
 
-int
-AuthzCheck::verify_path(const unsigned char * pred, size_t pred_sz)
+bool
+AuthzCheck::check_path(const std::string &prefix)
 {
-    std::string pred_str(reinterpret_cast<const char *>(pred), pred_sz);
-    if (strncmp("path:", pred_str.c_str(), 5)) {return 1;}
-    m_log.Log(LogMask::Debug, "AuthzCheck", "running verify path", pred_str.c_str());
-
     if ((m_path.find("/./") != std::string::npos) ||
         (m_path.find("/../") != std::string::npos))
     {
         m_log.Log(LogMask::Info, "AuthzCheck", "invalid requested path", m_path.c_str());
-        return 1;
+        return false;
     }
-    size_t compare_chars = pred_str.size() - 5;
-    if (pred_str[compare_chars + 5 - 1] == '/') {compare_chars--;}
+    size_t compare_chars = prefix.size();
+    if (compare_chars && prefix[compare_chars - 1] == '/') {compare_chars--;}
 
-    int result = strncmp(pred_str.c_str() + 5, m_path.c_str(), compare_chars);
+    int result = strncmp(prefix.c_str(), m_path.c_str(), compare_chars);
     if (!result)
     {
         m_log.Log(LogMask::Debug, "AuthzCheck", "path request verified for", m_path.c_str());
@@ -397,7 +536,7 @@ AuthzCheck::verify_path(const unsigned char * pred, size_t pred_sz)
     // to READ_METADATA for /foo.
     else if (m_oper == AOP_Stat)
     {
-        result = strncmp(m_path.c_str(), pred_str.c_str() + 5, m_path.size());
+        result = strncmp(m_path.c_str(), prefix.c_str(), m_path.size());
         if (!result) {m_log.Log(LogMask::Debug, "AuthzCheck", "READ_METADATA path request verified for", m_path.c_str());}
         else {m_log.Log(LogMask::Debug, "AuthzCheck", "READ_METADATA path request NOT allowed", m_path.c_str());}
     }
@@ -406,20 +545,5 @@ AuthzCheck::verify_path(const unsigned char * pred, size_t pred_sz)
         m_log.Log(LogMask::Debug, "AuthzCheck", "path request NOT allowed", m_path.c_str());
     }
 
-    return result;
-}
-
-
-int
-AuthzCheck::verify_name(const unsigned char * pred, size_t pred_sz)
-{
-    std::string pred_str(reinterpret_cast<const char *>(pred), pred_sz);
-    if (strncmp("name:", pred_str.c_str(), 5)) {return 1;}
-    if (pred_str.size() < 6) {return 1;}
-    m_log.Log(LogMask::Debug, "AuthzCheck", "Verifying macaroon with", pred_str.c_str());
-
-    // Make a copy of the name for the XrdSecEntity; this will be used later.
-    m_sec_name = pred_str.substr(5);
-
-    return 0;
+    return !result;
 }
@@ -1,4 +1,9 @@
 
+#include <memory>
+#include <string>
+
+#include <time.h>
+
 #include "XrdAcc/XrdAccAuthorize.hh"
 #include "XrdSys/XrdSysError.hh"
 
@@ -8,12 +13,15 @@ class XrdSysError;
 namespace Macaroons
 {
 
+struct TokenInfo;
+class TokenCache;
+
 class Authz : public XrdAccAuthorize
 {
 public:
     Authz(XrdSysLogger *lp, const char *parms, XrdAccAuthorize *chain);
 
-    virtual ~Authz() {}
+    virtual ~Authz();
 
     virtual XrdAccPrivs Access(const XrdSecEntity     *Entity,
                                const char             *path,
@@ -39,12 +47,21 @@ private:
                           const Access_Operation  oper,
                                 XrdOucEnv        *env);
 
+    std::shared_ptr<const TokenInfo> Verify(const XrdSecEntity     *Entity,
+                                            const char             *path,
+                                            const Access_Operation  oper,
+                                                  XrdOucEnv        *env,
+                                            const char             *token,
+                                                  time_t            now,
+                                                  XrdAccPrivs      &privs);
+
     ssize_t m_max_duration;
     XrdAccAuthorize *m_chain;
     XrdSysError m_log;
     std::string m_secret;
     std::string m_location;
     int m_authz_behavior;
+    std::unique_ptr<TokenCache> m_cache;
 };
 
 }
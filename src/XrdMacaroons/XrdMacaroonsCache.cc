@@ -0,0 +1,119 @@
+
+#include <functional>
+
+#include <stdio.h>
+
+#include "XrdSys/XrdSysError.hh"
+
+#include "XrdMacaroonsHandler.hh"
+#include "XrdMacaroonsCache.hh"
+
+using namespace Macaroons;
+
+
+TokenCache::TokenCache(size_t max_entries, XrdSysError &log)
+    : m_max_per_shard((max_entries + s_shards - 1) / s_shards),
+    m_log(log),
+    m_hits(0),
+    m_misses(0),
+    m_expired(0),
+    m_evictions(0)
+{
+    if (!m_max_per_shard) {m_max_per_shard = 1;}
+}
+
+
+TokenCache::~TokenCache()
+{
+    Report(m_hits + m_misses);
+}
+
+
+TokenCache::Shard &
+TokenCache::GetShard(const std::string &token)
+{
+    return m_shard[std::hash<std::string>()(token) % s_shards];
+}
+
+
+TokenInfoPtr
+TokenCache::Get(const std::string &token, time_t now)
+{
+    Shard &shard = GetShard(token);
+    TokenInfoPtr info;
+    bool expired = false;
+
+    {
+        XrdSysMutexHelper lock(shard.m_mutex);
+        auto iter = shard.m_map.find(token);
+        if (iter != shard.m_map.end())
+        {
+            if (now >= iter->second.m_info->m_expiry)
+            {
+                shard.m_lru.erase(iter->second.m_lru);
+                shard.m_map.erase(iter);
+                expired = true;
+            }
+            else
+            {
+                shard.m_lru.splice(shard.m_lru.begin(), shard.m_lru, iter->second.m_lru);
+                info = iter->second.m_info;
+            }
+        }
+    }
+
+    if (expired) {m_expired++;}
+    if (info) {m_hits++;}
+    else {m_misses++;}
+    unsigned long long lookups = m_hits + m_misses;
+    if (!(lookups % s_report_interval)) {Report(lookups);}
+    return info;
+}
+
+
+void
+TokenCache::Put(const std::string &token, const TokenInfoPtr &info)
+{
+    Shard &shard = GetShard(token);
+    unsigned evicted = 0;
+
+    {
+        XrdSysMutexHelper lock(shard.m_mutex);
+        auto result = shard.m_map.insert(std::make_pair(token, Entry()));
+        Entry &entry = result.first->second;
+        entry.m_info = info;
+        if (!result.second)
+        {
+            shard.m_lru.splice(shard.m_lru.begin(), shard.m_lru, entry.m_lru);
+            return;
+        }
+        shard.m_lru.push_front(&result.first->first);
+        entry.m_lru = shard.m_lru.begin();
+
+        while (shard.m_map.size() > m_max_per_shard)
+        {
+            auto victim = shard.m_map.find(*shard.m_lru.back());
+            shard.m_lru.pop_back();
+            shard.m_map.erase(victim);
+            evicted++;
+        }
+    }
+
+    if (evicted) {m_evictions += evicted;}
+}
+
+
+void
+TokenCache::Report(unsigned long long lookups)
+{
+    char buff[256];
+    unsigned long long hits = m_hits;
+
+    snprintf(buff, sizeof(buff), "%llu lookups, %llu hits (%.1f%%), %llu misses, "
+             "%llu expired, %llu evicted", lookups, hits,
+             (lookups ? 100.0 * hits / lookups : 0.0),
+             static_cast<unsigned long long>(m_misses),
+             static_cast<unsigned long long>(m_expired),
+             static_cast<unsigned long long>(m_evictions));
+    m_log.Log(LogMask::Info, "TokenCache", buff);
+}
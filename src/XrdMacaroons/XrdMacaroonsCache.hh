@@ -0,0 +1,80 @@
+
+#include <atomic>
+#include <limits>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <time.h>
+
+#include "XrdSys/XrdSysPthread.hh"
+
+class XrdSysError;
+
+namespace Macaroons
+{
+
+// The request-independent content of a macaroon whose signature has been
+// verified: the caveats it carries, already parsed.
+struct TokenInfo
+{
+    TokenInfo() : m_expiry(std::numeric_limits<time_t>::max()) {}
+
+    time_t m_expiry;                                // Earliest 'before' caveat
+    std::vector<std::vector<std::string>> m_activities; // One per caveat
+    std::vector<std::string> m_paths;
+    std::string m_name;
+    std::string m_id;
+};
+
+typedef std::shared_ptr<const TokenInfo> TokenInfoPtr;
+
+// A bounded cache of verified tokens, keyed by the serialized token.  The
+// cache is split into shards, each with its own lock and LRU list, so that
+// concurrent lookups of different tokens rarely contend.
+class TokenCache
+{
+public:
+    TokenCache(size_t max_entries, XrdSysError &log);
+
+    ~TokenCache();
+
+    // Returns the cached information for the token, or an empty pointer if
+    // the token is not cached or has expired as of 'now'.
+    TokenInfoPtr Get(const std::string &token, time_t now);
+
+    void Put(const std::string &token, const TokenInfoPtr &info);
+
+private:
+    static const unsigned s_shards = 16;
+    static const unsigned s_report_interval = 1 << 16;
+
+    struct Entry
+    {
+        TokenInfoPtr m_info;
+        std::list<const std::string *>::iterator m_lru;
+    };
+
+    struct Shard
+    {
+        XrdSysMutex m_mutex;
+        std::unordered_map<std::string, Entry> m_map;
+        std::list<const std::string *> m_lru;       // Most recent first
+    };
+
+    Shard &GetShard(const std::string &token);
+    void Report(unsigned long long lookups);
+
+    size_t m_max_per_shard;
+    XrdSysError &m_log;
+    Shard m_shard[s_shards];
+
+    std::atomic<unsigned long long> m_hits;
+    std::atomic<unsigned long long> m_misses;
+    std::atomic<unsigned long long> m_expired;
+    std::atomic<unsigned long long> m_evictions;
+};
+
+}
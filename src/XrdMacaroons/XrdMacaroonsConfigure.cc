@@ -36,7 +36,7 @@ static bool xonmissing(XrdOucStream &config_obj, XrdSysError *log, Handler::Auth
 
 bool Handler::Config(const char *config, XrdOucEnv *env, XrdSysError *log,
     std::string &location, std::string &secret, ssize_t &max_duration,
-    AuthzBehavior &behavior)
+    AuthzBehavior &behavior, ssize_t &token_cache)
 {
   XrdOucStream config_obj(log, getenv("XRDINSTANCE"), env, "=====> ");
 
@@ -54,6 +54,9 @@ bool Handler::Config(const char *config, XrdOucEnv *env, XrdSysError *log,
   // Set default maximum duration (24 hours).
   max_duration = 24*3600;
 
+  // Set default number of verified tokens to remember.
+  token_cache = 4096;
+
   // Process items
   //
   char *orig_var, *var;
@@ -72,6 +75,7 @@ bool Handler::Config(const char *config, XrdOucEnv *env, XrdSysError *log,
     else if (!strcmp("trace", var)) {success = xtrace(config_obj, log);}
     else if (!strcmp("maxduration", var)) {success = xmaxduration(config_obj, log, max_duration);}
     else if (!strcmp("onmissing", var)) {success = xonmissing(config_obj, log, behavior);}
+    else if (!strcmp("tokencache", var)) {success = xtokencache(config_obj, log, token_cache);}
     else {
         log->Say("Config warning: ignoring unknown directive '", orig_var, "'.");
         config_obj.Echo();
@@ -165,6 +169,26 @@ bool Handler::xmaxduration(XrdOucStream &config_obj, XrdSysError *log, ssize_t &
   return true;
 }
 
+bool Handler::xtokencache(XrdOucStream &config_obj, XrdSysError *log, ssize_t &token_cache)
+{
+  char *val = config_obj.GetWord();
+  if (!val || !val[0])
+  {
+    log->Emsg("Config", "macaroons.tokencache requires a value");
+    return false;
+  }
+  char *endptr = NULL;
+  long long token_cache_parsed = strtoll(val, &endptr, 10);
+  if (endptr == val || *endptr || token_cache_parsed < 0)
+  {
+    log->Emsg("Config", "Unable to parse macaroons.tokencache as a non-negative integer", val);
+    return false;
+  }
+  token_cache = token_cache_parsed;
+
+  return true;
+}
+
 bool Handler::xsitename(XrdOucStream &config_obj, XrdSysError *log, std::string &location)
 {
   char *val = config_obj.GetWord();
@@ -437,6 +437,8 @@ int XrdOfsFile::open(const char          *path,      // In
    static const int opMask = (SFS_O_RDONLY | SFS_O_WRONLY | SFS_O_RDWR);
    static const int fRedir = (XrdOucEI::uUrlOK | XrdOucEI::uMProt);
 
+   XrdOfsStats::Timer opTimer(OfsStats, OfsStats.Data.latOpen);
+
    struct OpenHelper
          {const char   *Path;
           XrdOfsHandle *hP;
@@ -620,10 +622,8 @@ int XrdOfsFile::open(const char          *path,      // In
        FTRACE(open, "attach use=" <<oh->Usage());
        if (oP.poscNum > 0) XrdOfsFS->poscQ->Commit(path, oP.poscNum);
        oP.hP->UnLock(); 
-       OfsStats.sdMutex.Lock();
-       isRW ? OfsStats.Data.numOpenW++ : OfsStats.Data.numOpenR++;
-       if (oP.poscNum > 0) OfsStats.Data.numOpenP++;
-       OfsStats.sdMutex.UnLock();
+       OfsStats.ocAdd(isRW ? OfsStats.Data.numOpenW : OfsStats.Data.numOpenR);
+       if (oP.poscNum > 0) OfsStats.ocAdd(OfsStats.Data.numOpenP);
        return oP.OK();
       }
 
@@ -687,10 +687,8 @@ int XrdOfsFile::open(const char          *path,      // In
 
 // Maintain statistics
 //
-   OfsStats.sdMutex.Lock();
-   isRW ? OfsStats.Data.numOpenW++ : OfsStats.Data.numOpenR++;
-   if (oP.poscNum > 0) OfsStats.Data.numOpenP++;
-   OfsStats.sdMutex.UnLock();
+   OfsStats.ocAdd(isRW ? OfsStats.Data.numOpenW : OfsStats.Data.numOpenR);
+   if (oP.poscNum > 0) OfsStats.ocAdd(OfsStats.Data.numOpenP);
 
 // All done
 //
@@ -717,6 +715,8 @@ int XrdOfsFile::close()  // In
          {public: void Retired(XrdOfsHandle *hP) {XrdOfsFS->Unpersist(hP);}};
    static XrdOfsHanCB *hCB = static_cast<XrdOfsHanCB *>(new CloseFH);
 
+   XrdOfsStats::Timer opTimer(OfsStats, OfsStats.Data.latClose);
+
    XrdOfsHandle *hP;
    int   poscNum, retc, cRetc = 0;
    short theMode;
@@ -744,12 +744,11 @@ int XrdOfsFile::close()  // In
 
 // Maintain statistics
 //
-   OfsStats.sdMutex.Lock();
-   if (!(hP->isRW)) OfsStats.Data.numOpenR--;
-      else {OfsStats.Data.numOpenW--;
-            if (hP->isRW == XrdOfsHandle::opPC) OfsStats.Data.numOpenP--;
+   if (!(hP->isRW)) OfsStats.ocDec(OfsStats.Data.numOpenR);
+      else {OfsStats.ocDec(OfsStats.Data.numOpenW);
+            if (hP->isRW == XrdOfsHandle::opPC)
+               OfsStats.ocDec(OfsStats.Data.numOpenP);
            }
-   OfsStats.sdMutex.UnLock();
 
 // If this file was tagged as a POSC then we need to make sure it will persist
 // Note that we unpersist the file immediately when it's inactive or if no hold
@@ -168,9 +168,10 @@ extern XrdOfsStats OfsStats;
 /*                        S t a t i c   O b j e c t s                         */
 /******************************************************************************/
   
-XrdSysMutex   XrdOfsHandle::myMutex;
-XrdOfsHanTab  XrdOfsHandle::roTable;
-XrdOfsHanTab  XrdOfsHandle::rwTable;
+XrdSysMutex   XrdOfsHandle::myMutex[XrdOfsHandle::hSlots];
+XrdOfsHanTab  XrdOfsHandle::roTable[XrdOfsHandle::hSlots];
+XrdOfsHanTab  XrdOfsHandle::rwTable[XrdOfsHandle::hSlots];
+XrdSysMutex   XrdOfsHandle::freeMutex;
 XrdOssDF     *XrdOfsHandle::ossDF = (XrdOssDF *)new XrdOfsHanOss;
 XrdOfsHandle *XrdOfsHandle::Free = 0;
 
@@ -184,22 +185,23 @@ XrdOfsHandle *XrdOfsHandle::Free = 0;
 int XrdOfsHandle::Alloc(const char *thePath, int Opts, XrdOfsHandle **Handle)
 {
    XrdOfsHandle *hP;
-   XrdOfsHanTab *theTable = (Opts & opRW ? &rwTable : &roTable);
    XrdOfsHanKey theKey(thePath, (int)strlen(thePath));
+   int          hS = hSlot(theKey.Hash);
+   XrdOfsHanTab *theTable = (Opts & opRW ? &rwTable[hS] : &roTable[hS]);
    int          retc;
 
 // Lock the search table and try to find the key. If found, increment the
-// the link count (can only be done with the global lock) then release the
+// the link count (can only be done with the slot lock) then release the
 // lock and try to lock the handle. It can't escape between lock calls because
 // the link count is positive. If we can't lock the handle then it must be the
 // that a long running operation is occuring. Return the handle to its former
 // state and return a delay. Otherwise, return the handle.
 //
-   myMutex.Lock();
+   myMutex[hS].Lock();
    if ((hP = theTable->Find(theKey)))
-      {hP->Path.Links++; myMutex.UnLock();
+      {hP->Path.Links++; myMutex[hS].UnLock();
        if (hP->WaitLock()) {*Handle = hP; return 0;}
-       myMutex.Lock(); hP->Path.Links--; myMutex.UnLock();
+       myMutex[hS].Lock(); hP->Path.Links--; myMutex[hS].UnLock();
        return nolokDelay;
       }
 
@@ -210,7 +212,7 @@ int XrdOfsHandle::Alloc(const char *thePath, int Opts, XrdOfsHandle **Handle)
 
 // All done
 //
-   myMutex.UnLock();
+   myMutex[hS].UnLock();
    return retc;
 }
 
@@ -223,10 +225,10 @@ int XrdOfsHandle::Alloc(XrdOfsHandle **Handle)
     XrdOfsHanKey myKey("dummy", 5);
     int retc;
 
-    myMutex.Lock();
+// Dummy handles never enter a table so no slot lock is needed
+//
     if (!(retc = Alloc(myKey, 0, Handle))) 
        {(*Handle)->Path.Links = 0; (*Handle)->UnLock();}
-    myMutex.UnLock();
     return retc;
 }
 
@@ -241,9 +243,11 @@ int XrdOfsHandle::Alloc(XrdOfsHanKey theKey, int Opts, XrdOfsHandle **Handle)
 
 // No handle currently in the table. Get a new one off the free list
 //
+   freeMutex.Lock();
    if (!Free && (hP = new XrdOfsHandle[minAlloc]))
       {int i = minAlloc; while(i--) {hP->Next = Free; Free = hP; hP++;}}
    if ((hP = Free)) Free = hP->Next;
+   freeMutex.UnLock();
 
 // Initialize the new handle, if we have one, and add it to the table
 //
@@ -271,14 +275,16 @@ void XrdOfsHandle::Hide(const char *thePath)
 {
    XrdOfsHandle *hP;
    XrdOfsHanKey theKey(thePath, (int)strlen(thePath));
+   int          hS = hSlot(theKey.Hash);
 
 // Lock the search table and try to find the key in each table. If found,
-// clear the length field to effectively hide the item.
+// clear the length field to effectively hide the item. The hash is left
+// alone so that the handle stays in the same slot.
 //
-   myMutex.Lock();
-   if ((hP = roTable.Find(theKey))) hP->Path.Len = 0;
-   if ((hP = rwTable.Find(theKey))) hP->Path.Len = 0;
-   myMutex.UnLock();
+   myMutex[hS].Lock();
+   if ((hP = roTable[hS].Find(theKey))) hP->Path.Len = 0;
+   if ((hP = rwTable[hS].Find(theKey))) hP->Path.Len = 0;
+   myMutex[hS].UnLock();
 }
 
 /******************************************************************************/
@@ -297,7 +303,10 @@ int XrdOfsHandle::PoscGet(short &Mode, int Done)
        Mode = Posc->Mode;
        if (Done)
           {pP = Posc; Posc = 0;
-           if (pP->xprP) {myMutex.Lock(); Path.Links--; myMutex.UnLock();}
+           if (pP->xprP)
+              {int hS = hSlot(Path.Hash);
+               myMutex[hS].Lock(); Path.Links--; myMutex[hS].UnLock();
+              }
            pP->Recycle();
           }
        return pnum;
@@ -379,29 +388,31 @@ const char *XrdOfsHandle::PoscUsr()
 int XrdOfsHandle::Retire(int &retc, long long *retsz, char *buff, int blen)
 {
    XrdOssDF *mySSI;
+   int hS = hSlot(Path.Hash);
    int numLeft;
 
-// Get the global lock as the links field can only be manipulated with it.
+// Get the slot lock as the links field can only be manipulated with it.
 // Decrement the links count and if zero, remove it from the table and
 // place it on the free list. Otherwise, it is still in use.
 //
    retc = 0;
-   myMutex.Lock();
+   myMutex[hS].Lock();
    if (Path.Links == 1)
       {if (buff) strlcpy(buff, Path.Val, blen);
        numLeft = 0; OfsStats.Dec(OfsStats.Data.numHandles);
-       if ( (isRW ? rwTable.Remove(this) : roTable.Remove(this)) )
+       if ( (isRW ? rwTable[hS].Remove(this) : roTable[hS].Remove(this)) )
          {if (Posc) {Posc->Recycle(); Posc = 0;}
           if (Path.Val) {free((void *)Path.Val); Path.Val = (char *)"";}
           Path.Len = 0; mySSI = ssi; ssi = ossDF;
-          Next = Free; Free = this; UnLock(); myMutex.UnLock();
+          UnLock(); myMutex[hS].UnLock();
+          freeMutex.Lock(); Next = Free; Free = this; freeMutex.UnLock();
           if (mySSI && mySSI != ossDF)
              {retc = mySSI->Close(retsz); delete mySSI;}
          } else {
-          UnLock(); myMutex.UnLock();
+          UnLock(); myMutex[hS].UnLock();
           OfsEroute.Emsg("Retire", "Lost handle to", buff);
         }
-      } else {numLeft = --Path.Links; UnLock(); myMutex.UnLock();}
+      } else {numLeft = --Path.Links; UnLock(); myMutex[hS].UnLock();}
    return numLeft;
 }
 
@@ -411,19 +422,20 @@ int XrdOfsHandle::Retire(XrdOfsHanCB *cbP, int hTime)
 {
    static int allOK = StartXpr(1);
    XrdOfsHanXpr *xP;
+   int hS = hSlot(Path.Hash);
    int retc;
 
 // The handle can only be held by one reference and only if it's a POSC and
 // defered handling was properly set up.
 //
-   myMutex.Lock();
+   myMutex[hS].Lock();
    if (!Posc || !allOK)
       {OfsEroute.Emsg("Retire", "ignoring deferred retire of", Path.Val);
-       if (Path.Links != 1 || !Posc || !cbP) myMutex.UnLock();
-          else {myMutex.UnLock(); cbP->Retired(this);}
+       if (Path.Links != 1 || !Posc || !cbP) myMutex[hS].UnLock();
+          else {myMutex[hS].UnLock(); cbP->Retired(this);}
        return Retire(retc);
       }
-   myMutex.UnLock();
+   myMutex[hS].UnLock();
 
 // If this object already has an xpr object (happens for bouncing connections)
 // then reuse that object. Otherwise create a new one and put it on the queue.
@@ -445,7 +457,7 @@ int XrdOfsHandle::StartXpr(int Init)
    static int InitDone = 0;
    XrdOfsHanXpr *xP;
    XrdOfsHandle *hP;
-   int retc;
+   int hS, retc;
 
 // If this is the initial all and we have not been initialized do so
 //
@@ -475,14 +487,15 @@ do{xP = XrdOfsHanXpr::Get(); hP = xP->Handle;
             hP->UnLock(); delete xP; continue;
            }
 
-// As the handle is locked we can get the global handle lock to prevent
-// additions and removals of handles as we need a stable reference count to
-// effect the callout, if any. Do so only if the reference count is one (for us)
-// and the handle is active. In all cases, drop the global lock.
+// As the handle is locked we can get the slot lock to prevent additions and
+// removals of handles as we need a stable reference count to effect the
+// callout, if any. Do so only if the reference count is one (for us) and the
+// handle is active. In all cases, drop the slot lock.
 //
-   myMutex.Lock();
-   if (hP->Path.Links != 1 || !xP->Call) myMutex.UnLock();
-      else {myMutex.UnLock();
+   hS = hSlot(hP->Path.Hash);
+   myMutex[hS].Lock();
+   if (hP->Path.Links != 1 || !xP->Call) myMutex[hS].UnLock();
+      else {myMutex[hS].UnLock();
             xP->Call->Retired(hP);
            }
 
@@ -562,6 +575,9 @@ void XrdOfsHanPsc::Recycle()
   
 XrdOfsHanTab::XrdOfsHanTab(int psize, int csize)
 {
+     oldtable      = 0;
+     oldtablesize  = 0;
+     oldnext       = 0;
      prevtablesize = psize;
      nashtablesize = csize;
      Threshold     = (csize * LoadMax) / 100;
@@ -579,11 +595,13 @@ void XrdOfsHanTab::Add(XrdOfsHandle *hip)
 {
    unsigned int kent;
 
-// Check if we should expand the table
+// Check if we should expand the table. Otherwise, move along any ongoing
+// expansion by a few buckets.
 //
    if (++nashnum > Threshold) Expand();
+      else if (oldtable) Migrate(MoveMax);
 
-// Add the entry to the table
+// Add the entry to the table (new entries always go into the new table)
 //
    kent = hip->Path.Hash % nashtablesize;
    hip->Next = nashtable[kent];
@@ -596,9 +614,14 @@ void XrdOfsHanTab::Add(XrdOfsHandle *hip)
   
 void XrdOfsHanTab::Expand()
 {
-   int newsize, newent, i;
+   int newsize;
    size_t memlen;
-   XrdOfsHandle **newtab, *nip, *nextnip;
+   XrdOfsHandle **newtab;
+
+// If a previous expansion is still being drained, finish it now. This only
+// happens when the table grows very quickly.
+//
+   if (oldtable) Migrate(oldtablesize);
 
 // Compute new size for table using a fibonacci series
 //
@@ -610,22 +633,13 @@ void XrdOfsHanTab::Expand()
    if (!(newtab = (XrdOfsHandle **) malloc(memlen))) return;
    memset((void *)newtab, 0, memlen);
 
-// Redistribute all of the current items
+// Plug in the new table. The current items are redistributed a few buckets
+// at a time by subsequent operations so that no single caller pays for
+// rehashing the whole table while holding the slot lock.
 //
-   for (i = 0; i < nashtablesize; i++)
-       {nip = nashtable[i];
-        while(nip)
-             {nextnip = nip->Next;
-              newent  = nip->Path.Hash % newsize;
-              nip->Next = newtab[newent];
-              newtab[newent] = nip;
-              nip = nextnip;
-             }
-       }
-
-// Free the old table and plug in the new table
-//
-   free((void *)nashtable);
+   oldtable      = nashtable;
+   oldtablesize  = nashtablesize;
+   oldnext       = 0;
    nashtable     = newtab;
    prevtablesize = nashtablesize;
    nashtablesize = newsize;
@@ -644,6 +658,10 @@ XrdOfsHandle *XrdOfsHanTab::Find(XrdOfsHanKey &Key)
   XrdOfsHandle *nip;
   unsigned int kent;
 
+// Move along any ongoing expansion
+//
+   if (oldtable) Migrate(MoveMax);
+
 // Compute position of the hash table entry
 //
    kent = Key.Hash%nashtablesize;
@@ -652,32 +670,79 @@ XrdOfsHandle *XrdOfsHanTab::Find(XrdOfsHanKey &Key)
 //
    nip = nashtable[kent];
    while(nip && nip->Path != Key) nip = nip->Next;
+
+// If not found, it may still be in the table being drained
+//
+   if (!nip && oldtable)
+      {nip = oldtable[Key.Hash%oldtablesize];
+       while(nip && nip->Path != Key) nip = nip->Next;
+      }
    return nip;
 }
 
+/******************************************************************************/
+/* private                       M i g r a t e                                */
+/******************************************************************************/
+  
+void XrdOfsHanTab::Migrate(int Count)
+{
+   XrdOfsHandle *nip, *nextnip;
+   int newent;
+
+// Move the requested number of buckets from the old table to the new one
+//
+   while(Count-- && oldnext < oldtablesize)
+        {nip = oldtable[oldnext];
+         oldtable[oldnext++] = 0;
+         while(nip)
+              {nextnip = nip->Next;
+               newent  = nip->Path.Hash % nashtablesize;
+               nip->Next = nashtable[newent];
+               nashtable[newent] = nip;
+               nip = nextnip;
+              }
+        }
+
+// Free the old table once it has been drained
+//
+   if (oldnext >= oldtablesize)
+      {free((void *)oldtable);
+       oldtable = 0; oldtablesize = 0; oldnext = 0;
+      }
+}
+
 /******************************************************************************/
 /* public                         R e m o v e                                 */
 /******************************************************************************/
   
 int XrdOfsHanTab::Remove(XrdOfsHandle *rip)
 {
-   XrdOfsHandle *nip, *pip = 0;
+   XrdOfsHandle *nip, *pip = 0, **theTab = nashtable;
    unsigned int kent;
 
+// Move along any ongoing expansion
+//
+   if (oldtable) Migrate(MoveMax);
+
 // Compute position of the hash table entry
 //
    kent = rip->Path.Hash%nashtablesize;
 
-// Find the entry
+// Find the entry, looking in the table being drained if need be
 //
    nip = nashtable[kent];
    while(nip && nip != rip) {pip = nip; nip = nip->Next;}
+   if (!nip && oldtable)
+      {theTab = oldtable; kent = rip->Path.Hash%oldtablesize; pip = 0;
+       nip = oldtable[kent];
+       while(nip && nip != rip) {pip = nip; nip = nip->Next;}
+      }
 
 // Remove if found
 //
    if (nip)
       {if (pip) pip->Next = nip->Next;
-          else nashtable[kent] = nip->Next;
+          else theTab[kent] = nip->Next;
        nashnum--;
       }
    return nip != 0;
@@ -96,18 +96,24 @@ int            Remove(XrdOfsHandle *rip);
 
 // When allocateing a new nash, specify the required starting size. Make
 // sure that the previous number is the correct Fibonocci antecedent. The
-// series is simply n[j] = n[j-1] + n[j-2].
+// series is simply n[j] = n[j-1] + n[j-2]. Tables are kept per lock slot so
+// the starting size is small.
 //
-    XrdOfsHanTab(int psize = 987, int size = 1597);
+    XrdOfsHanTab(int psize = 34, int size = 55);
    ~XrdOfsHanTab() {} // Never gets deleted
 
 private:
 
 static const int LoadMax = 80;
+static const int MoveMax =  8; // Old buckets moved per table operation
 
 void             Expand();
+void             Migrate(int Count);
 
 XrdOfsHandle   **nashtable;
+XrdOfsHandle   **oldtable;      // Table being drained after an Expand()
+int              oldtablesize;
+int              oldnext;       // Next oldtable bucket to be moved
 int              prevtablesize;
 int              nashtablesize;
 int              nashnum;
@@ -180,11 +186,21 @@ static const int     LockWait  = 333; // Mills to wait between tries
 static const int     nolokDelay=   3; // Secs to delay client when lock failed
 static const int     nomemDelay=  15; // Secs to delay client when ENOMEM
 
-static XrdSysMutex   myMutex;
-static XrdOfsHanTab  roTable;    // File handles open r/o
-static XrdOfsHanTab  rwTable;    // File Handles open r/w
-static XrdOssDF     *ossDF;      // Dummy storage sysem
-static XrdOfsHandle *Free;       // List of free handles
+// The handle tables are split into slots by the high order bits of the path
+// hash. Each slot has its own lock which covers both tables in the slot as
+// well as the link count of every handle in them.
+//
+static const int     hSlotBits = 6;
+static const int     hSlots    = 1 << hSlotBits;
+
+static inline int    hSlot(unsigned int hVal) {return hVal >> (32-hSlotBits);}
+
+static XrdSysMutex   myMutex[hSlots];
+static XrdOfsHanTab  roTable[hSlots]; // File handles open r/o
+static XrdOfsHanTab  rwTable[hSlots]; // File Handles open r/w
+static XrdSysMutex   freeMutex;       // Protects the free list
+static XrdOssDF     *ossDF;           // Dummy storage sysem
+static XrdOfsHandle *Free;            // List of free handles
 
        XrdSysMutex   hMutex;
        XrdOssDF     *ssi;        // Storage System Interface
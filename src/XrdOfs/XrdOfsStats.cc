@@ -42,8 +42,10 @@ int XrdOfsStats::Report(char *buff, int blen)
            "<rdr>%d</rdr><bxq>%d</bxq><rep>%d</rep><err>%d</err><dly>%d</dly>"
            "<sok>%d</sok><ser>%d</ser>"
            "<tpc><grnt>%d</grnt><deny>%d</deny><err>%d</err><exp>%d</exp></tpc>"
+           "<lat><opn><n>%lld</n><us>%lld</us><max>%lld</max></opn>"
+                "<cls><n>%lld</n><us>%lld</us><max>%lld</max></cls></lat>"
            "</stats>";
-    static const int  statsz = sizeof(stats1) + (12*10) + 64;
+    static const int  statsz = sizeof(stats1) + (16*10) + (6*20) + 64;
 
     StatsData myData;
 
@@ -69,5 +71,9 @@ int XrdOfsStats::Report(char *buff, int blen)
                     myData.numErrors,   myData.numDelays,
                     myData.numSeventOK, myData.numSeventER,
                     myData.numTPCgrant, myData.numTPCdeny,
-                    myData.numTPCerrs,  myData.numTPCexpr);
+                    myData.numTPCerrs,  myData.numTPCexpr,
+                    myData.latOpen.Count,  myData.latOpen.Total,
+                    myData.latOpen.Max,
+                    myData.latClose.Count, myData.latClose.Total,
+                    myData.latClose.Max);
 }
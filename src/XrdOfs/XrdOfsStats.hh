@@ -30,13 +30,22 @@
 /******************************************************************************/
 
 #include <stdlib.h>
+#include <time.h>
 
+#include "XrdSys/XrdSysAtomics.hh"
 #include "XrdSys/XrdSysPthread.hh"
 
 class XrdOfsStats
 {
 public:
 
+struct      LatData
+{
+long long   Count;      // Number of timed operations
+long long   Total;      // Total elapsed time in microseconds
+long long   Max;        // Longest single operation in microseconds
+};
+
 struct      StatsData
 {
 int         numOpenR;   // Read
@@ -55,6 +64,8 @@ int         numTPCgrant;
 int         numTPCdeny;
 int         numTPCerrs;
 int         numTPCexpr;
+LatData     latOpen;    // open()  latency
+LatData     latClose;   // close() latency
 }           Data;
 
 XrdSysMutex sdMutex;
@@ -63,6 +74,45 @@ inline void Add(int &Cntr) {sdMutex.Lock(); Cntr++; sdMutex.UnLock();}
 
 inline void Dec(int &Cntr) {sdMutex.Lock(); Cntr--; sdMutex.UnLock();}
 
+// The open file counts and the latencies change on every open and close. They
+// are updated without sdMutex when atomics are available and must only be
+// changed using the methods below.
+//
+inline void ocAdd(int &Cntr) {AtomicBeg(sdMutex); AtomicInc(Cntr); AtomicEnd(sdMutex);}
+
+inline void ocDec(int &Cntr) {AtomicBeg(sdMutex); AtomicDec(Cntr); AtomicEnd(sdMutex);}
+
+inline void Lat(LatData &Ltd, long long usec)
+               {AtomicBeg(sdMutex);
+                AtomicInc(Ltd.Count); AtomicAdd(Ltd.Total, usec);
+#ifdef HAVE_ATOMICS
+                long long lMax;
+                while(usec > (lMax = Ltd.Max)
+                &&    !AtomicCAS(Ltd.Max, lMax, usec)) {}
+#else
+                if (usec > Ltd.Max) Ltd.Max = usec;
+#endif
+                AtomicEnd(sdMutex);
+               }
+
+// Times an operation from construction to destruction and records it
+//
+class       Timer
+{
+public:
+            Timer(XrdOfsStats &sP, LatData &ltd) : Stats(sP), Ltd(ltd)
+                 {clock_gettime(CLOCK_MONOTONIC, &tBeg);}
+           ~Timer() {struct timespec tEnd;
+                     clock_gettime(CLOCK_MONOTONIC, &tEnd);
+                     Stats.Lat(Ltd, (tEnd.tv_sec  - tBeg.tv_sec)*1000000LL
+                                  + (tEnd.tv_nsec - tBeg.tv_nsec)/1000);
+                    }
+private:
+XrdOfsStats    &Stats;
+LatData        &Ltd;
+struct timespec tBeg;
+};
+
        int  Report(char *Buff, int Blen);
 
        void setRole(const char *theRole) {myRole = theRole;}
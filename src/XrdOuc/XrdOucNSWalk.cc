@@ -33,15 +33,118 @@
 #include <errno.h>
 #include <dirent.h>
 #include <unistd.h>
+#include <list>
+#include <vector>
 
 #include "XrdOuc/XrdOucNSWalk.hh"
 #include "XrdOuc/XrdOucTList.hh"
 #include "XrdSys/XrdSysError.hh"
 #include "XrdSys/XrdSysHeaders.hh"
 #include "XrdSys/XrdSysPlatform.hh"
+#include "XrdSys/XrdSysPthread.hh"
 
 using namespace std;
 
+/******************************************************************************/
+/*                         L o c a l   C l a s s e s                          */
+/******************************************************************************/
+/******************************************************************************/
+/*                          X r d O u c N S W D i r                           */
+/******************************************************************************/
+
+// One directory of a parallel walk. It is queued for indexing when found and
+// deleted once its entries have been handed out by Index().
+//
+class XrdOucNSWDir
+{
+public:
+
+XrdOucNSWDir               *Next;   // -> Next indexed directory (anyOrder)
+char                       *Path;   //    Directory path
+XrdOucNSWalk::NSEnt        *Ents;   // -> Entries once indexed
+std::vector<XrdOucNSWDir *> Kids;   //    Subdirectories in serial visit order
+std::list<XrdOucNSWDir *>::iterator wqPos; // Position in the work queue
+struct stat                 dStat;  //    Directory stat() if isEmpty
+int                         rc;     //    Indexing return code
+int                         nEnts;  //    Number of entries in Ents
+char                        State;  //    One of the following
+char                        isEmpty;
+char                        lkErr;  //    rc is from locking the directory
+
+static const char           isQueued = 0;
+static const char           isActive = 1;
+static const char           isDone   = 2;
+
+            XrdOucNSWDir(const char *path)
+                        : Next(0), Path(strdup(path)), Ents(0), rc(0),
+                          nEnts(0), State(isQueued), isEmpty(0), lkErr(0) {}
+
+           ~XrdOucNSWDir() {XrdOucNSWalk::NSEnt *eP;
+                            while((eP = Ents)) {Ents = eP->Next; delete eP;}
+                            for (int i = 0; i < (int)Kids.size(); i++)
+                                delete Kids[i];
+                            free(Path);
+                           }
+};
+
+/******************************************************************************/
+/*                          X r d O u c N S W P a r                           */
+/******************************************************************************/
+
+// The state of a parallel walk. Directories waiting to be indexed are kept
+// in a LIFO work queue so that the threads stay close to where the caller is
+// in the tree. The caller never waits for a directory that no thread has
+// picked up; it indexes such a directory itself. This keeps the walk moving
+// even when the threads have stopped because too many entries are waiting.
+//
+class XrdOucNSWPar
+{
+public:
+
+XrdOucNSWDir *Next();
+
+bool          Start(int nThreads);
+
+void          Work();
+
+              XrdOucNSWPar(XrdOucNSWalk *wP, int maxE, bool inOrder)
+                          : wCV(0, "NSWalk cv"), doneFirst(0), doneLast(0),
+                            Walker(wP), maxEnts(maxE), bufEnts(0), Pending(0),
+                            Ordered(inOrder), Stop(false) {}
+             ~XrdOucNSWPar();
+
+XrdSysCondVar               wCV;
+
+private:
+friend class  XrdOucNSWalk;
+
+void          Done(XrdOucNSWDir *dP);
+
+std::list<XrdOucNSWDir *>   workQ;     // Directories waiting to be indexed
+std::vector<XrdOucNSWDir *> Stack;     // Directories in serial return order
+std::vector<pthread_t>      TIDs;
+XrdOucNSWDir               *doneFirst; // Indexed directories (anyOrder)
+XrdOucNSWDir               *doneLast;
+XrdOucNSWalk               *Walker;
+int                         maxEnts;   // Max entries waiting to be returned
+int                         bufEnts;   // Entries waiting to be returned
+int                         Pending;   // Directories not yet returned(anyOrder)
+bool                        Ordered;
+bool                        Stop;
+};
+
+/******************************************************************************/
+/*                     E x t e r n a l   L i n k a g e s                      */
+/******************************************************************************/
+  
+void *XrdOucNSWalkWorker(void *pp)
+{
+   XrdOucNSWPar *parP = (XrdOucNSWPar *)pp;
+
+   parP->Work();
+   return (void *)0;
+}
+
 /******************************************************************************/
 /*                           C o n s t r u c t o r                            */
 /******************************************************************************/
@@ -53,6 +156,8 @@ XrdOucNSWalk::XrdOucNSWalk(XrdSysError *erp, const char *dpath,
 // Set the required fields
 //
    eDest = erp;
+   Boss  = 0;
+   Par   = 0;
    mPfx  = 0;
    DList = new XrdOucTList(dpath);
    if (lkfn) LKFn = strdup(lkfn);
@@ -62,11 +167,12 @@ XrdOucNSWalk::XrdOucNSWalk(XrdSysError *erp, const char *dpath,
    errOK= opts & skpErrs;
    DEnts= 0;
    edCB = 0;
+   isEmpty = 0;
 
 // Copy the exclude list if one exists
 //
-   if (!xlist) XList = 0;
-      else while(xlist)
+   XList = 0;
+   while(xlist)
                 {XList = new XrdOucTList(xlist->text,xlist->ival,XList);
                  xlist = xlist->next;
                 }
@@ -80,6 +186,8 @@ XrdOucNSWalk::~XrdOucNSWalk()
 {
    XrdOucTList *tP;
 
+   if (Par) delete Par;
+
    if (LKFn) free(LKFn);
 
    while((tP = DList)) {DList = tP->next; delete tP;}
@@ -95,10 +203,25 @@ XrdOucNSWalk::NSEnt *XrdOucNSWalk::Index(int &rc, const char **dPath)
 {
    XrdOucTList *tP;
    NSEnt *eP;
+   char isLkErr;
 
-// Sequence the directory
+// Sequence the directory. For parallel walks the directory has already been
+// indexed or is indexed by Next() and all we need do is pick up the results.
 //
    rc = 0; *DPath = '\0';
+   if (Par)
+      {XrdOucNSWDir *dP;
+       while((dP = Par->Next()))
+            {setPath(dP->Path);
+             rc = dP->rc; DEnts = dP->Ents; dP->Ents = 0;
+             if ((isEmpty = dP->isEmpty)) dStat = dP->dStat;
+             isLkErr = dP->lkErr;
+             delete dP;
+             if (DEnts || (rc && (!errOK || isLkErr))) break;
+             if (edCB && isEmpty) edCB->isEmpty(&dStat, DPath, LKFn);
+            }
+      }
+   else
    while((tP = DList))
         {setPath(tP->text);
          DList = tP->next; delete tP;
@@ -116,6 +239,45 @@ XrdOucNSWalk::NSEnt *XrdOucNSWalk::Index(int &rc, const char **dPath)
    return eP;
 }
 
+/******************************************************************************/
+/*                            s e t T h r e a d s                             */
+/******************************************************************************/
+  
+bool XrdOucNSWalk::setThreads(int nThreads, int maxEnts)
+{
+   XrdOucTList *tP;
+   XrdOucNSWDir *dP;
+   std::vector<XrdOucNSWDir *> dVec;
+
+// A non-recursive walk only ever indexes a single directory
+//
+   if (Par || nThreads <= 0 || !(Opts & Recurse)) return true;
+
+// Convert the pending directories to parallel walk form
+//
+   Par = new XrdOucNSWPar(this, (maxEnts > 0 ? maxEnts : 1),
+                          !(Opts & anyOrder));
+   for (tP = DList; tP; tP = tP->next) dVec.push_back(new XrdOucNSWDir(tP->text));
+   for (int i = dVec.size()-1; i >= 0; i--)
+       {dP = dVec[i];
+        Par->workQ.push_front(dP); dP->wqPos = Par->workQ.begin();
+        if (Par->Ordered) Par->Stack.push_back(dP);
+       }
+   Par->Pending = dVec.size();
+
+// Start the threads. If none could be started, revert to a serial walk.
+//
+   if (!Par->Start(nThreads))
+      {delete Par; Par = 0;
+       return false;
+      }
+
+// The directory list now lives in the parallel walk
+//
+   while((tP = DList)) {DList = tP->next; delete tP;}
+   return true;
+}
+
 /******************************************************************************/
 /*                       P r i v a t e   M e t h o d s                        */
 /******************************************************************************/
@@ -174,14 +336,19 @@ int XrdOucNSWalk::Build()
 // If we can optimize with a directory file descriptor, get one
 //
 #ifdef HAVE_FSTATAT
-   if ((DPfd = open(DPath, O_RDONLY)) < 0) rc = errno;
+   if ((DPfd = open(DPath, O_RDONLY|O_DIRECTORY)) < 0) rc = errno;
       else theEnt.F = DPfd;
 #else
    DPfd = -1;
 #endif
 
-// Open the directory
+// Open the directory. When we have a directory file descriptor, use it so
+// that the path need not be looked up again (the stream then owns it).
 //
+#ifdef HAVE_FSTATAT
+   if (DPfd >= 0 && (theEnt.D = fdopendir(DPfd))) theEnt.F = -1;
+      else
+#endif
    if (!(theEnt.D = opendir(DPath)))
       return Emsg("Build", errno, "open directory", DPath);
 
@@ -192,11 +359,12 @@ int XrdOucNSWalk::Build()
         {if (!strcmp(dp->d_name, ".") || !strcmp(dp->d_name, "..")) continue;
          strcpy(File, dp->d_name); nEnt++;
          if (!theEnt.P) theEnt.P = new NSEnt();
-         rc = getStat(theEnt.P, getLI);
+         if ((Opts & skpStat) && dType(theEnt.P, dp, getLI)) rc = 0;
+            else rc = getStat(theEnt.P, getLI);
          switch(theEnt.P->Type)
                {case NSEnt::isDir:
                      if (Opts & Recurse && (!getLI || !isSymlink())
-                     &&  (!XList || !inXList(File)))
+                     &&  !inXList(File))
                         DList = new XrdOucTList(DPath, 0, DList);
                      if (!(Opts & retDir)) continue;
                      break;
@@ -237,6 +405,72 @@ int XrdOucNSWalk::Build()
    return 0;
 }
 
+/******************************************************************************/
+/*                              B u i l d D i r                               */
+/******************************************************************************/
+
+// Index a single directory of a parallel walk. This may be called by many
+// threads at once so all of the work is done in a private walker object.
+  
+void XrdOucNSWalk::BuildDir(XrdOucNSWDir *dP)
+{
+   XrdOucNSWalk nsw(eDest, dP->Path, LKFn, Opts);
+   XrdOucTList *tP;
+   NSEnt *eP;
+   int rc;
+
+// Set up the private walker to index just this directory
+//
+   nsw.Boss = this; nsw.edCB = edCB; nsw.mPfx = mPfx;
+   tP = nsw.DList; nsw.DList = 0;
+   nsw.setPath(tP->text); delete tP;
+
+// Index the directory the same way Index() would
+//
+   if (LKFn && (rc = nsw.LockFile())) dP->lkErr = 1;
+      else {rc = nsw.Build();
+            if (nsw.LKfd >= 0) close(nsw.LKfd);
+           }
+
+// Return the results. Subdirectories are added to the front of the list as
+// they are found, so the list is already in serial visit order.
+//
+   dP->rc = rc;
+   dP->Ents = nsw.DEnts; nsw.DEnts = 0;
+   for (eP = dP->Ents; eP; eP = eP->Next) dP->nEnts++;
+   if ((dP->isEmpty = nsw.isEmpty)) dP->dStat = nsw.dStat;
+   while((tP = nsw.DList))
+        {nsw.DList = tP->next;
+         dP->Kids.push_back(new XrdOucNSWDir(tP->text));
+         delete tP;
+        }
+}
+
+/******************************************************************************/
+/*                                 d T y p e                                  */
+/******************************************************************************/
+
+// Set the entry type from the directory entry itself. Returns 0 if a stat()
+// is needed to determine the type (i.e. unknown or a symlink to be followed).
+
+int XrdOucNSWalk::dType(XrdOucNSWalk::NSEnt *eP, struct dirent *dp, int doLstat)
+{
+#ifdef DT_UNKNOWN
+   switch(dp->d_type)
+         {case DT_DIR:     eP->Type = NSEnt::isDir;  break;
+          case DT_REG:     eP->Type = NSEnt::isFile; break;
+          case DT_LNK:     if (!doLstat) return 0;
+                           eP->Type = NSEnt::isLink; break;
+          case DT_UNKNOWN: return 0;
+          default:         eP->Type = NSEnt::isMisc; break;
+         }
+   memset(&eP->Stat, 0, sizeof(struct stat));
+   return 1;
+#else
+   return 0;
+#endif
+}
+
 /******************************************************************************/
 /*                                  E m s g                                   */
 /******************************************************************************/
@@ -317,19 +551,30 @@ do{rc = doLstat ? lstat(DPath, &(eP->Stat)) : stat(DPath, &(eP->Stat));
   
 int XrdOucNSWalk::inXList(const char *dName)
 {
-    XrdOucTList *xTP = XList, *pTP = 0;
+    XrdOucNSWalk *xWP = (Boss ? Boss : this);
+    XrdOucTList *xTP, *pTP = 0;
+
+// In a parallel walk the exclude list belongs to the walker that owns the
+// walk and is shared by all the threads. So, even an empty list can only be
+// looked at under the lock.
+//
+    if (Boss) Boss->Par->wCV.Lock();
+       else if (!XList) return 0;
 
 // Search for the directory entry
 //
+    xTP = xWP->XList;
     while(xTP && strcmp(DPath, xTP->text)) {pTP = xTP; xTP = xTP->next;}
 
 // If not found return false. Otherwise, delete the entry and return true.
 //
-   if (!xTP) return 0;
-   if (pTP) pTP->next = xTP->next;
-      else      XList = xTP->next;
-   delete xTP;
-   return 1;
+   if (xTP)
+      {if (pTP) pTP->next = xTP->next;
+          else xWP->XList = xTP->next;
+       delete xTP;
+      }
+   if (Boss) Boss->Par->wCV.UnLock();
+   return xTP != 0;
 }
   
 /******************************************************************************/
@@ -408,3 +653,159 @@ void XrdOucNSWalk::setPath(char *newpath)
       {DPath[n++] = '/'; DPath[n] = '\0';}
    File = DPath+n;
 }
+
+/******************************************************************************/
+/*                    C l a s s   X r d O u c N S W P a r                     */
+/******************************************************************************/
+/******************************************************************************/
+/*                            D e s t r u c t o r                             */
+/******************************************************************************/
+  
+XrdOucNSWPar::~XrdOucNSWPar()
+{
+   XrdOucNSWDir *dP;
+
+// Tell the threads to stop and wait for them to do so
+//
+   wCV.Lock(); Stop = true; wCV.Broadcast(); wCV.UnLock();
+   for (int i = 0; i < (int)TIDs.size(); i++) XrdSysThread::Join(TIDs[i], 0);
+
+// Delete whatever was not returned. Directories not yet indexed are either
+// in the work queue or hang off directories on the stack (never both).
+//
+   if (Ordered)
+      {for (int i = 0; i < (int)Stack.size(); i++) delete Stack[i];
+      } else {
+       while(!workQ.empty()) {delete workQ.front(); workQ.pop_front();}
+       while((dP = doneFirst)) {doneFirst = dP->Next; delete dP;}
+      }
+}
+
+/******************************************************************************/
+/* Private:                         D o n e                                   */
+/******************************************************************************/
+
+// The lock must be held upon entry!
+
+void XrdOucNSWPar::Done(XrdOucNSWDir *dP)
+{
+   int n = dP->Kids.size();
+
+// Queue the subdirectories so that the one that will be returned next is
+// indexed first.
+//
+   bufEnts += dP->nEnts;
+   for (int i = n-1; i >= 0; i--)
+       {workQ.push_front(dP->Kids[i]); dP->Kids[i]->wqPos = workQ.begin();}
+
+// When order does not matter the directory is ready to be returned and the
+// subdirectories are tracked only by the work queue.
+//
+   if (!Ordered)
+      {Pending += n; dP->Kids.clear();
+       if (doneLast) doneLast->Next = dP;
+          else       doneFirst      = dP;
+       doneLast = dP;
+      }
+
+// Tell everyone a directory has been indexed
+//
+   dP->State = XrdOucNSWDir::isDone;
+   wCV.Broadcast();
+}
+
+/******************************************************************************/
+/*                                  N e x t                                   */
+/******************************************************************************/
+  
+XrdOucNSWDir *XrdOucNSWPar::Next()
+{
+   XrdOucNSWDir *dP;
+
+// Find the next directory to be returned. If it has not yet been picked up by
+// a thread, index it here. Otherwise, wait for it to be indexed.
+//
+   wCV.Lock();
+   do {if (Ordered)
+          {if (Stack.empty()) {dP = 0; break;}
+           dP = Stack.back();
+           if (dP->State == XrdOucNSWDir::isDone)
+              {Stack.pop_back();
+               for (int i = dP->Kids.size()-1; i >= 0; i--)
+                   Stack.push_back(dP->Kids[i]);
+               dP->Kids.clear();
+               break;
+              }
+          } else {
+           if ((dP = doneFirst))
+              {if (!(doneFirst = dP->Next)) doneLast = 0;
+               Pending--;
+               break;
+              }
+           if (!Pending) break;
+           dP = (workQ.empty() ? 0 : workQ.front());
+          }
+       if (dP && dP->State == XrdOucNSWDir::isQueued)
+          {workQ.erase(dP->wqPos);
+           dP->State = XrdOucNSWDir::isActive;
+           wCV.UnLock();
+           Walker->BuildDir(dP);
+           wCV.Lock();
+           Done(dP);
+          } else wCV.Wait();
+      } while(1);
+
+// Account for the entries being handed back and let any threads that were
+// waiting for room continue.
+//
+   if (dP) {bufEnts -= dP->nEnts; wCV.Broadcast();}
+   wCV.UnLock();
+   return dP;
+}
+
+/******************************************************************************/
+/*                                 S t a r t                                  */
+/******************************************************************************/
+  
+bool XrdOucNSWPar::Start(int nThreads)
+{
+   pthread_t tid;
+   int rc;
+
+// Start the requested number of threads
+//
+   while(nThreads--)
+        {if ((rc = XrdSysThread::Run(&tid, XrdOucNSWalkWorker, (void *)this,
+                                     XRDSYSTHREAD_HOLD, "NSWalk")))
+            {if (Walker->eDest)
+                Walker->eDest->Emsg("NSWalk", rc, "create walker thread");
+             break;
+            }
+         TIDs.push_back(tid);
+        }
+   return !TIDs.empty();
+}
+
+/******************************************************************************/
+/*                                  W o r k                                   */
+/******************************************************************************/
+  
+void XrdOucNSWPar::Work()
+{
+   XrdOucNSWDir *dP;
+
+// Index directories from the front of the work queue as long as there is
+// room to hold the results.
+//
+   wCV.Lock();
+   do {while(!Stop && (workQ.empty() || bufEnts >= maxEnts)) wCV.Wait();
+       if (Stop) break;
+       dP = workQ.front(); workQ.pop_front();
+       dP->State = XrdOucNSWDir::isActive;
+       wCV.UnLock();
+       Walker->BuildDir(dP);
+       wCV.Lock();
+       Done(dP);
+      } while(1);
+   wCV.UnLock();
+}
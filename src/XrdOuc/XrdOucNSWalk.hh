@@ -37,6 +37,8 @@
   
 
 class XrdOucTList;
+class XrdOucNSWPar;
+class XrdOucNSWDir;
 class XrdSysError;
 
 class XrdOucNSWalk
@@ -101,6 +103,17 @@ void         setCallBack(CallBack *cbP=0) {edCB = cbP;}
 //
 void         setMsgOn(const char *pfx) {mPfx = pfx;}
 
+// Calling setThreads() before the first call to Index() causes a recursive
+// walk to index directories ahead of the caller using nThreads threads. At
+// most maxEnts entries are held waiting to be returned by Index(). Unless
+// opts & anyOrder, directories are returned in the same order as a serial
+// walk would return them. Otherwise, they are returned as soon as they have
+// been indexed. Any empty directory callback and all Index() results are
+// delivered on the thread calling Index(). Returns false if the threads
+// could not be started, in which case the walk proceeds serially.
+//
+bool         setThreads(int nThreads, int maxEnts=65536);
+
 // The following are processing options passed to the constructor
 //
 static const int retDir =  0x0001; // Return directories (implies retStat)
@@ -114,6 +127,9 @@ static const int retIDLO=  0x0020; // Names returned in decreasing length order
 static const int retIILO=  0x0040; // Names returned in increasing length order
 static const int Recurse=  0x0080; // Recursive traversal, 1 Level per Index()
 static const int noPath =  0x0100; // Do not include the full directory path
+static const int skpStat=  0x0200; // Type entries by d_type; stat() only if
+                                   // the type is unknown or a link to follow
+static const int anyOrder= 0x0400; // Parallel walk may return dirs in any order
 static const int skpErrs=  0x8000; // Skip any entry causing an error
 
              XrdOucNSWalk(XrdSysError *erp,  // Error msg object. If 0->silent
@@ -130,8 +146,12 @@ static const int skpErrs=  0x8000; // Skip any entry causing an error
 //       as a directory entry if an empty directory call back has been set.
 
 private:
+friend class  XrdOucNSWPar;
+
 void          addEnt(XrdOucNSWalk::NSEnt *eP);
 int           Build();
+void          BuildDir(XrdOucNSWDir *dP);
+int           dType(XrdOucNSWalk::NSEnt *eP, struct dirent *dP, int doLstat);
 int           Emsg(const char *pfx, int rc, const char *tx1, const char *tx2=0);
 int           getLink(XrdOucNSWalk::NSEnt *eP);
 int           getStat(XrdOucNSWalk::NSEnt *eP, int doLstat=0);
@@ -142,6 +162,8 @@ int           LockFile();
 void          setPath(char *newpath);
 
 XrdSysError  *eDest;
+XrdOucNSWalk *Boss;       // -> Walker that owns XList (parallel walks)
+XrdOucNSWPar *Par;        // -> Parallel walk state, if any
 XrdOucTList  *DList;
 XrdOucTList  *XList;
 struct NSEnt *DEnts;
@@ -30,8 +30,10 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <sched.h>
 #include <sys/resource.h>
 #include <sys/stat.h>
+#include <vector>
 
 #include "XrdPosix/XrdPosixObject.hh"
 #include "XrdPosix/XrdPosixTrace.hh"
@@ -42,6 +44,9 @@
 /*                        S t a t i c   M e m b e r s                         */
 /******************************************************************************/
 
+XrdPosixObject::rdrSlot XrdPosixObject::rdrTable[XrdPosixObject::rdrSlots];
+int              XrdPosixObject::rdrEpoch =  0;
+XrdSysMutex      XrdPosixObject::qsMutex;
 XrdSysMutex      XrdPosixObject::fdMutex;
 XrdPosixObject **XrdPosixObject::myFiles  =  0;
 int              XrdPosixObject::highFD   = -1;
@@ -96,19 +101,23 @@ XrdPosixDir *XrdPosixObject::Dir(int fd, bool glk)
 {
    XrdPosixDir    *dP;
    XrdPosixObject *oP;
-   int  waitCount = 0;
+   int  slot = 0, waitCount = 0;
    bool haveLock;
 
-// Validate the fildes
+// Obtain the file object, if any. Only a caller that will remove the object
+// takes the global lock; everyone else relies on the reader slots to keep the
+// object from being deleted until it is locked and known to still be in use.
+// The fildes is validated only once announced, as Shutdown() may be emptying
+// the table (it waits for announced readers before freeing it).
 //
-do{if (fd >= lastFD || fd < baseFD)
-      {errno = EBADF; return (XrdPosixDir *)0;}
-
-// Obtain the file object, if any
-//
-   fdMutex.Lock();
-   if (!(oP = myFiles[fd - baseFD]) || !(oP->Who(&dP)))
-      {fdMutex.UnLock(); errno = EBADF; return (XrdPosixDir *)0;}
+do{if (glk) fdMutex.Lock();
+      else {AtomicBeg(fdMutex); slot = rdrBeg();}
+   if (fd >= AtomicGet(lastFD) || fd < baseFD
+   ||  !(oP = myFiles[fd - baseFD]) || !(oP->Who(&dP)))
+      {if (glk) fdMutex.UnLock();
+          else {rdrEnd(slot); AtomicEnd(fdMutex);}
+       errno = EBADF; return (XrdPosixDir *)0;
+      }
 
 // Attempt to lock the object in the appropriate mode. If we fail, then we need
 // to retry this after dropping the global lock. We pause a bit to let the
@@ -118,18 +127,26 @@ do{if (fd >= lastFD || fd < baseFD)
    if (glk) haveLock = oP->objMutex.CondWriteLock();
       else  haveLock = oP->objMutex.CondReadLock();
    if (!haveLock)
-      {fdMutex.UnLock();
+      {if (glk) fdMutex.UnLock();
+          else {rdrEnd(slot); AtomicEnd(fdMutex);}
        waitCount++;
        if (waitCount > 120) break;
        XrdSysTimer::Wait(500); // We wait 500 milliseconds
        continue;
       }
 
-// If the global lock is to be held, then release the object lock as this
-// is a call to destroy the object and there is no need for the local lock.
+// If the global lock is to be held, keep the object write locked as well as
+// this is a call to remove the object (see Remove()). Otherwise, make sure the
+// object was not removed while we were locking it. Once read locked, it cannot
+// be removed until we unlock it.
 //
-   if (glk) oP->UnLock();
-      else  fdMutex.UnLock();
+   if (!glk)
+      {if (myFiles[fd - baseFD] != oP)
+          {oP->UnLock(); rdrEnd(slot); AtomicEnd(fdMutex);
+           errno = EBADF; return (XrdPosixDir *)0;
+          }
+       rdrEnd(slot); AtomicEnd(fdMutex);
+      }
    return dP;
   } while(1);
 
@@ -147,19 +164,23 @@ XrdPosixFile *XrdPosixObject::File(int fd, bool glk)
 {
    XrdPosixFile   *fP;
    XrdPosixObject *oP;
-   int  waitCount = 0;
+   int  slot = 0, waitCount = 0;
    bool haveLock;
 
-// Validate the fildes
+// Obtain the file object, if any. Only a caller that will remove the object
+// takes the global lock; everyone else relies on the reader slots to keep the
+// object from being deleted until it is locked and known to still be in use.
+// The fildes is validated only once announced, as Shutdown() may be emptying
+// the table (it waits for announced readers before freeing it).
 //
-do{if (fd >= lastFD || fd < baseFD)
-      {errno = EBADF; return (XrdPosixFile *)0;}
-
-// Obtain the file object, if any
-//
-   fdMutex.Lock();
-   if (!(oP = myFiles[fd - baseFD]) || !(oP->Who(&fP)))
-      {fdMutex.UnLock(); errno = EBADF; return (XrdPosixFile *)0;}
+do{if (glk) fdMutex.Lock();
+      else {AtomicBeg(fdMutex); slot = rdrBeg();}
+   if (fd >= AtomicGet(lastFD) || fd < baseFD
+   ||  !(oP = myFiles[fd - baseFD]) || !(oP->Who(&fP)))
+      {if (glk) fdMutex.UnLock();
+          else {rdrEnd(slot); AtomicEnd(fdMutex);}
+       errno = EBADF; return (XrdPosixFile *)0;
+      }
 
 // Attempt to lock the object in the appropriate mode. If we fail, then we need
 // to retry this after dropping the global lock. We pause a bit to let the
@@ -169,18 +190,26 @@ do{if (fd >= lastFD || fd < baseFD)
    if (glk) haveLock = oP->objMutex.CondWriteLock();
       else  haveLock = oP->objMutex.CondReadLock();
    if (!haveLock)
-      {fdMutex.UnLock();
+      {if (glk) fdMutex.UnLock();
+          else {rdrEnd(slot); AtomicEnd(fdMutex);}
        waitCount++;
        if (waitCount > 120) break;
        XrdSysTimer::Wait(500); // We wait 500 milliseconds
        continue;
       }
 
-// If the global lock is to be held, then release the object lock as this
-// is a call to destroy the object and there is no need for the local lock.
+// If the global lock is to be held, keep the object write locked as well as
+// this is a call to remove the object (see Remove()). Otherwise, make sure the
+// object was not removed while we were locking it. Once read locked, it cannot
+// be removed until we unlock it.
 //
-   if (glk) oP->UnLock();
-      else  fdMutex.UnLock();
+   if (!glk)
+      {if (myFiles[fd - baseFD] != oP)
+          {oP->UnLock(); rdrEnd(slot); AtomicEnd(fdMutex);
+           errno = EBADF; return (XrdPosixFile *)0;
+          }
+       rdrEnd(slot); AtomicEnd(fdMutex);
+      }
    return fP;
   } while(1);
 
@@ -238,31 +267,72 @@ int XrdPosixObject::Init(int fdnum)
    return baseFD;
 }
 
+/******************************************************************************/
+/*                               Q u i e s c e                                */
+/******************************************************************************/
+
+void XrdPosixObject::Quiesce()
+{
+   XrdSysMutexHelper qsHelper(qsMutex);
+
+// Flip the epoch and wait for the readers of the previous one to finish. We
+// must do this twice as a reader may have sampled the epoch just before the
+// first flip and only announced itself after it. Lookups are short (they
+// never wait while announced) so this only takes a moment.
+//
+   for (int n = 0; n < 2; n++)
+       {int oldE = AtomicInc(rdrEpoch) & 1;
+        for (int i = 0; i < rdrSlots; i++)
+            while(AtomicGet(rdrTable[i].rdrCnt[oldE])) sched_yield();
+       }
+}
+
+/******************************************************************************/
+/*                                r d r B e g                                 */
+/******************************************************************************/
+
+int XrdPosixObject::rdrBeg()
+{
+// Spread the threads over the slots to keep them off each other's cache lines
+//
+   unsigned long long tid = (unsigned long long)XrdSysThread::ID();
+   int slot = ((tid * 0x9E3779B97F4A7C15ULL) >> 32) % rdrSlots;
+
+// Record the slot along with the epoch we announced ourselves in
+//
+   slot = slot*2 + (AtomicGet(rdrEpoch) & 1);
+   AtomicInc(rdrTable[slot>>1].rdrCnt[slot&1]);
+   return slot;
+}
+
+/******************************************************************************/
+/*                                r d r E n d                                 */
+/******************************************************************************/
+
+void XrdPosixObject::rdrEnd(int slot)
+{
+   AtomicDec(rdrTable[slot>>1].rdrCnt[slot&1]);
+}
+
 /******************************************************************************/
 /*                               R e l e a s e                                */
 /******************************************************************************/
   
 void XrdPosixObject::Release(XrdPosixObject *oP, bool needlk)
 {
-// Get the lock if need be
+// Write lock the object before removing it from the table, just as
+// ReleaseFile() does. A lookup that has already locked the object is then
+// done with it, and one that locks it afterwards sees that it is gone.
 //
+   oP->objMutex.WriteLock();
    if (needlk) fdMutex.Lock();
+   Remove(oP);
+   fdMutex.UnLock();
+   oP->UnLock();
 
-// Remove the object from the table
-//
-   if (baseFD)
-      {int myFD = oP->fdNum - baseFD;
-       if (myFD < freeFD) freeFD = myFD;
-       myFiles[myFD] = 0;
-      } else {
-       myFiles[oP->fdNum] = 0;
-       close(oP->fdNum);
-      }
-
-// Zorch the object fd and release the global lock
+// Wait for any lookup that may have seen the object to be done with it
 //
-   oP->fdNum = -1;
-   fdMutex.UnLock();
+   Quiesce();
 }
 
 /******************************************************************************/
@@ -277,9 +347,14 @@ XrdPosixDir *XrdPosixObject::ReleaseDir(int fd)
 //
    if (!(dP = Dir(fd, true))) return (XrdPosixDir *)0;
 
-// Release it and return the underlying object
+// Remove it while it is still write locked so that no lookup can lock it
+// afterwards, then wait for any lookup in progress to notice.
 //
-   Release((XrdPosixObject *)dP, false);
+   XrdPosixObject *oP = (XrdPosixObject *)dP;
+   Remove(oP);
+   oP->UnLock();
+   fdMutex.UnLock();
+   Quiesce();
    return dP;
 }
 
@@ -295,33 +370,69 @@ XrdPosixFile *XrdPosixObject::ReleaseFile(int fd)
 //
    if (!(fP = File(fd, true))) return (XrdPosixFile *)0;
 
-// Release it and return the underlying object
+// Remove it while it is still write locked so that no lookup can lock it
+// afterwards, then wait for any lookup in progress to notice.
 //
-   Release((XrdPosixObject *)fP, false);
+   XrdPosixObject *oP = (XrdPosixObject *)fP;
+   Remove(oP);
+   oP->UnLock();
+   fdMutex.UnLock();
+   Quiesce();
    return fP;
 }
   
+/******************************************************************************/
+/*                                R e m o v e                                 */
+/******************************************************************************/
+
+void XrdPosixObject::Remove(XrdPosixObject *oP)
+{
+// Remove the object from the table (the global lock must be held)
+//
+   if (baseFD)
+      {int myFD = oP->fdNum - baseFD;
+       if (myFD < freeFD) freeFD = myFD;
+       myFiles[myFD] = 0;
+      } else {
+       myFiles[oP->fdNum] = 0;
+       close(oP->fdNum);
+      }
+
+// Zorch the object fd
+//
+   oP->fdNum = -1;
+}
+  
 /******************************************************************************/
 /*                              S h u t d o w n                               */
 /******************************************************************************/
   
 void XrdPosixObject::Shutdown()
 {
+   std::vector<XrdPosixObject *> theObjs;
    XrdPosixObject *oP;
    int i;
 
-// Destory all files and static data
+// Empty the table so that no new lookup can find anything in it
 //
    fdMutex.Lock();
-   if (myFiles)
-      {for (i = 0; i <= highFD; i++) 
-           if ((oP = myFiles[i]))
-              {myFiles[i] = 0;
-               if (oP->fdNum >= 0) close(oP->fdNum);
-               oP->fdNum = -1;
-               delete oP;
-              };
-       free(myFiles); myFiles = 0;
-      }
+   if (!myFiles) {fdMutex.UnLock(); return;}
+   lastFD = -1;
+   for (i = 0; i <= highFD; i++)
+       if ((oP = myFiles[i]))
+          {myFiles[i] = 0;
+           if (oP->fdNum >= 0) close(oP->fdNum);
+           oP->fdNum = -1;
+           theObjs.push_back(oP);
+          }
+   fdMutex.UnLock();
+
+// Wait for any lookup in progress to finish and then destory all files and
+// static data.
+//
+   Quiesce();
+   for (i = 0; i < (int)theObjs.size(); i++) delete theObjs[i];
+   fdMutex.Lock();
+   free(myFiles); myFiles = 0;
    fdMutex.UnLock();
 }
@@ -98,6 +98,22 @@ protected:
 
 private:
 
+// Lookups do not take fdMutex. Instead, a thread announces itself in one of
+// the reader slots (picked by thread) for the current epoch parity while it
+// fetches and locks an object. Before a removed object may be deleted, the
+// remover waits for all readers of both parities to drain (see Quiesce()).
+//
+static const int        rdrSlots = 64;
+struct alignas(64) rdrSlot {int rdrCnt[2];};
+
+static int              rdrBeg();
+static void             rdrEnd(int slot);
+static void             Quiesce();
+static void             Remove(XrdPosixObject *oP);
+
+static rdrSlot          rdrTable[rdrSlots];
+static int              rdrEpoch;
+static XrdSysMutex      qsMutex;
 static XrdSysMutex      fdMutex;
 static XrdPosixObject **myFiles;
 static int              lastFD;
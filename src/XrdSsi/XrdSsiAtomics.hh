@@ -42,6 +42,8 @@
 #define Atomic_IMP "C++11"
 #define Atomic_BEG(x)
 #define Atomic_DEC(x)          x.fetch_sub(1,std::memory_order_relaxed)
+#define Atomic_FENCE_ACQ()     std::atomic_thread_fence(std::memory_order_acquire)
+#define Atomic_FENCE_REL()     std::atomic_thread_fence(std::memory_order_release)
 #define Atomic_GET(x)          x.load(std::memory_order_relaxed)
 #define Atomic_GET_STRICT(x)   x.load(std::memory_order_acquire)
 #define Atomic_INC(x)          x.fetch_add(1,std::memory_order_relaxed)
@@ -58,6 +60,8 @@
 #define Atomic_IMP "gnu-atomic"
 #define Atomic_BEG(x)
 #define Atomic_DEC(x)          __atomic_fetch_sub(&x,1,__ATOMIC_RELAXED)
+#define Atomic_FENCE_ACQ()     __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define Atomic_FENCE_REL()     __atomic_thread_fence(__ATOMIC_RELEASE)
 #define Atomic_GET(x)          __atomic_load_n   (&x,  __ATOMIC_RELAXED)
 #define Atomic_GET_STRICT(x)   __atomic_load_n   (&x,  __ATOMIC_ACQUIRE)
 #define Atomic_INC(x)          __atomic_fetch_add(&x,1,__ATOMIC_RELAXED)
@@ -76,6 +80,8 @@
 #define Atomic_IMP "gnu-sync"
 #define Atomic_BEG(x)
 #define Atomic_DEC(x)              __sync_fetch_and_sub(&x, 1)
+#define Atomic_FENCE_ACQ()         __sync_synchronize()
+#define Atomic_FENCE_REL()         __sync_synchronize()
 #define Atomic_GET(x)              __sync_fetch_and_or (&x, 0)
 #define Atomic_GET_STRICT(x)       __sync_fetch_and_or (&x, 0)
 #define Atomic_INC(x)              __sync_fetch_and_add(&x, 1)
@@ -93,6 +99,8 @@
 #define Atomic(type)    type
 #define Atomic_BEG(x)   pthread_mutex_lock(x)
 #define Atomic_DEC(x)   x--
+#define Atomic_FENCE_ACQ()
+#define Atomic_FENCE_REL()
 #define Atomic_GET(x)   x
 #define Atomic_INC(x)   x++
 #define Atomic_SET(x,y) x = y
@@ -30,6 +30,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string>
 #include <string.h>
 #include <time.h>
@@ -76,6 +77,10 @@ extern XrdSsiLogger::MCB_t *msgCBCl;
        bool          dsTTLSet = false;
        bool          reqTOSet = false;
        bool          strTOSet = false;
+       int           batchSz  =    0;  // Max bytes in a batch (0 -> off)
+       int           batchMS  =    0;  // Max ms a batch lingers
+       int           batchRQ  = 4096;  // Max bytes of a batchable request
+       int           taskMax  =  256;  // Max idle task objects kept
 }
 
 using namespace XrdSsi;
@@ -113,6 +118,7 @@ virtual void   SetTimeout(tmoType what, int tmoval);
 virtual       ~XrdSsiClientProvider() {}
 
 private:
+void SetBatching();
 void SetLogger();
 void SetScheduler();
 };
@@ -138,6 +144,7 @@ XrdSsiService *XrdSsiClientProvider::GetService(XrdSsiErrInfo     &eInfo,
       if (!Logger)   SetLogger();
       if (!schedP)   SetScheduler();
       if (!clEnvP)   clEnvP = XrdCl::DefaultEnv::GetEnv();
+      SetBatching();
       if (!dsTTLSet) clEnvP->PutInt("DataServerTTL",  maxTMO);
       if (!reqTOSet) clEnvP->PutInt("RequestTimeout", maxTMO);
       if (!strTOSet) clEnvP->PutInt("StreamTimeout",  maxTMO);
@@ -165,6 +172,35 @@ XrdSsiService *XrdSsiClientProvider::GetService(XrdSsiErrInfo     &eInfo,
    return new XrdSsiServReal(buff, oHold);
 }
 
+/******************************************************************************/
+/*     X r d S s i C l i e n t P r o v i d e r : : S e t B a t c h i n g      */
+/******************************************************************************/
+
+// Small requests to the same resource may be sent several to a write. This
+// needs servers that understand batches, so it is off unless XRDSSIBATCH is
+// set to the maximum batch size in bytes. XRDSSIBATCHMS is how long (in ms)
+// a batch may wait for more requests and XRDSSIBATCHRQ is the largest request
+// that is batched. XRDSSITASKPOOL is the number of idle task objects kept.
+  
+void XrdSsiClientProvider::SetBatching()
+{
+   static const int maxBSZ = 1048576;
+   const char *eVal;
+
+   if ((eVal = getenv("XRDSSIBATCH")))
+      {batchSz = atoi(eVal);
+       if (batchSz < 0) batchSz = 0;
+          else if (batchSz > maxBSZ) batchSz = maxBSZ;
+      }
+   if ((eVal = getenv("XRDSSIBATCHMS")) && (batchMS = atoi(eVal)) < 0)
+      batchMS = 0;
+   if ((eVal = getenv("XRDSSIBATCHRQ")) && (batchRQ = atoi(eVal)) < 0)
+      batchRQ = 0;
+   if (batchRQ > batchSz/2) batchRQ = batchSz/2;
+   if ((eVal = getenv("XRDSSITASKPOOL")) && (taskMax = atoi(eVal)) < 0)
+      taskMax = 0;
+}
+
 /******************************************************************************/
 /*    X r d S s i C l i e n t P r o v i d e r : : S e t C B T h r e a d s     */
 /******************************************************************************/
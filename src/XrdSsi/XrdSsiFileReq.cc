@@ -28,6 +28,7 @@
 /******************************************************************************/
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <arpa/inet.h>
 #include <sys/types.h>
@@ -906,40 +907,83 @@ int XrdSsiFileReq::sendStrmA(XrdSsiStream *strmP,
 {
    static const char *epname = "sendStrmA";
    XrdSsiErrInfo  eObj;
-   XrdOucSFVec    sfVec[2];
-   int rc;
+   XrdOucSFVec    sfVec[XrdOucSFVec::sfMax];
+   XrdSsiStream::Buffer *doneBuff[XrdOucSFVec::sfMax];
+   XrdSfsXferSize xlen = 0;
+   int rc, dlen, vNum = 1;
+
+// Gather as many stream buffers as needed to fill the request. The data is
+// sent directly out of the buffers the stream supplied. A short response tells
+// the client that the stream has ended, so we only come up short at the end.
+// Unless the stream allows it, only one of its buffers may be outstanding.
+//
+   const int vMax = (strmP->MultiBuff() ? XrdOucSFVec::sfMax : 2);
+   while(xlen < blen && vNum < vMax)
+        {if (!strBuff)
+            {if (strmEOF) break;
+             respLen = blen - xlen; respOff = 0;
+             if (!(strBuff = strmP->GetBuff(eObj, respLen, strmEOF)))
+                {if (strmEOF) break;
+                 while(vNum-- > 1) if (doneBuff[vNum]) doneBuff[vNum]->Recycle();
+                 myState = erRsp; strmEOF = true;
+                 return Emsg(epname, eObj, "read stream");
+                }
+            }
+         dlen = (respLen > blen - xlen ? blen - xlen : respLen);
+         sfVec[vNum].buffer = strBuff->data+respOff;
+         sfVec[vNum].fdnum  = -1;
+         sfVec[vNum].sendsz = dlen;
+         respLen -= dlen; respOff += dlen; xlen += dlen;
+         if (respLen > 0) doneBuff[vNum] = 0;
+            else {doneBuff[vNum] = strBuff; strBuff = 0;}
+         vNum++;
+        }
 
-// Check if we need a buffer
-//
-   if (!strBuff)
-      {respLen = blen;
-       if (strmEOF || !(strBuff = strmP->GetBuff(eObj, respLen, strmEOF)))
-          {myState = odRsp; strmEOF = true;
-           if (!strmEOF) Emsg(epname, eObj, "read stream");
-           return 1;
+// If we ran out of vector elements (i.e. the stream supplies many small
+// buffers or allows only one of them to be outstanding) the last element is
+// refilled with a copy of whatever else is needed. So, back out the last
+// element and let readStrmA() do the copying, one buffer at a time.
+//
+   if (xlen < blen && (strBuff || !strmEOF))
+      {vNum--;
+       if (doneBuff[vNum]) {strBuff = doneBuff[vNum]; respLen = 0;}
+       respLen += sfVec[vNum].sendsz; respOff -= sfVec[vNum].sendsz;
+       xlen    -= sfVec[vNum].sendsz;
+       dlen     = blen - xlen;
+       if (!(respBuf = (char *)malloc(dlen)))
+          {while(vNum-- > 1) if (doneBuff[vNum]) doneBuff[vNum]->Recycle();
+           myState = erRsp; strmEOF = true;
+           return Emsg(epname, ENOMEM, "send");
+          }
+       if ((dlen = readStrmA(strmP, respBuf, dlen)) < 0)
+          {while(vNum-- > 1) if (doneBuff[vNum]) doneBuff[vNum]->Recycle();
+           free(respBuf); respBuf = 0;
+           return dlen;
           }
-       respOff = 0;
+       sfVec[vNum].buffer = respBuf;
+       sfVec[vNum].sendsz = dlen;
+       doneBuff[vNum] = 0;
+       xlen += dlen;
+       vNum++;
       }
 
-// Complete the sendfile vector
+// A short (or empty) response tells the client the stream has ended. Should
+// the stream end exactly at the end of the request, the next request gets an
+// empty response.
 //
-   sfVec[1].buffer = strBuff->data+respOff;
-   sfVec[1].fdnum  = -1;
-   if (respLen > blen)
-      {sfVec[1].sendsz = blen;
-       respLen -= blen; respOff += blen;
-      } else {
-       sfVec[1].sendsz = respLen;
-       respLen = 0;
-      }
+   myState = (xlen < blen ? odRsp : doRsp);
+   if (!xlen) {sfVec[1].buffer = rID; sfVec[1].fdnum = -1; sfVec[1].sendsz = 0;
+               doneBuff[1] = 0; vNum = 2;
+              }
 
 // Send off the data
 //
-   rc = sfDio->SendFile(sfVec, 2);
+   rc = sfDio->SendFile(sfVec, vNum);
 
-// Release any completed buffer
+// Release all of the completely sent buffers
 //
-   if (strBuff && !respLen) {strBuff->Recycle(); strBuff = 0;}
+   while(vNum-- > 1) if (doneBuff[vNum]) doneBuff[vNum]->Recycle();
+   if (respBuf) {free(respBuf); respBuf = 0;}
 
 // If send succeeded, indicate the action to be taken
 //
@@ -952,6 +996,31 @@ int XrdSsiFileReq::sendStrmA(XrdSsiStream *strmP,
    return Emsg(epname, rc, "send");
 }
   
+/******************************************************************************/
+/*                         R e a d y R e s p o n s e                          */
+/******************************************************************************/
+
+const XrdSsiRespInfo *XrdSsiFileReq::ReadyResponse(int maxLen)
+{
+   EPNAME("ReadyResp");
+   XrdSsiMutexMon frqMon(frqMutex);
+   const XrdSsiRespInfo *rspP = XrdSsiRRAgent::RespP(this);
+
+// Only a complete data response that has no alerts ahead of it can be sent
+// along with the responses of other requests. WantResponse() handles the rest.
+//
+   if (!haveResp || alrtPend || rspP->rType != XrdSsiRespInfo::isData
+   ||  rspP->blen + rspP->mdlen > maxLen) return 0;
+
+// The caller sends the response and we get finalized when Done() is called
+//
+   if (alrtSent) {alrtSent->Recycle(); alrtSent = 0;}
+   respCBarg = 0;
+   myState   = odRsp;
+   DEBUGXQ("resp batched");
+   return rspP;
+}
+
 /******************************************************************************/
 /*                          W a n t R e s p o n s e                           */
 /******************************************************************************/
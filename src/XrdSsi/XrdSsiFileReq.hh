@@ -84,6 +84,8 @@ static  XrdSsiFileReq *Alloc(XrdOucErrInfo  *eP, XrdSsiFileResource *rP,
                         
         void           RelRequestBuffer();
 
+        const XrdSsiRespInfo *ReadyResponse(int maxLen);
+
         int            Send(XrdSfsDio *sfDio, XrdSfsXferSize size);
 
 static  void           SetMax(int mVal) {freeMax = mVal;}
@@ -103,6 +103,31 @@ virtual ~nullCallBack() {}
 };
 
 nullCallBack nullCB;
+
+/******************************************************************************/
+
+// Finalizes each request whose response was sent as part of a batch.
+
+class batchCallBack : public XrdOucEICB
+{
+public:
+
+void     Add(XrdSsiFileReq *rqstP) {reqP[reqN++] = rqstP;}
+
+void     Done(int &Result, XrdOucErrInfo *eInfo, const char *Path=0)
+             {for (int i = 0; i < reqN; i++) reqP[i]->Done(Result, eInfo);
+              delete this;
+             }
+
+int      Same(unsigned long long arg1, unsigned long long arg2) {return 0;}
+
+         batchCallBack() : reqN(0) {}
+virtual ~batchCallBack() {}
+
+private:
+XrdSsiFileReq *reqP[XrdSsiRRInfo::rbwMax];
+int            reqN;
+};
 };
   
 /******************************************************************************/
@@ -302,9 +327,11 @@ int XrdSsiFileSess::fctl(const int           cmd,
    if (!args || alen < (int)sizeof(XrdSsiRRInfo))
       return XrdSsiUtils::Emsg(epname, EINVAL, "fctl", gigID, *eInfo);
 
-// Grab the request identifier
+// Grab the request identifier. The caller may also want whichever responses
+// of a batch of requests are ready.
 //
    rInfo = (XrdSsiRRInfo *)args;
+   if (rInfo->Cmd() == XrdSsiRRInfo::Rbw) return fctlBatch(alen, args);
    reqID = rInfo->Id();
 
 // Do some debugging
@@ -382,6 +409,101 @@ bool XrdSsiFileSess::NewRequest(unsigned int     reqid,
    return true;
 }
   
+/******************************************************************************/
+/* Private:                    f c t l B a t c h                              */
+/******************************************************************************/
+
+int XrdSsiFileSess::fctlBatch(int alen, const char *args)
+/*
+  Function: Return the responses of a batch of requests that are ready.
+
+  Input:    alen      - The length of args.
+            args      - The request information of each request whose response
+                        is wanted (only the request id is used).
+
+  Output:   Returns SFS_DATAVEC. Each response that is ready is preceded by its
+            request information (id and the length of what follows) and is
+            formatted as an attn response carrying the full response.
+
+  Notes:    Only complete data responses that fit in a direct transfer are
+            returned this way. The client asks for the others one by one.
+*/
+{
+   EPNAME("fctlBatch");
+   static const int rrSz = sizeof(XrdSsiRRInfo);
+   struct RespHdr {XrdSsiRRInfo rrInfo; XrdSsiRRInfoAttn aHdr;};
+
+   const XrdSsiRespInfo *respP;
+   XrdSsiFileReq  *rqstP;
+   batchCallBack  *bcbP = 0;
+   XrdSsiRRInfo    rrInfo;
+   struct iovec   *ioV;
+   RespHdr        *rHdr;
+   char           *mBuff;
+   unsigned int    reqID;
+   int n, rNum, rMax, ioN = 1, xfrLeft = XrdSsiResponder::MaxDirectXfr;
+
+// The message buffer holds the iovec followed by the response headers. Each
+// response needs up to three elements (header, metadata, and data).
+//
+   mBuff = eInfo->getMsgBuff(n);
+   rMax  = (n - (int)sizeof(struct iovec))
+         / (3*(int)sizeof(struct iovec) + (int)sizeof(RespHdr));
+   if (rMax > XrdSsiRRInfo::rbwMax) rMax = XrdSsiRRInfo::rbwMax;
+   if ((rNum = alen/rrSz) > rMax) rNum = rMax;
+   ioV  = (struct iovec *)mBuff;
+   rHdr = (RespHdr *)(mBuff + (3*rMax+1)*sizeof(struct iovec));
+   memset(ioV, 0, sizeof(struct iovec));
+
+// Add each response that is ready
+//
+   for (int i = 0; i < rNum; i++)
+       {memcpy((void *)&rrInfo, args + i*rrSz, rrSz);
+        reqID = rrInfo.Id();
+        if (!(rqstP = rTab.LookUp(reqID))
+        ||  !(respP = rqstP->ReadyResponse(xfrLeft))) continue;
+        xfrLeft -= respP->blen + respP->mdlen;
+
+        memset((void *)rHdr, 0, sizeof(RespHdr));
+        rHdr->rrInfo.Id(reqID);
+        rHdr->rrInfo.Size(sizeof(XrdSsiRRInfoAttn)+respP->mdlen+respP->blen);
+        rHdr->aHdr.tag    = XrdSsiRRInfoAttn::fullResp;
+        rHdr->aHdr.pfxLen = htons(sizeof(XrdSsiRRInfoAttn));
+        rHdr->aHdr.mdLen  = htonl(respP->mdlen);
+        ioV[ioN].iov_base = (void *)rHdr;
+        ioV[ioN].iov_len  = sizeof(RespHdr); ioN++; rHdr++;
+        if (respP->mdlen)
+           {ioV[ioN].iov_base = (void *)respP->mdata;
+            ioV[ioN].iov_len  =         respP->mdlen; ioN++;
+            Stats.Bump(Stats.RspMDBytes, respP->mdlen);
+           }
+        if (respP->blen)
+           {ioV[ioN].iov_base = (void *)respP->buff;
+            ioV[ioN].iov_len  =         respP->blen; ioN++;
+           }
+
+   // The request gets finished off when the response is actually sent
+   //
+        rTab.Del(reqID, false);
+        if (!bcbP) bcbP = new batchCallBack;
+        bcbP->Add(rqstP);
+        Stats.Bump(Stats.RspReady);
+       }
+
+// Setup to have the responses sent, if any
+//
+   DEBUG(gigID <<' ' <<(bcbP ? ioN-1 : 0) <<" iovecs for " <<rNum
+               <<" batched requests");
+   if (!bcbP)
+      {eInfo->setErrInfo(0, "");
+       eInfo->setErrCB((XrdOucEICB *)0);
+      } else {
+       eInfo->setErrCode(ioN);
+       eInfo->setErrCB((XrdOucEICB *)bcbP);
+      }
+   return SFS_DATAVEC;
+}
+
 /******************************************************************************/
 /*                                  o p e n                                   */
 /******************************************************************************/
@@ -588,10 +710,13 @@ int XrdSsiFileSess::SendData(XrdSfsDio         *sfDio,
    unsigned int reqID = rInfo.Id();
    int rc;
 
-// Find the request object
+// Find the request object. If not there we may have encountered an eof in
+// which case we let read() handle it.
 //
    if (!(rqstP = rTab.LookUp(reqID)))
-      return XrdSsiUtils::Emsg(epname, ESRCH, "send", gigID, *eInfo);
+      {if (eofVec.IsSet(reqID)) return SFS_OK;
+       return XrdSsiUtils::Emsg(epname, ESRCH, "send", gigID, *eInfo);
+      }
 
 // Simply effect the send via the request object
 //
@@ -680,6 +805,11 @@ XrdSfsXferSize XrdSsiFileSess::write(XrdSfsFileOffset  offset,    // In
 //
    if (inProg) return writeAdd(buff, blen, reqID);
 
+// Check if this is a batch of requests and handle that
+//
+   if (rInfo.Cmd() == XrdSsiRRInfo::Rbq)
+      return writeBatch(buff, blen, rInfo.Size());
+
 // Make sure this request does not refer to an active request
 //
    if (rTab.LookUp(reqID))
@@ -741,6 +871,96 @@ XrdSfsXferSize XrdSsiFileSess::write(XrdSfsFileOffset  offset,    // In
    return blen;
 }
 
+/******************************************************************************/
+/* Private:                   w r i t e B a t c h                             */
+/******************************************************************************/
+
+XrdSfsXferSize XrdSsiFileSess::writeBatch(const char     *buff,      // In
+                                          XrdSfsXferSize  blen,      // In
+                                          unsigned int    bsz)
+/*
+  Function: Activate each of the requests in a batch of requests.
+
+  Input:    buff      - Address of the buffer holding the batch. Each request
+                        is preceded by its request information (id and size).
+            blen      - The size of the buffer.
+            bsz       - The size of the batch as stated by the client.
+
+  Output:   Returns the number of bytes written upon success and SFS_ERROR o/w.
+
+  Notes:    A batch must arrive in a single write. The whole batch is verified
+            before any of its requests are activated.
+*/
+{
+   static const char *epname = "writeBatch";
+   static const int   hdrSz  = sizeof(XrdSsiRRInfo);
+   XrdSsiRRInfo rrInfo;
+   XrdSsiBVec    idVec;
+   XrdOucBuffer *bP;
+   XrdSsiFileReq *rqstP;
+   const char *bNow, *bUndo, *bEnd = buff + blen;
+   unsigned int reqID;
+   int rSz, bNum = 0;
+
+// Make sure the batch is complete
+//
+   if ((unsigned int)blen != bsz)
+      return XrdSsiUtils::Emsg(epname, EPROTO, "write", gigID, *eInfo);
+
+// Verify each request in the batch
+//
+   for (bNow = buff; bNow < bEnd; bNow += hdrSz + rSz, bNum++)
+       {if (bEnd - bNow < hdrSz)
+           return XrdSsiUtils::Emsg(epname, EPROTO, "write", gigID, *eInfo);
+        memcpy((void *)&rrInfo, bNow, hdrSz);
+        rSz = rrInfo.Size();
+        if (rSz < 0 || rSz > bEnd - bNow - hdrSz)
+           return XrdSsiUtils::Emsg(epname, EPROTO, "write", gigID, *eInfo);
+        if (rSz > maxRSZ)
+           return XrdSsiUtils::Emsg(epname, EFBIG, "write", gigID, *eInfo);
+        if (rTab.LookUp(rrInfo.Id()) || idVec.IsSet(rrInfo.Id()))
+           return XrdSsiUtils::Emsg(epname,EADDRINUSE,"write",gigID,*eInfo);
+        idVec.Set(rrInfo.Id());
+       }
+   DEBUG(gigID <<" batch of " <<bNum <<" requests; bsz=" <<bsz);
+
+// Now activate each request. Like a single write, a zero length request is
+// passed as a one byte buffer.
+//
+   for (bNow = buff; bNow < bEnd; bNow += hdrSz + rSz)
+       {memcpy((void *)&rrInfo, bNow, hdrSz);
+        reqID = rrInfo.Id();
+        rSz   = rrInfo.Size();
+        if (!(bP = BuffPool->Alloc(rSz ? rSz : 1))) break;
+        if (rSz) memcpy(bP->Data(), bNow + hdrSz, rSz);
+           else *(bP->Data()) = 0;
+        bP->SetLen(rSz ? rSz : 1);
+        eofVec.UnSet(reqID);
+        DEBUG(reqID <<':' <<gigID <<" rsz=" <<rSz <<" batched");
+        if (!NewRequest(reqID, bP, 0, rSz)) {bP->Recycle(); break;}
+       }
+
+// If we could not activate all of the requests, cancel the ones we did. The
+// client fails the whole batch so it will not ask for their responses.
+//
+   if (bNow < bEnd)
+      {for (bUndo = buff; bUndo < bNow; bUndo += hdrSz + rrInfo.Size())
+           {memcpy((void *)&rrInfo, bUndo, hdrSz);
+            reqID = rrInfo.Id();
+            if ((rqstP = rTab.LookUp(reqID)))
+               {DEBUG(reqID <<':' <<gigID <<" cancelled; batch failed");
+                rqstP->Finalize();
+                rTab.Del(reqID);
+               }
+           }
+       return XrdSsiUtils::Emsg(epname, ENOMEM, "write", gigID, *eInfo);
+      }
+
+// All done
+//
+   return blen;
+}
+
 /******************************************************************************/
 /* Private:                     w r i t e A d d                               */
 /******************************************************************************/
@@ -100,12 +100,15 @@ private:
                                        {Init(einfo, user, false);}
                         ~XrdSsiFileSess() {} // Recycle() calls Reset()
 
+int                      fctlBatch(int alen, const char *args);
 void                     Init(XrdOucErrInfo &einfo, const char *user, bool forReuse);
 bool                     NewRequest(unsigned int reqid, XrdOucBuffer *oP,
                                     XrdSfsXioHandle *bR, int rSz);
 void                     Reset();
 XrdSfsXferSize           writeAdd(const char *buff, XrdSfsXferSize blen,
                                   unsigned int rid);
+XrdSfsXferSize           writeBatch(const char *buff, XrdSfsXferSize blen,
+                                    unsigned int bsz);
 
 static XrdSysMutex       arMutex;  // Alloc and Recycle protector
 static XrdSsiFileSess   *freeList;
@@ -39,8 +39,9 @@ class XrdSsiRRInfo
 public:
 
 static const unsigned int idMax = 16777215;
+static const int          rbwMax = 16; // Max requests in one Rbw
 
-enum   Opc {Rxq = 0, Rwt = 1, Can = 2};
+enum   Opc {Rxq = 0, Rwt = 1, Can = 2, Rbq = 3, Rbw = 4};
 
 inline void                 Cmd(Opc cmd)
                                {reqCmd  = static_cast<unsigned char>(cmd);}
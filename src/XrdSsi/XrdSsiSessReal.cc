@@ -33,6 +33,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <string>
+#include <time.h>
 #include <sys/types.h>
 #include <netinet/in.h>
   
@@ -49,6 +50,7 @@
 
 #include "XrdSys/XrdSysError.hh"
 #include "XrdSys/XrdSysHeaders.hh"
+#include "XrdSys/XrdSysPthread.hh"
 #include "Xrd/XrdScheduler.hh"
 
 using namespace XrdSsi;
@@ -84,6 +86,27 @@ namespace
    XrdSsiMutex sidMutex;
 
    Atomic(uint32_t) sidVal(0);
+
+// Idle task objects shared by all sessions
+//
+   XrdSsiMutex      poolMutex;
+   XrdSsiTaskReal  *taskPool = 0;
+   int              poolCnt  = 0;
+
+// Sessions whose request batch is waiting for more requests, in the order
+// in which their wait expires (all batches wait the same amount of time).
+// The condition variable is never destroyed as the linger thread never exits.
+//
+   XrdSysCondVar   &lingerCV = *(new XrdSysCondVar(0));
+   XrdSsiSessReal  *lingerFirst = 0;
+   XrdSsiSessReal  *lingerLast  = 0;
+   bool             lingerRun   = false;
+
+   long long NowMS()
+            {struct timespec tNow;
+             clock_gettime(CLOCK_MONOTONIC, &tNow);
+             return tNow.tv_sec*1000LL + tNow.tv_nsec/1000000;
+            }
 }
 
 /******************************************************************************/
@@ -96,6 +119,10 @@ extern XrdScheduler *schedP;
 
 extern XrdSysError   Log;
 extern XrdSsiScale   sidScale;
+extern int           batchSz;
+extern int           batchMS;
+extern int           batchRQ;
+extern int           taskMax;
 }
 
 /******************************************************************************/
@@ -119,6 +146,251 @@ void  DoIt() {sessP->Lock();
 private:
 XrdSsiSessReal *sessP;
 };
+
+/******************************************************************************/
+
+void *LingerThread(void *carg)
+{
+   XrdSsiSessReal *sP;
+   long long tNow;
+
+// Flush each batch once it has waited long enough for more requests
+//
+   lingerCV.Lock();
+   while(true)
+        {if (!(sP = lingerFirst)) {lingerCV.Wait(); continue;}
+         if ((tNow = NowMS()) < sP->LingerEnd())
+            {lingerCV.WaitMS(static_cast<int>(sP->LingerEnd() - tNow));
+             continue;
+            }
+         if (!(lingerFirst = sP->nextLinger)) lingerLast = 0;
+         lingerCV.UnLock();
+         sP->Linger();
+         lingerCV.Lock();
+        }
+   return 0;
+}
+}
+
+/******************************************************************************/
+/*                       X r d S s i S e s s B a t c h                        */
+/******************************************************************************/
+
+// A batch of small requests sent to a session's endpoint in a single write.
+// Each request is preceded by its request information. The write completion
+// is reflected to every task in the batch as its own write completion.
+
+class XrdSsiSessBatch : public XrdCl::ResponseHandler
+{
+public:
+
+static XrdSsiSessBatch *Alloc();
+
+       void             Add(XrdSsiTaskReal *tP, const char *reqBuff,
+                            int reqBlen, unsigned short tmo);
+
+       void             Demux(XrdCl::AnyObject *response);
+
+       bool             Fits(int reqBlen)
+                            {return bLen+hdrSz+reqBlen <= batchSz;}
+
+       bool             GetResponses();
+
+       void             HandleResponse(XrdCl::XRootDStatus *status,
+                                       XrdCl::AnyObject    *response);
+
+static const int        hdrSz = sizeof(XrdSsiRRInfo);
+
+XrdSsiSessReal         *sessP;
+char                   *bBuff;
+int                     bLen;
+int                     bNum;
+uint32_t                firstID;
+unsigned short          tmOut;
+bool                    inFetch;
+
+private:
+                        XrdSsiSessBatch() : sessP(0),
+                                            bBuff((char *)malloc(batchSz)),
+                                            bLen(0), bNum(0), firstID(0),
+                                            tmOut(0), inFetch(false),
+                                            taskFirst(0), taskLast(0),
+                                            next(0) {}
+                       ~XrdSsiSessBatch() {if (bBuff) free(bBuff);}
+
+static XrdSsiMutex      freeMutex;
+static XrdSsiSessBatch *freeBatch;
+static int              freeNum;
+static const int        freeMax = 32;
+
+XrdSsiTaskReal         *taskFirst;
+XrdSsiTaskReal         *taskLast;
+XrdSsiSessBatch        *next;
+};
+
+XrdSsiMutex      XrdSsiSessBatch::freeMutex;
+XrdSsiSessBatch *XrdSsiSessBatch::freeBatch = 0;
+int              XrdSsiSessBatch::freeNum   = 0;
+
+/******************************************************************************/
+/*                      X r d S s i S e s s B a t c h : : A d d               */
+/******************************************************************************/
+  
+void XrdSsiSessBatch::Add(XrdSsiTaskReal *tP, const char *reqBuff,
+                          int reqBlen, unsigned short tmo)
+{
+   XrdSsiRRInfo rrInfo;
+
+// Append the request information followed by the request itself. Without a
+// buffer we still account for the request as the whole batch will fail.
+//
+   rrInfo.Id(tP->ID());
+   rrInfo.Size(reqBlen);
+   if (bBuff)
+      {memcpy(bBuff+bLen, rrInfo.Data(), hdrSz);
+       if (reqBlen) memcpy(bBuff+bLen+hdrSz, reqBuff, reqBlen);
+      }
+   bLen += hdrSz + reqBlen;
+
+// The batch must wait as long as the most patient request (zero is forever)
+//
+   if (!bNum) {tmOut = tmo; firstID = tP->ID();}
+      else if (tmOut && (!tmo || tmo > tmOut)) tmOut = tmo;
+   bNum++;
+
+// Chain the task into the batch
+//
+   tP->batchNext = 0;
+   if (taskLast) taskLast->batchNext = tP;
+      else       taskFirst = tP;
+   taskLast = tP;
+}
+
+/******************************************************************************/
+/*                    X r d S s i S e s s B a t c h : : A l l o c             */
+/******************************************************************************/
+  
+XrdSsiSessBatch *XrdSsiSessBatch::Alloc()
+{
+   XrdSsiSessBatch *bP;
+
+   freeMutex.Lock();
+   if ((bP = freeBatch)) {freeBatch = bP->next; freeNum--;}
+   freeMutex.UnLock();
+   return (bP ? bP : new XrdSsiSessBatch);
+}
+
+/******************************************************************************/
+/*                    X r d S s i S e s s B a t c h : : D e m u x             */
+/******************************************************************************/
+
+// Hand each task the response that came back for it. Each response is preceded
+// by the request information of its task (id and response length).
+  
+void XrdSsiSessBatch::Demux(XrdCl::AnyObject *response)
+{
+   XrdCl::Buffer  *buffP = 0;
+   XrdSsiTaskReal *tP;
+   XrdSsiRRInfo    rrInfo;
+   const char     *bNow, *bEnd;
+   unsigned int    rID, rSz;
+
+   response->Get(buffP);
+   if (!buffP || !(bNow = buffP->GetBuffer())) return;
+   bEnd = bNow + buffP->GetSize();
+
+   while(bEnd - bNow >= hdrSz)
+        {memcpy((void *)&rrInfo, bNow, hdrSz);
+         rID = rrInfo.Id(); rSz = rrInfo.Size();
+         if (rSz > (unsigned int)(bEnd - bNow - hdrSz)) break;
+         for (tP = taskFirst; tP && tP->ID() != (int)rID; tP = tP->batchNext) {}
+         if (tP && !tP->batchResp) tP->SetBatchResp(bNow + hdrSz, rSz);
+         bNow += hdrSz + rSz;
+        }
+}
+
+/******************************************************************************/
+/*             X r d S s i S e s s B a t c h : : G e t R e s p o n s e s      */
+/******************************************************************************/
+
+// Ask for the responses of the batch that are ready in a single round trip.
+
+bool XrdSsiSessBatch::GetResponses()
+{
+   XrdCl::XRootDStatus epStatus;
+   XrdCl::Buffer       qBuff(hdrSz * (bNum < XrdSsiRRInfo::rbwMax
+                                     ? bNum : XrdSsiRRInfo::rbwMax));
+   XrdSsiTaskReal     *tP = taskFirst;
+   XrdSsiRRInfo        rrInfo;
+
+// List the tasks we want responses for; the rest will ask on their own
+//
+   for (int i = 0; tP && i < XrdSsiRRInfo::rbwMax; tP = tP->batchNext, i++)
+       {rrInfo.Id(tP->ID()); rrInfo.Cmd(XrdSsiRRInfo::Rbw);
+        memcpy(qBuff.GetBuffer(i*hdrSz), rrInfo.Data(), hdrSz);
+       }
+
+// Issue the query. The response comes back to us as well and may do so before
+// the call returns, so we must not reference ourselves if it was issued.
+//
+   inFetch  = true;
+   epStatus = sessP->epFile.Fcntl(qBuff, (XrdCl::ResponseHandler *)this, tmOut);
+   if (epStatus.IsOK()) return true;
+   inFetch = false;
+   return false;
+}
+
+/******************************************************************************/
+/*           X r d S s i S e s s B a t c h : : H a n d l e R e s p o n s e    */
+/******************************************************************************/
+  
+void XrdSsiSessBatch::HandleResponse(XrdCl::XRootDStatus *status,
+                                     XrdCl::AnyObject    *response)
+{
+   XrdSsiTaskReal *tP = taskFirst, *ntP;
+
+// Once the batch has been written, fetch whatever responses are ready. We must
+// not reference ourselves once the query has been issued.
+//
+   if (!inFetch && status->IsOK() && GetResponses())
+      {delete status;
+       if (response) delete response;
+       return;
+      }
+
+// If this is the end of the query, attach the responses to their tasks. The
+// write itself succeeded, so the status of the query is of no consequence as
+// the tasks without a response ask for it on their own.
+//
+   if (inFetch)
+      {if (status->IsOK() && response) Demux(response);
+       *status = XrdCl::XRootDStatus();
+       inFetch = false;
+      }
+
+// Reflect the write status to each task. We must not reference a task after
+// handing it its event as it may be finished and reused right away.
+//
+   while(tP)
+        {ntP = tP->batchNext;
+         tP->batchNext = 0;
+         tP->HandleResponse(new XrdCl::XRootDStatus(*status), 0);
+         tP = ntP;
+        }
+   delete status;
+   if (response) delete response;
+
+// Recycle this batch unless it never got a buffer
+//
+   bLen = bNum = 0; taskFirst = taskLast = 0;
+   freeMutex.Lock();
+   if (bBuff && freeNum < freeMax)
+      {next = freeBatch; freeBatch = this; freeNum++;
+       freeMutex.UnLock();
+      } else {
+       freeMutex.UnLock();
+       delete this;
+      }
 }
   
 /******************************************************************************/
@@ -136,6 +408,85 @@ XrdSsiSessReal::~XrdSsiSessReal()
    while((tP = freeTask)) {freeTask = tP->attList.next; delete tP;}
 }
 
+/******************************************************************************/
+/*                                 B a t c h                                  */
+/******************************************************************************/
+
+// Must be called with sessMutex locked!
+
+bool XrdSsiSessReal::Batch(XrdSsiTaskReal *tP, const char *reqBuff,
+                           int reqBlen, unsigned short tmo)
+{
+// Batch only small requests and only if there is a chance that others will
+// join them: either we are sending the requests that queued up during the open
+// or we may wait a bit for more requests.
+//
+   if (!batchSz || reqBlen > batchRQ || (!batchMS && !bulkSend)) return false;
+
+// Send the current batch if this request won't fit and start a new one
+//
+   if (batchP && !batchP->Fits(reqBlen)) FlushBatch();
+   if (!batchP) {batchP = XrdSsiSessBatch::Alloc(); batchBeg = NowMS();}
+
+// Add the request to the batch
+//
+   batchP->Add(tP, reqBuff, reqBlen, tmo);
+
+// When sending requests after an open, the caller sends the batch. Otherwise,
+// send it if it is full or arrange to have it sent after it waited long enough.
+//
+   if (!bulkSend)
+      {if (!batchP->Fits(0)) FlushBatch();
+          else if (!lingerQ) QueueLinger();
+      }
+   return true;
+}
+
+/******************************************************************************/
+/*                            F l u s h B a t c h                             */
+/******************************************************************************/
+
+// Must be called with sessMutex locked!
+
+void XrdSsiSessReal::FlushBatch()
+{
+   EPNAME("FlushBatch");
+   XrdCl::XRootDStatus epStatus;
+   XrdSsiRRInfo        rrInfo;
+   XrdSsiSessBatch    *bP = batchP;
+
+// Make sure we have something to send
+//
+   if (!bP) return;
+   batchP = 0;
+
+// Construct the info for the batch; the size is that of the whole batch
+//
+   bP->sessP = this;
+   rrInfo.Id(bP->firstID); rrInfo.Cmd(XrdSsiRRInfo::Rbq);
+   rrInfo.Size(bP->bLen);
+   DEBUG("Sending batch of " <<bP->bNum <<" requests; len=" <<bP->bLen);
+
+// If we could not get a buffer for the batch, fail every task in it
+//
+   if (!bP->bBuff)
+      {Log.Emsg("FlushBatch", ENOMEM, "allocate request batch buffer");
+       epStatus = XrdCl::XRootDStatus(XrdCl::stError,XrdCl::errOSError,ENOMEM);
+       bP->HandleResponse(new XrdCl::XRootDStatus(epStatus), 0);
+       return;
+      }
+
+// Issue the write. If it fails, reflect the error to every task in the batch
+// (this is done asynchronously) and stop reusing this session.
+//
+   epStatus = epFile.Write(rrInfo.Info(), (uint32_t)bP->bLen, bP->bBuff,
+                           (XrdCl::ResponseHandler *)bP, bP->tmOut);
+   if (!epStatus.IsOK())
+      {noReuse = true;
+       bP->HandleResponse(new XrdCl::XRootDStatus(epStatus), 0);
+      }
+}
+
 /******************************************************************************/
 /*                           I n i t S e s s i o n                            */
 /******************************************************************************/
@@ -154,6 +505,12 @@ void XrdSsiSessReal::InitSession(XrdSsiServReal *servP, const char *sName,
    isHeld    = hold;
    inOpen    = false;
    noReuse   = false;
+   bulkSend  = false;
+   lingerQ   = false;
+   batchP    = 0;
+   batchBeg  = 0;
+   lingerTm  = 0;
+   nextLinger= 0;
    if (resKey) {free(resKey); resKey = 0;}
    if (sessName) free(sessName);
    sessName  = (sName ? strdup(sName) : 0);
@@ -172,6 +529,36 @@ void XrdSsiSessReal::InitSession(XrdSsiServReal *servP, const char *sName,
       }
 }
 
+/******************************************************************************/
+/*                                L i n g e r                                 */
+/******************************************************************************/
+
+// Called by the linger thread once our batch has waited long enough.
+  
+void XrdSsiSessReal::Linger()
+{
+   sessMutex.Lock();
+   lingerQ = false;
+
+// If the batch we were queued for was sent and a new one started since then,
+// let the new one wait its full time. Otherwise, send the batch.
+//
+   if (batchP)
+      {if (NowMS() < batchBeg + batchMS)
+          {QueueLinger();
+           sessMutex.UnLock();
+           return;
+          }
+       FlushBatch();
+      }
+
+// While we were queued all tasks may have finished. If so, do the unprovision
+// that was deferred (it returns with the sessMutex unlocked).
+//
+   if (!inOpen && !isHeld && !attBase) Unprovision();
+      else sessMutex.UnLock();
+}
+
 /******************************************************************************/
 /* Private:                      N e w T a s k                                */
 /******************************************************************************/
@@ -186,10 +573,15 @@ XrdSsiTaskReal *XrdSsiSessReal::NewTask(XrdSsiRequest *reqP)
 // Allocate a task object for this request
 //
    if ((tP = freeTask)) freeTask = tP->attList.next;
-      else {if (!alocLeft || !(tP = new XrdSsiTaskReal(this)))
+      else {if (!alocLeft)
                {XrdSsiUtils::RetErr(*reqP, "Too many active requests.", EMLINK);
                 return 0;
                }
+            poolMutex.Lock();
+            if ((tP = taskPool)) {taskPool = tP->attList.next; poolCnt--;}
+            poolMutex.UnLock();
+            if (tP) tP->SetSession(this);
+               else tP = new XrdSsiTaskReal(this);
             alocLeft--;
            }
 
@@ -254,6 +646,32 @@ bool XrdSsiSessReal::Provision(XrdSsiRequest *reqP, const char *epURL)
    return true;
 }
 
+/******************************************************************************/
+/* Private:                  Q u e u e L i n g e r                            */
+/******************************************************************************/
+  
+void XrdSsiSessReal::QueueLinger() // sessMutex locked!
+{
+   lingerQ    = true;
+   lingerTm   = batchBeg + batchMS;
+   nextLinger = 0;
+
+// Add ourselves to the end of the linger queue, starting the linger thread if
+// it is not running yet. The thread needs waking only if the queue was empty.
+//
+   lingerCV.Lock();
+   if (lingerLast) lingerLast->nextLinger = this;
+      else {lingerFirst = this; lingerCV.Signal();}
+   lingerLast = this;
+   if (!lingerRun)
+      {pthread_t tid;
+       if (XrdSysThread::Run(&tid, LingerThread, 0, 0, "SSI batch linger"))
+          Log.Emsg("QueueLinger", errno, "start batch linger thread");
+          else lingerRun = true;
+      }
+   lingerCV.UnLock();
+}
+
 /******************************************************************************/
 /* Private:                      R e l T a s k                                */
 /******************************************************************************/
@@ -266,13 +684,12 @@ void XrdSsiSessReal::RelTask(XrdSsiTaskReal *tP) // sessMutex locked!
 //
    DEBUG((isHeld ? "Recycling":"Deleting")<<" task="<<tP<<" id=" <<tP->ID());
 
-// Delete this task or place it on the free list
+// Place this task on the free list. It goes to the shared pool once we are
+// shutdown unless we are held, in which case we will likely use it again.
 //
-   if (!isHeld) delete tP;
-      else {tP->ClrEvent();
-            tP->attList.next = freeTask;
-            freeTask = tP;
-           }
+   tP->ClrEvent();
+   tP->attList.next = freeTask;
+   freeTask = tP;
 }
 
 /******************************************************************************/
@@ -312,9 +729,15 @@ void XrdSsiSessReal::Shutdown(XrdCl::XRootDStatus &epStatus, bool onClose)
 {
    XrdSsiTaskReal *tP, *ntP = freeTask;
 
-// Delete all acccumulated tasks
+// Move all acccumulated tasks to the shared pool, deleting any excess
 //
-   while((tP = ntP)) {ntP = tP->attList.next; delete tP;}
+   poolMutex.Lock();
+   while((tP = ntP))
+        {ntP = tP->attList.next;
+         if (poolCnt >= taskMax) delete tP;
+            else {tP->attList.next = taskPool; taskPool = tP; poolCnt++;}
+        }
+   poolMutex.UnLock();
    freeTask = 0;
 
 // If the close failed then we cannot recycle this object as it is not reusable
@@ -364,10 +787,10 @@ void XrdSsiSessReal::TaskFinished(XrdSsiTaskReal *tP)
 
 // if we can shutdown, then unprovision which will drive a shutdown. Note
 // that Unprovision() returns without the sessMutex, otherwise we must
-// unlock it before we return.
+// unlock it before we return. A queued linger defers this as well.
 //
    if (!inOpen)
-      {if (!isHeld && !attBase) Unprovision();
+      {if (!isHeld && !attBase && !lingerQ) Unprovision();
           else sessMutex.UnLock();
       } else {
        DEBUG("Unprovision deferred for " <<sessName);
@@ -390,7 +813,8 @@ void XrdSsiSessReal::UnHold(bool cleanup)
 // Turn off the hold flag and if we have no attached tasks, schedule shutdown
 //
    isHeld = false;
-   if (cleanup && !attBase) XrdSsi::schedP->Schedule(new CleanUp(this));
+   if (cleanup && !attBase && !lingerQ)
+      XrdSsi::schedP->Schedule(new CleanUp(this));
 }
 
 /******************************************************************************/
@@ -483,12 +907,17 @@ bool XrdSsiSessReal::XeqEvent(XrdCl::XRootDStatus *status,
 
 // Execute each pending request. Make sure not to reference the task object
 // chain pointer after invoking SendRequest() as it may become invalid.
+//
+// Requests that are small enough are sent together in batches.
 //
    ztP = attBase;
+   bulkSend = true;
    do {ntP = tP->attList.next;
        if (!tP->SendRequest(sessNode)) noReuse = true;
        tP = ntP;
       } while(tP != ztP);
+   bulkSend = false;
+   FlushBatch();
 
 // We are done, field the next event
 //
@@ -39,6 +39,7 @@
 #include "XrdSys/XrdSysPthread.hh"
 
 class XrdSsiServReal;
+class XrdSsiSessBatch;
 class XrdSsiTaskReal;
 
 class XrdSsiSessReal : public XrdSsiEvent
@@ -46,11 +47,21 @@ class XrdSsiSessReal : public XrdSsiEvent
 public:
 
 XrdSsiSessReal  *nextSess;
+XrdSsiSessReal  *nextLinger;
+
+        bool     Batch(XrdSsiTaskReal *tP, const char *reqBuff, int reqBlen,
+                       unsigned short tmo);
+
+        void     FlushBatch();
 
 const char      *GetKey() {return resKey;}
 
 uint32_t         GetSID() {return sessID;}
 
+        void     Linger();
+
+        long long LingerEnd() {return lingerTm;}
+
         void     InitSession(XrdSsiServReal *servP,
                              const char     *sName,
                              int             uent,
@@ -86,7 +97,7 @@ XrdSsiMutex     *MutexP() {return &sessMutex;}
                                 int             uent,
                                 bool            hold=false)
                                : sessMutex(XrdSsiMutex::Recursive),
-                                 resKey(0), sessName(0), sessNode(0)
+                                 batchP(0), resKey(0), sessName(0), sessNode(0)
                                  {InitSession(servP, sName, uent, hold, true);}
 
                 ~XrdSsiSessReal();
@@ -95,6 +106,7 @@ XrdCl::File         epFile;
 
 private:
 XrdSsiTaskReal  *NewTask(XrdSsiRequest *reqP);
+void             QueueLinger();
 void             RelTask(XrdSsiTaskReal *tP);
 void             Shutdown(XrdCl::XRootDStatus &epStatus, bool onClose);
 
@@ -102,6 +114,7 @@ XrdSsiMutex      sessMutex;
 XrdSsiServReal  *myService;
 XrdSsiTaskReal  *attBase;
 XrdSsiTaskReal  *freeTask;
+XrdSsiSessBatch *batchP;
 XrdSsiRequest   *requestP;
 char            *resKey;
 char            *sessName;
@@ -109,9 +122,13 @@ char            *sessNode;
 uint32_t         sessID;
 uint32_t         nextTID;
 uint32_t         alocLeft;
+long long        batchBeg; // When the current batch was started (ms)
+long long        lingerTm; // When the queued linger expires (ms)
 int16_t          uEnt;     // User index for scaling
 bool             isHeld;
 bool             inOpen;
 bool             noReuse;
+bool             bulkSend; // Pending requests are being sent after open
+bool             lingerQ;  // Session is on the linger queue
 };
 #endif
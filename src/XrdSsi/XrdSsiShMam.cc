@@ -33,6 +33,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sched.h>
 #include <time.h>
 #include <unistd.h>
 #include <sys/file.h>
@@ -76,7 +77,7 @@ struct ShmInfo
        int   highUse;       // Offset to high memory that is used
        char  reUse;         // When non-zero items can be reused (r/o locking)
        char  multW;         // When non-zero multiple writers are allowed
-       char  rsvd1;
+       char  seqLk;         // When non-zero index entries have seq counters
        char  rsvd2;
        int   maxKeys;       // Maximum number of keys
        int   maxKeySz;      // Longest allowed key (not including null byte)
@@ -98,6 +99,23 @@ struct ShmInfo
 
 int       PageMask = ~(sysconf(_SC_PAGESIZE)-1);
 int       PageSize =   sysconf(_SC_PAGESIZE);
+
+// Lock-free readers retry this many times before locking the file
+//
+static const int SeqTries = 64;
+
+// Size of the sequence counter array for an index (rounded to a doubleword)
+//
+inline int SeqSize(int slots) {return (slots*sizeof(int)+7)/8*8;}
+
+// Maps with sequence counters record the implementation name with this suffix.
+// Older versions do not update the counters, so the name mismatch keeps them
+// from attaching such a map and changing it under lock-free readers.
+//
+static const char SeqImpl[] = "+seqlock";
+
+inline void ImplName(char *buff, int blen, const char *impl, bool seqlk)
+                    {snprintf(buff, blen, "%s%s", impl, (seqlk ? SeqImpl : ""));}
 }
 
 /******************************************************************************/
@@ -237,6 +255,9 @@ XrdSsiShMam::XrdSsiShMam(XrdSsiShMat::NewParms &parms) : XrdSsiShMat(parms)
    lockRO    = true;
    lockRW    = true;
    reUse     = false;
+   seqLk     = false;
+   seqRO     = false;
+   shmSeq    = 0;
    useAtomic = true;
 
 // Initialize r/w mutexes
@@ -287,8 +308,13 @@ bool XrdSsiShMam::AddItem(void *newdata, void *olddata, const char *key,
       {if (olddata) memcpy(olddata, ITEM_VAL(theItem), shmTypeSz);
        if (!replace) {errno = EEXIST; return false;}
        if (reUse)
-          {memcpy(ITEM_VAL(theItem), newdata, shmTypeSz);
+          {if (seqLk) SeqBeg(hEnt);
+           memcpy(ITEM_VAL(theItem), newdata, shmTypeSz);
            if (syncOn) Updated(ITEM_VOF(theItem), shmTypeSz);
+           if (seqLk)
+              {SeqEnd(hEnt);
+               if (syncOn) Updated(SHMOFFS(&shmSeq[hEnt]));
+              }
            errno = EEXIST;
            return true;
           }
@@ -324,11 +350,16 @@ bool XrdSsiShMam::AddItem(void *newdata, void *olddata, const char *key,
            }
 
    iOff = SHMOFFS(newItem);
+   if (seqLk) SeqBeg(hEnt);
    if (prvItem) Atomic_SET_STRICT(prvItem->next, iOff); // Atomic
       else {SHMINFO(slotsUsed)++;
                 Atomic_SET_STRICT(shmIndex[hEnt],iOff); // Atomic
             if (syncOn) Updated(SHMOFFS(&shmIndex[hEnt]));
            }
+   if (seqLk)
+      {SeqEnd(hEnt);
+       if (syncOn) Updated(SHMOFFS(&shmSeq[hEnt]));
+      }
 
 // Indicate which things we changed if we have syncing
 //
@@ -353,6 +384,7 @@ bool XrdSsiShMam::Attach(int tout, bool isrw)
    FileHelper  fileHelp(this);
    XLockHelper lockInfo(this, (isrw ? RWLock : ROLock));
    struct stat Stat1, Stat2;
+   char implName[sizeof(ShmInfo::myName)];
    int mMode, oMode;
    union {int *intP; Atomic(int) *antP;} xntP;
 
@@ -404,8 +436,9 @@ bool XrdSsiShMam::Attach(int tout, bool isrw)
 
 // Verify tha the objects in this mapping are compatible with this object
 //
+   ImplName(implName, sizeof(implName), shmImpl, SHMINFO(seqLk) != 0);
    if (SHMINFO(typeSz) != shmTypeSz    || strcmp(shmType, SHMINFO(typeID))
-   || strcmp(shmImpl, SHMINFO(myName)) || shmHash != SHMINFO(hashID))
+   || strcmp(implName, SHMINFO(myName)) || shmHash != SHMINFO(hashID))
       {errno = EDOM; return false;}
 
 // Copy out the information we can use locally
@@ -417,6 +450,10 @@ bool XrdSsiShMam::Attach(int tout, bool isrw)
    shmSlots   = SHMINFO(slots);
    shmItemSz  = SHMINFO(itemSz);
    shmInfoSz  = SHMINFO(infoSz);
+   if (SHMINFO(seqLk))
+      {xntP.intP  = SHMADDR(int, SHMINFO(index) - SeqSize(shmSlots));
+       shmSeq     = xntP.antP;
+      }
 
 // Now, there is a loophole here as the file could have been exported while
 // we were trying to attach it. If this happened, the inode would change.
@@ -445,7 +482,7 @@ bool XrdSsiShMam::Create(XrdSsiShMat::CRZParms &parms)
    static const int crMode = S_IRWXU|S_IRWXG|S_IROTH;
    FileHelper fileHelp(this);
    ShmInfo theInfo;
-   int n, maxEnts, totSz, indexSz;
+   int n, maxEnts, totSz, indexSz, seqSz;
    union {int *intP; Atomic(int) *antP;} xntP;
 
 // Validate parameter list values
@@ -459,6 +496,7 @@ bool XrdSsiShMam::Create(XrdSsiShMat::CRZParms &parms)
 //
    reUse = (parms.reUse <= 0 ? false : true);
    multW = (parms.multW <= 0 ? false : true);
+   seqLk = (parms.seqLk <= 0 || !reUse ? false : true);
   
 // Clear the memory segment information we will be constructing
 //
@@ -485,9 +523,14 @@ bool XrdSsiShMam::Create(XrdSsiShMat::CRZParms &parms)
    indexSz = parms.indexSz*sizeof(int);
    indexSz = (indexSz+7)/8*8;
 
+// Calculate the amount we need for the sequence counters, if any. These sit
+// right below the index and have one counter for each index entry.
+//
+   seqSz = (seqLk ? SeqSize(parms.indexSz) : 0);
+
 // Compute total size and adjust it to be a multiple of the page size
 //
-   totSz = totSz + indexSz + shmInfoSz;
+   totSz = totSz + indexSz + seqSz + shmInfoSz;
    totSz = (totSz/PageSize+1)*PageSize;
 
 // Generate the hashID if not specified
@@ -499,15 +542,16 @@ bool XrdSsiShMam::Create(XrdSsiShMat::CRZParms &parms)
    theInfo.index    = totSz-indexSz;
    theInfo.slots    = parms.indexSz;
    theInfo.typeSz   = shmTypeSz;
-   theInfo.highUse  = theInfo.index;
+   theInfo.highUse  = theInfo.index - seqSz;
    theInfo.reUse    = reUse;
    theInfo.multW    = multW;
+   theInfo.seqLk    = seqLk;
    theInfo.keyPos   = keyPos = shmTypeSz + sizeof(MemItem);
    theInfo.maxKeys  = maxEnts;
    theInfo.maxKeySz = maxKLen = parms.maxKLen;
    theInfo.hashID   = shmHash;
    strncpy(theInfo.typeID, shmType, sizeof(theInfo.typeID)-1);
-   strncpy(theInfo.myName, shmImpl, sizeof(theInfo.myName)-1);
+   ImplName(theInfo.myName, sizeof(theInfo.myName), shmImpl, seqLk);
 
 // Create the new filename of the new file we will create
 //
@@ -542,6 +586,8 @@ bool XrdSsiShMam::Create(XrdSsiShMat::CRZParms &parms)
    memcpy(shmBase, &theInfo, sizeof(theInfo));
    xntP.intP  = SHMADDR(int, SHMINFO(index)); shmIndex = xntP.antP;
    shmSlots = parms.indexSz;
+   if (seqLk) {xntP.intP = SHMADDR(int, SHMINFO(highUse)); shmSeq = xntP.antP;}
+      else shmSeq = 0;
 
 // A created table has, by definition, a single writer until it is exported.
 // So, we simply keep the r/w lock on the file until we export the file. Other
@@ -592,11 +638,16 @@ bool XrdSsiShMam::DelItem(void *data, const char *key, int hash)
 //
    iOff = theItem->next;
    SHMINFO(itemCount)--;
+   if (seqLk) SeqBeg(hEnt);
    if (prvItem)  Atomic_SET_STRICT(prvItem->next, iOff); // Atomic
       else {if (!iOff) SHMINFO(slotsUsed)--;
                  Atomic_SET_STRICT(shmIndex[hEnt],iOff); // Atomic
            }
    RetItem(theItem);
+   if (seqLk)
+      {SeqEnd(hEnt);
+       if (syncOn) Updated(SHMOFFS(&shmSeq[hEnt]));
+      }
 
 // Indicate the things we updated if need be
 //
@@ -624,6 +675,7 @@ void XrdSsiShMam::Detach()
    if (shmSize)    {munmap(shmBase, shmSize); shmSize = 0;}
    if (shmTemp)    {free(shmTemp); shmTemp = 0;}
    shmIndex = 0;
+   shmSeq   = 0;
 }
 
 /******************************************************************************/
@@ -819,6 +871,56 @@ int XrdSsiShMam::Find(XrdSsiShMam::MemItem  *&theItem,
    return 0;
 }
 
+/******************************************************************************/
+/* Private:                      F i n d S e q                                */
+/******************************************************************************/
+
+// Returns 1 if the item was found and its data copied, 0 if it does not exist,
+// and -1 if the index entry changed during the lookup, which must be retried.
+// As no file lock is held, items may be reused under us. So, every offset is
+// checked before use and the chain length is limited, the key comparison is
+// bounded, and nothing we read counts unless the sequence counter is unchanged.
+//
+int XrdSsiShMam::FindSeq(void *data, const char *key, int &hash)
+{
+   MemItem *theItem;
+   int hEnt, iOff, seqNum, iCnt = 0, rc = 0;
+
+// If no hash was supplied, get one
+//
+   if (!hash) hash = HashVal(key);
+
+// Compute index table entry and get its sequence counter. An odd counter
+// means that a writer is updating this entry.
+//
+   hEnt = (unsigned int)hash % shmSlots;
+   if (hEnt == 0) hEnt = 1;
+   seqNum = Atomic_GET_STRICT(shmSeq[hEnt]);
+   if (seqNum & 1) return -1;
+   iOff = Atomic_GET_STRICT(shmIndex[hEnt]);
+
+// Find the item
+//
+   while(iOff)
+      {if (iOff < shmInfoSz || iOff > shmSize - shmItemSz
+       ||  (iOff - shmInfoSz) % shmItemSz || ++iCnt > SHMINFO(maxKeys))
+          return -1;
+       theItem = SHMADDR(MemItem, iOff);
+       if (hash == theItem->hash && !strncmp(key,ITEM_KEY(theItem),maxKLen+1))
+          {if (data) memcpy(data, ITEM_VAL(theItem), shmTypeSz);
+           rc = 1;
+           break;
+          }
+       iOff = Atomic_GET_STRICT(theItem->next);
+      }
+
+// What we read is only valid if no writer touched the entry in the meantime
+//
+   Atomic_FENCE_ACQ();
+   if (Atomic_GET(shmSeq[hEnt]) != seqNum) return -1;
+   return rc;
+}
+
 /******************************************************************************/
 /* Private:                        F l u s h                                  */
 /******************************************************************************/
@@ -856,7 +958,7 @@ bool XrdSsiShMam::GetItem(void *data, const char *key, int hash)
 {
    XLockHelper lockInfo(this, ROLock);
    MemItem  *theItem, *prvItem;
-   int hEnt;
+   int hEnt, rc;
 
 // Make sure we can get an item
 //
@@ -867,6 +969,19 @@ bool XrdSsiShMam::GetItem(void *data, const char *key, int hash)
 //
    if (verNum != SHMINFO(verNum)) ReMap(ROLock);
 
+// If index entries have sequence counters, look up the item without locking
+// the file. Should the entry keep changing under us, lock the file after all.
+//
+   if (seqRO)
+      {for (int i = 0; i < SeqTries; i++)
+           {if ((rc = FindSeq(data, key, hash)) >= 0)
+               {if (rc) return true;
+                errno = ENOENT; return false;
+               }
+            if (i & 1) sched_yield();
+           }
+      }
+
 // Lock the file if we have multiple writers or recycling items
 //
    if (lockRO && !lockInfo.FLock()) return false;
@@ -995,6 +1110,7 @@ int  XrdSsiShMam::Info(const char *vname, char *buff, int blen)
    if (!strcmp(vname, "maxkeylen")) return SHMINFO(maxKeySz);
    if (!strcmp(vname, "multw"))     return multW;
    if (!strcmp(vname, "reuse"))     return reUse;
+   if (!strcmp(vname, "seqlock"))   return seqLk;
    if (!strcmp(vname, "type"))
       {int n = strlen(SHMINFO(typeID));
        if (!buff || blen < n) {errno = EMSGSIZE; return -1;}
@@ -1135,6 +1251,7 @@ bool XrdSsiShMam::Resize(XrdSsiShMat::CRZParms &parms)
    if (!parms.maxKLen)  parms.maxKLen = maxKLen;
    if (parms.reUse < 0) parms.reUse   = reUse;
    if (parms.multW < 0) parms.multW   = multW;
+   if (parms.seqLk < 0) parms.seqLk   = seqLk;
 
 // Create the new target file
 //
@@ -1204,6 +1321,8 @@ void XrdSsiShMam::SetLocking(bool isrw)
 //
 #ifdef NEED_ATOMIC_MUTEX
    lockRO   = lockRW = true;
+   seqLk    = SHMINFO(seqLk) != 0;
+   seqRO    = false;
 #else
 // A reader must lock the file R/O if objects are being reused
 //
@@ -1214,6 +1333,13 @@ void XrdSsiShMam::SetLocking(bool isrw)
 //
    multW  = SHMINFO(multW);
    lockRW = reUse || multW;
+
+// However, a reader need not lock the file when index entries have sequence
+// counters. It simply retries the lookup should the entry change under it.
+// Writers still update the counters while holding the file lock.
+//
+   seqLk  = SHMINFO(seqLk) != 0;
+   seqRO  = seqLk && lockRO;
 #endif
 }
   
@@ -1259,10 +1385,15 @@ void XrdSsiShMam::SwapMap(XrdSsiShMam &newMap)
    newMap.shmBase  =  0;
    shmIndex        = newMap.shmIndex;
    newMap.shmIndex =  0;
+   shmSeq          = newMap.shmSeq;
+   newMap.shmSeq   =  0;
+   shmSlots        = newMap.shmSlots;
    lockRO          = newMap.lockRO;
    lockRW          = newMap.lockRW;
    reUse           = newMap.reUse;
    multW           = newMap.multW;
+   seqLk           = newMap.seqLk;
+   seqRO           = newMap.seqRO;
    verNum          = newMap.verNum;
 }
 
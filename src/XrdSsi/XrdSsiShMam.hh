@@ -79,12 +79,17 @@ struct   MemItem {int hash; Atomic(int) next;};
 
 bool     ExportIt(bool fLocked);
 int      Find(MemItem  *&theItem, MemItem *&prvItem, const char *key, int &hash);
+int      FindSeq(void *data, const char *key, int &hash);
 bool     Flush();
 int      HashVal(const char *key);
 bool     Lock(bool doRW=false, bool nowait=false);
 MemItem *NewItem();
 bool     ReMap(LockType iHave);
 void     RetItem(MemItem *iP);
+inline
+void     SeqBeg(int hEnt) {Atomic_INC(shmSeq[hEnt]); Atomic_FENCE_REL();}
+inline
+void     SeqEnd(int hEnt) {Atomic_FENCE_REL(); Atomic_INC(shmSeq[hEnt]);}
 void     SetLocking(bool isrw);
 void     SwapMap(XrdSsiShMam &newMap);
 void     Snooze(int sec);
@@ -126,6 +131,7 @@ char       *shmTemp;
 long long   shmSize;
 char       *shmBase;
 Atomic(int)*shmIndex;
+Atomic(int)*shmSeq;
 int         shmSlots;
 int         shmItemSz;
 int         shmInfoSz;
@@ -145,6 +151,8 @@ bool        lockRO;
 bool        lockRW;
 bool        reUse;
 bool        multW;
+bool        seqLk;
+bool        seqRO;
 bool        useAtomic;
 bool        syncBase;
 bool        syncOn;
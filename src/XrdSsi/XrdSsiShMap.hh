@@ -79,6 +79,10 @@ static const
        int   ReUse  = 0x44000000; //!< Reuse map storage
 static const
        int noReUse  = 0x04000000; //!< Opposite (default for Create)
+static const
+       int   SeqLk  = 0x22000000; //!< Lock-free readers (with ReUse)
+static const
+       int noSeqLk  = 0x02000000; //!< Opposite (default for Create)
 
 //-----------------------------------------------------------------------------
 //! Constructor suitable for Create()
@@ -170,6 +174,15 @@ bool         Attach(const char *path, ShMap_Access access, int tmo=-1);
 //!                             looking at it. Otherwise, there is no need for
 //!                             file locks as no item is ever reused. ReUse is
 //!                             good when there are few key add/delete cycles.
+//!                 SeqLk     - Only meaningful with ReUse. Keep a sequence
+//!                             counter for each index entry so that r/o access
+//!                             does not need the file lock. Readers retry when
+//!                             an entry changes under them and fall back to the
+//!                             file lock if it keeps changing. Writers still
+//!                             lock among themselves as described for MultW.
+//!                             Versions without this option cannot attach
+//!                             such a map as they would not maintain the
+//!                             counters.
 //!
 //! @return true  - The shared memory was attached, the map can be used.
 //! @return false - The shared memory could not be attached, errno holds reason.
@@ -304,6 +317,7 @@ bool         Get(const char *key, T &val);
 //!                 maxkeylen   - Longest allowed key
 //!                 multw       - If 1 map supports multiple writers, else 0
 //!                 reuse       - If 1 map allows object reuse, else 0
+//!                 seqlock     - If 1 readers need no lock to reuse, else 0
 //!                 type        - Name of the data type in the table.
 //!                 typesz      - The number of bytes in the map's data type
 //!
@@ -109,10 +109,15 @@ struct CRZParms
                      //!<  1: Reuse deleted objects.
                      //!<  0: Never reuse deleted objects.
                      //!< -1: Use default or, for resize, previous setting.
-       char rsvd[6]; //!< Reserved for future options
+       signed char seqLk;
+                     //!<  1: Keep per-bucket sequence counters so that readers
+                     //!<     need not lock the file when objects are reused.
+                     //!<  0: Readers lock the file when objects are reused.
+                     //!< -1: Use default or, for resize, previous setting.
+       char rsvd[5]; //!< Reserved for future options
 
             CRZParms() : indexSz(0), maxKeys(0), maxKLen(0), mode(0640),
-                         multW(-1), reUse(-1)
+                         multW(-1), reUse(-1), seqLk(-1)
                         {memset(rsvd, -1, sizeof(rsvd));}
            ~CRZParms() {}
       };
@@ -209,6 +214,7 @@ virtual bool Enumerate(void *&jar) = 0;
 //!                 maxkeylen   - Longest allowed key
 //!                 multw       - If table supports multiple writers, else 0
 //!                 reuse       - If table allows object reuse, else 0
+//!                 seqlock     - If readers need no lock with reuse, else 0
 //!                 type        - Name of the data type in the table.
 //!                 typesz      - The number of bytes in the table's data type
 //!
@@ -151,12 +151,34 @@ virtual int     SetBuff(XrdSsiErrInfo &eRef, char *buff, int blen, bool &last)
 
 StreamType      Type() {return SType;}
 
-                XrdSsiStream(StreamType stype) : SType(stype) {}
+//-----------------------------------------------------------------------------
+//! Check whether an active stream allows more than one outstanding buffer.
+//!
+//! @return false Only one buffer is outstanding at any one time. GetBuff() is
+//!               not called again until the previous buffer is recycled.
+//! @return true  GetBuff() may be called before earlier buffers are recycled.
+//!               Each buffer must remain valid and unchanged until recycled.
+//!               This allows the data of several buffers to be sent at once.
+//-----------------------------------------------------------------------------
+
+bool            MultiBuff() {return mBuff;}
+
+//-----------------------------------------------------------------------------
+//! Constructor
+//!
+//! @param  stype     the stream type (see StreamType above).
+//! @param  multiBuff when true, the active stream allows more than one of its
+//!                   buffers to be outstanding at any one time.
+//-----------------------------------------------------------------------------
+
+                XrdSsiStream(StreamType stype, bool multiBuff=false)
+                            : SType(stype), mBuff(multiBuff) {}
 
 virtual        ~XrdSsiStream() {}
 
 protected:
 
 const StreamType SType;
+const bool       mBuff;
 };
 #endif
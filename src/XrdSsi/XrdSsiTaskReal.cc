@@ -316,6 +316,7 @@ bool XrdSsiTaskReal::Kill() // Called with session mutex locked!
 //
    if (tStat == isWrite && mhPend)
       {XrdSysSemaphore wSem(0);
+       sessP->FlushBatch(); // In case the request is still waiting in a batch
        wPost = &wSem;
        DEBUG("Waiting for write event.");
        sessP->UnLock();
@@ -340,6 +341,21 @@ bool XrdSsiTaskReal::Kill() // Called with session mutex locked!
    return !(mhPend || defer);
 }
   
+/******************************************************************************/
+/*                          S e t B a t c h R e s p                           */
+/******************************************************************************/
+
+// Called before the write completion of a batch is reflected to us!
+
+void XrdSsiTaskReal::SetBatchResp(const char *rBuff, int rBlen)
+{
+   XrdCl::Buffer *buffP = new XrdCl::Buffer(rBlen);
+
+   memcpy(buffP->GetBuffer(), rBuff, rBlen);
+   batchResp = new XrdCl::AnyObject();
+   batchResp->Set(buffP);
+}
+
 /******************************************************************************/
 /*                               R e d r i v e                                */
 /******************************************************************************/
@@ -493,6 +509,14 @@ bool XrdSsiTaskReal::SendRequest(const char *node)
    rrInfo.Size(reqBlen);
    tStat = isWrite;
 
+// Small requests may be sent along with others in a single write. The batch
+// write completion is then reflected to us as our own write completion.
+//
+   if (sessP->Batch(this, reqBuff, reqBlen, tmOut))
+      {mhPend = true;
+       return true;
+      }
+
 // If we are writing a zero length message, we must fake a request as zero
 // zero length messages are normally deep-sixed.
 //
@@ -683,12 +707,26 @@ bool XrdSsiTaskReal::XeqEvent(XrdCl::XRootDStatus *status,
                if (wPost)
                   {DEBUG("Posting killer.");
                    wPost->Post(); wPost = 0;
+                   if (batchResp) {delete batchResp; batchResp = 0;}
+                   return XeqEnd(false);
+                  }
+               DEBUG("Calling RelBuff.");
+               ReleaseRequestBuffer();
+               if (tStat != isWrite)
+                  {if (batchResp) {delete batchResp; batchResp = 0;}
+                   return XeqEnd(false);
                   }
-                  else {DEBUG("Calling RelBuff.");
-                        ReleaseRequestBuffer();
-                        if (tStat == isWrite) return Ask4Resp();
-                       }
-               return XeqEnd(false);
+               if (!batchResp) return Ask4Resp();
+
+          // Our response came back along with those of the rest of our batch,
+          // so handle it as if we had asked for it.
+          //
+               DEBUG("Response came with the batch.");
+               if (*respP) delete *respP;
+               *respP = response = batchResp;
+               batchResp = 0;
+               tStat = isSync;
+               // Fall through
 
           case isSync:
                if (!aOK) return RespErr(status);
@@ -85,6 +85,10 @@ int    SetBuff(XrdSsiErrInfo &eRef, char *buff, int blen, bool &last);
 
 bool   SetBuff(XrdSsiErrInfo &eRef, char *buff, int blen);
 
+void   SetBatchResp(const char *rBuff, int rBlen);
+
+void   SetSession(XrdSsiSessReal *sP) {sessP = sP;}
+
 void   SetTaskID(uint32_t tid, uint32_t sid)
                 {tskID = tid;
                  snprintf(tident, sizeof(tident), "T %u#%u", sid, tid);
@@ -94,14 +98,18 @@ bool   XeqEvent(XrdCl::XRootDStatus *status, XrdCl::AnyObject **respP);
 
        XrdSsiTaskReal(XrdSsiSessReal *sP)
                      : XrdSsiStream(XrdSsiStream::isPassive),
-                       sessP(sP), mdResp(0), wPost(0), tskID(0),
-                       mhPend(false), defer(false)
+                       batchNext(0), batchResp(0), sessP(sP), mdResp(0),
+                       wPost(0), tskID(0), mhPend(false), defer(false)
                     {}
 
-      ~XrdSsiTaskReal() {if (mdResp) delete mdResp;}
+      ~XrdSsiTaskReal() {if (mdResp)    delete mdResp;
+                         if (batchResp) delete batchResp;
+                        }
 
 struct dlQ {XrdSsiTaskReal *next; XrdSsiTaskReal *prev;};
 dlQ             attList;
+XrdSsiTaskReal   *batchNext; // Next task in the same request batch
+XrdCl::AnyObject *batchResp; // Response that came back with the batch
 
 enum respType     {isBad=0, isAlert, isData, isStream};
 
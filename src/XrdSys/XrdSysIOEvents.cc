@@ -29,6 +29,7 @@
 /******************************************************************************/
 
 #include <errno.h>
+#include <sched.h>
 #include <stdio.h>
 #include <stdlib.h>
   
@@ -555,6 +556,8 @@ XrdSys::IOEvents::Poller::Poller(int rFD, int cFD)
    pipePoll.fd     = rFD;
    pipePoll.events = POLLIN | POLLRDNORM;
    tmoMask         = 255;
+   pollCnt         = 0;
+   evntCnt         = 0;
 }
 
 /******************************************************************************/
@@ -870,6 +873,16 @@ int XrdSys::IOEvents::Poller::GetRequest()
    return 0;
 }
   
+/******************************************************************************/
+/*                              G e t S t a t s                               */
+/******************************************************************************/
+
+void XrdSys::IOEvents::Poller::GetStats(long long &pollNum, long long &evntNum)
+{
+   pollNum = AtomicGet(pollCnt);
+   evntNum = AtomicGet(evntCnt);
+}
+  
 /******************************************************************************/
 /* Protected:                       I n i t                                   */
 /******************************************************************************/
@@ -982,6 +995,26 @@ int XrdSys::IOEvents::Poller::SendCmd(PipeData &cmd)
    return (wlen >= 0 ? 0 : errno);
 }
   
+/******************************************************************************/
+/*                           S e t A f f i n i t y                            */
+/******************************************************************************/
+
+int XrdSys::IOEvents::Poller::SetAffinity(int cpu)
+{
+#if defined(__linux__) && defined(CPU_SET)
+   cpu_set_t cpuSet;
+
+// Bind the poller thread to the requested cpu
+//
+   if (cpu < 0 || cpu >= CPU_SETSIZE) return EINVAL;
+   CPU_ZERO(&cpuSet);
+   CPU_SET(cpu, &cpuSet);
+   return pthread_setaffinity_np(pollTid, sizeof(cpuSet), &cpuSet);
+#else
+   return ENOTSUP;
+#endif
+}
+  
 /******************************************************************************/
 /* Protected:                 S e t P o l l E n t                             */
 /******************************************************************************/
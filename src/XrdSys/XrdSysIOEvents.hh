@@ -399,6 +399,28 @@ enum   CreateOpts  {optTOM};
 
 static Poller     *Create(int &eNum, const char **eTxt=0, int crOpts=0);
 
+//-----------------------------------------------------------------------------
+//! Obtain the event statistics of a poller. Each wait for events returns a
+//! batch of ready channels; the ratio of both counts is the batch size.
+//!
+//! @param  pollCnt Place where the number of waits for events is placed.
+//! @param  evntCnt Place where the number of events returned is placed.
+//-----------------------------------------------------------------------------
+
+       void        GetStats(long long &pollCnt, long long &evntCnt);
+
+//-----------------------------------------------------------------------------
+//! Bind the polling thread to a CPU.
+//!
+//! @param  cpu    The number of the CPU to bind the thread to.
+//!
+//! @return 0      The thread has been bound.
+//!         !0     The thread could not be bound, the errno value is returned.
+//!                ENOTSUP is returned on platforms that do not support it.
+//-----------------------------------------------------------------------------
+
+       int         SetAffinity(int cpu);
+
 //-----------------------------------------------------------------------------
 //! Stop a poller object. Active callbacks are completed. Pending callbacks are
 //! discarded. After which the poller event thread exits. Subsequently, each
@@ -434,6 +456,10 @@ struct  PipeData;
 
         void  CbkTMO();
         bool  CbkXeq(Channel *cP, int events, int eNum, const char *eTxt);
+inline  void  CntPoll(int numEvents)
+                     {AtomicInc(pollCnt);
+                      if (numEvents > 0) AtomicAdd(evntCnt, numEvents);
+                     }
 inline  int   GetFault(Channel *cP)   {return cP->chFault;}
 inline  int   GetPollEnt(Channel *cP) {return cP->pollEnt;}
         int   GetRequest();
@@ -509,6 +535,8 @@ int             pipeBlen;   // Number of outstanding bytes
 unsigned char   tmoMask;    // Timeout mask
 CPP_ATOMIC_TYPE(bool) wakePend;   // Wakeup is effectively pending (don't send)
 bool            chDead;     // True if channel deleted by callback
+long long       pollCnt;    // Number of times the poll wait returned
+long long       evntCnt;    // Number of events returned by the poll waits
 
 static time_t   maxTime;    // Maximum time allowed
 
@@ -1,9 +1,11 @@
 
 #include "XrdTpcTPC.hh"
+#include "XrdTpcPool.hh"
 
 #include <dlfcn.h>
 #include <fcntl.h>
 
+#include "XrdOuc/XrdOuca2x.hh"
 #include "XrdOuc/XrdOucStream.hh"
 #include "XrdOuc/XrdOucPinPath.hh"
 #include "XrdSfs/XrdSfsInterface.hh"
@@ -148,6 +150,30 @@ bool TPCHandler::Configure(const char *configfn, XrdOucEnv *myEnv)
                 return false;
             }
             m_cadir = val;
+        } else if (!strcmp("tpc.maxbuffermem", val)) {
+            long long max_memory;
+            if (!(val = Config.GetWord())) {
+                Config.Close();
+                m_log.Emsg("Config", "tpc.maxbuffermem value not specified");
+                return false;
+            }
+            if (XrdOuca2x::a2sz(m_log, "tpc.maxbuffermem value", val, &max_memory, 1024*1024)) {
+                Config.Close();
+                return false;
+            }
+            BufferPool::Instance().SetMaxMemory(max_memory);
+        } else if (!strcmp("tpc.maxstreams", val)) {
+            int max_streams;
+            if (!(val = Config.GetWord())) {
+                Config.Close();
+                m_log.Emsg("Config", "tpc.maxstreams value not specified");
+                return false;
+            }
+            if (XrdOuca2x::a2i(m_log, "tpc.maxstreams value", val, &max_streams, 0, 100)) {
+                Config.Close();
+                return false;
+            }
+            m_max_streams = max_streams;
         }
     }
     Config.Close();
@@ -12,6 +12,9 @@
 
 #include <curl/curl.h>
 
+#include <algorithm>
+#include <chrono>
+#include <functional>
 #include <sstream>
 #include <stdexcept>
 
@@ -28,11 +31,44 @@ public:
 };
 
 namespace {
+
+// Statistics about the requests performed by one curl handle, used to
+// tune the transfer and to report per-stream performance markers.
+struct StreamStats {
+    StreamStats() : m_bytes_done(0), m_rate(0), m_rtt(0) {}
+
+    off_t m_bytes_done;  // Bytes received by completed (or aborted) requests.
+    double m_rate;  // Smoothed throughput of the past requests, bytes/s.
+    double m_rtt;  // Smoothed time to the first byte of the past requests, s.
+    std::chrono::steady_clock::time_point m_start;  // Start of the current request.
+};
+
+// Requests with less than this left are not worth moving to a new stream.
+const off_t g_min_rebalance_size = 1024*1024;
+
+// How often [s] requests paused for lack of buffers try again at the least.
+const double g_pause_retry = 0.1;
+
+double Seconds(std::chrono::steady_clock::duration duration) {
+    return std::chrono::duration_cast<std::chrono::duration<double> >(duration).count();
+}
+
 class MultiCurlHandler {
 public:
-    MultiCurlHandler(std::vector<State*> &states, XrdSysError &log) :
+    MultiCurlHandler(std::vector<State*> &states, XrdSysError &log,
+                     size_t streams, size_t max_streams, size_t handles_per_stream) :
         m_handle(curl_multi_init()),
         m_states(states),
+        m_stats(states.size()),
+        m_streams(streams),
+        m_prev_streams(streams),
+        m_max_streams(std::max(streams, max_streams)),
+        m_handles_per_stream(handles_per_stream),
+        m_last_bytes(0),
+        m_last_rate(0),
+        m_last_action(0),
+        m_checks_held(0),
+        m_slow_start(true),
         m_log(log)
     {
         if (m_handle == NULL) {
@@ -53,7 +89,11 @@ public:
         for (std::vector<CURL *>::const_iterator it = m_active_handles.begin();
              it != m_active_handles.end();
              it++) {
-            curl_multi_remove_handle(m_handle, *it);
+            CURLMcode mres = curl_multi_remove_handle(m_handle, *it);
+            if (mres) {
+                m_log.Emsg("MultiCurlHandler", "Failed to remove transfer from set:",
+                           curl_multi_strerror(mres));
+            }
             curl_easy_cleanup(*it);
         }
         for (std::vector<CURL *>::const_iterator it = m_avail_handles.begin();
@@ -68,6 +108,37 @@ public:
 
     CURLM *Get() const {return m_handle;}
 
+    // Maximum number of requests that may run at the same time.
+    size_t ActiveLimit() const {return m_streams * m_handles_per_stream;}
+
+    size_t Streams() const {return m_streams;}
+
+    // True if ranges taken away from slow requests are still to be reissued.
+    bool HasPendingRanges() const {return !m_pending_ranges.empty();}
+
+    // True if any request is paused waiting for a buffer.
+    bool HasPaused() const {
+        for (size_t idx = 0; idx < m_states.size(); idx++) {
+            if (m_states[idx]->IsPaused()) {return true;}
+        }
+        return false;
+    }
+
+    // Let the paused requests offer their data again.  This is done as soon
+    // as buffers are available again and, since the head of the stream may
+    // have moved onto a paused request without freeing any, also every
+    // g_pause_retry seconds.
+    void ResumePaused() {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if ((m_states[0]->AvailableBuffers() <= 0) && (Seconds(now - m_last_resume) < g_pause_retry)) {
+            return;
+        }
+        m_last_resume = now;
+        for (size_t idx = 0; idx < m_states.size(); idx++) {
+            if (m_states[idx]->IsPaused()) {m_states[idx]->Resume();}
+        }
+    }
+
     void FinishCurlXfer(CURL *curl) {
         CURLMcode mres = curl_multi_remove_handle(m_handle, curl);
         if (mres) {
@@ -76,28 +147,29 @@ public:
                << curl_multi_strerror(mres);
             throw std::runtime_error(ss.str());
         }
-        for (std::vector<State*>::iterator state_iter = m_states.begin();
-             state_iter != m_states.end();
-             state_iter++) {
-            if (curl == (*state_iter)->GetHandle()) {
-                (*state_iter)->ResetAfterRequest();
+        for (size_t idx = 0; idx < m_states.size(); idx++) {
+            if (curl == m_states[idx]->GetHandle()) {
+                RecordRequest(idx, true);
+                m_states[idx]->ResetAfterRequest();
                 break;
             }
         }
-        for (std::vector<CURL *>::iterator iter = m_active_handles.begin();
-             iter != m_active_handles.end();
-             ++iter)
-        {
-            if (*iter == curl) {
-                m_active_handles.erase(iter);
-                break;
-            }
-        }
-        m_avail_handles.push_back(curl);
+        ReleaseHandle(curl);
     }
 
     off_t StartTransfers(off_t current_offset, off_t content_length, size_t block_size,
                          int &running_handles) {
+         // Ranges taken away from slow requests go first, lowest offset first.
+         std::sort(m_pending_ranges.begin(), m_pending_ranges.end(),
+                   std::greater<std::pair<off_t, size_t> >());
+         while (!m_pending_ranges.empty()) {
+             std::pair<off_t, size_t> range = m_pending_ranges.back();
+             if (!StartTransfer(range.first, range.second)) {
+                 return current_offset;
+             }
+             running_handles += 1;
+             m_pending_ranges.pop_back();
+         }
          bool started_new_xfer = false;
          do {
              size_t xfer_size = std::min(content_length - current_offset, static_cast<off_t>(block_size));
@@ -118,19 +190,190 @@ public:
         return current_offset;
     }
 
+    // Total number of bytes received so far.
+    off_t BytesTransferred() const {
+        off_t bytes = 0;
+        for (size_t idx = 0; idx < m_states.size(); idx++) {
+            bytes += m_stats[idx].m_bytes_done + m_states[idx]->BytesTransferred();
+        }
+        return bytes;
+    }
+
+    // Adjust the number of streams toward the maximum throughput, hill-climbing
+    // on the aggregate rate measured between two calls: grow while adding
+    // streams pays off (doubling at first), step back when it does not and
+    // probe again from time to time as conditions change.
+    void AdjustStreams() {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        off_t bytes = BytesTransferred();
+        if (m_last_check == std::chrono::steady_clock::time_point()) {
+            m_last_check = now;
+            m_last_bytes = bytes;
+            return;
+        }
+        double elapsed = Seconds(now - m_last_check);
+        if (elapsed <= 0) {return;}
+        double rate = (bytes - m_last_bytes) / elapsed;
+
+        size_t streams = m_streams;
+        if ((m_last_action >= 0) && (rate > m_last_rate * 1.1) && (m_streams < m_max_streams)) {
+            m_prev_streams = m_streams;
+            streams = m_slow_start ? 2 * m_streams : m_streams + 1;
+            m_last_action = 1;
+        } else if (m_last_action > 0) {
+            // The last increase did not pay off; undo it if it made things worse.
+            if (rate < m_last_rate * 0.95) {
+                streams = m_prev_streams;
+            }
+            m_slow_start = false;
+            m_last_action = 0;
+            m_checks_held = 0;
+        } else if ((++m_checks_held >= 3) && (m_streams < m_max_streams)) {
+            m_prev_streams = m_streams;
+            streams = m_streams + 1;
+            m_last_action = 1;
+            m_checks_held = 0;
+        }
+        SetStreams(std::min(streams, m_max_streams));
+
+        m_last_check = now;
+        m_last_bytes = bytes;
+        m_last_rate = rate;
+    }
+
+    // When all the ranges have been handed out, move the remainder of a
+    // request that is much slower than the others to a new request (and thus
+    // a new connection), so that it does not dictate the transfer time.
+    // Returns true if a request was aborted.
+    bool Rebalance(int &running_handles) {
+        if (m_active_handles.size() >= ActiveLimit() || m_active_handles.size() < 2) {
+            return false;
+        }
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        double best_rate = 0, rtt = 0;
+        size_t slowest = m_states.size();
+        double slowest_eta = 0;
+        for (size_t idx = 0; idx < m_states.size(); idx++) {
+            best_rate = std::max(best_rate, m_stats[idx].m_rate);
+            rtt = std::max(rtt, m_stats[idx].m_rtt);
+            // A paused request is held back by us, not by the source.
+            if (!IsActive(m_states[idx]->GetHandle()) || !m_states[idx]->BodyTransferInProgress() ||
+                m_states[idx]->IsPaused()) {
+                continue;
+            }
+            double elapsed = Seconds(now - m_stats[idx].m_start);
+            if (elapsed < 2) {continue;}
+            double rate = m_states[idx]->BytesTransferred() / elapsed;
+            best_rate = std::max(best_rate, rate);
+            off_t remaining = m_states[idx]->GetContentLength() - m_states[idx]->BytesTransferred();
+            if (remaining < g_min_rebalance_size) {continue;}
+            double eta = rate > 0 ? remaining / rate : 1e9;
+            if (eta > slowest_eta) {
+                slowest_eta = eta;
+                slowest = idx;
+            }
+        }
+        if ((slowest == m_states.size()) || (best_rate <= 0)) {
+            return false;
+        }
+        State &state = *m_states[slowest];
+        off_t remaining = state.GetContentLength() - state.BytesTransferred();
+        if (slowest_eta < 2 * (remaining / best_rate + rtt)) {
+            return false;
+        }
+
+        // If the request cannot be taken out, just let it run to completion.
+        CURL *curl = state.GetHandle();
+        CURLMcode mres = curl_multi_remove_handle(m_handle, curl);
+        if (mres) {
+            m_log.Emsg("Rebalance", "Failed to remove slow transfer from set:",
+                       curl_multi_strerror(mres));
+            return false;
+        }
+
+        std::stringstream ss;
+        ss << "Moving the last " << remaining << " bytes of a slow request to a new one; "
+           << "expected " << slowest_eta << "s at its current rate.";
+        m_log.Emsg("Rebalance", ss.str().c_str());
+
+        m_pending_ranges.push_back(std::make_pair(state.GetStartOffset() + state.BytesTransferred(),
+                                                  static_cast<size_t>(remaining)));
+        RecordRequest(slowest, false);
+        state.ResetAfterRequest();
+        ReleaseHandle(curl);
+        running_handles -= 1;
+        return true;
+    }
+
+    // Log a summary of the per-stream performance.
+    void LogStats(const char *log_prefix) const {
+        for (size_t idx = 0; idx < m_states.size(); idx++) {
+            if (!m_stats[idx].m_bytes_done) {continue;}
+            std::stringstream ss;
+            ss << "Stream " << idx << ": bytes=" << m_stats[idx].m_bytes_done
+               << ", rate=" << static_cast<off_t>(m_stats[idx].m_rate) << "B/s"
+               << ", rtt=" << static_cast<int>(m_stats[idx].m_rtt * 1000) << "ms";
+            m_log.Emsg(log_prefix, ss.str().c_str());
+        }
+    }
+
 private:
 
+    void SetStreams(size_t streams) {
+        if (streams == m_streams) {return;}
+        std::stringstream ss;
+        ss << "Changing the number of streams from " << m_streams << " to " << streams
+           << "; last rate " << static_cast<off_t>(m_last_rate) << "B/s";
+        m_log.Emsg("AdjustStreams", ss.str().c_str());
+        m_streams = streams;
+#ifdef USE_PIPELINING
+        curl_multi_setopt(m_handle, CURLMOPT_MAX_HOST_CONNECTIONS, static_cast<long>(m_streams));
+#endif
+    }
+
+    bool IsActive(CURL *curl) const {
+        return std::find(m_active_handles.begin(), m_active_handles.end(), curl) != m_active_handles.end();
+    }
+
+    void ReleaseHandle(CURL *curl) {
+        std::vector<CURL *>::iterator iter = std::find(m_active_handles.begin(), m_active_handles.end(), curl);
+        if (iter != m_active_handles.end()) {
+            m_active_handles.erase(iter);
+        }
+        m_avail_handles.push_back(curl);
+    }
+
+    // Account for the request that the handle at idx just finished or abandoned.
+    void RecordRequest(size_t idx, bool complete) {
+        StreamStats &stats = m_stats[idx];
+        State &state = *m_states[idx];
+        off_t bytes = state.BytesTransferred();
+        stats.m_bytes_done += bytes;
+        double elapsed = Seconds(std::chrono::steady_clock::now() - stats.m_start);
+        if (elapsed > 0 && bytes > 0) {
+            double rate = bytes / elapsed;
+            stats.m_rate = stats.m_rate > 0 ? (stats.m_rate + rate) / 2 : rate;
+        }
+        double pretransfer = 0, starttransfer = 0;
+        if (complete &&
+            (curl_easy_getinfo(state.GetHandle(), CURLINFO_PRETRANSFER_TIME, &pretransfer) == CURLE_OK) &&
+            (curl_easy_getinfo(state.GetHandle(), CURLINFO_STARTTRANSFER_TIME, &starttransfer) == CURLE_OK) &&
+            (starttransfer > pretransfer)) {
+            double rtt = starttransfer - pretransfer;
+            stats.m_rtt = stats.m_rtt > 0 ? (stats.m_rtt + rtt) / 2 : rtt;
+        }
+    }
+
     bool StartTransfer(off_t offset, size_t size) {
         if (!CanStartTransfer(false)) {return false;}
         for (std::vector<CURL*>::const_iterator handle_it = m_avail_handles.begin();
              handle_it != m_avail_handles.end();
              handle_it++) {
-            for (std::vector<State*>::iterator state_it = m_states.begin();
-                 state_it != m_states.end();
-                 state_it++) {
-                if ((*state_it)->GetHandle() == *handle_it) {  // This state object represents an idle handle.
-                    (*state_it)->SetTransferParameters(offset, size);
-                    ActivateHandle(**state_it);
+            for (size_t idx = 0; idx < m_states.size(); idx++) {
+                if (m_states[idx]->GetHandle() == *handle_it) {  // This state object represents an idle handle.
+                    m_states[idx]->SetTransferParameters(offset, size);
+                    m_stats[idx].m_start = std::chrono::steady_clock::now();
+                    ActivateHandle(*m_states[idx]);
                     return true;
                 }
             }
@@ -181,6 +424,18 @@ private:
             }
             return false;
         }
+        if (m_active_handles.size() >= ActiveLimit()) {
+            if (log_reason) {
+                m_log.Emsg("CanStartTransfer", "Unable to start transfers as the stream limit is reached.");
+            }
+            return false;
+        }
+        // With nothing in flight the next range starts at the head of the
+        // stream, its data goes straight to the file without any buffer; so
+        // running out of buffers only slows the transfer down.
+        if (m_active_handles.empty()) {
+            return true;
+        }
         ssize_t available_buffers = m_states[0]->AvailableBuffers();
         // To be conservative, set aside buffers for any transfers that have been activated
         // but don't have their first responses back yet.
@@ -202,6 +457,19 @@ private:
     std::vector<CURL *> m_avail_handles;
     std::vector<CURL *> m_active_handles;
     std::vector<State*> &m_states;
+    std::vector<StreamStats> m_stats;  // Indexed as m_states.
+    std::vector<std::pair<off_t, size_t> > m_pending_ranges;  // (offset, size) to reissue.
+    size_t m_streams;  // Current number of streams.
+    size_t m_prev_streams;  // Number of streams before the last increase.
+    size_t m_max_streams;
+    size_t m_handles_per_stream;
+    std::chrono::steady_clock::time_point m_last_check;
+    std::chrono::steady_clock::time_point m_last_resume;
+    off_t m_last_bytes;
+    double m_last_rate;
+    int m_last_action;  // 1 if the last adjustment added streams, 0 otherwise.
+    int m_checks_held;  // Adjustments since the number of streams last changed.
+    bool m_slow_start;
     XrdSysError         &m_log;
 };
 }
@@ -209,6 +477,7 @@ private:
 
 int TPCHandler::RunCurlWithStreamsImpl(XrdHttpExtReq &req, State &state,
                                        const char *log_prefix, size_t streams,
+                                       size_t max_streams,
                                        std::vector<State*> handles)
 {
     int result;
@@ -227,7 +496,8 @@ int TPCHandler::RunCurlWithStreamsImpl(XrdHttpExtReq &req, State &state,
     }
     state.ResetAfterRequest();    
 
-    size_t concurrency = streams * m_pipelining_multiplier;
+    // Handles are set up for the largest number of streams that may be used.
+    size_t concurrency = std::max(streams, max_streams) * m_pipelining_multiplier;
 
     handles.reserve(concurrency);
     handles.push_back(new State());
@@ -237,7 +507,7 @@ int TPCHandler::RunCurlWithStreamsImpl(XrdHttpExtReq &req, State &state,
     }
 
     // Create the multi-handle and add in the current transfer to it.
-    MultiCurlHandler mch(handles, m_log);
+    MultiCurlHandler mch(handles, m_log, streams, max_streams, m_pipelining_multiplier);
     CURLM *multi_handle = mch.Get();
 
 #ifdef USE_PIPELINING
@@ -264,9 +534,17 @@ int TPCHandler::RunCurlWithStreamsImpl(XrdHttpExtReq &req, State &state,
         time_t now = time(NULL);
         time_t next_marker = last_marker + m_marker_period;
         if (now >= next_marker) {
-            if (SendPerfMarker(req, current_offset)) {
+            if (SendPerfMarker(req, mch.BytesTransferred())) {
                 return -1;
             }
+            if (last_marker) {
+                // Only tune the stream count while there is work left to hand out.
+                if ((current_offset != content_size) || mch.HasPendingRanges()) {
+                    mch.AdjustStreams();
+                } else {
+                    mch.Rebalance(running_handles);
+                }
+            }
             last_marker = now;
         }
 
@@ -299,16 +577,16 @@ int TPCHandler::RunCurlWithStreamsImpl(XrdHttpExtReq &req, State &state,
             break;
         }
 
-        if (running_handles < static_cast<int>(concurrency)) {
+        if (running_handles < static_cast<int>(mch.ActiveLimit())) {
             // Issue new transfers if there is still pending work to do.
             // Otherwise, continue running until there are no handles left.
-            if (current_offset != content_size) {
+            if ((current_offset != content_size) || mch.HasPendingRanges()) {
                 current_offset = mch.StartTransfers(current_offset, content_size,
                                                     m_block_size, running_handles);
                 if (!running_handles) {
                     std::stringstream ss;
-                    ss << "No handles are able to run.  Streams=" << streams << ", concurrency="
-                       << concurrency;
+                    ss << "No handles are able to run.  Streams=" << mch.Streams() << ", concurrency="
+                       << mch.ActiveLimit();
                     m_log.Emsg(log_prefix, ss.str().c_str());
                 }
             } else if (running_handles == 0) {
@@ -317,23 +595,28 @@ int TPCHandler::RunCurlWithStreamsImpl(XrdHttpExtReq &req, State &state,
             }
         }
 
-        int64_t max_sleep_time = next_marker - time(NULL);
-        if (max_sleep_time <= 0) {
+        // Requests that ran out of buffers wait here rather than failing.
+        int64_t max_sleep_ms = (next_marker - time(NULL)) * 1000;
+        if (mch.HasPaused()) {
+            mch.ResumePaused();
+            max_sleep_ms = std::min(max_sleep_ms, static_cast<int64_t>(g_pause_retry * 1000));
+        }
+        if (max_sleep_ms <= 0) {
             continue;
         }
         int fd_count;
 #ifdef HAVE_CURL_MULTI_WAIT
-        mres = curl_multi_wait(multi_handle, NULL, 0, max_sleep_time*1000,
+        mres = curl_multi_wait(multi_handle, NULL, 0, max_sleep_ms,
                                &fd_count);
 #else
-        mres = curl_multi_wait_impl(multi_handle, max_sleep_time*1000,
+        mres = curl_multi_wait_impl(multi_handle, max_sleep_ms,
                                     &fd_count);
 #endif
         if (mres != CURLM_OK) {
             m_log.Emsg(log_prefix, "Breaking transfer due to failed curl multi wait.");
             break;
         }
-    } while (running_handles);
+    } while (running_handles || mch.HasPendingRanges());
 
     if (mres != CURLM_OK) {
         std::stringstream ss;
@@ -358,13 +641,14 @@ int TPCHandler::RunCurlWithStreamsImpl(XrdHttpExtReq &req, State &state,
     if (res == static_cast<CURLcode>(-1)) { // No transfers returned?!?
         throw std::runtime_error("Internal state error in libcurl");
     }
+    mch.LogStats(log_prefix);
 
     // Generate the final response back to the client.
     std::stringstream ss;
     if (res != CURLE_OK) {
         m_log.Emsg(log_prefix, "request failed when processing", curl_easy_strerror(res));
         ss << "failure: " << curl_easy_strerror(res);
-    } else if (current_offset != content_size) {
+    } else if ((current_offset != content_size) || mch.HasPendingRanges()) {
         ss << "failure: Internal logic error led to early abort; current offset is " <<
               current_offset << " while full size is " << content_size;
         m_log.Emsg(log_prefix, ss.str().c_str());
@@ -388,11 +672,12 @@ int TPCHandler::RunCurlWithStreamsImpl(XrdHttpExtReq &req, State &state,
 
 
 int TPCHandler::RunCurlWithStreams(XrdHttpExtReq &req, State &state,
-                                   const char *log_prefix, size_t streams)
+                                   const char *log_prefix, size_t streams,
+                                   size_t max_streams)
 {
     std::vector<State*> handles;
     try {
-        int retval = RunCurlWithStreamsImpl(req, state, log_prefix, streams, handles);
+        int retval = RunCurlWithStreamsImpl(req, state, log_prefix, streams, max_streams, handles);
         for (std::vector<State*>::iterator state_iter = handles.begin();
              state_iter != handles.end();
              state_iter++) {
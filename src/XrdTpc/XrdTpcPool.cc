@@ -0,0 +1,118 @@
+
+#include <stdlib.h>
+
+#include "XrdTpcPool.hh"
+
+using namespace TPC;
+
+namespace {
+// Default cap on the memory used for reordering multi-stream writes.
+const size_t g_default_max_memory = 2048ULL*1024*1024;
+// Buffers are aligned so they can be handed to the filesystem as they are.
+const size_t g_buffer_alignment = 4096;
+}
+
+
+BufferPool &
+BufferPool::Instance()
+{
+    static BufferPool pool;
+    return pool;
+}
+
+
+BufferPool::BufferPool() :
+    m_max_memory(g_default_max_memory),
+    m_in_use(0),
+    m_idle_bytes(0)
+{}
+
+
+BufferPool::~BufferPool()
+{
+    TrimIdle(m_max_memory);
+}
+
+
+void
+BufferPool::SetMaxMemory(size_t max_memory)
+{
+    XrdSysMutexHelper lock(m_mutex);
+    m_max_memory = max_memory;
+}
+
+
+char *
+BufferPool::Get(size_t size)
+{
+    XrdSysMutexHelper lock(m_mutex);
+
+    if (m_in_use + size > m_max_memory) {
+        return NULL;
+    }
+
+    std::map<size_t, std::vector<char*> >::iterator iter = m_idle.find(size);
+    if ((iter != m_idle.end()) && !iter->second.empty()) {
+        char *buffer = iter->second.back();
+        iter->second.pop_back();
+        m_idle_bytes -= size;
+        m_in_use += size;
+        return buffer;
+    }
+
+    // Idle buffers of other sizes still count against the cap.
+    TrimIdle(size);
+    void *buffer;
+    if (posix_memalign(&buffer, g_buffer_alignment, size)) {
+        return NULL;
+    }
+    m_in_use += size;
+    return static_cast<char*>(buffer);
+}
+
+
+void
+BufferPool::Release(char *buffer, size_t size)
+{
+    if (!buffer) {return;}
+
+    XrdSysMutexHelper lock(m_mutex);
+    m_in_use -= size;
+
+    // Keep up to a quarter of the allowed memory for reuse.
+    if ((m_idle_bytes + size) * 4 > m_max_memory) {
+        free(buffer);
+        return;
+    }
+    m_idle[size].push_back(buffer);
+    m_idle_bytes += size;
+}
+
+
+size_t
+BufferPool::Available(size_t size) const
+{
+    if (!size) {return 0;}
+
+    XrdSysMutexHelper lock(m_mutex);
+    if (m_in_use >= m_max_memory) {
+        return 0;
+    }
+    return (m_max_memory - m_in_use) / size;
+}
+
+
+void
+BufferPool::TrimIdle(size_t needed)
+{
+    std::map<size_t, std::vector<char*> >::iterator iter = m_idle.begin();
+    while ((m_in_use + m_idle_bytes + needed > m_max_memory) && (iter != m_idle.end())) {
+        if (iter->second.empty()) {
+            iter++;
+            continue;
+        }
+        free(iter->second.back());
+        iter->second.pop_back();
+        m_idle_bytes -= iter->first;
+    }
+}
@@ -0,0 +1,57 @@
+/**
+ * pool.hh:
+ *
+ * A pool of large, page-aligned memory buffers shared by all the TPC
+ * transfers in the process.
+ *
+ * The total amount of memory handed out by the pool is capped; once the cap
+ * is reached, no more buffers are given out until some are released.  This
+ * keeps many concurrent multi-stream transfers from exhausting the server
+ * memory.  Released buffers are kept around (up to a fraction of the cap)
+ * so that busy transfers do not keep going back to the allocator.
+ */
+
+#include <map>
+#include <vector>
+
+#include <cstddef>
+
+#include "XrdSys/XrdSysPthread.hh"
+
+namespace TPC {
+class BufferPool {
+public:
+
+    static BufferPool &Instance();
+
+    // Set the maximum number of bytes the pool may hand out.
+    void SetMaxMemory(size_t max_memory);
+
+    size_t GetMaxMemory() const {return m_max_memory;}
+
+    // Get a buffer of the given size; returns NULL if this would exceed the
+    // memory cap or the allocation failed.
+    char *Get(size_t size);
+
+    // Give back a buffer obtained from Get(), along with its size.
+    void Release(char *buffer, size_t size);
+
+    // Number of buffers of the given size that could be handed out now.
+    size_t Available(size_t size) const;
+
+private:
+    BufferPool();
+    ~BufferPool();
+
+    BufferPool(const BufferPool&) = delete;
+
+    // Free idle buffers until the given number of bytes can be allocated.
+    void TrimIdle(size_t needed);
+
+    mutable XrdSysMutex m_mutex;
+    size_t m_max_memory;  // Cap on the memory held by the pool (in use + idle).
+    size_t m_in_use;  // Bytes currently handed out.
+    size_t m_idle_bytes;  // Bytes sitting in the idle lists.
+    std::map<size_t, std::vector<char*> > m_idle;  // Idle buffers, by size.
+};
+}
@@ -29,6 +29,7 @@ void State::Move(State &other)
     m_push = other.m_push;
     m_recv_status_line = other.m_recv_status_line;
     m_recv_all_headers = other.m_recv_all_headers;
+    m_paused = other.m_paused;
     m_offset = other.m_offset;
     m_start_offset = other.m_start_offset;
     m_status_code = other.m_status_code;
@@ -114,6 +115,7 @@ void State::ResetAfterRequest() {
     m_content_length = -1;
     m_recv_all_headers = false;
     m_recv_status_line = false;
+    m_paused = false;
 }
 
 size_t State::HeaderCB(char *buffer, size_t size, size_t nitems, void *userdata)
@@ -186,6 +188,12 @@ int State::Write(char *buffer, size_t size) {
     if (retval == SFS_ERROR) {
         return -1;
     }
+    // No room for the data right now; have libcurl hold on to it (and stop
+    // reading from the socket) until Resume() is called.
+    if (!retval && size) {
+        m_paused = true;
+        return CURL_WRITEFUNC_PAUSE;
+    }
     m_offset += retval;
     return retval;
 }
@@ -239,6 +247,15 @@ void State::SetTransferParameters(off_t offset, size_t size) {
     curl_easy_setopt(m_curl, CURLOPT_RANGE, ss.str().c_str());
 }
 
+void State::Resume()
+{
+    if (!m_paused) {return;}
+    m_paused = false;
+    // The held data is offered again from within this call; if there is
+    // still no room for it, the transfer gets paused once more.
+    curl_easy_pause(m_curl, CURLPAUSE_CONT);
+}
+
 int State::AvailableBuffers() const
 {
     return m_stream->AvailableBuffers();
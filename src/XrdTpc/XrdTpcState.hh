@@ -22,6 +22,7 @@ public:
         m_push(true),
         m_recv_status_line(false),
         m_recv_all_headers(false),
+        m_paused(false),
         m_offset(0),
         m_start_offset(0),
         m_status_code(-1),
@@ -38,6 +39,7 @@ public:
         m_push(push),
         m_recv_status_line(false),
         m_recv_all_headers(false),
+        m_paused(false),
         m_offset(0),
         m_start_offset(start_offset),
         m_status_code(-1),
@@ -59,6 +61,8 @@ public:
 
     off_t GetContentLength() const {return m_content_length;}
 
+    off_t GetStartOffset() const {return m_start_offset;}
+
     int GetStatusCode() const {return m_status_code;}
 
     void ResetAfterRequest();
@@ -67,6 +71,12 @@ public:
 
     int AvailableBuffers() const;
 
+    // True if the transfer was paused because the stream had no buffer for
+    // the data received; Resume() has libcurl offer the data again.
+    bool IsPaused() const {return m_paused;}
+
+    void Resume();
+
     void DumpBuffers() const;
 
     // Returns true if at least one byte of the response has been received,
@@ -109,6 +119,7 @@ private:
     bool m_push;  // whether we are transferring in "push-mode"
     bool m_recv_status_line;  // whether we have received a status line in the response from the remote host.
     bool m_recv_all_headers;  // true if we have seen the end of headers.
+    bool m_paused;  // true if libcurl was asked to pause the transfer.
     off_t m_offset;  // number of bytes we have received.
     off_t m_start_offset;  // offset where we started in the file.
     int m_status_code;  // status code from HTTP response.
@@ -1,7 +1,11 @@
 
+#include <algorithm>
 #include <sstream>
 
+#include <cstring>
+
 #include "XrdTpcStream.hh"
+#include "XrdTpcPool.hh"
 
 #include "XrdSfs/XrdSfsInterface.hh"
 #include "XrdSys/XrdSysError.hh"
@@ -10,13 +14,23 @@ using namespace TPC;
 
 Stream::~Stream()
 {
-    for (std::vector<Entry*>::iterator buffer_iter = m_buffers.begin();
-        buffer_iter != m_buffers.end();
-        buffer_iter++) {
-        delete *buffer_iter;
-        *buffer_iter = NULL;
+    ReleaseBuffers();
+    if (m_open_for_write) {
+        m_fh->close();
     }
-    m_fh->close();
+}
+
+
+void
+Stream::ReleaseBuffers()
+{
+    BufferPool &pool = BufferPool::Instance();
+    for (std::map<off_t, Entry>::iterator entry_iter = m_buffers.begin();
+         entry_iter != m_buffers.end();
+         entry_iter++) {
+        pool.Release(entry_iter->second.m_buffer, m_buffer_size);
+    }
+    m_buffers.clear();
 }
 
 
@@ -27,16 +41,14 @@ Stream::Finalize()
     if (!m_open_for_write) {
         return false;
     }
-    for (std::vector<Entry*>::iterator buffer_iter = m_buffers.begin();
-        buffer_iter != m_buffers.end();
-        buffer_iter++) {
-        delete *buffer_iter;
-        *buffer_iter = NULL;
-    }
+    // Write out whatever is contiguous, including a trailing partial window.
+    bool flushed = Flush(true);
+    // If there are outstanding buffers to reorder, finalization failed
+    bool success = flushed && m_buffers.empty();
+    ReleaseBuffers();
     m_fh->close();
     m_open_for_write = false;
-    // If there are outstanding buffers to reorder, finalization failed
-    return m_avail_count == m_buffers.size();
+    return success;
 }
 
 
@@ -46,75 +58,129 @@ Stream::Stat(struct stat* buf)
     return m_fh->stat(buf);
 }
 
+
+size_t
+Stream::AvailableBuffers() const
+{
+    if (m_buffers.size() >= m_max_blocks) {
+        return 0;
+    }
+    return std::min(m_max_blocks - m_buffers.size(),
+                    BufferPool::Instance().Available(m_buffer_size));
+}
+
+
 int
 Stream::Write(off_t offset, const char *buf, size_t size)
 {
     if (!m_open_for_write) return SFS_ERROR;
-    bool buffer_accepted = false;
-    int retval = size;
     if (offset < m_offset) {
         return SFS_ERROR;
     }
-    if (offset == m_offset) {
-        retval = m_fh->write(offset, buf, size);
-        buffer_accepted = true;
+    if (!m_max_blocks) {
+        if (offset != m_offset) {
+            return SFS_ERROR;
+        }
+        int retval = m_fh->write(offset, buf, size);
         if (retval != SFS_ERROR) {
             m_offset += retval;
         }
-        // If there are no in-use buffers, then we don't need to
-        // do any accounting.
-        if (m_avail_count == m_buffers.size()) {
-            return retval;
-        }
+        return retval;
     }
-    // Even if we already accepted the current data, always
-    // iterate through available buffers and try to write as
-    // much out to disk as possible.
-    Entry *avail_entry;
-    bool buffer_was_written;
-    size_t avail_count = 0;
-    do {
-        avail_count = 0;
-        avail_entry = NULL;
-        buffer_was_written = false;
-        for (std::vector<Entry*>::iterator entry_iter = m_buffers.begin();
-             entry_iter != m_buffers.end();
-             entry_iter++) {
-            // Always try to dump from memory.
-            if ((*entry_iter)->Write(*this) > 0) {
-                buffer_was_written = true;
-            }
-            if ((*entry_iter)->Available()) { // Empty buffer
-                if (!avail_entry) {avail_entry = *entry_iter;}
-                avail_count ++;
-            }
-            else if (!buffer_accepted && (*entry_iter)->Accept(offset, buf, size)) {
-                buffer_accepted = true;
+
+    // Data at the head of the stream goes straight to the file, the rest is
+    // copied into the buffer of the window it falls in.  Within a window,
+    // data is expected to arrive in order (one ranged GET fills one window);
+    // across windows, any order is fine.
+    //
+    // First make sure that all of the data can be taken: if a buffer is
+    // needed but none can be had right now, nothing is consumed and 0 is
+    // returned so that the caller can offer the same data again later.
+    off_t head = m_offset;
+    for (size_t done = 0; done < size; ) {
+        off_t cur = offset + done;
+        off_t window = cur - (cur % m_buffer_size);
+        size_t len = std::min(size - done, static_cast<size_t>(window + m_buffer_size - cur));
+        done += len;
+
+        std::map<off_t, Entry>::iterator entry_iter = m_buffers.find(window);
+        if (entry_iter != m_buffers.end()) {
+            if (static_cast<off_t>(window + entry_iter->second.m_end) != cur) {
+                return SFS_ERROR;
             }
+            continue;
         }
-    } while ((avail_count != m_buffers.size()) && buffer_was_written);
-    m_avail_count = avail_count;
-
-    if (!buffer_accepted) {  // No place for this data in allocated buffers
-        if (!avail_entry) {  // No available buffers to allocate.
-            return SFS_ERROR;
+        if (cur == head) {
+            head += len;
+            continue;
         }
-        if (!avail_entry->Accept(offset, buf, size)) {  // Empty buffer cannot accept?!?
-            return SFS_ERROR;
+        char *buffer = NULL;
+        if (m_buffers.size() < m_max_blocks) {
+            buffer = BufferPool::Instance().Get(m_buffer_size);
+        }
+        if (!buffer) {
+            return 0;
         }
-        m_avail_count --;
+        Entry entry;
+        entry.m_buffer = buffer;
+        entry.m_begin = entry.m_end = cur - window;
+        m_buffers.insert(std::make_pair(window, entry));
     }
 
-    // If we have low buffer occupancy, then release memory.
-    if ((m_buffers.size() > 2) && (m_avail_count * 2 > m_buffers.size())) {
-        for (std::vector<Entry*>::iterator entry_iter = m_buffers.begin();
-             entry_iter != m_buffers.end();
-             entry_iter++) {
-            (*entry_iter)->ShrinkIfUnused();
+    size_t done = 0;
+    while (done < size) {
+        off_t cur = offset + done;
+        off_t window = cur - (cur % m_buffer_size);
+        size_t len = std::min(size - done, static_cast<size_t>(window + m_buffer_size - cur));
+
+        std::map<off_t, Entry>::iterator entry_iter = m_buffers.find(window);
+        if (entry_iter == m_buffers.end()) {
+            int retval = m_fh->write(cur, buf + done, len);
+            if (retval != static_cast<int>(len)) {
+                return SFS_ERROR;
+            }
+            m_offset += retval;
+        } else {
+            Entry &entry = entry_iter->second;
+            memcpy(entry.m_buffer + entry.m_end, buf + done, len);
+            entry.m_end += len;
         }
+        done += len;
+    }
+
+    if (!Flush(false)) {
+        return SFS_ERROR;
     }
+    return size;
+}
+
 
-    return retval;
+bool
+Stream::Flush(bool final)
+{
+    BufferPool &pool = BufferPool::Instance();
+    while (!m_buffers.empty()) {
+        std::map<off_t, Entry>::iterator entry_iter = m_buffers.begin();
+        Entry &entry = entry_iter->second;
+        if (static_cast<off_t>(entry_iter->first + entry.m_begin) != m_offset) {
+            break;
+        }
+        if (!final && (entry.m_end != m_buffer_size)) {
+            break;
+        }
+        size_t len = entry.m_end - entry.m_begin;
+        int retval = m_fh->write(m_offset, entry.m_buffer + entry.m_begin, len);
+        if (retval != static_cast<int>(len)) {
+            std::stringstream ss;
+            ss << "Failed to write " << len << " bytes at offset " << m_offset;
+            m_log.Emsg("Stream::Flush", ss.str().c_str());
+            return false;
+        }
+        m_offset += len;
+        pool.Release(entry.m_buffer, m_buffer_size);
+        m_buffers.erase(entry_iter);
+    }
+    return true;
 }
 
 
@@ -123,15 +189,21 @@ Stream::DumpBuffers() const
 {
     m_log.Emsg("Stream::DumpBuffers", "Beginning dump of stream buffers.");
     size_t idx = 0;
-    for (std::vector<Entry*>::const_iterator entry_iter = m_buffers.begin();
+    for (std::map<off_t, Entry>::const_iterator entry_iter = m_buffers.begin();
          entry_iter!= m_buffers.end();
          entry_iter++) {
         std::stringstream ss;
-        ss << "Buffer " << idx << ": Offset=" << (*entry_iter)->GetOffset() << ", Size="
-           << (*entry_iter)->GetSize() << ", Capacity=" << (*entry_iter)->GetCapacity();
+        ss << "Buffer " << idx << ": Offset=" << entry_iter->first + entry_iter->second.m_begin
+           << ", Size=" << entry_iter->second.m_end - entry_iter->second.m_begin
+           << ", Capacity=" << m_buffer_size;
         m_log.Emsg("Stream::DumpBuffers", ss.str().c_str());
         idx ++;
     }
+    {
+        std::stringstream ss;
+        ss << "Stream offset=" << m_offset << ", pool limit=" << BufferPool::Instance().GetMaxMemory();
+        m_log.Emsg("Stream::DumpBuffers", ss.str().c_str());
+    }
     m_log.Emsg("Stream::DumpBuffers", "Finish dump of stream buffers.");
 }
 
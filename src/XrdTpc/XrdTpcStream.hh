@@ -7,10 +7,10 @@
  * supports single-stream writes.
  */
 
+#include <map>
 #include <memory>
-#include <vector>
 
-#include <cstring>
+#include <sys/types.h>
 
 struct stat;
 
@@ -20,19 +20,19 @@ class XrdSysError;
 namespace TPC {
 class Stream {
 public:
+    // Data arriving out of order is held in up to max_blocks buffers of
+    // buffer_size bytes, taken from the process-wide BufferPool; each buffer
+    // covers an aligned window of the file, so data is written out in large,
+    // aligned writes.  Data arriving in order at the head of the stream is not
+    // buffered.  With max_blocks == 0 all writes go straight to the file.
     Stream(std::unique_ptr<XrdSfsFile> fh, size_t max_blocks, size_t buffer_size, XrdSysError &log)
-        : m_open_for_write(false),
-          m_avail_count(max_blocks),
+        : m_open_for_write(true),
+          m_max_blocks(max_blocks),
+          m_buffer_size(buffer_size),
           m_fh(std::move(fh)),
           m_offset(0),
           m_log(log)
-    {
-        m_buffers.reserve(max_blocks);
-        for (size_t idx=0; idx < max_blocks; idx++) {
-            m_buffers.push_back(new Entry(buffer_size));
-        }
-        m_open_for_write = true;
-    }
+    {}
 
     ~Stream();
 
@@ -40,9 +40,13 @@ public:
 
     int Read(off_t offset, char *buffer, size_t size);
 
+    // Returns the number of bytes written, SFS_ERROR on failure or 0 if no
+    // buffer is available for out-of-order data at the moment; in the latter
+    // case none of the data has been taken and the write should be retried
+    // once buffers have been released.
     int Write(off_t offset, const char *buffer, size_t size);
 
-    size_t AvailableBuffers() const {return m_avail_count;}
+    size_t AvailableBuffers() const;
 
     void DumpBuffers() const;
 
@@ -57,89 +61,26 @@ public:
 
 private:
 
-    class Entry {
-    public:
-        Entry(size_t capacity) :
-            m_offset(-1),
-            m_capacity(capacity),
-            m_size(0)
-        {}
-
-        bool Available() const {return m_offset == -1;}
-
-        int Write(Stream &stream) {
-            if (Available() || !CanWrite(stream)) {return 0;}
-            // Currently, only full writes are accepted.
-            int size_desired = m_size;
-            int retval = stream.Write(m_offset, &m_buffer[0], size_desired);
-            m_size = 0;
-            m_offset = -1;
-            if (retval != size_desired) {
-                return -1;
-            }
-            return retval;
-        }
-
-        bool Accept(off_t offset, const char *buf, size_t size) {
-            // Validate acceptance criteria.
-            if ((m_offset != -1) && (offset != m_offset + static_cast<ssize_t>(m_size))) {
-                return false;
-            }
-            if (size > m_capacity - m_size) {
-                return false;
-            }
-
-            // Inflate the underlying buffer if needed.
-            ssize_t new_bytes_needed = (m_size + size) - m_buffer.capacity();
-            if (new_bytes_needed > 0) {
-                m_buffer.reserve(m_capacity);
-            }
-
-            // Finally, do the copy.
-            memcpy(&m_buffer[0] + m_size, buf, size);
-            m_size += size;
-            if (m_offset == -1) {
-                m_offset = offset;
-            }
-            return true;
-        }
-
-        void ShrinkIfUnused() {
-           if (!Available()) {return;}
-#if __cplusplus > 199711L
-           m_buffer.shrink_to_fit();
-#endif
-        }
-
-        void Move(Entry &other) {
-            m_buffer.swap(other.m_buffer);
-            m_offset = other.m_offset;
-            m_size = other.m_size;
-        }
-
-        off_t GetOffset() const {return m_offset;}
-        size_t GetCapacity() const {return m_capacity;}
-        size_t GetSize() const {return m_size;}
-
-    private:
-
-        Entry(const Entry&) = delete;
-
-        bool CanWrite(Stream &stream) const {
-            return (m_size > 0) && (m_offset == stream.m_offset);
-        }
-
-        off_t m_offset;  // Offset within file that m_buffer[0] represents.
-        size_t m_capacity;
-        size_t m_size;  // Number of bytes held in buffer.
-        std::vector<char> m_buffer;
+    // A buffer holding the data of one aligned window of the file; the
+    // valid bytes are [m_begin, m_end) relative to the window start.
+    struct Entry {
+        char *m_buffer;
+        size_t m_begin;
+        size_t m_end;
     };
 
+    // Write out the buffers at the head of the stream.  Partially filled
+    // buffers are only written if final is set.  Returns false on error.
+    bool Flush(bool final);
+
+    void ReleaseBuffers();
+
     bool m_open_for_write;
-    size_t m_avail_count;
+    size_t m_max_blocks;
+    size_t m_buffer_size;
     std::unique_ptr<XrdSfsFile> m_fh;
-    off_t m_offset;
-    std::vector<Entry*> m_buffers;
+    off_t m_offset;  // Bytes written to the file so far.
+    std::map<off_t, Entry> m_buffers;  // Buffered data, keyed by window offset.
     XrdSysError &m_log;
 };
 }
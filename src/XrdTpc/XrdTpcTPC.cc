@@ -26,6 +26,7 @@ using namespace TPC;
 uint64_t TPCHandler::m_monid{0};
 int TPCHandler::m_marker_period = 5;
 size_t TPCHandler::m_block_size = 16*1024*1024;
+int TPCHandler::m_max_streams = 0;
 XrdSysMutex TPCHandler::m_monid_mutex;
 
 XrdVERSIONINFO(XrdHttpGetExtHandler, HttpTPC);
@@ -401,6 +402,9 @@ int TPCHandler::RunCurlWithUpdates(CURL *curl, XrdHttpExtReq &req, State &state,
     } else if (state.GetStatusCode() >= 400) {
         ss << "failure: Remote side failed with status code " << state.GetStatusCode();
         m_log.Emsg(log_prefix, "Remote server failed request", ss.str().c_str());
+    } else if (!state.Finalize()) {
+        ss << "failure: Failed to finalize and close file handle.";
+        m_log.Emsg(log_prefix, "Failed to finalize file handle");
     } else {
         ss << "success: Created";
     }
@@ -430,6 +434,10 @@ int TPCHandler::RunCurlBasic(CURL *curl, XrdHttpExtReq &req, State &state,
         m_log.Emsg(log_prefix, "Curl failed", curl_easy_strerror(res));
         char msg[] = "Unknown internal transfer failure";
         return req.SendSimpleResp(500, NULL, NULL, msg, 0);
+    } else if (!state.Finalize()) {
+        m_log.Emsg(log_prefix, "Failed to finalize file handle");
+        char msg[] = "Failed to finalize and close file handle";
+        return req.SendSimpleResp(500, NULL, NULL, msg, 0);
     } else {
         char msg[] = "Created";
         return req.SendSimpleResp(201, NULL, NULL, msg, 0);
@@ -560,13 +568,19 @@ int TPCHandler::ProcessPullReq(const std::string &resource, XrdHttpExtReq &req)
         curl_easy_setopt(curl, CURLOPT_CAPATH, m_cadir.c_str());
     }
     curl_easy_setopt(curl, CURLOPT_URL, resource.c_str());
-    Stream stream(std::move(fh), streams * m_pipelining_multiplier, m_block_size, m_log);
+    // With adaptive streams, the client request only sets the starting point.
+    size_t max_streams = streams;
+    if (m_max_streams > 0) {
+        max_streams = m_max_streams;
+        streams = std::min(std::max(streams, 2), m_max_streams);
+    }
+    Stream stream(std::move(fh), max_streams * m_pipelining_multiplier, m_block_size, m_log);
     State state(0, stream, curl, false);
     state.CopyHeaders(req);
 
 #ifdef XRD_CHUNK_RESP
-    if (streams > 1) {
-        return RunCurlWithStreams(req, state, "ProcessPullReq", streams);
+    if (max_streams > 1) {
+        return RunCurlWithStreams(req, state, "ProcessPullReq", streams, max_streams);
     } else {
         return RunCurlWithUpdates(curl, req, state, "ProcessPullReq");
     }
@@ -47,11 +47,15 @@ private:
     int RunCurlWithUpdates(CURL *curl, XrdHttpExtReq &req, TPC::State &state,
                            const char *log_prefix);
 
-    // Experimental multi-stream version of RunCurlWithUpdates
+    // Experimental multi-stream version of RunCurlWithUpdates.  Starts with
+    // the given number of streams; if max_streams is larger, the number of
+    // streams is adjusted during the transfer to maximize throughput.
     int RunCurlWithStreams(XrdHttpExtReq &req, TPC::State &state,
-                           const char *log_prefix, size_t streams);
+                           const char *log_prefix, size_t streams,
+                           size_t max_streams);
     int RunCurlWithStreamsImpl(XrdHttpExtReq &req, TPC::State &state,
                            const char *log_prefix, size_t streams,
+                           size_t max_streams,
                            std::vector<TPC::State*> streams_handles);
 #else
     int RunCurlBasic(CURL *curl, XrdHttpExtReq &req, TPC::State &state,
@@ -67,6 +71,7 @@ private:
 
     static int m_marker_period;
     static size_t m_block_size;
+    static int m_max_streams;  // If non-zero, adapt the streams of pulls up to this.
     bool m_desthttps;
     std::string m_cadir;
     static XrdSysMutex m_monid_mutex;
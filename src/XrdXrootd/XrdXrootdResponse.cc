@@ -32,6 +32,7 @@
 #include <inttypes.h>
 #include <string.h>
 
+#include "Xrd/XrdBuffer.hh"
 #include "Xrd/XrdLink.hh"
 #include "XrdXrootd/XrdXrootdResponse.hh"
 #include "XrdXrootd/XrdXrootdTrace.hh"
@@ -123,6 +124,27 @@ int XrdXrootdResponse::Send(XResponseType rcode, void *data, int dlen)
 
 /******************************************************************************/
 
+// The link takes over the buffer and releases it once the data has been sent.
+// This may only be used when there is no bridge (i.e. isOurs() is true).
+
+int XrdXrootdResponse::Send(XResponseType rcode, XrdBuffer *bP, int dlen)
+{
+
+    TRACES(RSP, "sending " <<dlen <<" buffer bytes; status=" <<rcode);
+
+    RespIO[1].iov_base = (caddr_t)bP->buff;
+    RespIO[1].iov_len  = dlen;
+
+    Resp.status        = static_cast<kXR_unt16>(htons(rcode));
+    Resp.dlen          = static_cast<kXR_int32>(htonl(dlen));
+
+    if (Link->Send(RespIO, 2, sizeof(Resp) + dlen, bP) < 0)
+       return Link->setEtext("send failure");
+    return 0;
+}
+
+/******************************************************************************/
+
 int XrdXrootdResponse::Send(XResponseType rcode,
                             struct iovec *IOResp,int iornum, int iolen)
 {
@@ -41,6 +41,7 @@
 /*                       x r o o t d _ R e s p o n s e                        */
 /******************************************************************************/
   
+class XrdBuffer;
 class XrdLink;
 class XrdOucSFVec;
 class XrdXrootdTransit;
@@ -57,6 +58,7 @@ const  char *ID() {return (const char *)trsid;}
        int   Send(void *data, int dlen);
        int   Send(struct iovec *, int iovcnt, int iolen=-1);
        int   Send(XResponseType rcode, void *data, int dlen);
+       int   Send(XResponseType rcode, XrdBuffer *bP, int dlen); // isOurs()
        int   Send(XResponseType rcode, struct iovec *IOResp,
                  int iornum, int iolen=-1);
        int   Send(XResponseType rcode, int info, const char *data, int dsz=-1);
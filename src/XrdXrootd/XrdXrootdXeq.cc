@@ -2166,6 +2166,7 @@ int XrdXrootdProtocol::do_Read()
 int XrdXrootdProtocol::do_ReadAll(int asyncOK)
 {
    int rc, xframt, Quantum = (myIOLen > maxBuffsz ? maxBuffsz : myIOLen);
+   bool giveBuff;
    char *buff;
 
 // If this file is memory mapped, short ciruit all the logic and immediately
@@ -2182,10 +2183,12 @@ int XrdXrootdProtocol::do_ReadAll(int asyncOK)
        return Response.Send(myFile->mmAddr+myOffset, xframt);
       }
 
-// If we are sendfile enabled, then just send the file if possible
+// If we are sendfile enabled, then just send the file if possible. When the
+// file system sends the data via SendData() the file size is meaningless (e.g.
+// SSI responses) and it is up to SendData() to not send more than it has.
 //
    if (myFile->sfEnabled && myIOLen >= as_minsfsz
-   &&  myOffset+myIOLen <= myFile->Stats.fSize)
+   &&  (myFile->fdNum < 0 || myOffset+myIOLen <= myFile->Stats.fSize))
       {myFile->Stats.rdOps(myIOLen);
        if (myFile->fdNum >= 0)
           return Response.Send(myFile->fdNum, myOffset, myIOLen);
@@ -2214,10 +2217,23 @@ int XrdXrootdProtocol::do_ReadAll(int asyncOK)
 // Now read all of the data. For statistics, we need to record the orignal
 // amount of the request even if we really do not get to read that much!
 //
+// Large enough chunks are handed over to the link along with the buffer so
+// that they can be sent without copying them. We then need a new buffer.
+//
+   giveBuff = XrdLink::zcMin && Quantum >= XrdLink::zcMin && Response.isOurs();
    myFile->Stats.rdOps(myIOLen);
    do {if ((xframt = myFile->XrdSfsp->read(myOffset, buff, Quantum)) <= 0) break;
-       if (xframt >= myIOLen) return Response.Send(buff, xframt);
-       if (Response.Send(kXR_oksofar, buff, xframt) < 0) return -1;
+       if (giveBuff && xframt >= XrdLink::zcMin)
+          {rc = Response.Send((xframt >= myIOLen ? kXR_ok : kXR_oksofar),
+                              argp, xframt);
+           argp = 0;
+           if (rc < 0 || xframt >= myIOLen) return rc;
+           if ((rc = getBuff(1, Quantum)) <= 0) return rc;
+           buff = argp->buff;
+          } else {
+           if (xframt >= myIOLen) return Response.Send(buff, xframt);
+           if (Response.Send(kXR_oksofar, buff, xframt) < 0) return -1;
+          }
        myOffset += xframt; myIOLen -= xframt;
        if (myIOLen < Quantum) Quantum = myIOLen;
       } while(myIOLen);
@@ -35,6 +35,8 @@
 #include "XrdCl/XrdClZipArchiveReader.hh"
 #include "XrdCl/XrdClConstants.hh"
 
+#include <zlib.h>
+
 using namespace XrdClTests;
 
 //------------------------------------------------------------------------------
@@ -46,6 +48,7 @@ class FileTest: public CppUnit::TestCase
     CPPUNIT_TEST_SUITE( FileTest );
       CPPUNIT_TEST( RedirectReturnTest );
       CPPUNIT_TEST( ReadTest );
+      CPPUNIT_TEST( ReadDeflatedZipTest );
       CPPUNIT_TEST( WriteTest );
       CPPUNIT_TEST( WriteVTest );
       CPPUNIT_TEST( VectorReadTest );
@@ -55,6 +58,7 @@ class FileTest: public CppUnit::TestCase
     CPPUNIT_TEST_SUITE_END();
     void RedirectReturnTest();
     void ReadTest();
+    void ReadDeflatedZipTest();
     void WriteTest();
     void WriteVTest();
     void VectorReadTest();
@@ -242,10 +246,244 @@ void FileTest::ReadTest()
     CPPUNIT_ASSERT( testset[i].expected == result );
   }
 
+  //----------------------------------------------------------------------------
+  // The same reads in a single vector read
+  //----------------------------------------------------------------------------
+  std::vector<std::string> filenames;
+  ChunkList                chunks;
+  for( int i = 0; i < 3; ++i )
+  {
+    memset( testset[i].buffer, 0, sizeof( testset[i].buffer ) );
+    filenames.push_back( testset[i].file );
+    chunks.push_back( ChunkInfo( testset[i].offset, testset[i].size, testset[i].buffer ) );
+  }
+
+  VectorReadInfo *vrInfo = 0;
+  CPPUNIT_ASSERT_XRDST( zip.VectorRead( filenames, chunks, vrInfo ) );
+  CPPUNIT_ASSERT( vrInfo );
+  for( int i = 0; i < 3; ++i )
+  {
+    ChunkInfo &chunk = vrInfo->GetChunks()[i];
+    CPPUNIT_ASSERT( chunk.offset == testset[i].offset );
+    std::string result( testset[i].buffer, chunk.length );
+    CPPUNIT_ASSERT( testset[i].expected == result );
+  }
+  delete vrInfo;
+
   CPPUNIT_ASSERT_XRDST( zip.Close() );
 }
 
 
+namespace
+{
+  //----------------------------------------------------------------------------
+  // Append a little endian integer to a buffer
+  //----------------------------------------------------------------------------
+  void PutLE( std::string &buffer, uint32_t value, int bytes )
+  {
+    for( int i = 0; i < bytes; ++i )
+      buffer.push_back( char( ( value >> ( 8 * i ) ) & 0xff ) );
+  }
+
+  //----------------------------------------------------------------------------
+  // Build a ZIP archive with a single deflated member
+  //----------------------------------------------------------------------------
+  std::string MakeDeflatedZip( const std::string &name,
+                               const std::string &data )
+  {
+    std::string compressed;
+    z_stream    strm;
+    memset( &strm, 0, sizeof( strm ) );
+    CPPUNIT_ASSERT( deflateInit2( &strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                                  -MAX_WBITS, 8, Z_DEFAULT_STRATEGY ) == Z_OK );
+    compressed.resize( deflateBound( &strm, data.size() ) );
+    strm.next_in   = (Bytef*)data.data();
+    strm.avail_in  = data.size();
+    strm.next_out  = (Bytef*)&compressed[0];
+    strm.avail_out = compressed.size();
+    CPPUNIT_ASSERT( deflate( &strm, Z_FINISH ) == Z_STREAM_END );
+    compressed.resize( strm.total_out );
+    deflateEnd( &strm );
+
+    uint32_t crc    = crc32( 0, (const Bytef*)data.data(), data.size() );
+    uint16_t method = 8;
+
+    std::string zip;
+    PutLE( zip, 0x04034b50, 4 );         // local file header
+    PutLE( zip, 20, 2 );                 // version needed
+    PutLE( zip, 0, 2 );                  // flags
+    PutLE( zip, method, 2 );
+    PutLE( zip, 0, 4 );                  // time and date
+    PutLE( zip, crc, 4 );
+    PutLE( zip, compressed.size(), 4 );
+    PutLE( zip, data.size(), 4 );
+    PutLE( zip, name.size(), 2 );
+    PutLE( zip, 0, 2 );                  // extra field length
+    zip += name;
+    zip += compressed;
+
+    uint32_t cdOffset = zip.size();
+    PutLE( zip, 0x02014b50, 4 );         // central directory header
+    PutLE( zip, 20, 2 );                 // version made by
+    PutLE( zip, 20, 2 );                 // version needed
+    PutLE( zip, 0, 2 );                  // flags
+    PutLE( zip, method, 2 );
+    PutLE( zip, 0, 4 );                  // time and date
+    PutLE( zip, crc, 4 );
+    PutLE( zip, compressed.size(), 4 );
+    PutLE( zip, data.size(), 4 );
+    PutLE( zip, name.size(), 2 );
+    PutLE( zip, 0, 2 );                  // extra field length
+    PutLE( zip, 0, 2 );                  // comment length
+    PutLE( zip, 0, 2 );                  // disk number
+    PutLE( zip, 0, 2 );                  // internal attributes
+    PutLE( zip, 0, 4 );                  // external attributes
+    PutLE( zip, 0, 4 );                  // local header offset
+    zip += name;
+    uint32_t cdSize = zip.size() - cdOffset;
+
+    PutLE( zip, 0x06054b50, 4 );         // end of central directory
+    PutLE( zip, 0, 2 );                  // disk number
+    PutLE( zip, 0, 2 );                  // disk with the central directory
+    PutLE( zip, 1, 2 );                  // records on this disk
+    PutLE( zip, 1, 2 );                  // records in total
+    PutLE( zip, cdSize, 4 );
+    PutLE( zip, cdOffset, 4 );
+    PutLE( zip, 0, 2 );                  // comment length
+    return zip;
+  }
+
+  //----------------------------------------------------------------------------
+  // Read from a member of an archive and compare with the expected data
+  //----------------------------------------------------------------------------
+  void CheckZipRead( const std::string &url, const std::string &name,
+                     const std::string &data,
+                     const std::vector<uint64_t> &offsets, uint32_t size )
+  {
+    using namespace XrdCl;
+
+    File             archive;
+    ZipArchiveReader zip( archive );
+    std::string      buffer( size, 0 );
+    uint64_t         memberSize = 0;
+
+    CPPUNIT_ASSERT_XRDST( zip.Open( url ) );
+    CPPUNIT_ASSERT_XRDST( zip.GetSize( name, memberSize ) );
+    CPPUNIT_ASSERT( memberSize == data.size() );
+
+    for( size_t i = 0; i < offsets.size(); ++i )
+    {
+      uint32_t bytesRead = 0;
+      CPPUNIT_ASSERT_XRDST( zip.Read( name, offsets[i], size, &buffer[0],
+                                      bytesRead ) );
+      uint32_t expected = offsets[i] >= data.size() ? 0 :
+                          std::min<uint64_t>( size, data.size() - offsets[i] );
+      CPPUNIT_ASSERT( bytesRead == expected );
+      if( expected )
+        CPPUNIT_ASSERT( !data.compare( offsets[i], expected, buffer.data(),
+                                       bytesRead ) );
+    }
+
+    CPPUNIT_ASSERT_XRDST( zip.Close() );
+  }
+}
+
+//------------------------------------------------------------------------------
+// Read deflated ZIP member test
+//------------------------------------------------------------------------------
+void FileTest::ReadDeflatedZipTest()
+{
+  using namespace XrdCl;
+
+  //----------------------------------------------------------------------------
+  // Initialize
+  //----------------------------------------------------------------------------
+  Env *testEnv = TestEnv::GetEnv();
+
+  std::string address;
+  std::string dataPath;
+
+  CPPUNIT_ASSERT( testEnv->GetString( "MainServerURL", address ) );
+  CPPUNIT_ASSERT( testEnv->GetString( "DataPath", dataPath ) );
+
+  URL url( address );
+  CPPUNIT_ASSERT( url.IsValid() );
+
+  std::string filePath   = dataPath + "/deflated.zip";
+  std::string archiveUrl = address + "/" + filePath;
+
+  //----------------------------------------------------------------------------
+  // A few MB of text that compresses to more than the archive reader keeps
+  // in memory, so the member gets inflated from the remote file
+  //----------------------------------------------------------------------------
+  const char *words[] = { "event", "track", "vertex", "cluster", "hit",
+                          "jet", "muon", "electron", "photon", "tau" };
+  std::string data;
+  uint32_t    seed = 12345;
+  char        line[64];
+  while( data.size() < 4*1024*1024 )
+  {
+    seed = seed * 1103515245 + 12345;
+    snprintf( line, sizeof( line ), "%08u %s %u\n", (unsigned)data.size(),
+              words[( seed >> 16 ) % 10], seed % 100000 );
+    data += line;
+  }
+
+  std::string zip = MakeDeflatedZip( "deflated.txt", data );
+  CPPUNIT_ASSERT( zip.size() > 256*1024 );
+
+  File f;
+  CPPUNIT_ASSERT_XRDST( f.Open( archiveUrl, OpenFlags::Delete | OpenFlags::Update,
+                                Access::UR | Access::UW ) );
+  for( size_t off = 0; off < zip.size(); off += 1024*1024 )
+    CPPUNIT_ASSERT_XRDST( f.Write( off, std::min<size_t>( 1024*1024, zip.size() - off ),
+                                   zip.data() + off ) );
+  CPPUNIT_ASSERT_XRDST( f.Close() );
+
+  //----------------------------------------------------------------------------
+  // Read the whole member in order, then at random offsets (including one
+  // past the end) which are served from the nearest access point
+  //----------------------------------------------------------------------------
+  std::vector<uint64_t> sequential;
+  for( uint64_t off = 0; off < data.size(); off += 100000 )
+    sequential.push_back( off );
+
+  std::vector<uint64_t> random;
+  random.push_back( data.size() - 17 );
+  random.push_back( 5 );
+  random.push_back( 3*1024*1024 + 777 );
+  random.push_back( 1024*1024 - 1 );
+  random.push_back( 2*1024*1024 + 12345 );
+  random.push_back( 64*1024 );
+  random.push_back( data.size() + 10 );
+
+  std::vector<uint64_t> both = sequential;
+  both.insert( both.end(), random.begin(), random.end() );
+  CheckZipRead( archiveUrl, "deflated.txt", data, both, 100000 );
+
+  //----------------------------------------------------------------------------
+  // Random offsets on a fresh reader with a small index span, so that the
+  // index is built while seeking
+  //----------------------------------------------------------------------------
+  Env *env = DefaultEnv::GetEnv();
+  int  span = DefaultZipIndexSpan;
+  env->GetInt( "ZipIndexSpan", span );
+
+  env->PutInt( "ZipIndexSpan", 128*1024 );
+  CheckZipRead( archiveUrl, "deflated.txt", data, random, 4096 );
+
+  //----------------------------------------------------------------------------
+  // The same with the index disabled (XRD_ZIPINDEXSPAN=0), every read
+  // inflates from the start of the member
+  //----------------------------------------------------------------------------
+  env->PutInt( "ZipIndexSpan", 0 );
+  CheckZipRead( archiveUrl, "deflated.txt", data, random, 4096 );
+  env->PutInt( "ZipIndexSpan", span );
+
+  FileSystem fs( url );
+  CPPUNIT_ASSERT_XRDST( fs.Rm( filePath ) );
+}
+
 //------------------------------------------------------------------------------
 // Read test
 //------------------------------------------------------------------------------
@@ -27,8 +27,14 @@
 #include "XrdCl/XrdClURL.hh"
 #include "XrdCl/XrdClAnyObject.hh"
 #include "XrdCl/XrdClTaskManager.hh"
+#include "XrdCl/XrdClJobManager.hh"
 #include "XrdCl/XrdClSIDManager.hh"
 #include "XrdCl/XrdClPropertyList.hh"
+#include "XrdCl/XrdClReplicaStats.hh"
+
+#include <atomic>
+#include <vector>
+#include <pthread.h>
 
 //------------------------------------------------------------------------------
 // Declaration
@@ -40,14 +46,18 @@ class UtilsTest: public CppUnit::TestCase
       CPPUNIT_TEST( URLTest );
       CPPUNIT_TEST( AnyTest );
       CPPUNIT_TEST( TaskManagerTest );
+      CPPUNIT_TEST( JobManagerTest );
       CPPUNIT_TEST( SIDManagerTest );
       CPPUNIT_TEST( PropertyListTest );
+      CPPUNIT_TEST( ReplicaStatsTest );
     CPPUNIT_TEST_SUITE_END();
     void URLTest();
     void AnyTest();
     void TaskManagerTest();
+    void JobManagerTest();
     void SIDManagerTest();
     void PropertyListTest();
+    void ReplicaStatsTest();
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION( UtilsTest );
@@ -372,6 +382,104 @@ void UtilsTest::TaskManagerTest()
   CPPUNIT_ASSERT( taskMan.Stop() );
 }
 
+//------------------------------------------------------------------------------
+// A job counting its runs, every other one queues a follow-up job from
+// the worker like a response handler would
+//------------------------------------------------------------------------------
+class CountingJob: public XrdCl::Job
+{
+  public:
+    CountingJob( XrdCl::JobManager &jm, std::vector<std::atomic<int> > &runs,
+                 std::atomic<int> &total, std::atomic<int> &notWorker ):
+      pJobMan( jm ), pRuns( runs ), pTotal( total ), pNotWorker( notWorker ) {}
+
+    virtual void Run( void *arg )
+    {
+      size_t index = (size_t)arg;
+      if( !pJobMan.IsWorker() )
+        ++pNotWorker;
+      ++pRuns[index];
+      if( index % 2 == 0 && index + 1 < pRuns.size() )
+        pJobMan.QueueJob( this, (void*)(index + 1) );
+      ++pTotal;
+    }
+
+  private:
+    XrdCl::JobManager              &pJobMan;
+    std::vector<std::atomic<int> > &pRuns;
+    std::atomic<int>               &pTotal;
+    std::atomic<int>               &pNotWorker;
+};
+
+namespace
+{
+  struct JobProducer
+  {
+    XrdCl::JobManager *jobMan;
+    CountingJob       *job;
+    size_t             first;
+    size_t             last;
+  };
+
+  void *QueueJobs( void *arg )
+  {
+    JobProducer *p = (JobProducer*)arg;
+    for( size_t i = p->first; i < p->last; i += 2 )
+      p->jobMan->QueueJob( p->job, (void*)i );
+    return 0;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Job Manager test
+//------------------------------------------------------------------------------
+void UtilsTest::JobManagerTest()
+{
+  using namespace XrdCl;
+
+  const size_t   numProducers = 4;
+  const size_t   numJobs      = 100000;
+  std::vector<std::atomic<int> > runs( numJobs );
+  std::atomic<int> total( 0 );
+  std::atomic<int> notWorker( 0 );
+  for( size_t i = 0; i < numJobs; ++i )
+    runs[i] = 0;
+
+  //----------------------------------------------------------------------------
+  // A zero queue latency threshold makes the job manager grow right away
+  //----------------------------------------------------------------------------
+  JobManager jobMan( 2, 8, 0 );
+  CountingJob job( jobMan, runs, total, notWorker );
+  CPPUNIT_ASSERT( jobMan.Initialize() );
+  CPPUNIT_ASSERT( jobMan.Start() );
+  CPPUNIT_ASSERT( !jobMan.IsWorker() );
+
+  pthread_t   threads[numProducers];
+  JobProducer producers[numProducers];
+  for( size_t i = 0; i < numProducers; ++i )
+  {
+    producers[i].jobMan = &jobMan;
+    producers[i].job    = &job;
+    producers[i].first  = i * numJobs / numProducers;
+    producers[i].last   = (i + 1) * numJobs / numProducers;
+    CPPUNIT_ASSERT( pthread_create( &threads[i], 0, QueueJobs,
+                                    &producers[i] ) == 0 );
+  }
+  for( size_t i = 0; i < numProducers; ++i )
+    pthread_join( threads[i], 0 );
+
+  for( int i = 0; i < 300 && total < (int)numJobs; ++i )
+    ::usleep( 100000 );
+
+  CPPUNIT_ASSERT( jobMan.Stop() );
+  CPPUNIT_ASSERT( jobMan.Finalize() );
+
+  CPPUNIT_ASSERT( total == (int)numJobs );
+  CPPUNIT_ASSERT( notWorker == 0 );
+  for( size_t i = 0; i < numJobs; ++i )
+    CPPUNIT_ASSERT( runs[i] == 1 );
+}
+
 //------------------------------------------------------------------------------
 // SID Manager test
 //------------------------------------------------------------------------------
@@ -459,3 +567,60 @@ void UtilsTest::PropertyListTest()
   for( size_t i = 0; i < v1.size(); ++i )
     CPPUNIT_ASSERT( v1[i] == v2[i] );
 }
+
+//------------------------------------------------------------------------------
+// Replica stats test
+//------------------------------------------------------------------------------
+void UtilsTest::ReplicaStatsTest()
+{
+  using namespace XrdCl;
+  ReplicaStats &stats = ReplicaStats::Instance();
+
+  std::vector<std::string> urls;
+  urls.push_back( "root://rstest1.cern.ch:1094//data/file" );
+  urls.push_back( "root://rstest2.cern.ch:1094//data/file" );
+  urls.push_back( "root://rstest3.cern.ch:1094//data/file" );
+  urls.push_back( "root://rstest4.cern.ch:1094//data/file" );
+
+  //----------------------------------------------------------------------------
+  // Nothing known, the order is preserved
+  //----------------------------------------------------------------------------
+  std::vector<std::string> v( urls );
+  stats.Sort( v, 1000000000 );
+  for( size_t i = 0; i < urls.size(); ++i )
+    CPPUNIT_ASSERT( v[i] == urls[i] );
+
+  //----------------------------------------------------------------------------
+  // A slow host goes after a fast one, unknown hosts are average
+  //----------------------------------------------------------------------------
+  stats.ReportLatency( URL( urls[0] ), 1000 );
+  stats.ReportTransfer( URL( urls[0] ), 10000000, 10000000 );
+  stats.ReportLatency( URL( urls[2] ), 1000 );
+  stats.ReportTransfer( URL( urls[2] ), 100000000, 1000000 );
+
+  double t1 = 0, t3 = 0;
+  CPPUNIT_ASSERT( stats.ExpectedTime( URL( urls[0] ), 1000000000, t1 ) );
+  CPPUNIT_ASSERT( stats.ExpectedTime( URL( urls[2] ), 1000000000, t3 ) );
+  CPPUNIT_ASSERT( t3 < t1 );
+  CPPUNIT_ASSERT( !stats.ExpectedTime( URL( urls[1] ), 1000000000, t1 ) );
+
+  v = urls;
+  stats.Sort( v, 1000000000 );
+  CPPUNIT_ASSERT( v[0] == urls[2] );
+  CPPUNIT_ASSERT( v[1] == urls[1] );
+  CPPUNIT_ASSERT( v[2] == urls[3] );
+  CPPUNIT_ASSERT( v[3] == urls[0] );
+
+  //----------------------------------------------------------------------------
+  // A failed host goes last, until it delivers data again
+  //----------------------------------------------------------------------------
+  stats.ReportFailure( URL( urls[2] ) );
+  v = urls;
+  stats.Sort( v, 1000000000 );
+  CPPUNIT_ASSERT( v[3] == urls[2] );
+
+  stats.ReportTransfer( URL( urls[2] ), 100000000, 1000000 );
+  v = urls;
+  stats.Sort( v, 1000000000 );
+  CPPUNIT_ASSERT( v[0] == urls[2] );
+}
@@ -0,0 +1,219 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2026 by European Organization for Nuclear Research (CERN)
+//------------------------------------------------------------------------------
+// This file is part of the XRootD software suite.
+//
+// XRootD is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// XRootD is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with XRootD.  If not, see <http://www.gnu.org/licenses/>.
+//
+// In applying this licence, CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+//------------------------------------------------------------------------------
+
+
+//------------------------------------------------------------------------------
+// Benchmark for the job manager running the response callbacks. Jobs are
+// queued by a number of outside threads, like the event loop delivering
+// responses, and then in chains where every job queues the next one from
+// the worker, like a response handler issuing a follow-up request. The
+// number of jobs run per second is reported for both.
+//
+// Usage: xrdcljobbench [-c <chains>] [-d <depth>] [-j <jobs>] [-l <latency>]
+//                      [-m <max workers>] [-p <producers>] [-s <usec>]
+//                      [-w <workers>]
+//
+// -c   number of job chains, default 64.
+// -d   number of jobs in each chain, default 10000.
+// -j   number of jobs queued by the producers, default 1000000.
+// -l   queue latency (ms) above which a worker is added, default 10.
+// -m   maximum number of workers, default 0 (no autoscaling).
+// -p   number of producer threads, default 4.
+// -s   time (us) every job blocks for, default 0.
+// -w   number of workers, default 3.
+//------------------------------------------------------------------------------
+
+#include "XrdCl/XrdClJobManager.hh"
+#include "XrdSys/XrdSysPthread.hh"
+
+#include <atomic>
+#include <iostream>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+namespace
+{
+  uint32_t numChains    = 64;
+  uint32_t chainDepth   = 10000;
+  uint32_t numJobs      = 1000000;
+  uint32_t latency      = 10;
+  uint32_t maxWorkers   = 0;
+  uint32_t numProducers = 4;
+  uint32_t blockTime    = 0;
+  uint32_t numWorkers   = 3;
+
+  //----------------------------------------------------------------------------
+  // Current time in seconds
+  //----------------------------------------------------------------------------
+  double Now()
+  {
+    timeval tv;
+    gettimeofday( &tv, 0 );
+    return tv.tv_sec + tv.tv_usec / 1e6;
+  }
+
+  //----------------------------------------------------------------------------
+  // Job counting its runs, posting the semaphore after the last one
+  //----------------------------------------------------------------------------
+  class BenchJob: public XrdCl::Job
+  {
+    public:
+      BenchJob( XrdCl::JobManager &jm ): pJobMan( jm ), pDone( 0 ),
+        pSem( 0 ), pTarget( 0 ) {}
+
+      void Reset( uint64_t target )
+      {
+        pDone   = 0;
+        pTarget = target;
+      }
+
+      void Wait()
+      {
+        pSem.Wait();
+      }
+
+      //------------------------------------------------------------------------
+      // The argument is the number of jobs left in the chain
+      //------------------------------------------------------------------------
+      virtual void Run( void *arg )
+      {
+        uintptr_t left = (uintptr_t)arg;
+        if( blockTime )
+          usleep( blockTime );
+        if( left > 1 )
+          pJobMan.QueueJob( this, (void*)(left - 1) );
+        if( ++pDone == pTarget )
+          pSem.Post();
+      }
+
+    private:
+      XrdCl::JobManager     &pJobMan;
+      std::atomic<uint64_t>  pDone;
+      XrdSysSemaphore        pSem;
+      uint64_t               pTarget;
+  };
+
+  struct Producer
+  {
+    XrdCl::JobManager *jobMan;
+    BenchJob          *job;
+    uint32_t           jobs;
+    pthread_t          thread;
+  };
+
+  void *Produce( void *arg )
+  {
+    Producer *p = (Producer*)arg;
+    for( uint32_t i = 0; i < p->jobs; ++i )
+      p->jobMan->QueueJob( p->job, (void*)1 );
+    return 0;
+  }
+
+  void Report( const char *what, uint64_t jobs, double elapsed )
+  {
+    printf( "%-8s %10llu jobs in %.3fs = %.0f jobs/s\n", what,
+            (unsigned long long)jobs, elapsed, jobs / elapsed );
+  }
+}
+
+//------------------------------------------------------------------------------
+// Start it up
+//------------------------------------------------------------------------------
+int main( int argc, char **argv )
+{
+  const char *usage = "Usage: xrdcljobbench [-c <chains>] [-d <depth>] "
+                      "[-j <jobs>] [-l <latency>] [-m <max workers>] "
+                      "[-p <producers>] [-s <usec>] [-w <workers>]";
+  int c;
+  while( ( c = getopt( argc, argv, "c:d:j:l:m:p:s:w:" ) ) != -1 )
+  {
+    uint32_t val = atoi( optarg ? optarg : "0" );
+    switch( c )
+    {
+      case 'c': numChains    = val; break;
+      case 'd': chainDepth   = val; break;
+      case 'j': numJobs      = val; break;
+      case 'l': latency      = val; break;
+      case 'm': maxWorkers   = val; break;
+      case 'p': numProducers = val; break;
+      case 's': blockTime    = val; break;
+      case 'w': numWorkers   = val; break;
+      default: std::cerr << usage << std::endl; return 1;
+    }
+  }
+  if( !numWorkers || !numProducers || !numChains || !chainDepth )
+  {
+    std::cerr << usage << std::endl;
+    return 1;
+  }
+
+  XrdCl::JobManager jobMan( numWorkers, maxWorkers, latency );
+  BenchJob job( jobMan );
+  jobMan.Initialize();
+  if( !jobMan.Start() )
+  {
+    std::cerr << "Unable to start the job manager" << std::endl;
+    return 2;
+  }
+
+  //----------------------------------------------------------------------------
+  // Jobs queued by outside threads
+  //----------------------------------------------------------------------------
+  std::vector<Producer> producers( numProducers );
+  uint64_t total = 0;
+  for( uint32_t i = 0; i < numProducers; ++i )
+  {
+    producers[i].jobMan = &jobMan;
+    producers[i].job    = &job;
+    producers[i].jobs   = numJobs / numProducers;
+    total += producers[i].jobs;
+  }
+
+  job.Reset( total );
+  double start = Now();
+  for( uint32_t i = 0; i < numProducers; ++i )
+    pthread_create( &producers[i].thread, 0, Produce, &producers[i] );
+  for( uint32_t i = 0; i < numProducers; ++i )
+    pthread_join( producers[i].thread, 0 );
+  if( total )
+    job.Wait();
+  Report( "queued", total, Now() - start );
+
+  //----------------------------------------------------------------------------
+  // Jobs queued by the workers
+  //----------------------------------------------------------------------------
+  total = (uint64_t)numChains * chainDepth;
+  job.Reset( total );
+  start = Now();
+  for( uint32_t i = 0; i < numChains; ++i )
+    jobMan.QueueJob( &job, (void*)(uintptr_t)chainDepth );
+  job.Wait();
+  Report( "chained", total, Now() - start );
+
+  jobMan.Stop();
+  jobMan.Finalize();
+  return 0;
+}
@@ -0,0 +1,200 @@
+/******************************************************************************/
+/*                                                                            */
+/*                X r d F f s R e a d A h e a d T e s t . c c                 */
+/*                                                                            */
+/* This file is part of the XRootD software suite.                            */
+/*                                                                            */
+/* XRootD is free software: you can redistribute it and/or modify it under    */
+/* the terms of the GNU Lesser General Public License as published by the     */
+/* Free Software Foundation, either version 3 of the License, or (at your     */
+/* option) any later version.                                                 */
+/*                                                                            */
+/* XRootD is distributed in the hope that it will be useful, but WITHOUT      */
+/* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or      */
+/* FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public       */
+/* License for more details.                                                  */
+/*                                                                            */
+/* You should have received a copy of the GNU Lesser General Public License   */
+/* along with XRootD in a file called COPYING.LESSER (LGPL license) and file  */
+/* COPYING (GPL license).  If not, see <http://www.gnu.org/licenses/>.        */
+/*                                                                            */
+/* The copyright holder's institutional names and contributor's names may not */
+/* be used to endorse or promote products derived from this software without  */
+/* specific prior written permission of the institution or contributor.       */
+/******************************************************************************/
+
+/* Test of the xrootdfs read-ahead (XrdFfsWcache_pread). A file is written to
+   the given directory on a running server and read back through the cache
+   the way FUSE reads it: sequentially in 128KB pieces, at random offsets and
+   past its end. Only one file may do read-ahead at a time, so the test also
+   checks that a file gives its windows back once it is read at random.
+
+   Usage: xrdffsreadaheadtest root://<host>:<port>//<dir>
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "XrdFfs/XrdFfsPosix.hh"
+#include "XrdFfs/XrdFfsQueue.hh"
+#include "XrdFfs/XrdFfsWcache.hh"
+#include "XrdPosix/XrdPosixXrootd.hh"
+
+using namespace std;
+
+extern "C" int XrdFfsRcacheNfiles;
+
+/******************************************************************************/
+/*                          U n i t   G l o b a l s                           */
+/******************************************************************************/
+
+namespace
+{
+const size_t winSize  = 1024*1024;
+const size_t fuseRead = 128*1024;
+const off_t  fileSize = 3*winSize + 12345;
+const char  *MeMe     = "xrdffsreadaheadtest: ";
+int          numFail  = 0;
+
+#define SAY(x) cerr <<MeMe <<x <<endl
+
+#define CHECK(cond, what) \
+        if (!(cond)) {SAY("FAILED: " <<what); numFail++;}
+
+/******************************************************************************/
+/*                                  F i l l                                   */
+/******************************************************************************/
+
+// The byte at each offset is a function of the offset, so any misplaced
+// data shows.
+//
+inline char Byte(off_t off) {return (char)((off * 7 + off / 4099) & 0xff);}
+
+void Fill(char *buff, size_t len, off_t off)
+{
+   for (size_t i = 0; i < len; i++) buff[i] = Byte(off + i);
+}
+
+/******************************************************************************/
+/*                                 V e r i f y                                */
+/******************************************************************************/
+
+// Read len bytes at off and check what comes back, returns the read length.
+//
+ssize_t Verify(int fd, size_t len, off_t off, const char *what)
+{
+   vector<char> buff(len);
+   ssize_t rc, want;
+
+   rc = XrdFfsWcache_pread(fd, &buff[0], len, off);
+   want = (off >= fileSize ? 0 : (off + (off_t)len > fileSize ? fileSize - off
+                                                              : (off_t)len));
+   if (rc != want)
+      {SAY("FAILED: " <<what <<" read " <<rc <<" bytes at " <<off
+           <<", expected " <<want <<(rc < 0 ? "; " : "")
+           <<(rc < 0 ? strerror(errno) : ""));
+       numFail++;
+       return rc;
+      }
+   for (ssize_t i = 0; i < rc; i++)
+       if (buff[i] != Byte(off + i))
+          {SAY("FAILED: " <<what <<" bad data at " <<off + i); numFail++; break;}
+   return rc;
+}
+
+/******************************************************************************/
+/*                                  O p e n                                   */
+/******************************************************************************/
+
+int Open(const string &path)
+{
+   int fd = XrdFfsPosix_open(path.c_str(), O_RDONLY, 0);
+
+   if (fd < 0) {SAY("Unable to open " <<path <<"; " <<strerror(errno)); exit(2);}
+   if (!XrdFfsWcache_create(fd))
+      {SAY("Unable to create cache for " <<path); exit(2);}
+   return fd;
+}
+}
+
+/******************************************************************************/
+/*                                  m a i n                                   */
+/******************************************************************************/
+
+int main(int argc, char **argv)
+{
+   string path;
+   vector<char> buff(winSize);
+   off_t off;
+   int fd, fdA, fdB;
+
+   if (argc != 2) {SAY("Usage: xrdffsreadaheadtest root://<host>:<port>//<dir>");
+                   return 1;
+                  }
+   path = string(argv[1]) + "/xrdffsreadaheadtest.dat";
+
+// Set up things the way xrootdfs does, with room for one read-ahead file
+//
+   XrdPosixXrootd posix(-64);
+   XrdFfsWcache_init(posix.fdOrigin(), 64);
+   XrdFfsQueue_create_workers(2);
+   XrdFfsWcache_readahead(winSize, 1);
+
+// Write the test file
+//
+   fd = XrdFfsPosix_open(path.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
+   if (fd < 0) {SAY("Unable to create " <<path <<"; " <<strerror(errno)); return 2;}
+   for (off = 0; off < fileSize; off += winSize)
+       {size_t n = (fileSize - off < (off_t)winSize ? fileSize - off : winSize);
+        Fill(&buff[0], n, off);
+        if (XrdFfsPosix_pwrite(fd, &buff[0], n, off) != (ssize_t)n)
+           {SAY("Unable to write " <<path <<"; " <<strerror(errno)); return 2;}
+       }
+   XrdFfsPosix_close(fd);
+
+// A sequential read of the whole file, including the short read at its end
+// and the read following it, takes the read-ahead slot.
+//
+   fdA = Open(path);
+   fdB = Open(path);
+   for (off = 0; off < fileSize; off += fuseRead)
+       Verify(fdA, fuseRead, off, "sequential read");
+   Verify(fdA, fuseRead, off, "read past end of file");
+   CHECK(XrdFfsRcacheNfiles == 1, "sequential reader has no read-ahead");
+
+// Read out of order within what was read ahead, then at an offset that was
+// not read ahead (the first window starts at 128KB), which must give the slot back.
+//
+   Verify(fdA, fuseRead, fileSize - fuseRead, "read near end of file");
+   Verify(fdA, 4096, 7654, "random read");
+   CHECK(XrdFfsRcacheNfiles == 0, "random reader kept its read-ahead");
+   Verify(fdA, 4096, 1234567, "second random read");
+
+// Now the other file can do read-ahead. Start it near the end, so that
+// the windows are cut at the end of the file.
+//
+   for (off = fileSize - 5*fuseRead - 1000; off < fileSize + (off_t)fuseRead;
+        off += fuseRead)
+       Verify(fdB, fuseRead, off, "sequential read near end of file");
+   CHECK(XrdFfsRcacheNfiles == 1, "second reader did not get read-ahead");
+
+// Closing gives it back as well
+//
+   XrdFfsWcache_destroy(fdB);
+   XrdFfsPosix_close(fdB);
+   CHECK(XrdFfsRcacheNfiles == 0, "closed file kept its read-ahead");
+   XrdFfsWcache_destroy(fdA);
+   XrdFfsPosix_close(fdA);
+   XrdFfsPosix_unlink(path.c_str());
+
+   if (numFail) {SAY(numFail <<" check(s) failed"); return 3;}
+   cout <<"xrdffsreadaheadtest: all checks passed" <<endl;
+   return 0;
+}
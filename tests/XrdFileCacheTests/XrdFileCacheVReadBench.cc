@@ -0,0 +1,185 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2026 by European Organization for Nuclear Research (CERN)
+//------------------------------------------------------------------------------
+// This file is part of the XRootD software suite.
+//
+// XRootD is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// XRootD is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with XRootD.  If not, see <http://www.gnu.org/licenses/>.
+//
+// In applying this licence, CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Benchmark for vector reads through a caching proxy. It replays a ROOT-like
+// trace: baskets of 1-64KB in file order, with a random gap after about every
+// third one, sent in vector reads of the given number of chunks. The first
+// pass over a file that is not cached yet measures fetching from the origin,
+// further passes measure reading from the cache.
+//
+// Usage: xrdfilecachevreadbench [-n <chunks>] [-p <passes>] [-s <seed>]
+//                               [-v <local copy>] <url>
+//
+// -n   number of chunks in each vector read, default 512.
+// -p   number of passes over the file, default 1.
+// -s   seed of the trace, default 42.
+// -v   verify the data against a local copy of the file.
+//------------------------------------------------------------------------------
+
+#include "XrdCl/XrdClFile.hh"
+#include "XrdCl/XrdClXRootDResponses.hh"
+
+#include <iostream>
+#include <vector>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+namespace
+{
+int         numChunks = 512;
+int         numPasses = 1;
+unsigned    seed      = 42;
+const char *localCopy = 0;
+
+const uint32_t MinBasket = 1024;
+const uint32_t MaxBasket = 64 * 1024;
+const uint32_t MaxGap    = 256 * 1024;
+
+//------------------------------------------------------------------------------
+// Current time in seconds
+//------------------------------------------------------------------------------
+double Now()
+{
+   timeval tv;
+   gettimeofday(&tv, 0);
+   return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+//------------------------------------------------------------------------------
+// Compare what a vector read returned with the local copy
+//------------------------------------------------------------------------------
+bool Verify(int fd, const XrdCl::ChunkList &chunks)
+{
+   std::vector<char> buff(MaxBasket);
+
+   for (XrdCl::ChunkList::const_iterator it = chunks.begin(); it != chunks.end(); ++it)
+   {
+      if (pread(fd, &buff[0], it->length, it->offset) != (ssize_t) it->length ||
+          memcmp(&buff[0], it->buffer, it->length))
+      {
+         std::cerr << "Data mismatch in chunk at offset " << it->offset << std::endl;
+         return false;
+      }
+   }
+   return true;
+}
+}
+
+//------------------------------------------------------------------------------
+// Main
+//------------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+   const char *usage = "Usage: xrdfilecachevreadbench [-n <chunks>] "
+                       "[-p <passes>] [-s <seed>] [-v <local copy>] <url>";
+   int c;
+   while ((c = getopt(argc, argv, "n:p:s:v:")) != -1)
+   {
+      switch (c)
+      {
+         case 'n': numChunks = atoi(optarg); break;
+         case 'p': numPasses = atoi(optarg); break;
+         case 's': seed      = atoi(optarg); break;
+         case 'v': localCopy = optarg;       break;
+         default: std::cerr << usage << std::endl; return 1;
+      }
+   }
+   if (optind + 1 != argc || numChunks <= 0 || numPasses <= 0)
+   {
+      std::cerr << usage << std::endl;
+      return 1;
+   }
+
+   XrdCl::File         file;
+   XrdCl::StatInfo    *statInfo = 0;
+   XrdCl::XRootDStatus st = file.Open(argv[optind], XrdCl::OpenFlags::Read);
+   if (st.IsOK()) st = file.Stat(false, statInfo);
+   if ( ! st.IsOK())
+   {
+      std::cerr << "Unable to open " << argv[optind] << ": " << st.ToStr() << std::endl;
+      return 2;
+   }
+   uint64_t fileSize = statInfo->GetSize();
+   delete statInfo;
+
+   int fd = -1;
+   if (localCopy && (fd = open(localCopy, O_RDONLY)) < 0)
+   {
+      std::cerr << "Unable to open " << localCopy << std::endl;
+      return 2;
+   }
+
+   //---------------------------------------------------------------------------
+   // Replay the trace
+   //---------------------------------------------------------------------------
+   std::vector<char> buff((size_t) numChunks * MaxBasket);
+   uint64_t bytes = 0;
+   int      calls = 0;
+
+   srand(seed);
+   double start = Now();
+   for (int pass = 0; pass < numPasses; ++pass)
+   {
+      uint64_t offset = rand() % 4096;
+      while (offset < fileSize)
+      {
+         XrdCl::ChunkList chunks;
+         size_t           used = 0;
+         while ((int) chunks.size() < numChunks && offset < fileSize)
+         {
+            uint32_t size = MinBasket + rand() % (MaxBasket - MinBasket);
+            if (offset + size > fileSize) size = fileSize - offset;
+            chunks.push_back(XrdCl::ChunkInfo(offset, size, &buff[used]));
+            used   += size;
+            offset += size;
+            if (rand() % 3 == 0) offset += rand() % MaxGap;
+         }
+
+         XrdCl::VectorReadInfo *vrInfo = 0;
+         st = file.VectorRead(chunks, 0, vrInfo);
+         if ( ! st.IsOK())
+         {
+            std::cerr << "Vector read failed: " << st.ToStr() << std::endl;
+            return 3;
+         }
+         bytes += vrInfo->GetSize();
+         delete vrInfo;
+         ++calls;
+
+         if (fd >= 0 && ! Verify(fd, chunks)) return 3;
+      }
+   }
+   double elapsed = Now() - start;
+
+   printf("%d readv calls, %.1f MB in %.3fs = %.1f MB/s\n", calls, bytes / 1e6,
+          elapsed, bytes / 1e6 / elapsed);
+
+   if (fd >= 0) close(fd);
+   st = file.Close();
+   return 0;
+}
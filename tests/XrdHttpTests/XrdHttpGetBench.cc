@@ -0,0 +1,286 @@
+/******************************************************************************/
+/*                                                                            */
+/*                    X r d H t t p G e t B e n c h . c c                     */
+/*                                                                            */
+/* This file is part of the XRootD software suite.                            */
+/*                                                                            */
+/* XRootD is free software: you can redistribute it and/or modify it under    */
+/* the terms of the GNU Lesser General Public License as published by the     */
+/* Free Software Foundation, either version 3 of the License, or (at your     */
+/* option) any later version.                                                 */
+/*                                                                            */
+/* XRootD is distributed in the hope that it will be useful, but WITHOUT      */
+/* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or      */
+/* FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public       */
+/* License for more details.                                                  */
+/*                                                                            */
+/* You should have received a copy of the GNU Lesser General Public License   */
+/* along with XRootD in a file called COPYING.LESSER (LGPL license) and file  */
+/* COPYING (GPL license).  If not, see <http://www.gnu.org/licenses/>.        */
+/*                                                                            */
+/* The copyright holder's institutional names and contributor's names may not */
+/* be used to endorse or promote products derived from this software without  */
+/* specific prior written permission of the institution or contributor.       */
+/******************************************************************************/
+
+/* Benchmark for https file downloads. Each connection issues the given number
+   of GETs for the same path over one keep-alive TLS session and reads the
+   body. Running it against a server with "http.ktls yes" and one without
+   shows what kernel TLS with sendfile() buys. The total transfer rate and the
+   CPU time used by the benchmark itself are reported.
+
+   Usage: xrdhttpgetbench [-c <conns>] [-n <gets>] [-p] <host>:<port> <path>
+
+   -c   number of parallel connections, default 1.
+   -n   number of GETs per connection, default 10.
+   -p   use plain http instead of https.
+
+   The server certificate is not verified.
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <errno.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+using namespace std;
+
+/******************************************************************************/
+/*                          U n i t   G l o b a l s                           */
+/******************************************************************************/
+
+namespace
+{
+int         numConn = 1;
+int         numGets = 10;
+bool        useTLS  = true;
+string      Host, Port, Path;
+SSL_CTX    *sslCtx  = 0;
+const char *MeMe    = "xrdhttpgetbench: ";
+
+struct ConnInfo
+{
+pthread_t tid;
+long long bytes;
+bool      aOK;
+          ConnInfo() : tid(0), bytes(0), aOK(false) {}
+};
+}
+
+#define SAY(x) cerr <<MeMe <<x <<endl
+
+/******************************************************************************/
+/*                          c l a s s   C o n n                               */
+/******************************************************************************/
+
+namespace
+{
+class Conn
+{
+public:
+
+bool Open();
+
+int  Read(char *buff, int blen)
+         {return (ssl ? SSL_read(ssl, buff, blen) : read(fd, buff, blen));}
+
+bool Write(const string &data)
+         {int n = (ssl ? SSL_write(ssl, data.c_str(), data.size())
+                       : write(fd, data.c_str(), data.size()));
+          return n == (int)data.size();
+         }
+
+     Conn() : fd(-1), ssl(0) {}
+    ~Conn() {if (ssl) {SSL_shutdown(ssl); SSL_free(ssl);}
+             if (fd >= 0) close(fd);
+            }
+
+private:
+int  fd;
+SSL *ssl;
+};
+
+/******************************************************************************/
+
+bool Conn::Open()
+{
+   struct addrinfo hints, *res;
+
+// Connect to the server
+//
+   memset(&hints, 0, sizeof(hints));
+   hints.ai_socktype = SOCK_STREAM;
+   if (getaddrinfo(Host.c_str(), Port.c_str(), &hints, &res))
+      {SAY("Unable to resolve " <<Host); return false;}
+   fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+   if (fd < 0 || connect(fd, res->ai_addr, res->ai_addrlen))
+      {SAY("Unable to connect to " <<Host <<':' <<Port <<"; " <<strerror(errno));
+       freeaddrinfo(res);
+       return false;
+      }
+   freeaddrinfo(res);
+
+// Do the handshake if so wanted
+//
+   if (!useTLS) return true;
+   ssl = SSL_new(sslCtx);
+   SSL_set_fd(ssl, fd);
+   if (SSL_connect(ssl) != 1)
+      {SAY("TLS handshake failed"); ERR_print_errors_fp(stderr); return false;}
+   return true;
+}
+
+/******************************************************************************/
+/*                                 G e t O n e                                */
+/******************************************************************************/
+
+// Issue one GET and read the whole response, returns the body size or -1.
+// Any bytes read past the body are left in rest for the next response.
+//
+long long GetOne(Conn &conn, string &rest, char *buff, int bsize)
+{
+   string req = "GET " + Path + " HTTP/1.1\r\nHost: " + Host
+              + "\r\nConnection: keep-alive\r\n\r\n";
+   string hdr = rest;
+   size_t hEnd;
+   long long clen = -1, got;
+   int n;
+
+   rest.clear();
+   if (!conn.Write(req)) {SAY("Unable to send request"); return -1;}
+
+// Read the header
+//
+   while((hEnd = hdr.find("\r\n\r\n")) == string::npos)
+        {if ((n = conn.Read(buff, bsize)) <= 0)
+            {SAY("Connection closed while reading the header"); return -1;}
+         hdr.append(buff, n);
+        }
+
+   if (hdr.compare(0, 12, "HTTP/1.1 200") && hdr.compare(0, 12, "HTTP/1.0 200"))
+      {SAY("Unexpected response: " <<hdr.substr(0, hdr.find("\r\n")));
+       return -1;
+      }
+
+   for (size_t pos = 0; pos < hEnd; pos = hdr.find("\r\n", pos) + 2)
+       {if (!strncasecmp(hdr.c_str()+pos, "Content-Length:", 15))
+           {clen = atoll(hdr.c_str()+pos+15); break;}
+       }
+   if (clen < 0) {SAY("Response has no Content-Length"); return -1;}
+
+// Read the body
+//
+   got = hdr.size() - (hEnd + 4);
+   if (got > clen) {rest = hdr.substr(hEnd + 4 + clen); got = clen;}
+   while(got < clen)
+        {if ((n = conn.Read(buff, bsize)) <= 0)
+            {SAY("Connection closed while reading the body"); return -1;}
+         if (got + n > clen) rest.assign(buff + (clen - got), got + n - clen);
+         got += n;
+        }
+   return clen;
+}
+
+/******************************************************************************/
+/*                                 D o C o n n                                */
+/******************************************************************************/
+
+void *DoConn(void *carg)
+{
+   ConnInfo *ciP = (ConnInfo *)carg;
+   Conn conn;
+   string rest;
+   vector<char> buff(1024*1024);
+   long long n;
+
+   if (!conn.Open()) return 0;
+   for (int i = 0; i < numGets; i++)
+       {if ((n = GetOne(conn, rest, &buff[0], buff.size())) < 0) return 0;
+        ciP->bytes += n;
+       }
+   ciP->aOK = true;
+   return 0;
+}
+}
+
+/******************************************************************************/
+/*                                  m a i n                                   */
+/******************************************************************************/
+
+int main(int argc, char **argv)
+{
+   const char *Usage = "Usage: xrdhttpgetbench [-c <conns>] [-n <gets>] [-p] "
+                       "<host>:<port> <path>";
+   struct timeval tBeg, tEnd;
+   struct rusage  rUse;
+   double elapsed, cpu;
+   long long bytes = 0;
+   bool aOK = true;
+   char c, *colon;
+
+// Process the options
+//
+   while ((c = getopt(argc, argv, "c:n:p")) != (char)-1)
+         {switch(c)
+                {case 'c': numConn = atoi(optarg); break;
+                 case 'n': numGets = atoi(optarg); break;
+                 case 'p': useTLS  = false;        break;
+                 default:  SAY(Usage); return 1;
+                }
+         }
+   if (optind+2 != argc || numConn <= 0 || numGets <= 0
+   ||  !(colon = rindex(argv[optind], ':')))
+      {SAY(Usage); return 1;}
+   Host.assign(argv[optind], colon - argv[optind]);
+   Port = colon+1;
+   Path = argv[optind+1];
+
+// Set up the TLS context
+//
+   if (useTLS)
+      {SSL_library_init();
+       SSL_load_error_strings();
+       if (!(sslCtx = SSL_CTX_new(SSLv23_client_method())))
+          {SAY("Unable to create TLS context"); return 2;}
+       SSL_CTX_set_verify(sslCtx, SSL_VERIFY_NONE, 0);
+      }
+
+// Run all the connections
+//
+   vector<ConnInfo> conns(numConn);
+   gettimeofday(&tBeg, 0);
+   for (int i = 0; i < numConn; i++)
+       if (pthread_create(&conns[i].tid, 0, DoConn, &conns[i]))
+          {SAY("Unable to create thread"); return 2;}
+   for (int i = 0; i < numConn; i++)
+       {pthread_join(conns[i].tid, 0);
+        bytes += conns[i].bytes;
+        aOK = aOK && conns[i].aOK;
+       }
+   gettimeofday(&tEnd, 0);
+
+// Report the result
+//
+   getrusage(RUSAGE_SELF, &rUse);
+   elapsed = (tEnd.tv_sec - tBeg.tv_sec) + (tEnd.tv_usec - tBeg.tv_usec)/1e6;
+   cpu = rUse.ru_utime.tv_sec + rUse.ru_utime.tv_usec/1e6
+       + rUse.ru_stime.tv_sec + rUse.ru_stime.tv_usec/1e6;
+   printf("%s: %lld bytes in %.3fs = %.1f MB/s, client cpu %.3fs%s\n",
+          (useTLS ? "https" : "http"), bytes, elapsed,
+          bytes/elapsed/(1024*1024), cpu, (aOK ? "" : " (failed)"));
+   if (sslCtx) SSL_CTX_free(sslCtx);
+   return (aOK ? 0 : 3);
+}
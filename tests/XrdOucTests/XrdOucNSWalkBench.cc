@@ -0,0 +1,269 @@
+/******************************************************************************/
+/*                                                                            */
+/*                  X r d O u c N S W a l k B e n c h . c c                   */
+/*                                                                            */
+/* This file is part of the XRootD software suite.                            */
+/*                                                                            */
+/* XRootD is free software: you can redistribute it and/or modify it under    */
+/* the terms of the GNU Lesser General Public License as published by the     */
+/* Free Software Foundation, either version 3 of the License, or (at your     */
+/* option) any later version.                                                 */
+/*                                                                            */
+/* XRootD is distributed in the hope that it will be useful, but WITHOUT      */
+/* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or      */
+/* FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public       */
+/* License for more details.                                                  */
+/*                                                                            */
+/* You should have received a copy of the GNU Lesser General Public License   */
+/* along with XRootD in a file called COPYING.LESSER (LGPL license) and file  */
+/* COPYING (GPL license).  If not, see <http://www.gnu.org/licenses/>.        */
+/*                                                                            */
+/* The copyright holder's institutional names and contributor's names may not */
+/* be used to endorse or promote products derived from this software without  */
+/* specific prior written permission of the institution or contributor.       */
+/******************************************************************************/
+
+
+/* Benchmark for XrdOucNSWalk. A directory tree is generated under a temporary
+   directory and then walked serially, in parallel (in serial order and in any
+   order), and with d_type based typing. The entry counts of each walk must
+   match the serial walk and the ordered parallel walk must return directories
+   in exactly the serial order. Finally, a serial and a parallel walk that
+   exclude two subtrees must match each other and must not enter them. The
+   time of each walk is reported.
+
+   Usage: xrdnswalkbench [-d <depth>] [-f <files>] [-n <fanout>] [-t <threads>]
+                         [<dir>]
+
+   The tree is created in <dir> (default /tmp) and removed afterwards.
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include "XrdOuc/XrdOucNSWalk.hh"
+#include "XrdOuc/XrdOucTList.hh"
+
+using namespace std;
+
+/******************************************************************************/
+/*                          U n i t   G l o b a l s                           */
+/******************************************************************************/
+
+namespace
+{
+int         Depth   = 4;
+int         Fanout  = 6;
+int         numFile = 20;
+int         numThr  = 8;
+const char *MeMe    = "xrdnswalkbench: ";
+
+struct WalkInfo
+{
+vector<string> Dirs;
+long long      nEnts;
+long long      nDirs;
+double         Secs;
+               WalkInfo() : nEnts(0), nDirs(0), Secs(0) {}
+};
+}
+
+#define SAY(x) cerr <<MeMe <<x <<endl
+
+/******************************************************************************/
+/*                                  M a k e                                   */
+/******************************************************************************/
+
+bool Make(const string &dir, int level)
+{
+   char buff[32];
+   int fd;
+
+// Create the files in this directory
+//
+   for (int i = 0; i < numFile; i++)
+       {snprintf(buff, sizeof(buff), "/file%d", i);
+        if ((fd = open((dir+buff).c_str(), O_CREAT|O_WRONLY, 0644)) < 0)
+           {SAY("Unable to create " <<dir+buff <<"; " <<strerror(errno));
+            return false;
+           }
+        close(fd);
+       }
+
+// Create the subdirectories
+//
+   if (level >= Depth) return true;
+   for (int i = 0; i < Fanout; i++)
+       {snprintf(buff, sizeof(buff), "/dir%d", i);
+        if (mkdir((dir+buff).c_str(), 0755))
+           {SAY("Unable to create " <<dir+buff <<"; " <<strerror(errno));
+            return false;
+           }
+        if (!Make(dir+buff, level+1)) return false;
+       }
+   return true;
+}
+
+/******************************************************************************/
+/*                                R e m o v e                                 */
+/******************************************************************************/
+
+int RmEnt(const char *path, const struct stat *sb, int tflag, struct FTW *ftwb)
+{
+   remove(path);
+   return 0;
+}
+
+/******************************************************************************/
+/*                                  W a l k                                   */
+/******************************************************************************/
+
+bool Walk(const char *root, int opts, int nThreads, WalkInfo &wInfo,
+          XrdOucTList *xList=0)
+{
+   static const int bOpts = XrdOucNSWalk::retAll | XrdOucNSWalk::Recurse
+                          | XrdOucNSWalk::noPath;
+   XrdOucNSWalk nsObj(0, root, 0, bOpts | opts, xList);
+   XrdOucNSWalk::NSEnt *nP, *fP;
+   struct timeval tBeg, tEnd;
+   const char *dPath;
+   int rc;
+
+// Walk the tree counting what we find
+//
+   nsObj.setMsgOn(MeMe);
+   gettimeofday(&tBeg, 0);
+   if (nThreads && !nsObj.setThreads(nThreads))
+      {SAY("Unable to start walker threads."); return false;}
+   while((nP = nsObj.Index(rc, &dPath)))
+        {wInfo.Dirs.push_back(dPath);
+         while((fP = nP))
+              {if (fP->Type == XrdOucNSWalk::NSEnt::isDir) wInfo.nDirs++;
+               wInfo.nEnts++;
+               nP = nP->Next; delete fP;
+              }
+        }
+   gettimeofday(&tEnd, 0);
+   wInfo.Secs = (tEnd.tv_sec - tBeg.tv_sec) + (tEnd.tv_usec-tBeg.tv_usec)/1e6;
+   if (rc) {SAY("Walk failed; " <<strerror(rc)); return false;}
+   return true;
+}
+
+/******************************************************************************/
+/*                                R e p o r t                                 */
+/******************************************************************************/
+
+bool Report(const char *What, WalkInfo &wInfo, WalkInfo *sInfo, bool chkOrder)
+{
+   printf("%-24s %8lld entries %7lld dirs %9.3f s\n", What,
+          wInfo.nEnts, wInfo.nDirs, wInfo.Secs);
+
+   if (!sInfo) return true;
+   if (wInfo.nEnts != sInfo->nEnts || wInfo.nDirs != sInfo->nDirs)
+      {SAY(What <<" walk does not match the serial walk!"); return false;}
+   if (chkOrder && wInfo.Dirs != sInfo->Dirs)
+      {SAY(What <<" walk returned directories out of order!"); return false;}
+   return true;
+}
+
+/******************************************************************************/
+/*                              E x c l u d e d                               */
+/******************************************************************************/
+
+// Make sure that no directory in or below an excluded one was indexed
+
+bool Excluded(const char *What, WalkInfo &wInfo, XrdOucTList *xList)
+{
+   for (XrdOucTList *tP = xList; tP; tP = tP->next)
+       {string xDir = string(tP->text) + '/';
+        for (size_t i = 0; i < wInfo.Dirs.size(); i++)
+            if (!wInfo.Dirs[i].compare(0, xDir.size(), xDir))
+               {SAY(What <<" walk entered excluded " <<tP->text); return false;}
+       }
+   return true;
+}
+
+/******************************************************************************/
+/*                                   m a i n                                  */
+/******************************************************************************/
+
+int main(int argc, char **argv)
+{
+   WalkInfo sInfo, pInfo, aInfo, tInfo, sxInfo, pxInfo;
+   XrdOucTList *xList = 0;
+   string root;
+   char c, *tmpDir;
+   bool aOK;
+
+// Process the options
+//
+   while ((c = getopt(argc, argv, "d:f:n:t:")) != (char)-1)
+         {switch(c)
+                {case 'd': Depth   = atoi(optarg); break;
+                 case 'f': numFile = atoi(optarg); break;
+                 case 'n': Fanout  = atoi(optarg); break;
+                 case 't': numThr  = atoi(optarg); break;
+                 default:  SAY("Usage: xrdnswalkbench [-d <depth>] "
+                               "[-f <files>] [-n <fanout>] [-t <threads>] "
+                               "[<dir>]");
+                           return 1;
+                }
+         }
+   if (Depth < 0 || numFile < 0 || Fanout < 0 || numThr <= 0)
+      {SAY("Option values must not be negative."); return 1;}
+
+// Generate the tree
+//
+   root = (optind < argc ? argv[optind] : "/tmp");
+   root += "/nswalkXXXXXX";
+   tmpDir = strdup(root.c_str());
+   if (!mkdtemp(tmpDir))
+      {SAY("Unable to create " <<tmpDir <<"; " <<strerror(errno)); return 2;}
+   root = tmpDir; free(tmpDir);
+   if (!Make(root, 0)) {nftw(root.c_str(), RmEnt, 64, FTW_DEPTH|FTW_PHYS);
+                        return 2;
+                       }
+
+// Walk it in each of the ways and make sure we got the same answer
+//
+   aOK = Walk(root.c_str(), 0, 0, sInfo)
+      && Report("serial", sInfo, 0, false)
+      && Walk(root.c_str(), 0, numThr, pInfo)
+      && Report("parallel ordered", pInfo, &sInfo, true)
+      && Walk(root.c_str(), XrdOucNSWalk::anyOrder, numThr, aInfo)
+      && Report("parallel any order", aInfo, &sInfo, false)
+      && Walk(root.c_str(), XrdOucNSWalk::anyOrder|XrdOucNSWalk::skpStat,
+              numThr, tInfo)
+      && Report("parallel d_type only", tInfo, &sInfo, false);
+
+// Walk it with a couple of subtrees excluded, both serially and in parallel
+//
+   if (aOK && Depth > 1 && Fanout > 2)
+      {xList = new XrdOucTList((root+"/dir1").c_str(), 0, xList);
+       xList = new XrdOucTList((root+"/dir2/dir0").c_str(), 0, xList);
+       aOK = Walk(root.c_str(), 0, 0, sxInfo, xList)
+          && Report("serial excluded", sxInfo, 0, false)
+          && Excluded("serial", sxInfo, xList)
+          && Walk(root.c_str(), 0, numThr, pxInfo, xList)
+          && Report("parallel excluded", pxInfo, &sxInfo, true)
+          && Excluded("parallel", pxInfo, xList);
+       if (aOK && sxInfo.Dirs.size() >= sInfo.Dirs.size())
+          {SAY("exclude list had no effect!"); aOK = false;}
+       while(xList) {XrdOucTList *tP = xList; xList = xList->next; delete tP;}
+      }
+
+// Remove the tree
+//
+   nftw(root.c_str(), RmEnt, 64, FTW_DEPTH|FTW_PHYS);
+   return (aOK ? 0 : 3);
+}
@@ -0,0 +1,217 @@
+/******************************************************************************/
+/*                                                                            */
+/*                     X r d P o s i x F D B e n c h . c c                    */
+/*                                                                            */
+/* This file is part of the XRootD software suite.                            */
+/*                                                                            */
+/* XRootD is free software: you can redistribute it and/or modify it under    */
+/* the terms of the GNU Lesser General Public License as published by the     */
+/* Free Software Foundation, either version 3 of the License, or (at your     */
+/* option) any later version.                                                 */
+/*                                                                            */
+/* XRootD is distributed in the hope that it will be useful, but WITHOUT      */
+/* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or      */
+/* FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public       */
+/* License for more details.                                                  */
+/*                                                                            */
+/* You should have received a copy of the GNU Lesser General Public License   */
+/* along with XRootD in a file called COPYING.LESSER (LGPL license) and file  */
+/* COPYING (GPL license).  If not, see <http://www.gnu.org/licenses/>.        */
+/*                                                                            */
+/* The copyright holder's institutional names and contributor's names may not */
+/* be used to endorse or promote products derived from this software without  */
+/* specific prior written permission of the institution or contributor.       */
+/******************************************************************************/
+
+/* Microbenchmark for the XrdPosix file descriptor table. A number of threads
+   look up (and lock/unlock) random file descriptors, as every read or write
+   through the preload library or the proxy does, while another thread keeps
+   closing and reopening descriptors. The lookup rate is reported for each
+   thread count.
+
+   Usage: xrdposixbench [-c] [-f <fds>] [-s <seconds>] [-t <maxthreads>]
+
+   -c   do not churn (close/reopen) descriptors while looking them up.
+*/
+
+#include <iostream>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "XrdPosix/XrdPosixObject.hh"
+#include "XrdSys/XrdSysAtomics.hh"
+#include "XrdSys/XrdSysPthread.hh"
+#include "XrdSys/XrdSysTimer.hh"
+
+using namespace std;
+
+/******************************************************************************/
+/*                         L o c a l   C l a s s e s                          */
+/******************************************************************************/
+
+namespace
+{
+// A stand-in for a file; the table only cares that it claims to be one.
+//
+class BenchObj : public XrdPosixObject
+{
+public:
+
+bool Who(XrdPosixFile **fileP)
+        {*fileP = reinterpret_cast<XrdPosixFile *>(this); return true;}
+
+     BenchObj() {}
+    ~BenchObj() {}
+};
+
+/******************************************************************************/
+/*                          U n i t   G l o b a l s                           */
+/******************************************************************************/
+
+int            numFD   = 1024;
+int            numSec  = 2;
+int            maxThr  = 16;
+bool           doChurn = true;
+int           *theFD   = 0;
+volatile bool stopIt   = false;
+const char    *MeMe    = "xrdposixbench: ";
+}
+
+#define SAY(x) cerr <<MeMe <<x <<endl
+
+/******************************************************************************/
+/*                                C h u r n e r                               */
+/******************************************************************************/
+
+void *Churner(void *carg)
+{
+   long long *nChurn = (long long *)carg;
+   unsigned int seed = 1;
+   XrdPosixFile *fP;
+
+// Close and reopen random descriptors until told to stop
+//
+   while(!stopIt)
+        {int i = rand_r(&seed) % numFD;
+         if (!(fP = XrdPosixObject::ReleaseFile(theFD[i]))) continue;
+         delete reinterpret_cast<BenchObj *>(fP);
+         BenchObj *oP = new BenchObj;
+         if (!oP->AssignFD()) {SAY("Unable to reassign fd!"); exit(3);}
+         theFD[i] = oP->FDNum();
+         (*nChurn)++;
+        }
+   return 0;
+}
+
+/******************************************************************************/
+/*                                L o o k e r                                 */
+/******************************************************************************/
+
+void *Looker(void *carg)
+{
+   long long *nLook = (long long *)carg;
+   unsigned int seed = (unsigned int)(long)nLook;
+   XrdPosixFile *fP;
+   long long n = 0;
+
+// Look up random descriptors until told to stop. A lookup may fail if the
+// descriptor is being reopened, which is fine.
+//
+   while(!stopIt)
+        {if ((fP = XrdPosixObject::File(theFD[rand_r(&seed) % numFD])))
+            reinterpret_cast<BenchObj *>(fP)->UnLock();
+         n++;
+        }
+   *nLook = n;
+   return 0;
+}
+
+/******************************************************************************/
+/*                                   R u n                                    */
+/******************************************************************************/
+
+double Run(int nThreads, long long &nChurn)
+{
+   pthread_t tid[nThreads+1];
+   long long nLook[nThreads];
+   long long total = 0;
+   struct timeval tBeg, tEnd;
+   int i;
+
+// Start all the threads, let them run, and stop them
+//
+   stopIt = false; nChurn = 0;
+   gettimeofday(&tBeg, 0);
+   for (i = 0; i < nThreads; i++)
+       {nLook[i] = i+1;
+        if (XrdSysThread::Run(&tid[i], Looker, (void *)&nLook[i],
+                              XRDSYSTHREAD_HOLD, "looker"))
+           {SAY("Unable to start thread; " <<strerror(errno)); exit(4);}
+       }
+   if (doChurn && XrdSysThread::Run(&tid[nThreads], Churner, (void *)&nChurn,
+                                    XRDSYSTHREAD_HOLD, "churner"))
+      {SAY("Unable to start thread; " <<strerror(errno)); exit(4);}
+
+   XrdSysTimer::Snooze(numSec);
+   stopIt = true;
+   for (i = 0; i < nThreads; i++) {XrdSysThread::Join(tid[i], 0); total += nLook[i];}
+   if (doChurn) XrdSysThread::Join(tid[nThreads], 0);
+   gettimeofday(&tEnd, 0);
+
+// Return the lookup rate
+//
+   return total / ((tEnd.tv_sec - tBeg.tv_sec) + (tEnd.tv_usec - tBeg.tv_usec)/1e6);
+}
+
+/******************************************************************************/
+/*                                  m a i n                                   */
+/******************************************************************************/
+
+int main(int argc, char **argv)
+{
+   long long nChurn;
+   char c;
+
+// Process the options
+//
+   while ((c = getopt(argc, argv, "cf:s:t:")) != (char)-1)
+         {switch(c)
+                {case 'c': doChurn = false;        break;
+                 case 'f': numFD   = atoi(optarg); break;
+                 case 's': numSec  = atoi(optarg); break;
+                 case 't': maxThr  = atoi(optarg); break;
+                 default:  SAY("Usage: xrdposixbench [-c] [-f <fds>] "
+                               "[-s <seconds>] [-t <maxthreads>]");
+                           return 1;
+                }
+         }
+   if (numFD <= 0 || numSec <= 0 || maxThr <= 0)
+      {SAY("Option values must be positive."); return 1;}
+
+// Use virtual file descriptors so that we do not need real ones
+//
+   if (XrdPosixObject::Init(-(numFD+1)) < 0)
+      {SAY("Unable to initialize the fd table."); return 2;}
+   theFD = new int[numFD];
+   for (int i = 0; i < numFD; i++)
+       {BenchObj *oP = new BenchObj;
+        if (!oP->AssignFD()) {SAY("Unable to assign fd!"); return 2;}
+        theFD[i] = oP->FDNum();
+       }
+
+// Run with increasing number of threads
+//
+   for (int n = 1; n <= maxThr; n *= 2)
+       {double rate = Run(n, nChurn);
+        printf("threads %3d: %12.0f lookups/s", n, rate);
+        if (doChurn) printf(", %lld reopens", nChurn);
+        printf("\n");
+       }
+
+   XrdPosixObject::Shutdown();
+   return 0;
+}
@@ -142,11 +142,12 @@ const char *attHelp[] =
 };
 
 const char *creHelp[] =
-{"cr[eate] {[m][s][r][u][=]}",
+{"cr[eate] {[m][s][r][u][l][f][=]}",
  "    Create a shared memory identified by the -p command line option.",
  "    Specify 'm' to enable multiple writers or 's' for a single writer.",
  "    Specify 'r' to enable space reuse or 'u' to disallow space reuse.",
- "    Specify '=' for defaults (su). See the setmax command for size options.",
+ "    Specify 'l' for lock-free readers with reuse or 'f' for file locking.",
+ "    Specify '=' for defaults (suf). See the setmax command for size options.",
  "    The map is not visible to other processes until 'export' is executed."
 };
 
@@ -229,10 +230,11 @@ const char *repHelp[] =
 };
 
 const char *rszHelp[] =
-{"res[ize] {[m][s][r][u][=]}",
+{"res[ize] {[m][s][r][u][l][f][=]}",
  "    Resize a shared memory identified by the -p command line option.",
  "    Specify 'm' to enable multiple writers or 's' for a single writer.",
  "    Specify 'r' to enable space reuse or 'u' to disallow space reuse.",
+ "    Specify 'l' for lock-free readers with reuse or 'f' for file locking.",
  "    Specify '=' to use the existing values in the map. This compresses the",
  "    map as much as possible. The map must have been exported. See the setmax",
  "    command for more size options."
@@ -535,7 +537,7 @@ void DoInfo()
 {
    const char *vname[] = {"flockro", "flockrw",  "indexsz",  "indexused",
                           "keys",    "keysfree", "maxkeylen",
-                          "multw",   "reuse",    "typesz", 0};
+                          "multw",   "reuse",    "seqlock",  "typesz", 0};
    int n, i = 0;
    char iBuff[256];
 
@@ -756,6 +758,10 @@ while(true)
                                    break;
                          case 'u': attOpts |= XrdSsi::ShMap_Parms::noReUse;
                                    break;
+                         case 'l': attOpts |= XrdSsi::ShMap_Parms::SeqLk;
+                                   break;
+                         case 'f': attOpts |= XrdSsi::ShMap_Parms::noSeqLk;
+                                   break;
                          case '=': attOpts = 0;
                                    break;
                          default:  EMSG("Unknown create option - " <<*theOp);
@@ -885,6 +891,10 @@ while(true)
                                    break;
                          case 'u': rszOpts |= XrdSsi::ShMap_Parms::noReUse;
                                    break;
+                         case 'l': rszOpts |= XrdSsi::ShMap_Parms::SeqLk;
+                                   break;
+                         case 'f': rszOpts |= XrdSsi::ShMap_Parms::noSeqLk;
+                                   break;
                          case '=': xParms = 0;
                                    break;
                          default:  EMSG("Unknown resize option - " <<*theOp);
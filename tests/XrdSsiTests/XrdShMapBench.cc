@@ -0,0 +1,296 @@
+/******************************************************************************/
+/*                                                                            */
+/*                      X r d S h M a p B e n c h . c c                       */
+/*                                                                            */
+/* This file is part of the XRootD software suite.                            */
+/*                                                                            */
+/* XRootD is free software: you can redistribute it and/or modify it under    */
+/* the terms of the GNU Lesser General Public License as published by the     */
+/* Free Software Foundation, either version 3 of the License, or (at your     */
+/* option) any later version.                                                 */
+/*                                                                            */
+/* XRootD is distributed in the hope that it will be useful, but WITHOUT      */
+/* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or      */
+/* FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public       */
+/* License for more details.                                                  */
+/*                                                                            */
+/* You should have received a copy of the GNU Lesser General Public License   */
+/* along with XRootD in a file called COPYING.LESSER (LGPL license) and file  */
+/* COPYING (GPL license).  If not, see <http://www.gnu.org/licenses/>.        */
+/*                                                                            */
+/* The copyright holder's institutional names and contributor's names may not */
+/* be used to endorse or promote products derived from this software without  */
+/* specific prior written permission of the institution or contributor.       */
+/******************************************************************************/
+
+/* Microbenchmark for shared memory maps that reuse storage. A number of reader
+   processes look up random keys while a writer process replaces, deletes and
+   re-adds keys at a given rate. This is done for maps whose readers lock the
+   file and for maps whose readers use the per-entry sequence counters. The
+   aggregate lookup rate is reported for each writer rate. Readers also verify
+   every value they get back.
+
+   Usage: xrdshmapbench [-d <dir>] [-k <keys>] [-r <readers>] [-s <seconds>]
+                        [-w <rate>[,<rate>[,...]]]
+
+   -w   writer updates per second; 0 means no writer and 'max' means as fast
+        as possible. The default is 0,1000,100000,max.
+*/
+
+#include <iostream>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#include "XrdSsi/XrdSsiShMap.hh"
+
+using namespace std;
+
+/******************************************************************************/
+/*                          U n i t   G l o b a l s                           */
+/******************************************************************************/
+
+namespace
+{
+struct Counts
+      {long long lookups;
+       long long misses;
+       long long errors;
+       double    elapsed;
+      };
+
+const char    *theDir  = "/tmp";
+char           thePath[1024];
+int            numKeys = 10000;
+int            numRdr  = 4;
+int            numSec  = 2;
+const char    *theRates= "0,1000,100000,max";
+Counts        *theCnts = 0;
+const char    *MeMe    = "xrdshmapbench: ";
+}
+
+#define SAY(x) cerr <<MeMe <<x <<endl
+
+/******************************************************************************/
+/*                                  N o w                                     */
+/******************************************************************************/
+
+double Now()
+{
+   struct timeval tNow;
+
+   gettimeofday(&tNow, 0);
+   return tNow.tv_sec + tNow.tv_usec/1e6;
+}
+
+/******************************************************************************/
+/*                                R e a d e r                                 */
+/******************************************************************************/
+
+// Values are always congruent to their key number modulo numKeys, so a reader
+// can tell whether it was handed a torn or foreign value.
+//
+void Reader(int rNum)
+{
+   XrdSsi::ShMap<int> theMap("int");
+   Counts *cP = &theCnts[rNum];
+   unsigned int seed = rNum+1;
+   double tBeg, tEnd;
+   char key[32];
+   int  k, val;
+
+   if (!theMap.Attach(thePath, XrdSsi::ReadOnly, 5))
+      {SAY("Unable to attach map; " <<strerror(errno)); _exit(3);}
+
+   tBeg = Now(); tEnd = tBeg + numSec;
+   do {for (int i = 0; i < 1024; i++)
+           {k = rand_r(&seed) % numKeys;
+            snprintf(key, sizeof(key), "key%d", k);
+            if (!theMap.Get(key, val)) cP->misses++;
+               else if (val % numKeys != k) cP->errors++;
+            cP->lookups++;
+           }
+      } while(Now() < tEnd);
+   cP->elapsed = Now() - tBeg;
+   _exit(0);
+}
+
+/******************************************************************************/
+/*                                W r i t e r                                 */
+/******************************************************************************/
+
+void Writer(int rate)
+{
+   XrdSsi::ShMap<int> theMap("int");
+   struct timespec naptime;
+   unsigned int seed = 12345;
+   double tBeg, tEnd;
+   long long nOps = 0;
+   char key[32];
+   int  k, val;
+
+   if (!theMap.Attach(thePath, XrdSsi::ReadWrite, 5))
+      {SAY("Unable to attach map; " <<strerror(errno)); _exit(3);}
+
+// Update in batches of ten, pacing ourselves to the requested rate. Every
+// tenth update deletes the key and adds it back, the rest replace it.
+//
+   tBeg = Now(); tEnd = tBeg + numSec + 1;
+   do {for (int i = 0; i < 10; i++, nOps++)
+           {k = rand_r(&seed) % numKeys;
+            snprintf(key, sizeof(key), "key%d", k);
+            val = k + (int)(nOps % 1000 + 1) * numKeys;
+            if (i == 9) {theMap.Del(key); theMap.Add(key, val);}
+               else theMap.Rep(key, val);
+           }
+       if (rate > 0)
+          {double ahead = tBeg + (double)nOps/rate - Now();
+           if (ahead > 0)
+              {naptime.tv_sec  = (int)ahead;
+               naptime.tv_nsec = (long)((ahead - naptime.tv_sec) * 1e9);
+               nanosleep(&naptime, 0);
+              }
+          }
+      } while(Now() < tEnd);
+   _exit(0);
+}
+
+/******************************************************************************/
+/*                                M a k e M a p                               */
+/******************************************************************************/
+
+bool MakeMap(bool seqLk)
+{
+   XrdSsi::ShMap<int> theMap("int");
+   XrdSsi::ShMap_Parms parms;
+   char key[32];
+
+   parms.indexSize = numKeys/2+1;
+   parms.maxKeys   = numKeys*2;
+   parms.mode      = S_IRWXU|S_IRWXG|S_IROTH;
+   parms.options   = XrdSsi::ShMap_Parms::ReUse
+                   | (seqLk ? XrdSsi::ShMap_Parms::SeqLk
+                            : XrdSsi::ShMap_Parms::noSeqLk);
+   if (!theMap.Create(thePath, parms))
+      {SAY("Unable to create map; " <<strerror(errno)); return false;}
+
+   for (int k = 0; k < numKeys; k++)
+       {snprintf(key, sizeof(key), "key%d", k);
+        if (!theMap.Add(key, k)) {SAY("Unable to fill map!"); return false;}
+       }
+
+   if (!theMap.Export())
+      {SAY("Unable to export map; " <<strerror(errno)); return false;}
+
+   if (seqLk && theMap.Info("seqlock") != 1)
+      {SAY("Map does not support lock-free readers."); return false;}
+   return true;
+}
+
+/******************************************************************************/
+/*                                   R u n                                    */
+/******************************************************************************/
+
+bool Run(bool seqLk, int rate)
+{
+   Counts total;
+   pid_t  pid, wPid = 0;
+   int    status;
+
+// Create a fresh map for each run so that runs do not influence each other
+//
+   if (!MakeMap(seqLk)) return false;
+   memset(theCnts, 0, sizeof(Counts)*numRdr);
+   memset(&total,  0, sizeof(total));
+
+// Start the writer, if any, and then all of the readers
+//
+   if (rate && !(wPid = fork())) Writer(rate);
+   for (int i = 0; i < numRdr; i++)
+       {if ((pid = fork()) < 0)
+           {SAY("Unable to fork; " <<strerror(errno)); exit(4);}
+        if (!pid) Reader(i);
+       }
+
+// Wait for the readers to finish and then stop the writer
+//
+   for (int i = 0; i < numRdr; i++)
+       {if ((pid = wait(&status)) == wPid) {i--; wPid = 0; continue;}
+        if (!WIFEXITED(status) || WEXITSTATUS(status))
+           {SAY("Reader failed!"); return false;}
+       }
+   if (wPid) {kill(wPid, SIGTERM); waitpid(wPid, 0, 0);}
+
+// Report the aggregate lookup rate
+//
+   for (int i = 0; i < numRdr; i++)
+       {total.lookups += theCnts[i].lookups;
+        total.misses  += theCnts[i].misses;
+        total.errors  += theCnts[i].errors;
+        total.elapsed += theCnts[i].lookups / theCnts[i].elapsed;
+       }
+   if (rate < 0) printf("%-7s writer   max/s:", (seqLk ? "seqlock" : "flock"));
+      else printf("%-7s writer %5d/s:", (seqLk ? "seqlock" : "flock"), rate);
+   printf(" %12.0f lookups/s, %lld misses, %lld errors\n",
+          total.elapsed, total.misses, total.errors);
+   return total.errors == 0;
+}
+
+/******************************************************************************/
+/*                                  m a i n                                   */
+/******************************************************************************/
+
+int main(int argc, char **argv)
+{
+   const char *Usage = "Usage: xrdshmapbench [-d <dir>] [-k <keys>] "
+                       "[-r <readers>] [-s <seconds>] [-w <rate>[,<rate>]]";
+   char *rates, *rate, *sP;
+   bool  aOK = true;
+   char  c;
+
+// Process the options
+//
+   while ((c = getopt(argc, argv, "d:k:r:s:w:")) != (char)-1)
+         {switch(c)
+                {case 'd': theDir   = optarg;       break;
+                 case 'k': numKeys  = atoi(optarg); break;
+                 case 'r': numRdr   = atoi(optarg); break;
+                 case 's': numSec   = atoi(optarg); break;
+                 case 'w': theRates = optarg;       break;
+                 default:  SAY(Usage); return 1;
+                }
+         }
+   if (numKeys <= 0 || numRdr <= 0 || numSec <= 0)
+      {SAY("Option values must be positive."); return 1;}
+   snprintf(thePath, sizeof(thePath), "%s/xrdshmapbench.%d",
+            theDir, (int)getpid());
+
+// The readers report their counts through anonymous shared memory
+//
+   theCnts = (Counts *)mmap(0, sizeof(Counts)*numRdr, PROT_READ|PROT_WRITE,
+                            MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+   if (theCnts == MAP_FAILED)
+      {SAY("Unable to map counters; " <<strerror(errno)); return 2;}
+
+// Run each writer rate with both kinds of readers
+//
+   rates = strdup(theRates);
+   for (rate = strtok_r(rates, ",", &sP); rate; rate = strtok_r(0, ",", &sP))
+       {int wRate = (!strcmp(rate, "max") ? -1 : atoi(rate));
+        if (!Run(false, wRate) || !Run(true, wRate)) {aOK = false; break;}
+       }
+   free(rates);
+
+// Clean up
+//
+   unlink(thePath);
+   return (aOK ? 0 : 5);
+}
@@ -0,0 +1,311 @@
+/******************************************************************************/
+/*                                                                            */
+/*                    X r d S s i B a t c h T e s t . c c                     */
+/*                                                                            */
+/* This file is part of the XRootD software suite.                            */
+/*                                                                            */
+/* XRootD is free software: you can redistribute it and/or modify it under    */
+/* the terms of the GNU Lesser General Public License as published by the     */
+/* Free Software Foundation, either version 3 of the License, or (at your     */
+/* option) any later version.                                                 */
+/*                                                                            */
+/* XRootD is distributed in the hope that it will be useful, but WITHOUT      */
+/* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or      */
+/* FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public       */
+/* License for more details.                                                  */
+/*                                                                            */
+/* You should have received a copy of the GNU Lesser General Public License   */
+/* along with XRootD in a file called COPYING.LESSER (LGPL license) and file  */
+/* COPYING (GPL license).  If not, see <http://www.gnu.org/licenses/>.        */
+/*                                                                            */
+/* The copyright holder's institutional names and contributor's names may not */
+/* be used to endorse or promote products derived from this software without  */
+/* specific prior written permission of the institution or contributor.       */
+/******************************************************************************/
+
+/* Test for batched SSI requests against a server running the libXrdSsiStrmSvc
+   service. The following is checked:
+
+   1) A batch holding the same request id twice is rejected as a whole.
+   2) The responses of a valid batch come back, each tagged with the id of
+      its request, when asked for with a single Rbw query.
+   3) Many concurrent requests sent through the client with batching on each
+      get their own response back.
+
+   Usage: xrdssibatchtest [-n <reqs>] <host>:<port> [<resource>]
+
+   -n   number of concurrent requests for the last test, default 64.
+
+   The exit code is the number of the first test that failed.
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include "XrdCl/XrdClBuffer.hh"
+#include "XrdCl/XrdClFile.hh"
+#include "XrdSsi/XrdSsiErrInfo.hh"
+#include "XrdSsi/XrdSsiProvider.hh"
+#include "XrdSsi/XrdSsiRequest.hh"
+#include "XrdSsi/XrdSsiResource.hh"
+#include "XrdSsi/XrdSsiRRInfo.hh"
+#include "XrdSsi/XrdSsiService.hh"
+#include "XrdSys/XrdSysPthread.hh"
+
+using namespace std;
+
+/******************************************************************************/
+/*                          U n i t   G l o b a l s                           */
+/******************************************************************************/
+
+extern XrdSsiProvider *XrdSsiProviderClient;
+
+namespace
+{
+int            numReqs  = 64;
+const char    *MeMe     = "xrdssibatchtest: ";
+const int      hdrSz    = sizeof(XrdSsiRRInfo);
+
+XrdSysMutex     doneMutex;
+XrdSysSemaphore doneSem(0);
+int             numDone  = 0;
+int             numBad   = 0;
+}
+
+#define SAY(x) cerr <<MeMe <<x <<endl
+
+/******************************************************************************/
+/*                               V e r i f y                                  */
+/******************************************************************************/
+
+namespace
+{
+// Check that the response of a "D <bytes>" request is what it should be.
+//
+bool Verify(const char *buff, int blen, int bytes)
+{
+   if (blen != bytes) return false;
+   for (int i = 0; i < blen; i++) if (buff[i] != (char)(i % 251)) return false;
+   return true;
+}
+
+/******************************************************************************/
+/*                            A d d R e q u e s t                             */
+/******************************************************************************/
+
+// Append a "D <bytes>" request with the given id to a batch.
+//
+void AddRequest(string &batch, unsigned int id, int bytes)
+{
+   XrdSsiRRInfo rrInfo;
+   char rBuff[32];
+   int  rLen = snprintf(rBuff, sizeof(rBuff), "D %d", bytes);
+
+   rrInfo.Id(id); rrInfo.Size(rLen);
+   batch.append((const char *)rrInfo.Data(), hdrSz);
+   batch.append(rBuff, rLen);
+}
+
+/******************************************************************************/
+/*                             S e n d B a t c h                              */
+/******************************************************************************/
+
+XrdCl::XRootDStatus SendBatch(XrdCl::File &file, const string &batch)
+{
+   XrdSsiRRInfo rrInfo;
+
+   rrInfo.Id(0); rrInfo.Cmd(XrdSsiRRInfo::Rbq); rrInfo.Size(batch.size());
+   return file.Write(rrInfo.Info(), batch.size(), batch.data());
+}
+
+/******************************************************************************/
+/*                            G e t R e p l i e s                             */
+/******************************************************************************/
+
+// Ask for the responses of the given requests until all of them came back.
+// Each request id i asked for "D <sizes[i]>".
+//
+bool GetReplies(XrdCl::File &file, const vector<int> &sizes)
+{
+   vector<bool> gotIt(sizes.size(), false);
+   XrdSsiRRInfo rrInfo;
+   size_t left = sizes.size();
+
+   for (int tries = 0; left && tries < 100; tries++)
+       {XrdCl::Buffer qBuff(hdrSz*left), *rBuff = 0;
+        int n = 0;
+        for (size_t i = 0; i < sizes.size(); i++)
+            if (!gotIt[i])
+               {rrInfo.Id(i); rrInfo.Cmd(XrdSsiRRInfo::Rbw);
+                memcpy(qBuff.GetBuffer(hdrSz*n++), rrInfo.Data(), hdrSz);
+               }
+        XrdCl::XRootDStatus st = file.Fcntl(qBuff, rBuff);
+        if (!st.IsOK())
+           {SAY("Rbw query failed; " <<st.ToString()); return false;}
+
+   // Each response is preceded by its request info and an attn header
+   //
+        const char *bNow = (rBuff ? rBuff->GetBuffer() : 0);
+        const char *bEnd = bNow + (rBuff ? rBuff->GetSize() : 0);
+        while(bEnd - bNow >= hdrSz)
+             {XrdSsiRRInfoAttn aHdr;
+              unsigned int id, rSz, pfx, mdLen;
+              memcpy((void *)&rrInfo, bNow, hdrSz);
+              id = rrInfo.Id(); rSz = rrInfo.Size(); bNow += hdrSz;
+              if (rSz > (unsigned int)(bEnd - bNow) || rSz < sizeof(aHdr))
+                 {SAY("Malformed batch response"); delete rBuff; return false;}
+              memcpy(&aHdr, bNow, sizeof(aHdr));
+              pfx = ntohs(aHdr.pfxLen); mdLen = ntohl(aHdr.mdLen);
+              if (id >= sizes.size() || gotIt[id]
+              ||  aHdr.tag != XrdSsiRRInfoAttn::fullResp
+              ||  !Verify(bNow+pfx+mdLen, rSz-pfx-mdLen, sizes[id]))
+                 {SAY("Wrong response for request " <<id); delete rBuff;
+                  return false;
+                 }
+              gotIt[id] = true; left--;
+              bNow += rSz;
+             }
+        delete rBuff;
+        if (left) usleep(10000);
+       }
+
+   if (left) SAY(left <<" responses never came back");
+   return left == 0;
+}
+
+/******************************************************************************/
+/*                        c l a s s   R e q u e s t                           */
+/******************************************************************************/
+
+class Request : public XrdSsiRequest
+{
+public:
+
+char   *GetRequest(int &dlen) {dlen = rLen; return rBuff;}
+
+bool    ProcessResponse(const XrdSsiErrInfo &eInfo, const XrdSsiRespInfo &rInfo);
+
+PRD_Xeq ProcessResponseData(const XrdSsiErrInfo &eInfo, char *buff, int blen,
+                            bool last) {return PRD_Normal;}
+
+        Request(int bytes) : rBytes(bytes)
+                  {rLen = snprintf(rBuff, sizeof(rBuff), "D %d", bytes);}
+       ~Request() {}
+
+private:
+void    Done(bool isOK);
+
+int             rBytes;
+int             rLen;
+char            rBuff[32];
+};
+
+/******************************************************************************/
+
+void Request::Done(bool isOK)
+{
+   Finished();
+   doneMutex.Lock();
+   if (!isOK) numBad++;
+   if (++numDone == numReqs) doneSem.Post();
+   doneMutex.UnLock();
+   delete this;
+}
+
+/******************************************************************************/
+
+bool Request::ProcessResponse(const XrdSsiErrInfo &eInfo,
+                              const XrdSsiRespInfo &rInfo)
+{
+   if (eInfo.hasError())
+      {SAY("Request failed; " <<eInfo.Get()); Done(false);}
+      else if (rInfo.rType != XrdSsiRespInfo::isData)
+              {SAY("Response is not data!"); Done(false);}
+      else if (!Verify(rInfo.buff, rInfo.blen, rBytes))
+              {SAY("Wrong response for 'D " <<rBytes <<"'"); Done(false);}
+      else Done(true);
+   return true;
+}
+}
+
+/******************************************************************************/
+/*                                  m a i n                                   */
+/******************************************************************************/
+
+int main(int argc, char **argv)
+{
+   const char *Usage = "Usage: xrdssibatchtest [-n <reqs>] <host>:<port> "
+                       "[<resource>]";
+   XrdSsiErrInfo  eInfo;
+   XrdSsiService *servP;
+   XrdCl::File    file;
+   XrdCl::XRootDStatus st;
+   vector<int>    sizes;
+   string         batch, url, rName;
+   char c;
+
+// Process the options
+//
+   while ((c = getopt(argc, argv, "n:")) != (char)-1)
+         {switch(c)
+                {case 'n': numReqs = atoi(optarg); break;
+                 default:  SAY(Usage); return 1;
+                }
+         }
+   if (optind >= argc || numReqs <= 0) {SAY(Usage); return 1;}
+   rName = (optind+1 < argc ? argv[optind+1] : "/ssitest");
+   url   = string("root://") + argv[optind] + "/" + rName;
+
+// Open the resource the way the client does
+//
+   st = file.Open(url, XrdCl::OpenFlags::Read);
+   if (!st.IsOK())
+      {SAY("Unable to open " <<url <<"; " <<st.ToString()); return 1;}
+
+// Test 1: a batch with a duplicate request id must be rejected
+//
+   AddRequest(batch, 0, 10);
+   AddRequest(batch, 1, 20);
+   AddRequest(batch, 0, 30);
+   if (SendBatch(file, batch).IsOK())
+      {SAY("Batch with a duplicate request id was accepted!"); return 1;}
+   SAY("Test 1 passed: duplicate request id rejected");
+
+// Test 2: a valid batch and its responses with one query per round. None of
+// the ids of the rejected batch may be in use now.
+//
+   batch.clear();
+   for (int i = 0; i < 8; i++)
+       {sizes.push_back(i*131 + (i & 1));
+        AddRequest(batch, i, sizes.back());
+       }
+   st = SendBatch(file, batch);
+   if (!st.IsOK()) {SAY("Valid batch rejected; " <<st.ToString()); return 2;}
+   if (!GetReplies(file, sizes)) return 2;
+   SAY("Test 2 passed: batch responses demultiplexed");
+   st = file.Close();
+
+// Test 3: many concurrent requests through the client with batching on. They
+// all go through one reusable session so that they end up in a few batches.
+//
+   setenv("XRDSSIBATCH",   "65536", 1);
+   setenv("XRDSSIBATCHMS", "5",     1);
+   if (!(servP = XrdSsiProviderClient->GetService(eInfo, argv[optind])))
+      {SAY("Unable to get service; " <<eInfo.Get()); return 3;}
+   XrdSsiResource rSpec(rName, "", "", "", XrdSsiResource::Reusable);
+
+   for (int i = 0; i < numReqs; i++)
+       servP->ProcessRequest(*(new Request(i*37 + 1)), rSpec);
+   doneSem.Wait();
+   servP->Stop();
+   if (numBad) {SAY(numBad <<" of " <<numReqs <<" requests failed"); return 3;}
+   SAY("Test 3 passed: " <<numReqs <<" batched requests answered");
+   return 0;
+}
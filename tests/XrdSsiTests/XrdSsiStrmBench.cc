@@ -0,0 +1,239 @@
+/******************************************************************************/
+/*                                                                            */
+/*                    X r d S s i S t r m B e n c h . c c                     */
+/*                                                                            */
+/* This file is part of the XRootD software suite.                            */
+/*                                                                            */
+/* XRootD is free software: you can redistribute it and/or modify it under    */
+/* the terms of the GNU Lesser General Public License as published by the     */
+/* Free Software Foundation, either version 3 of the License, or (at your     */
+/* option) any later version.                                                 */
+/*                                                                            */
+/* XRootD is distributed in the hope that it will be useful, but WITHOUT      */
+/* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or      */
+/* FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public       */
+/* License for more details.                                                  */
+/*                                                                            */
+/* You should have received a copy of the GNU Lesser General Public License   */
+/* along with XRootD in a file called COPYING.LESSER (LGPL license) and file  */
+/* COPYING (GPL license).  If not, see <http://www.gnu.org/licenses/>.        */
+/*                                                                            */
+/* The copyright holder's institutional names and contributor's names may not */
+/* be used to endorse or promote products derived from this software without  */
+/* specific prior written permission of the institution or contributor.       */
+/******************************************************************************/
+
+/* Benchmark for SSI stream responses. A single request is sent to a server
+   running the libXrdSsiStrmSvc service which answers with a stream of the
+   requested size. The stream is read back in pieces of the given size and the
+   transfer rate is reported.
+
+   Usage: xrdssistrmbench [-b <bsize>] [-m] [-p] [-r <rsize>] [-s <size>]
+                          [-v] <host>:<port> [<resource>]
+
+   -b   size of the buffers an active stream hands out, default 1m.
+   -m   let the active stream have more than one buffer outstanding.
+   -p   have the server use a passive stream (i.e. copy the data).
+   -r   size of each read, default 8m.
+   -s   size of the response, default 4g.
+   -v   verify every byte of the response.
+
+   Sizes may be suffixed by k, m or g.
+*/
+
+#include <iostream>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "XrdSsi/XrdSsiErrInfo.hh"
+#include "XrdSsi/XrdSsiProvider.hh"
+#include "XrdSsi/XrdSsiRequest.hh"
+#include "XrdSsi/XrdSsiResource.hh"
+#include "XrdSsi/XrdSsiService.hh"
+#include "XrdSys/XrdSysPthread.hh"
+
+using namespace std;
+
+/******************************************************************************/
+/*                          U n i t   G l o b a l s                           */
+/******************************************************************************/
+
+extern XrdSsiProvider *XrdSsiProviderClient;
+
+namespace
+{
+long long      strmSize = 4LL*1024*1024*1024;
+int            buffSize = 1024*1024;
+int            readSize = 8*1024*1024;
+bool           doVerify = false;
+bool           isActive = true;
+bool           isMulti  = false;
+const char    *MeMe     = "xrdssistrmbench: ";
+}
+
+#define SAY(x) cerr <<MeMe <<x <<endl
+
+/******************************************************************************/
+/*                        c l a s s   R e q u e s t                           */
+/******************************************************************************/
+
+namespace
+{
+class Request : public XrdSsiRequest
+{
+public:
+
+char   *GetRequest(int &dlen) {dlen = rLen; return rBuff;}
+
+bool    ProcessResponse(const XrdSsiErrInfo &eInfo, const XrdSsiRespInfo &rInfo);
+
+PRD_Xeq ProcessResponseData(const XrdSsiErrInfo &eInfo, char *buff, int blen,
+                            bool last);
+
+bool    Wait() {doneSem.Wait(); return aOK;}
+
+long long Bytes() {return rBytes;}
+
+        Request() : doneSem(0), rBytes(0), aOK(false)
+                  {rLen = snprintf(rBuff, sizeof(rBuff), "%c %lld %d",
+                                   (isActive ? (isMulti ? 'M' : 'A') : 'P'),
+                                   strmSize, buffSize);
+                   if (!(dBuff = (char *)malloc(readSize)))
+                      {SAY("Unable to allocate read buffer!"); exit(2);}
+                  }
+       ~Request() {free(dBuff);}
+
+private:
+void    Done(bool isOK) {aOK = isOK; Finished(); doneSem.Post();}
+
+XrdSysSemaphore doneSem;
+char           *dBuff;
+long long       rBytes;
+int             rLen;
+bool            aOK;
+char            rBuff[128];
+};
+
+/******************************************************************************/
+
+bool Request::ProcessResponse(const XrdSsiErrInfo &eInfo,
+                              const XrdSsiRespInfo &rInfo)
+{
+   if (eInfo.hasError())
+      {SAY("Request failed; " <<eInfo.Get()); Done(false);}
+      else if (rInfo.rType != XrdSsiRespInfo::isStream)
+              {SAY("Response is not a stream!"); Done(false);}
+              else GetResponseData(dBuff, readSize);
+   return true;
+}
+
+/******************************************************************************/
+
+XrdSsiRequest::PRD_Xeq Request::ProcessResponseData(const XrdSsiErrInfo &eInfo,
+                                                    char *buff, int blen,
+                                                    bool last)
+{
+   if (blen < 0)
+      {SAY("Stream failed; " <<eInfo.Get()); Done(false); return PRD_Normal;}
+
+// Verify the data, if so wanted
+//
+   if (doVerify)
+      for (int i = 0; i < blen; i++)
+          {if (buff[i] != (char)(((rBytes+i) % buffSize) % 251))
+              {SAY("Data mismatch at offset " <<rBytes+i); Done(false);
+               return PRD_Normal;
+              }
+          }
+   rBytes += blen;
+
+// Get more data or finish up
+//
+   if (!last) GetResponseData(dBuff, readSize);
+      else Done(rBytes == strmSize);
+   return PRD_Normal;
+}
+}
+
+/******************************************************************************/
+/*                               G e t S i z e                                */
+/******************************************************************************/
+
+long long GetSize(const char *arg)
+{
+   long long val;
+   char *eP;
+
+   val = strtoll(arg, &eP, 10);
+   switch(*eP)
+         {case 'k': case 'K': val *= 1024;               eP++; break;
+          case 'm': case 'M': val *= 1024*1024;          eP++; break;
+          case 'g': case 'G': val *= 1024LL*1024*1024;   eP++; break;
+          default: break;
+         }
+   if (*eP || val <= 0)
+      {SAY("Invalid size - " <<arg); exit(1);}
+   return val;
+}
+
+/******************************************************************************/
+/*                                  m a i n                                   */
+/******************************************************************************/
+
+int main(int argc, char **argv)
+{
+   const char *Usage = "Usage: xrdssistrmbench [-b <bsize>] [-m] [-p] "
+                       "[-r <rsize>] [-s <size>] [-v] <host>:<port> "
+                       "[<resource>]";
+   XrdSsiErrInfo  eInfo;
+   XrdSsiService *servP;
+   Request       *reqP;
+   struct timeval tBeg, tEnd;
+   double elapsed;
+   bool   aOK;
+   char   c;
+
+// Process the options
+//
+   while ((c = getopt(argc, argv, "b:mpr:s:v")) != (char)-1)
+         {switch(c)
+                {case 'b': buffSize = (int)GetSize(optarg); break;
+                 case 'm': isMulti  = true;                 break;
+                 case 'p': isActive = false;                break;
+                 case 'r': readSize = (int)GetSize(optarg); break;
+                 case 's': strmSize = GetSize(optarg);      break;
+                 case 'v': doVerify = true;                 break;
+                 default:  SAY(Usage); return 1;
+                }
+         }
+   if (optind >= argc) {SAY(Usage); return 1;}
+
+// Get the service object for the server
+//
+   if (!(servP = XrdSsiProviderClient->GetService(eInfo, argv[optind])))
+      {SAY("Unable to get service; " <<eInfo.Get()); return 2;}
+   XrdSsiResource rSpec((optind+1 < argc ? argv[optind+1] : "/ssitest"));
+
+// Send off the request and wait for the whole response
+//
+   reqP = new Request;
+   gettimeofday(&tBeg, 0);
+   servP->ProcessRequest(*reqP, rSpec);
+   aOK = reqP->Wait();
+   gettimeofday(&tEnd, 0);
+
+// Report the result
+//
+   elapsed = (tEnd.tv_sec - tBeg.tv_sec) + (tEnd.tv_usec - tBeg.tv_usec)/1e6;
+   printf("%s stream: %lld bytes in %.3fs = %.1f MB/s%s\n",
+          (isActive ? (isMulti ? "multi-buffer active" : "active")
+                    : "passive"), reqP->Bytes(), elapsed,
+          reqP->Bytes()/elapsed/(1024*1024), (aOK ? "" : " (failed)"));
+   delete reqP;
+   servP->Stop();
+   return (aOK ? 0 : 3);
+}
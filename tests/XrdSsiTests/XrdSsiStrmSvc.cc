@@ -0,0 +1,242 @@
+/******************************************************************************/
+/*                                                                            */
+/*                      X r d S s i S t r m S v c . c c                       */
+/*                                                                            */
+/* This file is part of the XRootD software suite.                            */
+/*                                                                            */
+/* XRootD is free software: you can redistribute it and/or modify it under    */
+/* the terms of the GNU Lesser General Public License as published by the     */
+/* Free Software Foundation, either version 3 of the License, or (at your     */
+/* option) any later version.                                                 */
+/*                                                                            */
+/* XRootD is distributed in the hope that it will be useful, but WITHOUT      */
+/* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or      */
+/* FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public       */
+/* License for more details.                                                  */
+/*                                                                            */
+/* You should have received a copy of the GNU Lesser General Public License   */
+/* along with XRootD in a file called COPYING.LESSER (LGPL license) and file  */
+/* COPYING (GPL license).  If not, see <http://www.gnu.org/licenses/>.        */
+/*                                                                            */
+/* The copyright holder's institutional names and contributor's names may not */
+/* be used to endorse or promote products derived from this software without  */
+/* specific prior written permission of the institution or contributor.       */
+/******************************************************************************/
+
+/* Server-side service used by xrdssistrmbench and xrdssibatchtest. Every
+   request has the form
+
+      {A|M|P} <bytes> <bsize>
+
+   and is answered by a stream of <bytes> bytes. An active stream (A) hands
+   out buffers of <bsize> bytes that all refer to one read-only block of data,
+   so the data is never copied by the service. An M stream is the same but
+   allows more than one of its buffers to be outstanding. A passive stream (P)
+   copies the data into whatever buffer it is given. Byte n of the response is always
+   (n % <bsize>) % 251 so that the client can verify what it got. A request
+
+      D <bytes>
+
+   is answered right away by a data response of <bytes> bytes where byte n is
+   n % 251.
+
+   Load it with: ssi.svclib libXrdSsiStrmSvc.so
+*/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "XrdSsi/XrdSsiErrInfo.hh"
+#include "XrdSsi/XrdSsiProvider.hh"
+#include "XrdSsi/XrdSsiRequest.hh"
+#include "XrdSsi/XrdSsiResource.hh"
+#include "XrdSsi/XrdSsiResponder.hh"
+#include "XrdSsi/XrdSsiService.hh"
+#include "XrdSsi/XrdSsiStream.hh"
+#include "XrdSys/XrdSysPthread.hh"
+
+/******************************************************************************/
+/*                         L o c a l   C l a s s e s                          */
+/******************************************************************************/
+
+namespace
+{
+XrdSysMutex   blkMutex;
+char         *blkData = 0;
+int           blkSize = 0;
+
+// Return a block of the requested size filled with the data pattern. We keep
+// the largest one ever asked for as a smaller one is simply its prefix.
+//
+const char *GetBlock(int bsize)
+{
+   XrdSysMutexHelper mHelp(blkMutex);
+
+   if (bsize > blkSize)
+      {char *bP = (char *)malloc(bsize);
+       if (!bP) return 0;
+       for (int i = 0; i < bsize; i++) bP[i] = i % 251;
+       blkData = bP; blkSize = bsize; // The old block may still be in use
+      }
+   return blkData;
+}
+
+/******************************************************************************/
+/*                           c l a s s   S t r m                              */
+/******************************************************************************/
+
+class Strm : public XrdSsiStream
+{
+public:
+
+class Buff : public XrdSsiStream::Buffer
+{
+public:
+void    Recycle() {delete this;}
+
+        Buff(const char *dP) : Buffer(const_cast<char *>(dP)) {}
+       ~Buff() {}
+};
+
+XrdSsiStream::Buffer *GetBuff(XrdSsiErrInfo &eRef, int &dlen, bool &last)
+                     {if (bLeft <= 0) {last = true; return 0;}
+                      dlen = (bLeft > bSize ? bSize : (int)bLeft);
+                      bLeft -= dlen;
+                      last = (bLeft <= 0);
+                      return new Buff(bData);
+                     }
+
+int                   SetBuff(XrdSsiErrInfo &eRef, char *buff, int blen,
+                              bool &last)
+                     {int dlen, xlen = 0;
+                      while(blen > 0 && bLeft > 0)
+                           {dlen = bSize - bOff;
+                            if (dlen > blen)  dlen = blen;
+                            if (dlen > bLeft) dlen = (int)bLeft;
+                            memcpy(buff, bData+bOff, dlen);
+                            buff += dlen; blen -= dlen; xlen += dlen;
+                            bLeft -= dlen;
+                            if ((bOff += dlen) >= bSize) bOff = 0;
+                           }
+                      last = (bLeft <= 0);
+                      return xlen;
+                     }
+
+      Strm(char mode, long long bytes, const char *bP, int bsize)
+          : XrdSsiStream((mode == 'P' ? isPassive : isActive), mode == 'M'),
+            bData(bP), bLeft(bytes), bSize(bsize), bOff(0) {}
+     ~Strm() {}
+
+private:
+
+const char *bData;
+long long   bLeft;
+int         bSize;
+int         bOff;
+};
+
+/******************************************************************************/
+/*                           c l a s s   R e s p                              */
+/******************************************************************************/
+
+class Resp : public XrdSsiResponder
+{
+public:
+
+void   Finished(XrdSsiRequest &rqstR, const XrdSsiRespInfo &rInfo, bool cancel)
+               {UnBindRequest(); delete this;}
+
+void   Start(XrdSsiRequest &rqstR);
+
+       Resp() : strmP(0) {}
+      ~Resp() {if (strmP) delete strmP;}
+
+private:
+
+Strm  *strmP;
+};
+
+/******************************************************************************/
+
+void Resp::Start(XrdSsiRequest &rqstR)
+{
+   const char *bP;
+   char rBuff[128], mode;
+   long long bytes;
+   int  rLen, bsize;
+
+// Get the request and parse it
+//
+   BindRequest(rqstR);
+   bP = rqstR.GetRequest(rLen);
+   if (rLen >= (int)sizeof(rBuff)) rLen = sizeof(rBuff)-1;
+   memcpy(rBuff, bP, rLen); rBuff[rLen] = 0;
+   ReleaseRequestBuffer();
+
+   if (*rBuff == 'D')
+      {if (sscanf(rBuff, "%c %d", &mode, &bsize) != 2 || bsize < 0)
+          {SetErrResponse("Invalid request", EINVAL); return;}
+       if (!(bP = GetBlock(bsize ? bsize : 1)))
+          {SetErrResponse("Insufficient memory", ENOMEM); return;}
+       SetResponse(bP, bsize);
+       return;
+      }
+
+   if (sscanf(rBuff, "%c %lld %d", &mode, &bytes, &bsize) != 3
+   ||  !strchr("AMP", mode) || bytes < 0 || bsize <= 0)
+      {SetErrResponse("Invalid request", EINVAL); return;}
+
+// Respond with the stream
+//
+   if (!(bP = GetBlock(bsize)))
+      {SetErrResponse("Insufficient memory", ENOMEM); return;}
+   strmP = new Strm(mode, bytes, bP, bsize);
+   SetResponse(strmP);
+}
+
+/******************************************************************************/
+/*                        c l a s s   S e r v i c e                           */
+/******************************************************************************/
+
+class Service : public XrdSsiService
+{
+public:
+
+void ProcessRequest(XrdSsiRequest &rqstR, XrdSsiResource &rsrc)
+                   {(new Resp)->Start(rqstR);}
+
+     Service() {}
+    ~Service() {}
+};
+
+/******************************************************************************/
+/*                       c l a s s   P r o v i d e r                          */
+/******************************************************************************/
+
+class Provider : public XrdSsiProvider
+{
+public:
+
+XrdSsiService *GetService(XrdSsiErrInfo &eInfo, const std::string &contact,
+                          int oHold=256) {return new Service;}
+
+bool           Init(XrdSsiLogger *logP, XrdSsiCluster *clsP, std::string cfgFn,
+                    std::string parms, int argc, char **argv) {return true;}
+
+rStat          QueryResource(const char *rName, const char *contact=0)
+                            {return isPresent;}
+
+               Provider() {}
+              ~Provider() {}
+};
+
+Provider theProvider;
+}
+
+/******************************************************************************/
+/*                     P r o v i d e r   E x p o r t                          */
+/******************************************************************************/
+
+XrdSsiProvider *XrdSsiProviderServer = &theProvider;